@@ -9,5 +9,9 @@
 #include "minicore/clustering/l1.h"
 #include "minicore/clustering/centroid.h"
 #include "minicore/clustering/solve.h"
+#include "minicore/clustering/incremental.h"
+#include "minicore/clustering/outofcore.h"
+#include "minicore/clustering/restarts.h"
+#include "minicore/clustering/ksweep.h"
 
 #endif /* MINOCORE_CLUSTERING_HEADERS_H__ */
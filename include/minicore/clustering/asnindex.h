@@ -0,0 +1,115 @@
+#ifndef MINOCORE_CLUSTERING_ASNINDEX_H__
+#define MINOCORE_CLUSTERING_ASNINDEX_H__
+#include <vector>
+#include <numeric>
+#include <stdexcept>
+#include <atomic>
+#include "minicore/util/macros.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace minicore { namespace clustering {
+
+/*
+ * AssignmentIndex
+ * Rows grouped by their assigned cluster: perm_[offsets_[c]:offsets_[c + 1]] holds the ids of rows assigned to c,
+ * in increasing order, so per-cluster loops stream through the data in order.
+ *
+ * build() is a parallel counting sort: the rows are split into contiguous blocks, each of which is histogrammed
+ * and then scattered to offsets computed in (cluster, block) order, which keeps every cluster's rows sorted.
+ * This replaces per-cluster scans over asn (O(nk)) and vector-of-vectors buckets.
+ */
+template<typename IT=uint32_t>
+struct AssignmentIndex {
+    std::vector<IT> perm_;
+    std::vector<size_t> offsets_;
+
+    AssignmentIndex() {}
+    template<typename AsnT>
+    AssignmentIndex(const AsnT &asn, size_t np, size_t k) {build(asn, np, k);}
+
+    template<typename AsnT>
+    void build(const AsnT &asn, size_t np, size_t k) {
+        perm_.resize(np);
+        offsets_.assign(k + 1, 0);
+        int nb = 1;
+#ifdef _OPENMP
+        // Threads only pay off once each has a few thousand rows to histogram
+        nb = std::max(1, std::min(omp_get_max_threads(), int(np / 4096)));
+#endif
+        // Rows are split into nb blocks, which are distributed with omp for, so that every block is counted
+        // even if the team is smaller than requested (e.g., when nested)
+        std::vector<size_t> counts(size_t(nb) * k);
+        const size_t blocksz = (np + nb - 1) / nb;
+        std::atomic<bool> out_of_range{false};
+        OMP_PRAGMA("omp parallel num_threads(nb)")
+        {
+            OMP_PRAGMA("omp for schedule(static, 1)")
+            for(int b = 0; b < nb; ++b) {
+                const size_t start = std::min(np, b * blocksz), stop = std::min(np, start + blocksz);
+                size_t *cnt = counts.data() + b * k;
+                for(size_t i = start; i < stop; ++i) {
+                    const size_t a = asn[i];
+                    if(unlikely(a >= k)) {
+                        out_of_range.store(true, std::memory_order_relaxed);
+                        continue;
+                    }
+                    ++cnt[a];
+                }
+            }
+            OMP_PRAGMA("omp single")
+            {
+                size_t total = 0;
+                for(size_t c = 0; c < k; ++c) {
+                    offsets_[c] = total;
+                    for(int b = 0; b < nb; ++b) {
+                        const size_t v = counts[b * k + c];
+                        counts[b * k + c] = total;
+                        total += v;
+                    }
+                }
+                offsets_[k] = total;
+            }
+            OMP_PRAGMA("omp for schedule(static, 1)")
+            for(int b = 0; b < nb; ++b) {
+                const size_t start = std::min(np, b * blocksz), stop = std::min(np, start + blocksz);
+                size_t *cnt = counts.data() + b * k;
+                for(size_t i = start; i < stop; ++i)
+                    if(likely(size_t(asn[i]) < k))
+                        perm_[cnt[asn[i]]++] = i;
+            }
+        }
+        if(out_of_range) throw std::out_of_range("Assignment out of range for AssignmentIndex");
+    }
+    size_t ncenters() const {return offsets_.empty() ? size_t(0): offsets_.size() - 1;}
+    size_t size(size_t c) const {return offsets_[c + 1] - offsets_[c];}
+    bool empty(size_t c) const {return offsets_[c + 1] == offsets_[c];}
+    const IT *data(size_t c) const {return perm_.data() + offsets_[c];}
+    const IT *begin(size_t c) const {return data(c);}
+    const IT *end(size_t c) const {return perm_.data() + offsets_[c + 1];}
+    // Contiguous view of the rows assigned to one cluster
+    struct Range {
+        const IT *b_, *e_;
+        const IT *begin() const {return b_;}
+        const IT *end() const {return e_;}
+        const IT *data() const {return b_;}
+        size_t size() const {return e_ - b_;}
+        bool empty() const {return b_ == e_;}
+        IT operator[](size_t i) const {return b_[i];}
+    };
+    Range operator[](size_t c) const {return Range{begin(c), end(c)};}
+    // Clusters with no assigned rows
+    std::vector<IT> orphans() const {
+        std::vector<IT> ret;
+        for(size_t c = 0; c < ncenters(); ++c) if(empty(c)) ret.push_back(c);
+        return ret;
+    }
+};
+
+} // namespace clustering
+using clustering::AssignmentIndex;
+
+} // namespace minicore
+
+#endif /* MINOCORE_CLUSTERING_ASNINDEX_H__ */
@@ -2,8 +2,12 @@
 #define MINOCORE_CLUSTERING_CENTROID_H__
 #include "minicore/util/blaze_adaptor.h"
 #include "minicore/util/csc.h"
+#include "minicore/util/wsample.h"
 #include "minicore/dist.h"
 #include "minicore/optim/kmedian.h"
+#include "minicore/clustering/asnindex.h"
+#include "minicore/clustering/geomedian.h"
+#include "minicore/clustering/sparsemedian.h"
 
 namespace minicore { namespace clustering {
 
@@ -91,7 +95,7 @@ void set_center(CtrT &ctr, const util::CSparseMatrix<DataT, IndicesT, IndPtrT> &
 #endif
     for(size_t i = 0; i < nasn; ++i) {
         auto r = row(mat, asn[i]);
-        const double dmul = winv / (rs ? double((*rs)[i]): 1.);
+        const double dmul = winv / (rs ? double((*rs)[asn[i]]): 1.);
         if(w) {
             VT itemw = (*w)[asn[i]] * dmul;
             SK_UNROLL_4
@@ -277,11 +281,7 @@ struct CentroidPolicy {
                                 const blaze::Vector<WPT, WSO> *weight_cv=nullptr, const PriorData *pd=nullptr)
     {
         // Scale weights up if necessary
-        std::vector<blaze::SmallArray<uint32_t, 16>> assignv(centers.size());
-        for(size_t i = 0; i < assignments.size(); ++i) {
-            assert(assignments[i] < centers.size());
-            assignv.at(assignments[i]).pushBack(i);
-        }
+        const AssignmentIndex<uint32_t> assignv(assignments, assignments.size(), centers.size());
         if(measure == dist::TVD || measure == dist::L1) {
             using ptr_t = decltype((**weight_cv).data());
             ptr_t ptr = nullptr;
@@ -433,15 +433,11 @@ template<typename FT=double, typename Mat, typename AsnT, typename CostsT, typen
 void set_centroids_l1(const Mat &mat, AsnT &asn, CostsT &costs, CtrsT &ctrs, WeightsT *weights) {
     const unsigned k = ctrs.size();
     using asn_t = std::decay_t<decltype(asn[0])>;
-    std::vector<std::vector<asn_t>> assigned(ctrs.size());
     assert(costs.size() == asn.size());
-    for(size_t i = 0; i < costs.size(); ++i) {
-        assert(asn[i] < assigned.size());
-        blz::push_back(assigned[asn[i]], i);
-    }
+    AssignmentIndex<asn_t> assigned(asn, costs.size(), k);
     blaze::SmallArray<asn_t, 16> sa;
     wy::WyRand<asn_t, 4> rng(costs.size());
-    for(unsigned i = 0; i < k; ++i) if(assigned[i].empty()) blz::push_back(sa, i);
+    for(unsigned i = 0; i < k; ++i) if(assigned.empty(i)) blz::push_back(sa, i);
     while(!sa.empty()) {
         std::vector<uint32_t> idxleft;
         for(unsigned i = 0; i < k; ++i)
@@ -464,7 +460,7 @@ void set_centroids_l1(const Mat &mat, AsnT &asn, CostsT &costs, CtrsT &ctrs, Wei
         }
         // Use D2 sampling to re-seed
         for(const auto idx: sa) {
-            std::ptrdiff_t found = reservoir_simd::sample(costs.data(), costs.size(), rng());
+            std::ptrdiff_t found = util::parallel_weighted_sample(costs.size(), rng(), [&](size_t i) {return weights ? double(costs[i]) * (*weights)[i]: double(costs[i]);});
             set_center(ctrs[idx], row(mat, found));
             for(size_t i = 0; i < mat.rows(); ++i) {
                 const auto c = l1Dist(ctrs[idx], row(mat, i, unchecked));
@@ -474,13 +470,15 @@ void set_centroids_l1(const Mat &mat, AsnT &asn, CostsT &costs, CtrsT &ctrs, Wei
                 }
             }
         }
-        for(auto &subasn: assigned) subasn.clear();
         // Check for orphans again
         sa.clear();
-        for(size_t i = 0; i < costs.size(); ++i) {
-            blz::push_back(assigned[asn[i]], i);
-        }
-        for(const auto &subasn: assigned) if(subasn.empty()) sa.pushBack(&subasn - assigned.data());
+        assigned.build(asn, costs.size(), k);
+        for(unsigned i = 0; i < k; ++i) if(assigned.empty(i)) sa.pushBack(i);
+    }
+    if constexpr(!blaze::IsMatrix_v<Mat>) {
+        for(unsigned i = 0; i < k; ++i) MINOCORE_VALIDATE(!assigned.empty(i));
+        sparse_l1_medians<FT>(mat, assigned, ctrs, weights);
+        return;
     }
     for(unsigned i = 0; i < k; ++i) {
         const auto &asnv = assigned[i];
@@ -509,15 +507,11 @@ template<typename FT=double, typename Mat, typename AsnT, typename CostsT, typen
 void set_centroids_tvd(const Mat &mat, AsnT &asn, CostsT &costs, CtrsT &ctrs, WeightsT *weights, const RowSums &rsums) {
     const unsigned k = ctrs.size();
     using asn_t = std::decay_t<decltype(asn[0])>;
-    std::vector<std::vector<asn_t>> assigned(ctrs.size());
     assert(costs.size() == asn.size());
-    for(size_t i = 0; i < costs.size(); ++i) {
-        assert(asn[i] < assigned.size());
-        blz::push_back(assigned[asn[i]], i);
-    }
+    AssignmentIndex<asn_t> assigned(asn, costs.size(), k);
     blaze::SmallArray<asn_t, 16> sa;
     wy::WyRand<asn_t, 4> rng(costs.size());
-    for(unsigned i = 0; i < k; ++i) if(assigned[i].empty()) blz::push_back(sa, i);
+    for(unsigned i = 0; i < k; ++i) if(assigned.empty(i)) blz::push_back(sa, i);
     while(!sa.empty()) {
         std::vector<uint32_t> idxleft;
         for(unsigned i = 0; i < k; ++i)
@@ -540,7 +534,7 @@ void set_centroids_tvd(const Mat &mat, AsnT &asn, CostsT &costs, CtrsT &ctrs, We
         }
         // Use D2 sampling to re-seed
         for(const auto idx: sa) {
-            std::ptrdiff_t found = reservoir_simd::sample(costs.data(), costs.size(), rng());
+            std::ptrdiff_t found = util::parallel_weighted_sample(costs.size(), rng(), [&](size_t i) {return weights ? double(costs[i]) * (*weights)[i]: double(costs[i]);});
             assert(found < (std::ptrdiff_t)(costs.size()));
             set_center(ctrs[idx], row(mat, found));
             for(size_t i = 0; i < mat.rows(); ++i) {
@@ -551,13 +545,15 @@ void set_centroids_tvd(const Mat &mat, AsnT &asn, CostsT &costs, CtrsT &ctrs, We
                 }
             }
         }
-        for(auto &subasn: assigned) subasn.clear();
         // Check for orphans again
         sa.clear();
-        for(size_t i = 0; i < costs.size(); ++i) {
-            blz::push_back(assigned[asn[i]], i);
-        }
-        for(const auto &subasn: assigned) if(subasn.empty()) sa.pushBack(&subasn - assigned.data());
+        assigned.build(asn, costs.size(), k);
+        for(unsigned i = 0; i < k; ++i) if(assigned.empty(i)) sa.pushBack(i);
+    }
+    if constexpr(!blaze::IsMatrix_v<Mat>) {
+        for(unsigned i = 0; i < k; ++i) MINOCORE_VALIDATE(!assigned.empty(i));
+        sparse_l1_medians<FT>(mat, assigned, ctrs, weights, &rsums);
+        return;
     }
     for(unsigned i = 0; i < k; ++i) {
         const auto &asnv = assigned[i];
@@ -581,15 +577,12 @@ void set_centroids_tvd(Args &&...args) {
 template<typename FT=double, typename Mat, typename AsnT, typename CostsT, typename CtrsT, typename WeightsT, typename IT=uint32_t>
 void set_centroids_l2(const Mat &mat, AsnT &asn, CostsT &costs, CtrsT &ctrs, WeightsT *weights, double eps=0.) {
     using asn_t = std::decay_t<decltype(asn[0])>;
-    std::vector<std::vector<asn_t>> assigned(ctrs.size());
     const size_t np = costs.size();
     const unsigned k = ctrs.size();
-    for(size_t i = 0; i < np; ++i) {
-        blz::push_back(assigned[asn[i]], i);
-    }
+    AssignmentIndex<asn_t> assigned(asn, np, k);
     wy::WyRand<asn_t, 4> rng(costs.size());
     blaze::SmallArray<asn_t, 16> sa;
-    for(unsigned i = 0; i < k; ++i) if(assigned[i].empty()) blz::push_back(sa, i);
+    for(unsigned i = 0; i < k; ++i) if(assigned.empty(i)) blz::push_back(sa, i);
     while(!sa.empty()) {
         // Compute partial sum
         std::vector<uint32_t> idxleft;
@@ -613,7 +606,7 @@ void set_centroids_l2(const Mat &mat, AsnT &asn, CostsT &costs, CtrsT &ctrs, Wei
         }
         // Use D2 sampling to re-seed
         for(const auto idx: sa) {
-            std::ptrdiff_t found = reservoir_simd::sample(costs.data(), costs.size(), rng());
+            std::ptrdiff_t found = util::parallel_weighted_sample(costs.size(), rng(), [&](size_t i) {return weights ? double(costs[i]) * (*weights)[i]: double(costs[i]);});
             set_center(ctrs[idx], row(mat, found));
             OMP_PFOR
             for(size_t i = 0; i < mat.rows(); ++i) {
@@ -624,24 +617,13 @@ void set_centroids_l2(const Mat &mat, AsnT &asn, CostsT &costs, CtrsT &ctrs, Wei
                 }
             }
         }
-        for(auto &subasn: assigned) subasn.clear();
         // Check for orphans again
         sa.clear();
-        for(size_t i = 0; i < np; ++i) {
-            blz::push_back(assigned[asn[i]], i);
-        }
-        for(const auto &subasn: assigned) if(subasn.empty()) sa.pushBack(&subasn - assigned.data());
-    }
-    for(unsigned i = 0; i < k; ++i) {
-        const auto nasn = assigned[i].size();
-        const auto asp = assigned[i].data();
-        MINOCORE_VALIDATE(nasn != 0);
-        if(nasn == 1) {
-            set_center(ctrs[i], row(mat, *asp));
-        } else {
-            set_center_l2(ctrs[i], mat, asp, nasn, weights, eps);
-        }
+        assigned.build(asn, np, k);
+        for(unsigned i = 0; i < k; ++i) if(assigned.empty(i)) sa.pushBack(i);
     }
+    for(unsigned i = 0; i < k; ++i) MINOCORE_VALIDATE(!assigned.empty(i));
+    geomedians<FT>(mat, ctrs, [&](size_t i, const auto &f) {f(asn[i], weights ? double((*weights)[i]): 1.);}, eps);
 }
 
 template<typename FT=double, typename Mat, typename PriorT, typename AsnT, typename CostsT, typename CtrsT, typename WeightsT, typename IT=uint32_t, typename SumT>
@@ -661,14 +643,9 @@ bool set_centroids_full_mean(const Mat &mat,
     blaze::SmallArray<size_t, 16> sa;
     wy::WyRand<size_t, 4> rng(costs.size()); // Used for restarting orphaned centers
     const size_t np = costs.size(), k = ctrs.size();
-    auto assigned = std::make_unique<std::vector<size_t>[]>(k);
-    OMP_ONLY(std::unique_ptr<std::mutex[]> locks(new std::mutex[k]);)
-    for(size_t i = 0; i < np; ++i) {
-        OMP_ONLY(std::lock_guard<std::mutex> lock(locks[asn[i]]);)
-        assigned[asn[i]].push_back(i);
-    }
+    AssignmentIndex<size_t> assigned(asn, np, k);
     for(unsigned i = 0; i < k; ++i)
-        if(assigned[i].empty())
+        if(assigned.empty(i))
             blz::push_back(sa, i);
 #ifndef NDEBUG
     int nfails = 0;
@@ -691,8 +668,6 @@ bool set_centroids_full_mean(const Mat &mat,
         std::cerr << buf;
         const constexpr RestartMethodPol restartpol = RESTART_D2;
         const FT psum = prior.size() == 1 ? FT(prior[0]) * prior.size(): sum(prior);
-        OMP_PFOR
-        for(size_t i = 0; i < k; ++i) assigned[i].clear();
         std::vector<std::ptrdiff_t> rs;
         for(size_t i = 0; i < ne; ++i) {
             // Instead, use a temporary buffer to store partial sums and randomly select newly-started centers
@@ -704,7 +679,7 @@ bool set_centroids_full_mean(const Mat &mat,
                 r = rng() % costs.size();
             else {
                 assert(restartpol == RESTART_D2);
-                r = reservoir_simd::sample(costs.data(), costs.size(), rng());
+                r = util::parallel_weighted_sample(costs.size(), rng(), [&](size_t i) {return weights ? double(costs[i]) * (*weights)[i]: double(costs[i]);});
             }
             rs.push_back(r);
             const auto id = sa[i];
@@ -733,10 +708,6 @@ bool set_centroids_full_mean(const Mat &mat,
                 }
             }
             asn[i] = bestid;
-            OMP_CRITICAL
-            {
-                assigned[bestid].push_back(i);
-            }
         }
         for(size_t i = 0; i < ne; ++i) {
             auto pid = rs[i];
@@ -744,16 +715,14 @@ bool set_centroids_full_mean(const Mat &mat,
             if(asn[pid] != cid) {
                 asn[pid] = cid;
                 costs[pid] = 0.;
-                assigned[cid].push_back(pid);
             }
         }
+        assigned.build(asn, np, k);
     }
-    OMP_PFOR
-    for(unsigned i = 0; i < k; ++i) shared::sort(assigned[i].begin(), assigned[i].end());
 
     for(unsigned i = 0; i < k; ++i) {
-        const auto nasn = assigned[i].size();
-        const auto asp = assigned[i].data();
+        const auto nasn = assigned.size(i);
+        const auto asp = assigned.data(i);
         auto &ctr = ctrs[i];
         if(nasn == 0) continue;
         else if(nasn == 1) {
@@ -812,7 +781,13 @@ double set_centroids_full_mean(const Mat &mat,
     }
     //std::fprintf(stderr, "Sum of costs: %g\n", ret);
     //std::fprintf(stderr, "Now setting centers\n");
-    if(measure == distance::L2 || measure == distance::L1) {
+    if(measure == distance::L2) {
+        geomedians<FT>(mat, ctrs, [&](size_t i, const auto &f) {
+            const double w = weights ? double((*weights)[i]): 1.;
+            auto r = row(asns, i, unchecked);
+            for(size_t j = 0; j < k; ++j) f(j, w * r[j]);
+        });
+    } else if(measure == distance::L1) {
         //OMP_PFOR
         for(size_t i = 0; i < k; ++i) {
             blz::DV<FT, blz::columnVector> colweights;
@@ -823,17 +798,8 @@ double set_centroids_full_mean(const Mat &mat,
             } else {
                 colweights = trans(*weights) * column(asns, i, unchecked);
             }
-            if(measure == distance::L2) {
-                //std::fprintf(stderr, "l2 geomedian\n");
-                if constexpr(blaze::IsMatrix_v<Mat>) {
-                    geomedian(mat, ctrs[i], colweights.data());
-                } else {
-                    geomedian(mat, ctrs[i], (uint64_t *)nullptr, 0, &colweights);
-                }
-            } else {
-                //std::fprintf(stderr, "l1median\n");
-                l1_median(mat, ctrs[i], (uint64_t *)nullptr, 0, &colweights);
-            }
+            //std::fprintf(stderr, "l1median\n");
+            l1_median(mat, ctrs[i], (uint64_t *)nullptr, 0, &colweights);
         }
     } else { // full weighted mean (Bregman)
         const bool isnorm = msr_is_normalized(measure);
@@ -894,7 +860,14 @@ double set_centroids_full_mean(const util::CSparseMatrix<VT, IT, IPtrT> &mat,
         ret += dot(cr, r) * w;
     }
     std::vector<blz::DV<FT>> tmprows(ctrs.size(), blz::DV<FT>(mat.columns(), 0.));
-    if(measure == distance::L2 || measure == distance::L1) {
+    if(measure == distance::L2) {
+        const size_t k = ctrs.size();
+        geomedians<FT>(mat, ctrs, [&](size_t i, const auto &f) {
+            const double w = weights ? double((*weights)[i]): 1.;
+            auto r = row(asns, i, unchecked);
+            for(size_t j = 0; j < k; ++j) f(j, w * r[j]);
+        });
+    } else if(measure == distance::L1) {
         //OMP_PFOR
         for(size_t i = 0; i < ctrs.size(); ++i) {
             blz::DV<FT, blz::columnVector> colweights;
@@ -907,10 +880,7 @@ double set_centroids_full_mean(const util::CSparseMatrix<VT, IT, IPtrT> &mat,
             }
             std::fprintf(stderr, "Weights selected for row %zu/%zu\n", i + 1, ctrs.size());
             uint64_t *np = 0;
-            if(measure == distance::L2)
-                geomedian(mat, tmprows[i], np, 0, &colweights);
-            else
-                l1_median(mat, tmprows[i], np, 0, &colweights);
+            l1_median(mat, tmprows[i], np, 0, &colweights);
             std::fprintf(stderr, "Centroid selected for row %zu/%zu\n", i + 1, ctrs.size());
             if constexpr(blz::TransposeFlag_v<std::decay_t<decltype(ctrs[0])>> == blaze::rowVector) {
                 ctrs[i] = trans(tmprows[i]);
@@ -924,7 +894,7 @@ double set_centroids_full_mean(const util::CSparseMatrix<VT, IT, IPtrT> &mat,
         for(size_t j = 0; j < mat.rows(); ++j) {
             auto r = row(mat, j, unchecked);
             auto smr = row(asns, j, unchecked);
-            const double dmul = isnorm ? 1. / rowsums[j]: 1.;
+            const double dmul = (isnorm ? 1. / rowsums[j]: 1.) * (weights ? double((*weights)[j]): 1.);
             for(size_t i = 0; i < r.n_; ++i) {
                 double data = r.data_[i] * dmul;
                 auto idx = r.indices_[i];
@@ -0,0 +1,152 @@
+#ifndef MINOCORE_CLUSTERING_GEOMEDIAN_H__
+#define MINOCORE_CLUSTERING_GEOMEDIAN_H__
+#include "minicore/clustering/lazycenter.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace minicore { namespace clustering {
+
+#ifndef MC_GEOMEDIANS_MAX_BYTES
+#define MC_GEOMEDIANS_MAX_BYTES (size_t(1) << 30)
+#endif
+
+/*
+ * geomedians
+ * Solves the weighted geometric medians of all k clusters at once with over-relaxed Weiszfeld iterations.
+ *
+ * entries(i, f) must call f(cluster_id, weight) for each cluster which point i contributes to:
+ *   once per point for hard clustering, once per (point, center) pair for soft clustering.
+ *
+ * Each iteration is a single parallel pass over the data, accumulating every cluster's Weiszfeld
+ * numerator and denominator into thread-local buffers, which are reduced at the end of the pass.
+ * The numerator buffers of all threads are capped at MAX_ACCUM_BYTES in total: if the active clusters do not all fit,
+ * the active clusters are split into blocks which do, and the pass makes one sweep over the data per block.
+ * Distances to sparse rows are computed in O(nnz) from cached row and center norms.
+ *
+ * Centers are warm-started from their current values in ctrs.
+ * Steps are over-relaxed, x <- x + lambda (T(x) - x), with lambda = OVERRELAX;
+ * if a step increases a cluster's cost, that cluster falls back to the plain Weiszfeld step T(x),
+ * which never increases the cost, and continues with lambda = 1.
+ * A cluster stops once its relative improvement falls below eps.
+ *
+ * Returns the number of passes over the data.
+ */
+template<typename FT=double, typename Mat, typename CtrT, typename EntryFunc>
+size_t geomedians(const Mat &mat, std::vector<CtrT> &ctrs, const EntryFunc &entries, double eps=0., size_t maxiter=1000)
+{
+    static constexpr double MINVAL = 1e-80;        // For the case of exactly lying on a current center
+    static constexpr double OVERRELAX = 1.8;
+    static constexpr size_t MAX_ACCUM_BYTES = MC_GEOMEDIANS_MAX_BYTES; // Cap on total thread-local accumulator memory
+    const size_t np = mat.rows(), nc = mat.columns(), k = ctrs.size();
+    if(!k || !np) return 0;
+    const double tol = eps > 0. ? eps: 1e-10;
+    blz::DV<double> rowsq(np);
+    OMP_PFOR
+    for(size_t i = 0; i < np; ++i) {
+        double s = 0.;
+        detail::for_each_nonzero(row(mat, i, unchecked), [&](size_t, auto v) {s += double(v) * v;});
+        rowsq[i] = s;
+    }
+    // Every thread holds a numerator row for each cluster of a block, so blocks hold at most bk clusters
+    int nt = 1;
+    OMP_ONLY(nt = std::max(1, std::min(omp_get_max_threads(), int(MAX_ACCUM_BYTES / std::max(size_t(1), nc * sizeof(double))))));
+    const size_t bk = std::min(k, std::max(size_t(1), MAX_ACCUM_BYTES / (size_t(nt) * std::max(size_t(1), nc) * sizeof(double))));
+    // The team may be smaller than nt (e.g., when nested), so only the first nteam buffers of a sweep are reduced
+    std::vector<blz::DM<double>> nums(nt, blz::DM<double>(bk, nc, 0.));
+    blz::DM<double> dens(nt, k), tcosts(nt, k);
+    blz::DM<FT> targets(k, nc);
+    blz::DV<double> csq(k), prevcosts(k, std::numeric_limits<double>::max()), lambdas(k, OVERRELAX);
+    std::vector<uint8_t> active(k, 1);
+    // The active clusters of a pass, and each one's row of the numerator buffers during its block's sweep (-1 otherwise)
+    std::vector<uint32_t> ids;
+    std::vector<int64_t> slot(k, -1);
+    size_t iternum = 0, nactive = k;
+    int nteam = 1;
+    while(nactive && iternum++ < maxiter) {
+        ids.clear();
+        for(size_t j = 0; j < k; ++j) if(active[j]) csq[j] = sqrNorm(ctrs[j]), ids.push_back(j);
+        dens = 0.; tcosts = 0.;
+        nactive = 0;
+        for(size_t b = 0; b < ids.size(); b += bk) {
+            const size_t e = std::min(ids.size(), b + bk);
+            for(size_t q = b; q < e; ++q) slot[ids[q]] = q - b;
+            OMP_PRAGMA("omp parallel num_threads(nt)")
+            {
+                int tid = 0;
+                OMP_ONLY(tid = omp_get_thread_num();)
+                OMP_ONLY(if(tid == 0) nteam = omp_get_num_threads();)
+                auto &num = nums[tid];
+                submatrix(num, 0, 0, e - b, nc) = 0.;
+                auto den = row(dens, tid);
+                auto tcost = row(tcosts, tid);
+                OMP_PRAGMA("omp for schedule(dynamic, 256)")
+                for(size_t i = 0; i < np; ++i) {
+                    auto r = row(mat, i, unchecked);
+                    entries(i, [&](size_t cid, double w) {
+                        if(slot[cid] < 0 || w <= 0.) return;
+                        const auto &ctr = ctrs[cid];
+                        double dot = 0.;
+                        detail::for_each_nonzero(r, [&](size_t idx, auto v) {dot += double(v) * ctr[idx];});
+                        double sq = rowsq[i] - 2. * dot + csq[cid];
+                        double dist;
+                        if(sq > 1e-6 * (rowsq[i] + csq[cid])) {
+                            dist = std::sqrt(sq);
+                        } else { // Recompute directly to avoid cancellation near the center
+                            if constexpr(blaze::IsMatrix_v<Mat>) dist = blz::l2Norm(ctr - r);
+                            else dist = l2Dist(ctr, r);
+                        }
+                        tcost[cid] += w * dist;
+                        const double a = w / std::max(dist, MINVAL);
+                        den[cid] += a;
+                        auto numrow = row(num, slot[cid], unchecked);
+                        detail::for_each_nonzero(r, [&](size_t idx, auto v) {numrow[idx] += a * v;});
+                    });
+                }
+            }
+            // Each cluster's sums are complete after its block's sweep, so the block is updated before the next one reuses the buffers
+            OMP_PRAGMA("omp parallel for schedule(dynamic) reduction(+:nactive)")
+            for(size_t q = b; q < e; ++q) {
+                const size_t j = ids[q], sl = q - b;
+                slot[j] = -1;
+                auto &ctr = ctrs[j];
+                const double cost = sum(column(tcosts, j)), den = sum(column(dens, j));
+                if(den <= 0.) { // No support
+                    active[j] = 0;
+                    continue;
+                }
+                if(cost > prevcosts[j]) {
+                    // Over-relaxed step overshot; fall back to the Weiszfeld step from the previous center
+                    ctr = row(targets, j);
+                    lambdas[j] = 1.;
+                    ++nactive;
+                    continue;
+                }
+                if(prevcosts[j] - cost <= tol * cost) {
+                    active[j] = 0;
+                    continue;
+                }
+                prevcosts[j] = cost;
+                auto target = row(targets, j);
+                target = row(nums[0], sl);
+                for(int t = 1; t < nteam; ++t) target += row(nums[t], sl);
+                target *= 1. / den;
+                const double lam = lambdas[j];
+                for(size_t c = 0; c < nc; ++c)
+                    ctr[c] += lam * (target[c] - ctr[c]);
+                ++nactive;
+            }
+        }
+    }
+    DBG_ONLY(std::fprintf(stderr, "[%s] %zu-cluster geometric medians took %zu passes\n", __func__, k, iternum);)
+    return iternum;
+}
+
+#undef MC_GEOMEDIANS_MAX_BYTES
+
+} // namespace clustering
+using clustering::geomedians;
+
+} // namespace minicore
+
+#endif /* MINOCORE_CLUSTERING_GEOMEDIAN_H__ */
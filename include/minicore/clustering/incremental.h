@@ -0,0 +1,289 @@
+#ifndef MINOCORE_CLUSTERING_INCREMENTAL_H__
+#define MINOCORE_CLUSTERING_INCREMENTAL_H__
+#pragma once
+
+#include "minicore/clustering/solve.h"
+
+namespace minicore {
+
+namespace clustering {
+
+#ifndef MC_DEFAULT_INCREMENTAL_TOL
+#define MC_DEFAULT_INCREMENTAL_TOL 1e-4
+#endif
+static constexpr double DEFAULT_INCREMENTAL_TOL = MC_DEFAULT_INCREMENTAL_TOL;
+#undef MC_DEFAULT_INCREMENTAL_TOL
+
+namespace detail {
+
+/*
+ * Sufficient statistics for mean-based centers: the weighted sum of (possibly normalized) rows assigned to each cluster,
+ * the total weight and the number of rows.
+ * A cluster's sum is computed from its members the first time the cluster changes,
+ * so clusters untouched by an update cost nothing, and centers need not be the means of their members.
+ */
+struct IncrementalSums {
+    std::vector<blz::DV<double, rowVector>> sums_;
+    std::vector<double> weights_;
+    std::vector<size_t> counts_;
+    const size_t nc_;
+    IncrementalSums(size_t k, size_t nc): sums_(k), weights_(k), counts_(k), nc_(nc) {}
+
+    bool has_sums(size_t cid) const {return sums_[cid].size() == nc_;}
+    // Sets the sum of cluster cid from the rows in members
+    template<typename MT, typename WFunc, typename RSumsT>
+    void compute(size_t cid, const MT &mat, const std::vector<size_t> &members, const WFunc &getw, const RSumsT &rowsums, bool isnorm) {
+        auto &s = sums_[cid];
+        s.resize(nc_);
+        s = 0.;
+        for(const size_t i: members) {
+            const double scale = isnorm ? getw(i) / rowsums[i]: getw(i);
+            for_each_nonzero(row(mat, i, unchecked), [&](size_t idx, auto v) {s[idx] += scale * v;});
+        }
+    }
+    // Adds (sign > 0) or removes (sign < 0) row r, with weight w, from cluster cid, whose sum must have been computed
+    template<typename RowT>
+    void update(size_t cid, const RowT &r, double w, double rsum, bool isnorm, int sign) {
+        assert(has_sums(cid));
+        auto &s = sums_[cid];
+        const double scale = sign * (isnorm ? w / rsum: w);
+        for_each_nonzero(r, [&](size_t idx, auto v) {s[idx] += scale * v;});
+        weights_[cid] += sign * w;
+        if(sign > 0) ++counts_[cid];
+        else         --counts_[cid];
+        if(counts_[cid] == 0) {
+            // Avoid carrying rounding error into a cluster which is later repopulated
+            s = 0.;
+            weights_[cid] = 0.;
+        }
+    }
+};
+
+} // namespace detail
+
+/*
+ * update_hard_clustering
+ * Updates a hard clustering after rows have been appended to the dataset,
+ * without re-seeding or re-running Lloyd's algorithm over all of the data.
+ *
+ * mat holds all rows, and rows [0, nold) are the ones clustered previously:
+ * asn, costs and rowsums hold their assignments, costs and row sums,
+ * and costs must be current for the given centers, as perform_hard_clustering leaves them.
+ * Centers need not be the means of their rows (e.g., if clustering stopped before converging).
+ * asn, costs and rowsums are resized to mat.rows(); weights, if provided, must cover all rows.
+ *
+ * 1. New rows are assigned against all k centers, and added to the sums of the clusters they join.
+ *    A cluster's sum is computed from its rows the first time it changes.
+ * 2. Centers whose mean moved by more than tol (relative to the center's L2 norm) are replaced by it.
+ *    Smaller moves are deferred, so that the published centers and assignments stay consistent;
+ *    moves still pending on return are dropped, as the next call recomputes sums from the assignments.
+ * 3. Local Lloyd iterations: points in a cluster whose center moved are compared against all centers,
+ *    and every other point only against the moved centers, since its distances to the rest are unchanged.
+ *    Reassigned points are moved between cluster sums, and step 2 is repeated,
+ *    until no center moves by more than tol or after maxiter iterations.
+ * This costs O(n * |moved| + |rows in moved clusters| * k) distance evaluations per iteration rather than O(n * k),
+ * and old rows are only read when they are compared against a moved center.
+ *
+ * Only mean-based centroid policies (FULL_WEIGHTED_MEAN and JSM_MEDIAN) can be updated this way;
+ * other measures throw std::invalid_argument. Clusters which lose all of their points (or all of their weight) keep their previous centers.
+ * Returns {cost after assigning the new rows, final cost, number of local iterations}.
+ */
+template<typename MT, // MatrixType
+         typename FT=DefaultFT<MT>,
+         typename CtrT=blz::DynamicVector<FT, rowVector>, // Vector Type
+         typename CostsT,
+         typename PriorT=blz::DynamicVector<FT, rowVector>,
+         typename AsnT=blz::DynamicVector<uint32_t>,
+         typename WeightT=blz::DynamicVector<FT>, // Vector Type
+         typename RSumsT=blz::DV<double>
+        >
+std::tuple<double, double, size_t>
+update_hard_clustering(const MT &mat,
+                       size_t nold,
+                       const dist::DissimilarityMeasure measure,
+                       const PriorT &prior,
+                       std::vector<CtrT> &centers,
+                       AsnT &asn,
+                       CostsT &costs,
+                       RSumsT &rowsums,
+                       const WeightT *weights=static_cast<WeightT *>(nullptr),
+                       double tol=DEFAULT_INCREMENTAL_TOL,
+                       size_t maxiter=5)
+{
+    const size_t np = mat.rows(), k = centers.size();
+    if(!dist::is_valid_measure(measure)) throw std::invalid_argument("Invalid measure");
+    const CentroidPol pol = msr2pol(measure);
+    if(pol != FULL_WEIGHTED_MEAN && pol != JSM_MEDIAN)
+        throw std::invalid_argument(std::string("update_hard_clustering requires a mean-based centroid policy; ") + dist::msr2str(measure) + " uses " + cp2str(pol) + ". Use perform_hard_clustering instead.");
+    if(k == 0) throw std::invalid_argument("update_hard_clustering requires at least one center");
+    if(nold > np) throw std::invalid_argument("nold must be <= the number of rows");
+    if(asn.size() < nold || costs.size() < nold || rowsums.size() < nold)
+        throw std::invalid_argument("asn, costs and rowsums must cover the previously clustered rows");
+    using asn_t = std::decay_t<decltype(asn[0])>;
+    const bool isnorm = msr_is_normalized(measure);
+    const FT prior_sum =
+        prior.size() == 0 ? 0.
+                          : prior.size() == 1
+                          ? double(prior[0] * mat.columns())
+                          : double(blz::sum(prior));
+    auto getw = [weights](size_t i) -> double {return weights ? double((*weights)[i]): 1.;};
+    auto compute_cost = [&]() -> double {
+        if(weights) return blz::dot(costs, *weights);
+        else        return blz::sum(costs);
+    };
+    asn.resize(np);
+    costs.resize(np);
+    rowsums.resize(np);
+    blz::DV<double> ctrsums = blaze::generate(k, [&](auto x){return sum(centers[x]);});
+    detail::IncrementalSums stats(k, mat.columns());
+    for(size_t i = 0; i < nold; ++i) {
+        const auto a = asn[i];
+        if(a >= k) throw std::invalid_argument(std::string("Assignment ") + std::to_string(a) + " out of range for k = " + std::to_string(k));
+        stats.weights_[a] += getw(i);
+        ++stats.counts_[a];
+    }
+#define __compute_cost(id, cid) cmp::msr_with_prior<FT>(measure, row(mat, id, unchecked), centers[cid], prior, prior_sum, rowsums[id], ctrsums[cid])
+
+    // Applies the queued moves, [(point, from, to)], with from == k for new points, and returns the clusters whose means changed
+    // asn already holds the destinations of the moves.
+    std::vector<std::vector<std::pair<size_t, int>>> deltas(k);
+    std::vector<std::vector<size_t>> members(k);
+    auto apply_moves = [&](const std::vector<std::tuple<size_t, asn_t, asn_t>> &moves) {
+        for(auto &d: deltas) d.clear();
+        for(const auto &[idx, from, to]: moves) {
+            if(from < k) deltas[from].emplace_back(idx, -1);
+            deltas[to].emplace_back(idx, 1);
+        }
+        // Clusters changing for the first time start from the sums of their rows before these moves
+        std::vector<uint8_t> fresh(k);
+        bool anyfresh = false;
+        for(size_t j = 0; j < k; ++j)
+            if(!deltas[j].empty() && !stats.has_sums(j))
+                fresh[j] = 1, anyfresh = true;
+        if(anyfresh) {
+            for(const auto &[idx, from, to]: moves) asn[idx] = from;
+            for(size_t i = 0; i < np; ++i)
+                if(const auto a = asn[i]; a < k && fresh[a])
+                    members[a].push_back(i);
+            for(const auto &[idx, from, to]: moves) asn[idx] = to;
+        }
+        std::vector<uint8_t> changed(k);
+        OMP_PFOR_DYN
+        for(size_t j = 0; j < k; ++j) {
+            if(deltas[j].empty()) continue;
+            if(fresh[j]) {
+                stats.compute(j, mat, members[j], getw, rowsums, isnorm);
+                std::vector<size_t>().swap(members[j]);
+            }
+            for(const auto &[idx, sign]: deltas[j])
+                stats.update(j, row(mat, idx, unchecked), getw(idx), rowsums[idx], isnorm, sign);
+            changed[j] = 1;
+        }
+        return changed;
+    };
+    // Publishes the means of changed clusters which moved by more than tol, and returns their ids
+    auto publish = [&](const std::vector<uint8_t> &changed) {
+        std::vector<uint8_t> moved(k);
+        OMP_PFOR_DYN
+        for(size_t j = 0; j < k; ++j) {
+            // Clusters with no rows, or only rows of weight 0, have no mean and keep their centers
+            if(!changed[j] || stats.counts_[j] == 0 || stats.weights_[j] <= 0.) continue;
+            blz::DV<double, rowVector> mean = stats.sums_[j] * (1. / stats.weights_[j]);
+            const double shift = blz::l2Norm(mean - centers[j]), cnorm = blz::l2Norm(centers[j]);
+            if(shift > tol * cnorm) {
+                set_center(centers[j], mean);
+                ctrsums[j] = sum(centers[j]);
+                moved[j] = 1;
+            }
+        }
+        std::vector<asn_t> ret;
+        for(size_t j = 0; j < k; ++j) if(moved[j]) ret.push_back(j);
+        return ret;
+    };
+
+    // 1. Row sums and assignments for the new rows
+    std::vector<std::tuple<size_t, asn_t, asn_t>> moves;
+    {
+        util::PhaseTimer pt("incremental.assign_new", (np - nold) * k);
+        OMP_PFOR
+        for(size_t i = nold; i < np; ++i) {
+            rowsums[i] = sum(row(mat, i, unchecked));
+            auto cost = __compute_cost(i, 0);
+            asn_t bestid = 0;
+            for(unsigned j = 1; j < k; ++j)
+                if(auto newcost = __compute_cost(i, j); newcost < cost)
+                    bestid = j, cost = newcost;
+            costs[i] = cost; asn[i] = bestid;
+        }
+        for(size_t i = nold; i < np; ++i) moves.emplace_back(i, asn_t(k), asn[i]);
+    }
+    const double initcost = compute_cost();
+    std::vector<uint8_t> changed;
+    {
+        util::PhaseTimer pt("incremental.update_sums");
+        changed = apply_moves(moves);
+    }
+    util::Telemetry *const tel = util::active_telemetry();
+    if(tel) tel->mark();
+    size_t iternum = 0;
+    double cost = initcost;
+    std::vector<uint8_t> ismoved(k);
+    const int nt = std::max(1, OMP_ELSE(omp_get_max_threads(), 1));
+    std::vector<std::vector<std::tuple<size_t, asn_t, asn_t>>> tmoves(nt);
+    // 2. Local Lloyd iterations, restricted to moved centers
+    while(iternum < maxiter) {
+        PYBIND11_EXCEPTION_CHECK();
+        const std::vector<asn_t> moved = publish(changed);
+        if(moved.empty()) break;
+        ++iternum;
+        std::fill(ismoved.begin(), ismoved.end(), uint8_t(0));
+        size_t nmembers = 0;
+        for(const auto m: moved) ismoved[m] = 1, nmembers += stats.counts_[m];
+        {
+            util::PhaseTimer pt("incremental.reassign", nmembers * k + (np - nmembers) * moved.size());
+            for(auto &tm: tmoves) tm.clear();
+            OMP_PFOR
+            for(size_t i = 0; i < np; ++i) {
+                int tid = 0;
+                OMP_ONLY(tid = omp_get_thread_num();)
+                const asn_t oldid = asn[i];
+                asn_t bestid = oldid;
+                double bestcost;
+                if(ismoved[oldid]) {
+                    bestcost = __compute_cost(i, 0);
+                    bestid = 0;
+                    for(unsigned j = 1; j < k; ++j)
+                        if(auto newcost = __compute_cost(i, j); newcost < bestcost)
+                            bestid = j, bestcost = newcost;
+                } else {
+                    bestcost = costs[i];
+                    for(const auto j: moved)
+                        if(auto newcost = __compute_cost(i, j); newcost < bestcost)
+                            bestid = j, bestcost = newcost;
+                }
+                costs[i] = bestcost;
+                if(bestid != oldid) {
+                    asn[i] = bestid;
+                    tmoves[tid].emplace_back(i, oldid, bestid);
+                }
+            }
+            moves.clear();
+            for(const auto &tm: tmoves) moves.insert(moves.end(), tm.begin(), tm.end());
+        }
+        const double newcost = compute_cost();
+        if(tel) tel->add_iteration(newcost);
+        DBG_ONLY(std::fprintf(stderr, "[%s] iteration %zu: %zu centers moved, %zu points reassigned, cost %0.12g -> %0.12g\n", __func__, iternum, moved.size(), moves.size(), cost, newcost);)
+        cost = newcost;
+        util::PhaseTimer pt("incremental.update_sums");
+        changed = apply_moves(moves);
+    }
+#undef __compute_cost
+    std::fprintf(stderr, "[%s] %zu new rows, %zu local iterations, from cost %0.12g->%0.12g\n", __func__, np - nold, iternum, initcost, cost);
+    return {initcost, cost, iternum};
+}
+
+} // namespace clustering
+using clustering::update_hard_clustering;
+
+} // namespace minicore
+#endif /* #ifndef MINOCORE_CLUSTERING_INCREMENTAL_H__ */
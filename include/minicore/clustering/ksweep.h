@@ -0,0 +1,64 @@
+#ifndef MINOCORE_CLUSTERING_KSWEEP_H__
+#define MINOCORE_CLUSTERING_KSWEEP_H__
+#pragma once
+
+#include "minicore/clustering/restarts.h"
+
+namespace minicore {
+
+namespace clustering {
+
+/*
+ * perform_hard_clustering_ksweep
+ * Hard clustering for every k in ks, for choosing k (e.g., by the elbow of the cost curve).
+ *
+ * seeds holds at least max(ks) centers in the order k-means++ (or k-means||) selected them,
+ * so its first k entries seed the k-clustering; one seeding to max(ks) serves every k.
+ * All solutions are then optimized together, sharing each pass over the data as perform_hard_clustering_restarts does,
+ * and each follows perform_hard_clustering with csr_transforms = 0 from its prefix of seeds.
+ * Any measure with a centroid policy is supported; only mean-based policies also share the centroid computation.
+ *
+ * centers, asns and costs are resized to one entry per k in ks, in the order of ks.
+ * Returns {initial cost, final cost, iterations} for each k in ks.
+ */
+template<typename MT, // MatrixType
+         typename FT=DefaultFT<MT>,
+         typename CtrT=blz::DynamicVector<FT, rowVector>, // Vector Type
+         typename CostsT,
+         typename PriorT=blz::DynamicVector<FT, rowVector>,
+         typename AsnT=blz::DynamicVector<uint32_t>,
+         typename WeightT=blz::DynamicVector<FT> // Vector Type
+        >
+std::vector<std::tuple<double, double, size_t>>
+perform_hard_clustering_ksweep(const MT &mat,
+                               const dist::DissimilarityMeasure measure,
+                               const PriorT &prior,
+                               const std::vector<CtrT> &seeds,
+                               const std::vector<size_t> &ks,
+                               std::vector<std::vector<CtrT>> &centers,
+                               std::vector<AsnT> &asns,
+                               std::vector<CostsT> &costs,
+                               const WeightT *weights=static_cast<WeightT *>(nullptr),
+                               double eps=DEFAULT_EPS,
+                               size_t maxiter=size_t(-1))
+{
+    auto tstart = std::chrono::high_resolution_clock::now();
+    if(ks.empty()) throw std::invalid_argument("perform_hard_clustering_ksweep requires at least one k");
+    centers.clear();
+    for(const auto k: ks) {
+        if(k < 1 || k > seeds.size())
+            throw std::invalid_argument(std::string("k (") + std::to_string(k) + ") must be in [1, " + std::to_string(seeds.size()) + "], the number of seeds");
+        centers.emplace_back(seeds.begin(), seeds.begin() + k);
+    }
+    auto ret = detail::perform_hard_clustering_multi<FT>(mat, measure, prior, centers, asns, costs, weights, eps, maxiter);
+    auto tstop = std::chrono::high_resolution_clock::now();
+    std::fprintf(stderr, "Clustering for %zu values of k in %gms\n", ks.size(), std::chrono::duration<double, std::milli>(tstop - tstart).count());
+    DBG_ONLY(for(size_t i = 0; i < ks.size(); ++i) std::fprintf(stderr, "k = %zu: cost %0.12g->%0.12g in %zu rounds\n", ks[i], std::get<0>(ret[i]), std::get<1>(ret[i]), std::get<2>(ret[i]));)
+    return ret;
+}
+
+} // namespace clustering
+using clustering::perform_hard_clustering_ksweep;
+
+} // namespace minicore
+#endif /* #ifndef MINOCORE_CLUSTERING_KSWEEP_H__ */
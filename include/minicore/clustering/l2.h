@@ -3,6 +3,7 @@
 #include "mtx2cs.h"
 #include <vector>
 #include "minicore/util/blaze_adaptor.h"
+#include "minicore/clustering/asnindex.h"
 
 namespace minicore {
 
@@ -47,14 +48,14 @@ l2_sum_core(blz::SM<FT> &mat, std::string out, SumOpts &opts) {
     for(;;) {
         std::fprintf(stderr, "[Iter %zu] Cost: %g\n", iternum, tcost);
         center_setup:
+        AssignmentIndex<uint32_t> asnidx(asn, mat.rows(), opts.k);
         blz::SmallArray<uint32_t, 16> sa;
+        for(unsigned i = 0; i < opts.k; ++i) if(asnidx.empty(i)) sa.pushBack(i);
         OMP_PFOR
         for(size_t i = 0; i < opts.k; ++i) {
-            auto submat = blz::rows(mat,  blz::functional::indices_if([&](auto x) {return asn[x] == i;}, asn.size()));
-            if(!submat.rows())
-                sa.pushBack(i);
-            else
-                blz::geomedian(submat, centers[i]);
+            if(asnidx.empty(i)) continue;
+            auto submat = blz::rows(mat, asnidx.data(i), asnidx.size(i));
+            blz::geomedian(submat, centers[i]);
         }
         // Set centers
         if(sa.size()) {
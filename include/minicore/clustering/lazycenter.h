@@ -0,0 +1,131 @@
+#ifndef MINOCORE_CLUSTERING_LAZYCENTER_H__
+#define MINOCORE_CLUSTERING_LAZYCENTER_H__
+#include "minicore/util/blaze_adaptor.h"
+#include "minicore/util/csc.h"
+
+namespace minicore { namespace clustering {
+
+namespace detail {
+
+// Calls func(index, value) for each stored entry of a (dense, blaze sparse, or CSparse) vector.
+template<typename VT, typename Func>
+INLINE void for_each_nonzero(const VT &x, const Func &func) {
+    if constexpr(blaze::IsDenseVector_v<VT>) {
+        for(size_t i = 0; i < x.size(); ++i)
+            func(i, x[i]);
+    } else {
+        for(auto it = x.begin(), e = x.end(); it != e; ++it)
+            func(it->index(), it->value());
+    }
+}
+
+} // namespace detail
+
+/*
+ * LazyScaledCenter
+ * Represents a center as scale_ * data_, so that multiplying by a constant (decay) is O(1)
+ * and adding a sparse row is O(nnz(row)).
+ * The sum and squared norm of data_ are maintained incrementally,
+ * which makes squared Euclidean distances to sparse rows O(nnz(row)) as well:
+ *   ||x - s * v||^2 = ||x||^2 - 2 s <x, v> + s^2 ||v||^2
+ *
+ * update() performs the per-center learning-rate step from Sculley's web-scale k-means:
+ *   c <- (1 - eta) c + eta x, eta = w / (total weight assigned to c so far)
+ */
+template<typename FT=double>
+struct LazyScaledCenter {
+    blz::DV<FT, blz::rowVector> data_;
+    double scale_  = 1.;
+    double sum_    = 0.; // sum(data_)
+    double sqnorm_ = 0.; // sqrNorm(data_)
+    double count_  = 0.; // Total weight absorbed into this center
+
+    // Below this, fold scale_ into data_ to avoid losing precision
+    static constexpr double MIN_SCALE = 1e-8;
+
+    LazyScaledCenter() {}
+    template<typename VT>
+    LazyScaledCenter(const VT &x, double count=1.) {set(x, count);}
+
+    size_t size() const {return data_.size();}
+    double sum() const {return scale_ * sum_;}
+    double sqrNorm() const {return scale_ * scale_ * sqnorm_;}
+    double count() const {return count_;}
+
+    template<typename VT>
+    void set(const VT &x, double count=1.) {
+        if(data_.size() != x.size()) data_.resize(x.size());
+        data_ = FT(0);
+        scale_ = 1.;
+        sum_ = sqnorm_ = 0.;
+        detail::for_each_nonzero(x, [&](size_t idx, auto v) {
+            data_[idx] = v;
+            sum_ += v;
+            sqnorm_ += double(v) * v;
+        });
+        count_ = count;
+    }
+    // Multiplies the center by factor in O(1)
+    void decay(double factor) {
+        assert(factor > 0.);
+        scale_ *= factor;
+        if(scale_ < MIN_SCALE) flush();
+    }
+    // center += a * x in O(nnz(x))
+    template<typename VT>
+    void axpy(double a, const VT &x) {
+        const double mul = a / scale_;
+        detail::for_each_nonzero(x, [&](size_t idx, auto v) {
+            const double inc = mul * v;
+            auto &dv = data_[idx];
+            sqnorm_ += inc * (2. * dv + inc);
+            sum_ += inc;
+            dv += inc;
+        });
+    }
+    template<typename VT>
+    void update(const VT &x, double weight=1.) {
+        if(count_ <= 0.) {
+            set(x, weight);
+            return;
+        }
+        count_ += weight;
+        const double eta = weight / count_;
+        decay(1. - eta);
+        axpy(eta, x);
+    }
+    template<typename VT>
+    double dot(const VT &x) const {
+        double ret = 0.;
+        detail::for_each_nonzero(x, [&](size_t idx, auto v) {ret += double(v) * data_[idx];});
+        return ret * scale_;
+    }
+    // Squared Euclidean distance to x, given x's squared norm.
+    template<typename VT>
+    double sqrl2(const VT &x, double xsqnorm) const {
+        return std::max(xsqnorm - 2. * dot(x) + sqrNorm(), 0.);
+    }
+    // Folds scale_ into data_ and recomputes the cached sum and norm exactly.
+    void flush() {
+        if(scale_ != 1.) {
+            data_ *= scale_;
+            scale_ = 1.;
+        }
+        sum_ = blz::sum(data_);
+        sqnorm_ = blz::sqrNorm(data_);
+    }
+    template<typename CtrT>
+    void materialize(CtrT &ctr) const {
+        if constexpr(blaze::IsResizable_v<CtrT>) {
+            if(ctr.size() != data_.size()) ctr.resize(data_.size());
+        }
+        ctr = data_ * FT(scale_);
+    }
+};
+
+} // namespace clustering
+using clustering::LazyScaledCenter;
+
+} // namespace minicore
+
+#endif /* MINOCORE_CLUSTERING_LAZYCENTER_H__ */
@@ -184,6 +184,8 @@ auto m2greedysel(blaze::Matrix<FT, SO> &sm, const SumOpts &opts)
             app, app.size(), rng, opts.k,
             /*eps=*/1.5, opts.outlier_fraction
         );
+    } else if(dist::satisfies_metric(opts.dis) && opts.dis != dist::SRLRT && opts.dis != dist::SRULRT) {
+        return coresets::kcenter_greedy_2approx_pruned_costs<decltype(app), double, uint64_t>(app, app.size(), opts.k, rng);
     } else return coresets::kcenter_greedy_2approx_costs<decltype(app), double, uint64_t>(app, app.size(), opts.k, rng);
 }
 
@@ -205,6 +207,8 @@ std::pair<std::vector<uint64_t>, std::vector<double>> m2greedysel(util::CSparseM
             oracle, matrix.rows(), rng, opts.k,
             /*eps=*/1.5, opts.outlier_fraction
         );
+    } else if(dist::satisfies_metric(opts.dis) && opts.dis != dist::SRLRT && opts.dis != dist::SRULRT) {
+        return coresets::kcenter_greedy_2approx_pruned_costs<decltype(oracle), double, uint64_t>(oracle, matrix.rows(), opts.k, rng);
     } else return coresets::kcenter_greedy_2approx_costs<decltype(oracle), double, uint64_t>(oracle, matrix.rows(), opts.k, rng);
 }
 
@@ -0,0 +1,354 @@
+#ifndef MINOCORE_CLUSTERING_OUTOFCORE_H__
+#define MINOCORE_CLUSTERING_OUTOFCORE_H__
+#pragma once
+
+#include "minicore/clustering/solve.h"
+#include "minicore/clustering/streamedmeans.h"
+#include "minicore/util/mappedcsr.h"
+
+namespace minicore {
+
+namespace clustering {
+
+#ifndef MC_DEFAULT_OOC_CHUNK_ROWS
+#define MC_DEFAULT_OOC_CHUNK_ROWS 65536
+#endif
+static constexpr size_t DEFAULT_OOC_CHUNK_ROWS = MC_DEFAULT_OOC_CHUNK_ROWS;
+#undef MC_DEFAULT_OOC_CHUNK_ROWS
+
+namespace detail {
+
+/*
+ * Calls func(chunk, start, stop) on consecutive chunks of chunk_rows rows of src, in order.
+ * Before chunk i is processed, the kernel is asked to read chunk i + 1, so its I/O overlaps the work on chunk i;
+ * chunk i is released afterwards, so resident memory stays bounded by a few chunks.
+ */
+template<typename SrcT, typename Func>
+void for_each_chunk(const SrcT &src, size_t chunk_rows, const Func &func) {
+    const size_t nr = src.rows();
+    chunk_rows = std::max(chunk_rows, size_t(1));
+    if(nr) src.prefetch(0, std::min(chunk_rows, nr));
+    for(size_t start = 0; start < nr; start += chunk_rows) {
+        const size_t stop = std::min(start + chunk_rows, nr);
+        if(stop < nr) src.prefetch(stop, std::min(stop + chunk_rows, nr));
+        func(src.chunk(start, stop), start, stop);
+        src.release(start, stop);
+    }
+}
+
+// Row sum computed as util::sum<rowwise> computes it for a whole CSparseMatrix
+template<typename VT, typename IT, typename IPtrT>
+INLINE double csr_rowsum(const util::CSparseMatrix<VT, IT, IPtrT> &chunk, size_t i) {
+    const auto ip = chunk.indptr_;
+    return blz::sum(blz::CustomVector<VT, blaze::unaligned, blaze::unpadded>(chunk.data_ + ip[i], ip[i + 1] - ip[i]));
+}
+
+} // namespace detail
+
+/*
+ * perform_hard_clustering_ooc
+ * Out-of-core Lloyd's algorithm for data which does not fit in memory, such as a MappedCSparseMatrix.
+ *
+ * src must provide rows(), columns(), bytes(start, stop), prefetch(start, stop), release(start, stop),
+ * and chunk(start, stop), which returns a util::CSparseMatrix of rows [start, stop); see MappedCSparseMatrix.
+ * Only per-row state (asn, costs and row sums) and per-center state are kept in memory.
+ *
+ * Each iteration is one sequential pass over src in chunks of chunk_rows rows (see detail::for_each_chunk),
+ * which assigns every row to its nearest center and adds it to its new cluster's sum,
+ * from which the next centers are computed; restarting an empty cluster costs one extra pass.
+ *
+ * This follows perform_hard_clustering step for step: the same assignments, costs, restarts, termination,
+ * and rejection of a final step which increases the cost, and it returns the same {initial cost, final cost, iterations}.
+ * Centers match up to the order of floating-point summation.
+ * In-memory CSR clustering computes costs through a CSRTransformCache by default;
+ * compare against perform_hard_clustering with csr_transforms = 0 for identical costs.
+ *
+ * Only mean-based centroid policies (FULL_WEIGHTED_MEAN and JSM_MEDIAN) are supported;
+ * other measures throw std::invalid_argument. weights, if provided, must be in memory.
+ */
+template<typename SrcT,
+         typename FT=DefaultFT<SrcT>,
+         typename CtrT=blz::DynamicVector<FT, rowVector>, // Vector Type
+         typename CostsT,
+         typename PriorT=blz::DynamicVector<FT, rowVector>,
+         typename AsnT=blz::DynamicVector<uint32_t>,
+         typename WeightT=blz::DynamicVector<FT> // Vector Type
+        >
+std::tuple<double, double, size_t>
+perform_hard_clustering_ooc(const SrcT &src,
+                            const dist::DissimilarityMeasure measure,
+                            const PriorT &prior,
+                            std::vector<CtrT> &centers,
+                            AsnT &asn,
+                            CostsT &costs,
+                            const WeightT *weights=static_cast<WeightT *>(nullptr),
+                            double eps=DEFAULT_EPS,
+                            size_t maxiter=size_t(-1),
+                            size_t chunk_rows=DEFAULT_OOC_CHUNK_ROWS)
+{
+    detail::check_mean_measure(measure, __func__);
+    auto tstart = std::chrono::high_resolution_clock::now();
+    using asn_t = std::decay_t<decltype(asn[0])>;
+    const size_t np = src.rows(), nc = src.columns(), k = centers.size();
+    if(!k) throw std::invalid_argument("perform_hard_clustering_ooc requires at least one center");
+    const bool isnorm = msr_is_normalized(measure);
+    const FT prior_sum =
+        prior.size() == 0 ? 0.
+                          : prior.size() == 1
+                          ? double(prior[0] * nc)
+                          : double(blz::sum(prior));
+    asn.resize(np);
+    costs.resize(np);
+    blz::DV<double> rowsums(np), ctrsums(k);
+    detail::StreamedMeans means(k, nc);
+    auto getw = [weights](size_t i) -> double {return weights ? double((*weights)[i]): 1.;};
+    auto compute_cost = [&costs,w=weights]() -> FT {
+        if(w) return blz::dot(costs, *w);
+        else  return blz::sum(costs);
+    };
+    auto getrow = [&](size_t i) {return row(src.chunk(i, i + 1), 0, unchecked);};
+    const uint64_t nbytes = src.bytes(0, np);
+    bool have_rowsums = false;
+    // One pass over src: assign each row to its nearest center in ctrs and add it to that cluster's sum.
+    // cost(i, j) computes the cost of local row i of chunk to center j.
+    auto stream_assign = [&](const std::vector<CtrT> &ctrs, const auto &cost) {
+        util::PhaseTimer pt("ooc.pass", uint64_t(np) * k, nbytes);
+        means.reset();
+        detail::for_each_chunk(src, chunk_rows, [&](const auto &chunk, size_t start, size_t stop) {
+            PYBIND11_EXCEPTION_CHECK();
+            OMP_PFOR
+            for(size_t i = 0; i < stop - start; ++i) {
+                const size_t gi = start + i;
+                if(!have_rowsums) rowsums[gi] = detail::csr_rowsum(chunk, i);
+                auto bestcost = cost(chunk, i, gi, 0);
+                asn_t bestid = 0;
+                for(unsigned j = 1; j < k; ++j)
+                    if(auto newcost = cost(chunk, i, gi, j); newcost < bestcost)
+                        bestid = j, bestcost = newcost;
+                costs[gi] = bestcost; asn[gi] = bestid;
+            }
+            means.partition(stop - start, [&](int tid, size_t i) {
+                const size_t gi = start + i;
+                means.add(tid, asn[gi], row(chunk, i, unchecked), isnorm ? getw(gi) / rowsums[gi]: getw(gi));
+            });
+        });
+        have_rowsums = true;
+    };
+    auto assign = [&](const std::vector<CtrT> &ctrs) {
+        for(size_t j = 0; j < k; ++j) ctrsums[j] = sum(ctrs[j]);
+        stream_assign(ctrs, [&](const auto &chunk, size_t i, size_t gi, size_t j) {
+            return cmp::msr_with_prior<FT>(measure, row(chunk, i, unchecked), ctrs[j], prior, prior_sum, rowsums[gi], ctrsums[j]);
+        });
+    };
+    // The M step of set_centroids_full_mean, from the sums accumulated in the last pass;
+    // empty clusters are restarted by D2 sampling exactly as there. Returns whether any center was restarted.
+    auto set_centroids = [&](std::vector<CtrT> &ctrs) {
+        std::vector<size_t> counts(k), first(k);
+        std::vector<double> wsums(k);
+        auto count = [&]() {
+            std::fill(counts.begin(), counts.end(), size_t(0));
+            std::fill(wsums.begin(), wsums.end(), 0.);
+            for(size_t i = 0; i < np; ++i) {
+                const auto a = asn[i];
+                if(!counts[a]++) first[a] = i;
+                wsums[a] += getw(i);
+            }
+        };
+        count();
+        std::vector<size_t> sa;
+        for(size_t j = 0; j < k; ++j) if(!counts[j]) sa.push_back(j);
+        bool restarted_any = false;
+        if(!sa.empty()) {
+            restarted_any = true;
+            std::fprintf(stderr, "[%s] Restarting %zu centers with no support\n", __func__, sa.size());
+            wy::WyRand<size_t, 4> rng(np);
+            const FT psum = prior.size() == 1 ? FT(prior[0]) * prior.size(): sum(prior);
+            std::vector<size_t> rs;
+            for(const auto id: sa) {
+                const size_t r = util::parallel_weighted_sample(np, rng(), [&](size_t i) {return weights ? double(costs[i]) * (*weights)[i]: double(costs[i]);});
+                rs.push_back(r);
+                if(isnorm) set_center(ctrs[id], getrow(r) / rowsums[r]);
+                else       set_center(ctrs[id], getrow(r));
+                ctrsums[id] = sum(ctrs[id]);
+            }
+            stream_assign(ctrs, [&](const auto &chunk, size_t i, size_t gi, size_t j) {
+                return cmp::msr_with_prior(measure, row(chunk, i, unchecked), ctrs[j], prior, psum, rowsums[gi], ctrsums[j]);
+            });
+            for(size_t i = 0; i < sa.size(); ++i) {
+                const auto pid = rs[i];
+                const auto cid = sa[i];
+                if(asn[pid] != cid) {
+                    const double scale = isnorm ? getw(pid) / rowsums[pid]: getw(pid);
+                    means.add(0, asn[pid], getrow(pid), -scale);
+                    means.add(0, cid, getrow(pid), scale);
+                    asn[pid] = cid;
+                    costs[pid] = 0.;
+                }
+            }
+            count();
+        }
+        OMP_PFOR_DYN
+        for(size_t j = 0; j < k; ++j) {
+            if(counts[j] == 0) continue;
+            if(counts[j] == 1) {
+                if(isnorm) set_center(ctrs[j], getrow(first[j]) / rowsums[first[j]]);
+                else       set_center(ctrs[j], getrow(first[j]));
+            } else {
+                set_center(ctrs[j], means.total(j) * (1. / wsums[j]));
+            }
+        }
+        return restarted_any;
+    };
+
+    assign(centers);
+    const auto initcost = compute_cost();
+    FT cost = initcost;
+    std::fprintf(stderr, "[%s] initial cost: %0.12g\n", __func__, cost);
+    if(cost == 0) {
+        std::fprintf(stderr, "Cost is 0 (unexpected), but the cost can't decrease. No optimization performed\n");
+        return {0., 0., 0};
+    }
+    size_t iternum = 0;
+    auto centers_cpy = centers;
+    AsnT prevasn;
+    CostsT prevcosts;
+    util::Telemetry *const tel = util::active_telemetry();
+    if(tel) tel->mark();
+    for(;;) {
+        DBG_ONLY(std::fprintf(stderr, "Beginning iter %zu\n", iternum);)
+        bool res;
+        {
+            util::PhaseTimer pt("ooc.set_centroids");
+            res = set_centroids(centers_cpy);
+        }
+        // Kept so that a step which increases the cost can be undone without another pass
+        prevasn = asn;
+        prevcosts = costs;
+        assign(centers_cpy);
+        const FT newcost = compute_cost();
+        if(tel) tel->add_iteration(newcost);
+        DBG_ONLY(std::fprintf(stderr, "Iteration %zu: [%.16g old/%.16g new]\n", iternum, cost, newcost);)
+        if(newcost > cost && !res) {
+            asn = std::move(prevasn);
+            costs = std::move(prevcosts);
+            break;
+        }
+        centers = centers_cpy;
+        ++iternum;
+        auto oldcost = cost;
+        cost = newcost;
+        if(oldcost - newcost < eps * std::max(double(newcost), double(oldcost)) || iternum > maxiter)
+            break;
+    }
+    auto tstop = std::chrono::high_resolution_clock::now();
+    std::fprintf(stderr, "out-of-core clustering for %zu rounds, from cost %0.12g->%0.12g, in %gms\n", iternum, initcost, cost, std::chrono::duration<double, std::milli>(tstop - tstart).count());
+    return {initcost, cost, iternum};
+}
+
+/*
+ * perform_soft_clustering_ooc
+ * Out-of-core counterpart of perform_soft_clustering, with src as for perform_hard_clustering_ooc.
+ *
+ * Each iteration is one pass over src: the costs of each row to the current centers give its responsibilities
+ * and its contribution to the cost, and the row is added to every cluster's sum with its responsibility as weight.
+ * This is the sequence of centers and costs perform_soft_clustering computes when its costs start at those of centers,
+ * without keeping the n x k cost and responsibility matrices; centers match up to the order of floating-point summation.
+ *
+ * Only mean-based centroid policies (FULL_WEIGHTED_MEAN and JSM_MEDIAN) are supported.
+ * Returns {initial cost, final cost, iterations}.
+ */
+template<typename SrcT,
+         typename FT=DefaultFT<SrcT>,
+         typename CtrT=blz::DynamicVector<FT, rowVector>, // Vector Type
+         typename PriorT=blaze::DynamicVector<FT, rowVector>,
+         typename WeightT=blz::DV<FT, rowVector> // Vector Type
+        >
+std::tuple<double, double, size_t>
+perform_soft_clustering_ooc(const SrcT &src,
+                            const dist::DissimilarityMeasure measure,
+                            const PriorT &prior,
+                            std::vector<CtrT> &centers,
+                            double temperature=1.,
+                            size_t maxiter=size_t(-1),
+                            const WeightT *weights=static_cast<WeightT *>(nullptr),
+                            double eps=DEFAULT_EPS,
+                            size_t chunk_rows=DEFAULT_OOC_CHUNK_ROWS)
+{
+    detail::check_mean_measure(measure, __func__);
+    const size_t np = src.rows(), nc = src.columns(), k = centers.size();
+    if(!k) throw std::invalid_argument("perform_soft_clustering_ooc requires at least one center");
+    const bool isnorm = msr_is_normalized(measure);
+    const double prior_sum =
+        prior.size() == 0 ? 0.
+                          : prior.size() == 1
+                          ? double(prior[0] * nc)
+                          : double(blz::sum(prior));
+    blz::DV<double> rowsums(np), ctrsums(k);
+    detail::StreamedMeans means(k, nc);
+    std::vector<blz::DV<FT, rowVector>> tcosts(means.nt_, blz::DV<FT, rowVector>(k)), tresp(tcosts);
+    std::vector<double> tret(means.nt_);
+    const uint64_t nbytes = src.bytes(0, np);
+    bool have_rowsums = false;
+    auto centers_cpy(centers);
+    double cost = std::numeric_limits<double>::max();
+    double initcost = -1;
+    size_t iternum = 0;
+    util::Telemetry *const tel = util::active_telemetry();
+    if(tel) tel->mark();
+    for(;;) {
+        PYBIND11_EXCEPTION_CHECK();
+        double oldcost = cost;
+        {
+            util::PhaseTimer pt("ooc.soft_pass", uint64_t(np) * k, nbytes);
+            for(size_t j = 0; j < k; ++j) ctrsums[j] = sum(centers_cpy[j]);
+            means.reset();
+            std::fill(tret.begin(), tret.end(), 0.);
+            detail::for_each_chunk(src, chunk_rows, [&](const auto &chunk, size_t start, size_t stop) {
+                PYBIND11_EXCEPTION_CHECK();
+                means.partition(stop - start, [&](int tid, size_t i) {
+                    const size_t gi = start + i;
+                    auto r = row(chunk, i, unchecked);
+                    if(!have_rowsums) rowsums[gi] = detail::csr_rowsum(chunk, i);
+                    auto &c = tcosts[tid];
+                    auto &resp = tresp[tid];
+                    for(size_t j = 0; j < k; ++j)
+                        c[j] = cmp::msr_with_prior<FT>(measure, r, centers_cpy[j], prior, prior_sum, rowsums[gi], ctrsums[j]);
+                    resp = softmax(c * -temperature);
+                    correct_softmax(c, resp);
+                    const double w = weights ? double((*weights)[gi]): 1.;
+                    tret[tid] += dot(c, resp) * w;
+                    const double scale = isnorm ? w / rowsums[gi]: w;
+                    for(size_t j = 0; j < k; ++j) {
+                        if(resp[j] == 0.) continue;
+                        means.add(tid, j, r, scale * resp[j]);
+                        means.weights_(tid, j) += w * resp[j];
+                    }
+                });
+            });
+            have_rowsums = true;
+            cost = std::accumulate(tret.begin(), tret.end(), 0.);
+            OMP_PFOR_DYN
+            for(size_t j = 0; j < k; ++j)
+                set_center(centers_cpy[j], means.total(j) * (1. / means.total_weight(j)));
+        }
+        if(tel) tel->add_iteration(cost);
+        if(initcost < 0) {
+            initcost = cost;
+            std::fprintf(stderr, "[%s] initial cost: %0.12g\n", __func__, cost);
+        }
+        DBG_ONLY(std::fprintf(stderr, "oldcost: %.20g. newcost: %.20g. Difference: %0.20g\n", oldcost, cost, oldcost - cost);)
+        if(oldcost >= cost) // Update centers only if an improvement
+            std::copy(centers_cpy.begin(), centers_cpy.end(), centers.begin());
+        if(oldcost - cost <= eps * std::max(oldcost, cost) || ++iternum == maxiter) {
+            break;
+        }
+    }
+    return std::make_tuple(initcost, cost, iternum);
+}
+
+} // namespace clustering
+using clustering::perform_hard_clustering_ooc;
+using clustering::perform_soft_clustering_ooc;
+
+} // namespace minicore
+#endif /* #ifndef MINOCORE_CLUSTERING_OUTOFCORE_H__ */
@@ -0,0 +1,356 @@
+#ifndef MINOCORE_CLUSTERING_RESTARTS_H__
+#define MINOCORE_CLUSTERING_RESTARTS_H__
+#pragma once
+
+#include "minicore/clustering/solve.h"
+#include "minicore/clustering/streamedmeans.h"
+
+namespace minicore {
+
+namespace clustering {
+
+namespace detail {
+
+/*
+ * perform_hard_clustering_multi_impl
+ * Runs Lloyd's algorithm on several solutions at once, each with its own set of centers (which may differ in size),
+ * sharing each pass over the data among them.
+ *
+ * Each pass reads every row once and assigns it to its nearest center in each unfinished solution.
+ * For mean-based centroid policies (FULL_WEIGHTED_MEAN and JSM_MEDIAN), the same pass adds the row to the sums
+ * from which that solution's next centers are computed, so S solutions read the data about as often as one run does;
+ * restarting an empty cluster costs one extra pass, for that solution alone.
+ * Each thread sums into its own buffer, so solutions are grouped into batches whose buffers fit in StreamedMeans::MAX_ACCUM_BYTES
+ * with every thread; a pass makes one sweep over the data per batch, after which each batch's sums are reduced into one copy.
+ * Other policies compute each solution's centers with set_centroids_hard, so only assignment is shared.
+ * mat may also be a util::HalfDenseMatrix, whose rows are decoded to float once per pass; this requires a mean-based policy.
+ *
+ * Every solution follows perform_hard_clustering with csr_transforms = 0 from its initial centers step for step:
+ * the same assignments, costs, restarts of empty clusters, termination and rejection of a final step which increases the cost.
+ * Centers match up to the order of floating-point summation.
+ * Returns {initial cost, final cost, iterations} for each solution.
+ */
+template<typename FT, typename MT, typename MsrT, typename CtrT, typename CostsT, typename PriorT, typename AsnT, typename WeightT>
+std::vector<std::tuple<double, double, size_t>>
+perform_hard_clustering_multi_impl(const MT &mat,
+                                   const MsrT measure,
+                                   const PriorT &prior,
+                                   std::vector<std::vector<CtrT>> &centers,
+                                   std::vector<AsnT> &asns,
+                                   std::vector<CostsT> &costs,
+                                   const WeightT *weights,
+                                   double eps,
+                                   size_t maxiter)
+{
+    const dist::DissimilarityMeasure msr = measure;
+    MINOCORE_VALIDATE(dist::is_valid_measure(msr));
+    const size_t nsol = centers.size(), np = mat.rows(), nc = mat.columns();
+    if(!nsol) throw std::invalid_argument("Multiple-solution clustering requires at least one set of centers");
+    std::vector<size_t> offsets(nsol + 1);
+    for(size_t s = 0; s < nsol; ++s) {
+        if(centers[s].empty()) throw std::invalid_argument("Each set of centers must be nonempty");
+        offsets[s + 1] = offsets[s] + centers[s].size();
+    }
+    using asn_t = std::decay_t<decltype(asns[0][0])>;
+    const CentroidPol pol = msr2pol(msr);
+    const bool fused = pol == FULL_WEIGHTED_MEAN || pol == JSM_MEDIAN;
+    if(util::IsHalfDenseMatrix_v<MT> && !fused)
+        throw std::invalid_argument(std::string("16-bit storage requires a mean-based centroid policy; ") + dist::msr2str(msr) + " uses " + cp2str(pol));
+    const bool isnorm = msr_is_normalized(msr);
+    const FT prior_sum =
+        prior.size() == 0 ? 0.
+                          : prior.size() == 1
+                          ? double(prior[0] * nc)
+                          : double(blz::sum(prior));
+    asns.resize(nsol);
+    costs.resize(nsol);
+    for(size_t s = 0; s < nsol; ++s) asns[s].resize(np), costs[s].resize(np);
+    const blz::DV<double> rowsums = sum<blz::rowwise>(mat);
+    std::vector<blz::DV<double>> ctrsums(nsol);
+    // Solutions are assigned in order to batches of at most batchcap clusters (or one solution, if larger)
+    // Cluster j of solution s is cluster boffsets[s] + j of means during its batch's sweep, and row offsets[s] + j of totals afterwards
+    std::vector<size_t> batchof(nsol), boffsets(nsol);
+    size_t nbatches = 0, maxbatchk = 0;
+    std::unique_ptr<StreamedMeans> means;
+    blz::DM<double> totals;
+    if(fused) {
+        int nt = 1;
+        OMP_ONLY(nt = omp_get_max_threads();)
+        const size_t batchcap = std::max(size_t(1), StreamedMeans::MAX_ACCUM_BYTES / (size_t(nt) * nc * sizeof(double)));
+        size_t bk = 0;
+        for(size_t s = 0; s < nsol; ++s) {
+            const size_t k = centers[s].size();
+            if(bk && bk + k > batchcap) ++nbatches, bk = 0;
+            batchof[s] = nbatches;
+            boffsets[s] = bk;
+            bk += k;
+            maxbatchk = std::max(maxbatchk, bk);
+        }
+        ++nbatches;
+        means.reset(new StreamedMeans(maxbatchk, nc));
+        totals.resize(offsets.back(), nc);
+    }
+    // Reduces the sums of solution s, clusters [boff, boff + k) of means, into its rows of totals
+    auto collect = [&](size_t s, size_t boff) {
+        const size_t k = centers[s].size();
+        OMP_PFOR
+        for(size_t j = 0; j < k; ++j)
+            row(totals, offsets[s] + j) = means->total(boff + j);
+    };
+    auto getw = [weights](size_t i) -> double {return weights ? double((*weights)[i]): 1.;};
+    auto compute_cost = [&](size_t s) -> double {
+        if(weights) return blz::dot(costs[s], *weights);
+        else        return blz::sum(costs[s]);
+    };
+    // Rows of a HalfDenseMatrix are decoded to float once per pass, into a buffer owned by the calling thread
+    auto getrow = [&](size_t i) -> decltype(auto) {
+        if constexpr(util::IsHalfDenseMatrix_v<MT>) return mat.decoded_row(i);
+        else                                        return row(mat, i, unchecked);
+    };
+    const uint64_t nbytes = data_bytes(mat);
+    // One pass over mat: for each solution s in sel, assign each row to its nearest center in ctrs[s] and, if fused, add it to that cluster's sum
+    auto pass = [&](const std::vector<size_t> &sel, const std::vector<std::vector<CtrT>> &ctrs) {
+        uint64_t nevals = 0;
+        for(const auto s: sel) {
+            const size_t k = ctrs[s].size();
+            ctrsums[s] = blaze::generate(k, [&](auto j) {return sum(ctrs[s][j]);});
+            nevals += uint64_t(np) * k;
+        }
+        util::PhaseTimer pt("multi.assign", nevals, nbytes);
+        std::vector<size_t> bsel; // The solutions in sel of the current batch
+        auto onerow = [&](int tid, size_t i) {
+            const auto &rr = getrow(i);
+            const double scale = isnorm ? getw(i) / rowsums[i]: getw(i);
+            for(const auto s: bsel) {
+                const auto &sc = ctrs[s];
+                const auto &cs = ctrsums[s];
+                auto bestcost = cmp::msr_with_prior<FT>(measure, rr, sc[0], prior, prior_sum, rowsums[i], cs[0]);
+                asn_t bestid = 0;
+                for(unsigned j = 1; j < sc.size(); ++j)
+                    if(auto newcost = cmp::msr_with_prior<FT>(measure, rr, sc[j], prior, prior_sum, rowsums[i], cs[j]); newcost < bestcost)
+                        bestid = j, bestcost = newcost;
+                costs[s][i] = bestcost; asns[s][i] = bestid;
+                if(means) means->add(tid, boffsets[s] + bestid, rr, scale);
+            }
+        };
+        if(!means) {
+            bsel = sel;
+            OMP_PFOR_DYN
+            for(size_t i = 0; i < np; ++i) onerow(0, i);
+            return;
+        }
+        for(size_t b = 0; b < nbatches; ++b) {
+            bsel.clear();
+            for(const auto s: sel) if(batchof[s] == b) bsel.push_back(s);
+            if(bsel.empty()) continue;
+            means->reset();
+            means->partition(np, onerow);
+            for(const auto s: bsel) collect(s, boffsets[s]);
+        }
+    };
+    // The M step of set_centroids_full_mean for solution s, from the sums collected in the last pass;
+    // empty clusters are restarted by D2 sampling exactly as there. Returns whether any center was restarted.
+    auto set_centroids_fused = [&](size_t s, std::vector<std::vector<CtrT>> &ctrs) {
+        auto &asn = asns[s];
+        auto &scosts = costs[s];
+        auto &sc = ctrs[s];
+        const size_t k = sc.size(), off = offsets[s];
+        std::vector<size_t> counts(k), first(k);
+        std::vector<double> wsums(k);
+        auto count = [&]() {
+            std::fill(counts.begin(), counts.end(), size_t(0));
+            std::fill(wsums.begin(), wsums.end(), 0.);
+            for(size_t i = 0; i < np; ++i) {
+                const auto a = asn[i];
+                if(!counts[a]++) first[a] = i;
+                wsums[a] += getw(i);
+            }
+        };
+        count();
+        std::vector<size_t> sa;
+        for(size_t j = 0; j < k; ++j) if(!counts[j]) sa.push_back(j);
+        bool restarted_any = false;
+        if(!sa.empty()) {
+            restarted_any = true;
+            std::fprintf(stderr, "[%s] Restarting %zu centers with no support in solution %zu\n", __func__, sa.size(), s);
+            wy::WyRand<size_t, 4> rng(np);
+            const FT psum = prior.size() == 1 ? FT(prior[0]) * prior.size(): sum(prior);
+            std::vector<size_t> rs;
+            for(const auto id: sa) {
+                const size_t pid = util::parallel_weighted_sample(np, rng(), [&](size_t i) {return weights ? double(scosts[i]) * (*weights)[i]: double(scosts[i]);});
+                rs.push_back(pid);
+                if(isnorm) set_center(sc[id], getrow(pid) / rowsums[pid]);
+                else       set_center(sc[id], getrow(pid));
+            }
+            // As set_centroids_full_mean, reassign with the restarted centers
+            auto &cs = ctrsums[s];
+            for(size_t j = 0; j < k; ++j) cs[j] = sum(sc[j]);
+            // Solution s alone fits in means, at offset 0
+            means->reset(0, k);
+            means->partition(np, [&](int tid, size_t i) {
+                const auto &rr = getrow(i);
+                auto bestcost = cmp::msr_with_prior(msr, rr, sc[0], prior, psum, rowsums[i], cs[0]);
+                asn_t bestid = 0;
+                for(unsigned j = 1; j < k; ++j)
+                    if(auto newcost = cmp::msr_with_prior(msr, rr, sc[j], prior, psum, rowsums[i], cs[j]); newcost < bestcost)
+                        bestid = j, bestcost = newcost;
+                scosts[i] = bestcost; asn[i] = bestid;
+                means->add(tid, bestid, rr, isnorm ? getw(i) / rowsums[i]: getw(i));
+            });
+            for(size_t i = 0; i < sa.size(); ++i) {
+                const auto pid = rs[i];
+                const auto cid = sa[i];
+                if(asn[pid] != cid) {
+                    const double scale = isnorm ? getw(pid) / rowsums[pid]: getw(pid);
+                    means->add(0, asn[pid], getrow(pid), -scale);
+                    means->add(0, cid, getrow(pid), scale);
+                    asn[pid] = cid;
+                    scosts[pid] = 0.;
+                }
+            }
+            collect(s, 0);
+            count();
+        }
+        OMP_PFOR_DYN
+        for(size_t j = 0; j < k; ++j) {
+            if(counts[j] == 0) continue;
+            if(counts[j] == 1) {
+                if(isnorm) set_center(sc[j], getrow(first[j]) / rowsums[first[j]]);
+                else       set_center(sc[j], getrow(first[j]));
+            } else {
+                set_center(sc[j], row(totals, off + j) * (1. / wsums[j]));
+            }
+        }
+        return restarted_any;
+    };
+    auto set_centroids = [&](size_t s, std::vector<std::vector<CtrT>> &ctrs) -> bool {
+        if(fused) return set_centroids_fused(s, ctrs);
+        if constexpr(!util::IsHalfDenseMatrix_v<MT>)
+            return set_centroids_hard<FT>(mat, msr, prior, ctrs[s], asns[s], costs[s], weights, ctrsums[s], rowsums);
+        else __builtin_unreachable();
+    };
+
+    std::vector<std::tuple<double, double, size_t>> ret(nsol);
+    std::vector<size_t> active(nsol);
+    std::iota(active.begin(), active.end(), size_t(0));
+    pass(active, centers);
+    std::vector<double> cost(nsol);
+    for(size_t s = 0; s < nsol; ++s) {
+        cost[s] = compute_cost(s);
+        std::get<0>(ret[s]) = std::get<1>(ret[s]) = cost[s];
+    }
+    // As in perform_hard_clustering, a cost of 0 can't decrease
+    active.erase(std::remove_if(active.begin(), active.end(), [&](size_t s) {return cost[s] == 0.;}), active.end());
+    auto centers_cpy = centers;
+    std::vector<AsnT> prevasns(nsol);
+    std::vector<CostsT> prevcosts(nsol);
+    std::vector<bool> res(nsol);
+    util::Telemetry *const tel = util::active_telemetry();
+    if(tel) tel->mark();
+    while(!active.empty()) {
+        PYBIND11_EXCEPTION_CHECK();
+        {
+            util::PhaseTimer pt("multi.set_centroids", 0, fused ? 0: nbytes * active.size());
+            for(const auto s: active) res[s] = set_centroids(s, centers_cpy);
+        }
+        // Kept so that a step which increases the cost can be undone without another pass
+        for(const auto s: active) prevasns[s] = asns[s], prevcosts[s] = costs[s];
+        pass(active, centers_cpy);
+        std::vector<size_t> next;
+        for(const auto s: active) {
+            const double newcost = compute_cost(s);
+            DBG_ONLY(std::fprintf(stderr, "Solution %zu, iteration %zu: [%.16g old/%.16g new]\n", s, std::get<2>(ret[s]), cost[s], newcost);)
+            if(newcost > cost[s] && !res[s]) {
+                asns[s] = std::move(prevasns[s]);
+                costs[s] = std::move(prevcosts[s]);
+                continue;
+            }
+            centers[s] = centers_cpy[s];
+            const size_t iternum = ++std::get<2>(ret[s]);
+            const double oldcost = cost[s];
+            cost[s] = std::get<1>(ret[s]) = newcost;
+            if(!(oldcost - newcost < eps * std::max(newcost, oldcost) || iternum > maxiter))
+                next.push_back(s);
+        }
+        if(tel) tel->add_iteration(*std::min_element(cost.begin(), cost.end()));
+        active = std::move(next);
+    }
+    return ret;
+}
+
+/*
+ * perform_hard_clustering_multi
+ * Runtime measure version of perform_hard_clustering_multi_impl;
+ * dispatches once to the compile-time instantiation for measure, as perform_hard_clustering does.
+ */
+template<typename FT, typename MT, typename CtrT, typename CostsT, typename PriorT, typename AsnT, typename WeightT>
+std::vector<std::tuple<double, double, size_t>>
+perform_hard_clustering_multi(const MT &mat,
+                              const dist::DissimilarityMeasure measure,
+                              const PriorT &prior,
+                              std::vector<std::vector<CtrT>> &centers,
+                              std::vector<AsnT> &asns,
+                              std::vector<CostsT> &costs,
+                              const WeightT *weights,
+                              double eps,
+                              size_t maxiter)
+{
+    switch(measure) {
+#define DISPATCH_MULTI(x) case dist::x: return perform_hard_clustering_multi_impl<FT>(mat, dist::MeasureConstant<dist::x>(), prior, centers, asns, costs, weights, eps, maxiter);
+        DISPATCH_MSR_MACRO(DISPATCH_MULTI)
+#undef DISPATCH_MULTI
+        default: return perform_hard_clustering_multi_impl<FT>(mat, measure, prior, centers, asns, costs, weights, eps, maxiter);
+    }
+}
+
+} // namespace detail
+
+/*
+ * perform_hard_clustering_restarts
+ * Runs Lloyd's algorithm from several initial solutions (restarts) at once, sharing each pass over the data among them.
+ *
+ * centers holds one set of k initial centers per restart; asns and costs are resized to one vector per restart.
+ * Each pass reads every row once and assigns it to its nearest center in each unfinished restart.
+ * For mean-based centroid policies, the same pass accumulates the sums from which the next centers are computed,
+ * so R restarts read the data about as often as one run does.
+ *
+ * Every restart follows perform_hard_clustering with csr_transforms = 0 from its initial centers step for step;
+ * see detail::perform_hard_clustering_multi_impl.
+ * Returns the index of the restart with the lowest final cost, and {initial cost, final cost, iterations} for each restart.
+ */
+template<typename MT, // MatrixType
+         typename FT=DefaultFT<MT>,
+         typename CtrT=blz::DynamicVector<FT, rowVector>, // Vector Type
+         typename CostsT,
+         typename PriorT=blz::DynamicVector<FT, rowVector>,
+         typename AsnT=blz::DynamicVector<uint32_t>,
+         typename WeightT=blz::DynamicVector<FT> // Vector Type
+        >
+std::pair<size_t, std::vector<std::tuple<double, double, size_t>>>
+perform_hard_clustering_restarts(const MT &mat,
+                                 const dist::DissimilarityMeasure measure,
+                                 const PriorT &prior,
+                                 std::vector<std::vector<CtrT>> &centers,
+                                 std::vector<AsnT> &asns,
+                                 std::vector<CostsT> &costs,
+                                 const WeightT *weights=static_cast<WeightT *>(nullptr),
+                                 double eps=DEFAULT_EPS,
+                                 size_t maxiter=size_t(-1))
+{
+    auto tstart = std::chrono::high_resolution_clock::now();
+    if(centers.empty()) throw std::invalid_argument("perform_hard_clustering_restarts requires at least one set of centers");
+    for(const auto &ctrs: centers)
+        if(ctrs.size() != centers.front().size()) throw std::invalid_argument("All restarts must have the same number of centers");
+    auto ret = detail::perform_hard_clustering_multi<FT>(mat, measure, prior, centers, asns, costs, weights, eps, maxiter);
+    const size_t best = std::min_element(ret.begin(), ret.end(), [](const auto &x, const auto &y) {return std::get<1>(x) < std::get<1>(y);}) - ret.begin();
+    auto tstop = std::chrono::high_resolution_clock::now();
+    std::fprintf(stderr, "%zu restarts of clustering in %gms; best is restart %zu, from cost %0.12g->%0.12g in %zu rounds\n",
+                 centers.size(), std::chrono::duration<double, std::milli>(tstop - tstart).count(), best, std::get<0>(ret[best]), std::get<1>(ret[best]), std::get<2>(ret[best]));
+    return {best, std::move(ret)};
+}
+
+} // namespace clustering
+using clustering::perform_hard_clustering_restarts;
+
+} // namespace minicore
+#endif /* #ifndef MINOCORE_CLUSTERING_RESTARTS_H__ */
@@ -0,0 +1,192 @@
+#ifndef MINOCORE_CLUSTERING_SOFTTOPM_H__
+#define MINOCORE_CLUSTERING_SOFTTOPM_H__
+#include "minicore/clustering/centroid.h"
+#include "minicore/clustering/geomedian.h"
+
+namespace minicore { namespace clustering {
+
+/*
+ * TopMResponsibilities
+ * Truncated soft assignments: each point keeps only its m lowest-cost centers.
+ * Entries are stored in CSR layout with a fixed row length of m (indptr[i] = i * m),
+ * so memory is O(nm) rather than the O(nk) of the dense costs/responsibilities matrices.
+ *
+ * Kept responsibilities are renormalized to sum to 1, and dropped_[i] holds the softmax mass
+ * that point i would have given to the k - m discarded centers.
+ * This is at most (k - m) / (k - m + exp(T * (c_(m+1) - c_(1))))
+ * where c_(j) is the j-th smallest cost, so it shrinks quickly with separation and temperature.
+ */
+template<typename FT=float, typename IT=uint32_t>
+struct TopMResponsibilities {
+    size_t n_ = 0, k_ = 0, m_ = 0;
+    std::vector<IT> ids_;
+    std::vector<FT> costs_;
+    std::vector<FT> resp_;
+    blz::DV<FT> dropped_;
+
+    TopMResponsibilities() {}
+    TopMResponsibilities(size_t n, size_t k, size_t m) {resize(n, k, m);}
+    void resize(size_t n, size_t k, size_t m) {
+        if(!m) throw std::invalid_argument("m must be positive");
+        m = std::min(m, k);
+        n_ = n; k_ = k; m_ = m;
+        ids_.resize(n * m);
+        costs_.resize(n * m);
+        resp_.resize(n * m);
+        dropped_.resize(n);
+    }
+    size_t rows() const {return n_;}
+    size_t ncenters() const {return k_;}
+    size_t m() const {return m_;}
+    size_t nnz() const {return ids_.size();}
+    IT *ids(size_t i) {return ids_.data() + i * m_;}
+    const IT *ids(size_t i) const {return ids_.data() + i * m_;}
+    FT *costs(size_t i) {return costs_.data() + i * m_;}
+    const FT *costs(size_t i) const {return costs_.data() + i * m_;}
+    FT *resp(size_t i) {return resp_.data() + i * m_;}
+    const FT *resp(size_t i) const {return resp_.data() + i * m_;}
+    double max_dropped() const {return n_ ? double(blz::max(dropped_)): 0.;}
+    double total_dropped() const {return n_ ? double(blz::sum(dropped_)): 0.;}
+};
+
+/*
+ * E-step for truncated soft clustering.
+ * Computes all k costs for each point in a thread-local buffer, keeps the m smallest
+ * and their (renormalized) softmax responsibilities, and records the dropped mass.
+ * Returns the expected cost, sum_i w_i sum_j r_ij c_ij, over the kept entries.
+ */
+template<typename FT, typename Mat, typename PriorT, typename CtrT, typename RFT, typename IT, typename WeightT, typename SumT, typename RSumT>
+double assign_points_topm(const Mat &mat,
+                          const dist::DissimilarityMeasure measure,
+                          const PriorT &prior,
+                          const std::vector<CtrT> &centers,
+                          TopMResponsibilities<RFT, IT> &resp,
+                          const WeightT *weights,
+                          const double temp,
+                          const SumT &centersums,
+                          const RSumT &rowsums)
+{
+    const size_t np = mat.rows(), k = centers.size(), m = resp.m();
+    if(resp.rows() != np || resp.ncenters() != k) throw std::invalid_argument("TopMResponsibilities has the wrong shape");
+    const double prior_sum =
+        prior.size() == 0 ? 0.
+                          : prior.size() == 1
+                          ? double(prior[0] * mat.columns())
+                          : double(blz::sum(prior));
+    double ret = 0.;
+    OMP_PRAGMA("omp parallel for schedule(dynamic) reduction(+:ret)")
+    for(size_t i = 0; i < np; ++i) {
+        thread_local std::vector<std::pair<double, IT>> buf;
+        buf.resize(k);
+        for(size_t j = 0; j < k; ++j)
+            buf[j] = {cmp::msr_with_prior<FT>(measure, row(mat, i, unchecked), centers[j], prior, prior_sum, rowsums[i], centersums[j]), IT(j)};
+        std::partial_sort(buf.begin(), buf.begin() + m, buf.end());
+        const double cmin = buf[0].first;
+        auto ids = resp.ids(i);
+        auto costs = resp.costs(i);
+        auto r = resp.resp(i);
+        double kept = 0., total = 0.;
+        for(size_t j = 0; j < k; ++j) {
+            const double e = std::exp(-temp * (buf[j].first - cmin));
+            total += e;
+            if(j < m) {
+                kept += e;
+                ids[j] = buf[j].second;
+                costs[j] = buf[j].first;
+                r[j] = e;
+            }
+        }
+        double rowcost = 0.;
+        if(unlikely(!(kept > 0.) || std::isnan(kept))) {
+            // All costs are infinite or NaN; split evenly between ties, as in correct_softmax
+            size_t nties = 1;
+            while(nties < m && buf[nties].first == cmin) ++nties;
+            for(size_t j = 0; j < m; ++j) r[j] = j < nties ? RFT(1. / nties): RFT(0);
+            resp.dropped_[i] = 0.;
+            rowcost = cmin;
+        } else {
+            const double kinv = 1. / kept;
+            for(size_t j = 0; j < m; ++j) {
+                r[j] *= kinv;
+                rowcost += r[j] * costs[j];
+            }
+            resp.dropped_[i] = 1. - kept / total;
+        }
+        ret += rowcost * (weights ? double((*weights)[i]): 1.);
+    }
+    return ret;
+}
+
+/*
+ * M-step for truncated soft clustering.
+ * Responsibilities are regrouped by center with a counting sort,
+ * so each center only visits the points which kept it.
+ * Centers which no point kept are left unchanged.
+ * L2 solves all k weighted geometric medians together (see geomedians), L1 uses weighted L1 medians,
+ * and all other measures use the weighted mean.
+ */
+template<typename FT=double, typename Mat, typename CtrT, typename RFT, typename IT, typename WeightT, typename SumT, typename RSumT>
+void set_centroids_topm(const Mat &mat,
+                        const dist::DissimilarityMeasure measure,
+                        const TopMResponsibilities<RFT, IT> &resp,
+                        std::vector<CtrT> &ctrs,
+                        const WeightT *weights,
+                        SumT &ctrsums,
+                        const RSumT &rowsums)
+{
+    const size_t np = resp.rows(), k = ctrs.size(), m = resp.m();
+    if(measure == distance::L2) {
+        geomedians<FT>(mat, ctrs, [&](size_t i, const auto &f) {
+            const double w = weights ? double((*weights)[i]): 1.;
+            auto ids = resp.ids(i);
+            auto r = resp.resp(i);
+            for(size_t j = 0; j < m; ++j) f(ids[j], w * r[j]);
+        });
+        for(size_t i = 0; i < k; ++i) ctrsums[i] = sum(ctrs[i]);
+        return;
+    }
+    std::vector<size_t> offsets(k + 1);
+    for(size_t i = 0; i < resp.nnz(); ++i) ++offsets[resp.ids_[i] + 1];
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+    std::vector<std::pair<uint64_t, FT>> entries(resp.nnz());
+    // ends[i] may stop short of offsets[i + 1], as zero-responsibility entries are skipped
+    std::vector<size_t> ends(offsets.begin(), offsets.end() - 1);
+    for(size_t i = 0; i < np; ++i) {
+        const double w = weights ? double((*weights)[i]): 1.;
+        auto ids = resp.ids(i);
+        auto r = resp.resp(i);
+        for(size_t j = 0; j < m; ++j)
+            if(r[j] > 0.)
+                entries[ends[ids[j]]++] = {i, FT(w * r[j])};
+    }
+    if(measure == distance::L1) {
+        blz::DV<FT, blz::columnVector> colweights(np);
+        for(size_t i = 0; i < k; ++i) {
+            auto b = entries.data() + offsets[i], e = entries.data() + ends[i];
+            if(b == e) continue;
+            colweights = 0.;
+            for(; b != e; ++b) colweights[b->first] = b->second;
+            l1_median(mat, ctrs[i], (uint64_t *)nullptr, 0, &colweights);
+        }
+    } else { // weighted mean (Bregman)
+        const bool isnorm = msr_is_normalized(measure);
+        OMP_PFOR_DYN
+        for(size_t i = 0; i < k; ++i) {
+            auto b = entries.data() + offsets[i], e = entries.data() + ends[i];
+            if(b == e) continue;
+            blz::DV<FT, blz::TransposeFlag_v<CtrT>> tmp(mat.columns(), FT(0));
+            double wsum = 0.;
+            for(; b != e; ++b) {
+                const double mul = isnorm ? b->second / double(rowsums[b->first]): double(b->second);
+                detail::for_each_nonzero(row(mat, b->first, unchecked), [&](size_t idx, auto v) {tmp[idx] += mul * v;});
+                wsum += b->second;
+            }
+            ctrs[i] = tmp * FT(1. / wsum);
+        }
+    }
+    for(size_t i = 0; i < k; ++i) ctrsums[i] = sum(ctrs[i]);
+}
+
+} } // namespace minicore::clustering
+
+#endif /* MINOCORE_CLUSTERING_SOFTTOPM_H__ */
@@ -4,6 +4,8 @@
 
 #include "minicore/dist.h"
 #include "minicore/clustering/centroid.h"
+#include "minicore/clustering/lazycenter.h"
+#include "minicore/clustering/softtopm.h"
 #include "minicore/coreset/coreset.h"
 
 namespace minicore {
@@ -55,9 +57,9 @@ static constexpr double DEFAULT_EPS = MC_DEFAULT_EPS;
  * 3. Then, assign points to their nearest centers.
  * While not converged, continue
  */
-template<typename FT, typename Mat, typename PriorT, typename CtrT, typename CostsT, typename AsnT, typename WeightT=CtrT, typename SumT>
+template<typename FT, typename Mat, typename MsrT, typename PriorT, typename CtrT, typename CostsT, typename AsnT, typename WeightT=CtrT, typename SumT>
 void assign_points_hard(const Mat &mat,
-                        const dist::DissimilarityMeasure measure,
+                        const MsrT measure,
                         const PriorT &prior,
                         const std::vector<CtrT> &centers,
                         AsnT &asn,
@@ -65,6 +67,14 @@ void assign_points_hard(const Mat &mat,
                         const WeightT *,
                         const SumT &centersums,
                         const SumT &rowsums);
+template<typename FT, typename CFT, typename VT, typename IT, typename IPtrT, typename MsrT, typename CtrT, typename CostsT, typename AsnT, typename SumT>
+void assign_points_hard_cached(const cmp::CSRTransformCache<CFT> &cache,
+                               const util::CSparseMatrix<VT, IT, IPtrT> &mat,
+                               const MsrT measure,
+                               const std::vector<CtrT> &centers,
+                               AsnT &asn,
+                               CostsT &costs,
+                               const SumT &centersums);
 template<typename FT, typename Mat, typename PriorT, typename CtrT, typename CostsT, typename AsnT, typename WeightT=CtrT, typename SumT>
 bool set_centroids_hard(const Mat &mat,
                         const dist::DissimilarityMeasure measure,
@@ -95,26 +105,34 @@ using DefaultFT = std::conditional_t<std::is_floating_point_v<blz::ElementType_t
                                                               blz::ElementType_t<MT>,
                                                               std::conditional_t<sizeof(blz::ElementType_t<MT>) < 8, float, double>>;
 
-template<typename MT, // MatrixType
-         typename FT=DefaultFT<MT>,
-         typename CtrT=blz::DynamicVector<FT, rowVector>, // Vector Type
-         typename CostsT,
-         typename PriorT=blz::DynamicVector<FT, rowVector>,
-         typename AsnT=blz::DynamicVector<uint32_t>,
-         typename WeightT=blz::DynamicVector<FT>, // Vector Type
-         typename RSumsT=blz::DV<double>
-        >
+namespace detail {
+
+// Approximate bytes read in one pass over mat, for telemetry
+template<typename MT>
+uint64_t data_bytes(const MT &mat) {
+    if constexpr(util::IsCSparseMatrix_v<MT>) {
+        return mat.nnz() * (sizeof(*mat.data_) + sizeof(*mat.indices_)) + (mat.rows() + 1) * sizeof(*mat.indptr_);
+    } else if constexpr(blaze::IsSparseMatrix_v<MT>) {
+        return nonZeros(mat) * (sizeof(blaze::ElementType_t<MT>) + sizeof(size_t));
+    } else {
+        return uint64_t(mat.rows()) * mat.columns() * sizeof(blaze::ElementType_t<MT>);
+    }
+}
+
+// measure is either a runtime DissimilarityMeasure or a dist::MeasureConstant; see perform_hard_clustering below.
+template<typename FT, typename MT, typename MsrT, typename CtrT, typename CostsT, typename PriorT, typename AsnT, typename WeightT, typename RSumsT>
 std::tuple<double, double, size_t>
-perform_hard_clustering(const MT &mat,
-                        const dist::DissimilarityMeasure measure,
-                        const PriorT &prior,
-                        std::vector<CtrT> &centers,
-                        AsnT &asn,
-                        CostsT &costs,
-                        const WeightT *weights=static_cast<WeightT *>(nullptr),
-                        double eps=DEFAULT_EPS,
-                        size_t maxiter=size_t(-1),
-                        RSumsT *rsums=static_cast<RSumsT *>(nullptr))
+perform_hard_clustering_impl(const MT &mat,
+                             const MsrT measure,
+                             const PriorT &prior,
+                             std::vector<CtrT> &centers,
+                             AsnT &asn,
+                             CostsT &costs,
+                             const WeightT *weights,
+                             double eps,
+                             size_t maxiter,
+                             RSumsT *rsums,
+                             unsigned csr_transforms)
 {
     auto tstart = std::chrono::high_resolution_clock::now();
     auto compute_cost = [&costs,w=weights]() -> FT {
@@ -128,7 +146,25 @@ perform_hard_clustering(const MT &mat,
         rsums = &rowsums;
     }
     blz::DV<double> ctrsums = blaze::generate(centers.size(), [&](auto x){return sum(centers[x]);});
-    assign_points_hard<FT>(mat, measure, prior, centers, asn, costs, weights, ctrsums, *rsums); // Assign points myself
+    // For CSR input, transforms of the data are computed once here rather than in every comparison
+    std::unique_ptr<cmp::CSRTransformCache<FT>> csrcache;
+    if constexpr(util::IsCSparseMatrix_v<MT> && !blaze::IsSparseVector_v<CtrT>) {
+        const unsigned need = cmp::csr_transforms_for(measure);
+        if(csr_transforms && (csr_transforms & need) == need && cmp::csr_cache_supports(measure, prior.size() && cmp::getv(prior) > 0.)) {
+            csrcache.reset(new cmp::CSRTransformCache<FT>(mat, prior, need));
+            DBG_ONLY(std::fprintf(stderr, "[%s] Cached CSR transforms: %zu bytes\n", __func__, csrcache->bytes());)
+        }
+    }
+    auto assign = [&](const std::vector<CtrT> &ctrs) {
+        if constexpr(util::IsCSparseMatrix_v<MT> && !blaze::IsSparseVector_v<CtrT>) {
+            if(csrcache) {
+                assign_points_hard_cached<FT>(*csrcache, mat, measure, ctrs, asn, costs, ctrsums);
+                return;
+            }
+        }
+        assign_points_hard<FT>(mat, measure, prior, ctrs, asn, costs, weights, ctrsums, *rsums);
+    };
+    assign(centers); // Assign points myself
     PYBIND11_EXCEPTION_CHECK();
     const auto initcost = compute_cost();
     PYBIND11_EXCEPTION_CHECK();
@@ -140,26 +176,32 @@ perform_hard_clustering(const MT &mat,
     }
     size_t iternum = 0;
     auto centers_cpy = centers;
+    const size_t np = mat.rows(), k = centers.size();
+    const uint64_t nbytes = data_bytes(mat);
+    util::Telemetry *const tel = util::active_telemetry();
+    if(tel) tel->mark();
     for(;;) {
         PYBIND11_EXCEPTION_CHECK();
         DBG_ONLY(std::fprintf(stderr, "Beginning iter %zu\n", iternum);)
-        auto ctrstart = std::chrono::high_resolution_clock::now();
-        auto res = set_centroids_hard<FT>(mat, measure, prior, centers_cpy, asn, costs, weights, ctrsums, *rsums);
-        auto ctrstop = std::chrono::high_resolution_clock::now();
-        std::fprintf(stderr, "Setting centroids took %gms\n", std::chrono::duration<double, std::milli>(ctrstop - ctrstart).count());
-
-        ctrstart = std::chrono::high_resolution_clock::now();
-        assign_points_hard<FT>(mat, measure, prior, centers_cpy, asn, costs, weights, ctrsums, *rsums);
-        ctrstop = std::chrono::high_resolution_clock::now();
-        std::fprintf(stderr, "Assigning points took %gms\n", std::chrono::duration<double, std::milli>(ctrstop - ctrstart).count());
-        ctrstart = std::chrono::high_resolution_clock::now();
-        auto newcost = compute_cost();
-        ctrstop = std::chrono::high_resolution_clock::now();
-        std::fprintf(stderr, "Computing cost took %gms\n", std::chrono::duration<double, std::milli>(ctrstop - ctrstart).count());
+        bool res;
+        {
+            util::PhaseTimer pt("hard.set_centroids", 0, nbytes);
+            res = set_centroids_hard<FT>(mat, measure, prior, centers_cpy, asn, costs, weights, ctrsums, *rsums);
+        }
+        {
+            util::PhaseTimer pt("hard.assign", np * k, nbytes);
+            assign(centers_cpy);
+        }
+        FT newcost;
+        {
+            util::PhaseTimer pt("hard.cost", 0, np * sizeof(costs[0]));
+            newcost = compute_cost();
+        }
+        if(tel) tel->add_iteration(newcost);
         DBG_ONLY(std::fprintf(stderr, "Iteration %zu: [%.16g old/%.16g new]\n", iternum, cost, newcost);)
         if(newcost > cost && !res) {
             ctrsums = blaze::generate(centers.size(), [&](auto x) {return sum(centers[x]);});
-            assign_points_hard<FT>(mat, measure, prior, centers, asn, costs, weights, ctrsums, *rsums);
+            assign(centers);
             break;
         }
         centers = centers_cpy;
@@ -174,6 +216,76 @@ perform_hard_clustering(const MT &mat,
     return {initcost, cost, iternum};
 }
 
+} // namespace detail
+
+/*
+ * perform_hard_clustering<Measure>
+ * Compile-time measure version: the measure switch in msr_with_prior is resolved when this is instantiated,
+ * so the assignment loop calls the measure's kernel directly.
+ */
+template<dist::DissimilarityMeasure MSR,
+         typename MT, // MatrixType
+         typename FT=DefaultFT<MT>,
+         typename CtrT=blz::DynamicVector<FT, rowVector>, // Vector Type
+         typename CostsT,
+         typename PriorT=blz::DynamicVector<FT, rowVector>,
+         typename AsnT=blz::DynamicVector<uint32_t>,
+         typename WeightT=blz::DynamicVector<FT>, // Vector Type
+         typename RSumsT=blz::DV<double>
+        >
+std::tuple<double, double, size_t>
+perform_hard_clustering(const MT &mat,
+                        const PriorT &prior,
+                        std::vector<CtrT> &centers,
+                        AsnT &asn,
+                        CostsT &costs,
+                        const WeightT *weights=static_cast<WeightT *>(nullptr),
+                        double eps=DEFAULT_EPS,
+                        size_t maxiter=size_t(-1),
+                        RSumsT *rsums=static_cast<RSumsT *>(nullptr),
+                        unsigned csr_transforms=cmp::CSR_AUTO)
+{
+    return detail::perform_hard_clustering_impl<FT>(mat, dist::MeasureConstant<MSR>(), prior, centers, asn, costs, weights, eps, maxiter, rsums, csr_transforms);
+}
+
+/*
+ * perform_hard_clustering
+ * Runtime measure version; dispatches once per solve to the compile-time instantiation for measure.
+ *
+ * For a util::CSparseMatrix with dense centers, the transforms the measure needs (see cmp::CSRTransformCache)
+ * are computed once up front, if the measure has a cached kernel and they are all in csr_transforms.
+ * Pass 0 to disable the cache, or a narrower CSRTransform mask to bound its memory.
+ */
+template<typename MT, // MatrixType
+         typename FT=DefaultFT<MT>,
+         typename CtrT=blz::DynamicVector<FT, rowVector>, // Vector Type
+         typename CostsT,
+         typename PriorT=blz::DynamicVector<FT, rowVector>,
+         typename AsnT=blz::DynamicVector<uint32_t>,
+         typename WeightT=blz::DynamicVector<FT>, // Vector Type
+         typename RSumsT=blz::DV<double>
+        >
+std::tuple<double, double, size_t>
+perform_hard_clustering(const MT &mat,
+                        const dist::DissimilarityMeasure measure,
+                        const PriorT &prior,
+                        std::vector<CtrT> &centers,
+                        AsnT &asn,
+                        CostsT &costs,
+                        const WeightT *weights=static_cast<WeightT *>(nullptr),
+                        double eps=DEFAULT_EPS,
+                        size_t maxiter=size_t(-1),
+                        RSumsT *rsums=static_cast<RSumsT *>(nullptr),
+                        unsigned csr_transforms=cmp::CSR_AUTO)
+{
+    switch(measure) {
+#define DISPATCH_HARD(x) case dist::x: return detail::perform_hard_clustering_impl<FT>(mat, dist::MeasureConstant<dist::x>(), prior, centers, asn, costs, weights, eps, maxiter, rsums, csr_transforms);
+        DISPATCH_MSR_MACRO(DISPATCH_HARD)
+#undef DISPATCH_HARD
+        default: return detail::perform_hard_clustering_impl<FT>(mat, measure, prior, centers, asn, costs, weights, eps, maxiter, rsums, csr_transforms);
+    }
+}
+
 
 /*
  *
@@ -231,9 +343,9 @@ bool set_centroids_hard(const Mat &mat,
     return ctrs_restarted;
 }
 
-template<typename FT, typename Mat, typename PriorT, typename CtrT, typename CostsT, typename AsnT, typename WeightT=CtrT, typename SumT>
+template<typename FT, typename Mat, typename MsrT, typename PriorT, typename CtrT, typename CostsT, typename AsnT, typename WeightT=CtrT, typename SumT>
 void assign_points_hard(const Mat &mat,
-                        const dist::DissimilarityMeasure measure,
+                        const MsrT measure,
                         const PriorT &prior,
                         const std::vector<CtrT> &centers,
                         AsnT &asn,
@@ -284,6 +396,39 @@ void assign_points_hard(const Mat &mat,
 #undef __compute_cost
 }
 
+/*
+ * assign_points_hard for a CSparseMatrix with a CSRTransformCache.
+ * Center-side sums and transforms are computed once per call,
+ * after which each comparison only visits the row's nonzeros; see cached_msr_with_prior.
+ */
+template<typename FT, typename CFT, typename VT, typename IT, typename IPtrT, typename MsrT, typename CtrT, typename CostsT, typename AsnT, typename SumT>
+void assign_points_hard_cached(const cmp::CSRTransformCache<CFT> &cache,
+                               const util::CSparseMatrix<VT, IT, IPtrT> &mat,
+                               const MsrT measure,
+                               const std::vector<CtrT> &centers,
+                               AsnT &asn,
+                               CostsT &costs,
+                               const SumT &centersums)
+{
+    using asn_t = std::decay_t<decltype(asn[0])>;
+    const dist::DissimilarityMeasure msr = measure;
+    if(!cache.supports(msr)) throw std::invalid_argument(std::string("CSRTransformCache does not support ") + dist::msr2str(msr));
+    const size_t e = mat.rows(), k = centers.size();
+    std::vector<cmp::CenterTransforms<CFT>> cts(k);
+    OMP_PFOR
+    for(size_t j = 0; j < k; ++j)
+        cts[j].build(msr, centers[j], centersums[j], cache.prior_value());
+    OMP_PFOR
+    for(size_t i = 0; i < e; ++i) {
+        double cost = cmp::cached_msr_with_prior(msr, cache, mat, i, centers[0], cts[0]);
+        asn_t bestid = 0;
+        for(unsigned j = 1; j < k; ++j)
+            if(auto newcost = cmp::cached_msr_with_prior(msr, cache, mat, i, centers[j], cts[j]); newcost < cost)
+                bestid = j, cost = newcost;
+        costs[i] = cost; asn[i] = bestid;
+    }
+}
+
 template<typename MT, // MatrixType
          typename FT=std::conditional_t<(sizeof(ElementType_t<MT>) <= 4), float, double>,
          typename CtrT=blz::DynamicVector<FT, rowVector>, // Vector Type
@@ -312,6 +457,9 @@ auto perform_soft_clustering(const MT &mat,
     double cost = std::numeric_limits<double>::max();
     double initcost = -1;
     size_t iternum = 0;
+    const uint64_t nbytes = detail::data_bytes(mat), nevals = uint64_t(mat.rows()) * centers.size();
+    util::Telemetry *const tel = util::active_telemetry();
+    if(tel) tel->mark();
     for(;;) {
         PYBIND11_EXCEPTION_CHECK();
         double oldcost = cost;
@@ -319,8 +467,11 @@ auto perform_soft_clustering(const MT &mat,
             throw std::runtime_error("Not yet completed: minibatch soft clustering");
             for(int i = 0; i < mbn; ++i); // Perform mbn rounds of minibatch clustering between central
         } else {
+            // Each call updates centers from the current responsibilities, then recomputes costs and responsibilities
+            util::PhaseTimer pt("soft.em_step", nevals, 2 * nbytes);
             cost = set_centroids_soft<FT>(mat, measure, prior, centers_cpy, costs, asns, weights, temperature, centersums, rowsums);
         }
+        if(tel) tel->add_iteration(cost);
         if(initcost < 0) {
             initcost = cost;
             std::fprintf(stderr, "[%s] initial cost: %0.12g\n", __PRETTY_FUNCTION__, cost);
@@ -334,6 +485,71 @@ auto perform_soft_clustering(const MT &mat,
     }
     return std::make_tuple(initcost, cost, iternum);
 }
+
+/*
+ * perform_soft_clustering_topm
+ * Soft clustering which keeps only each point's m lowest-cost centers (see TopMResponsibilities),
+ * using O(nm) memory for costs and responsibilities instead of O(nk).
+ * Responsibilities are renormalized over the kept centers; resp.max_dropped() reports
+ * the largest softmax mass discarded for any point in the final E-step.
+ * With m >= k, this computes the same updates as perform_soft_clustering.
+ */
+template<typename MT, // MatrixType
+         typename FT=std::conditional_t<(sizeof(ElementType_t<MT>) <= 4), float, double>,
+         typename CtrT=blz::DynamicVector<FT, rowVector>, // Vector Type
+         typename RFT=float, typename IT=uint32_t,
+         typename PriorT=blaze::DynamicVector<FT, rowVector>,
+         typename WeightT=blz::DV<FT, rowVector>, // Vector Type
+         typename=std::enable_if_t<std::is_floating_point_v<FT>>
+        >
+auto perform_soft_clustering_topm(const MT &mat,
+                                  const dist::DissimilarityMeasure measure,
+                                  const PriorT &prior,
+                                  std::vector<CtrT> &centers,
+                                  TopMResponsibilities<RFT, IT> &resp,
+                                  size_t m,
+                                  double temperature=1.,
+                                  size_t maxiter=size_t(-1),
+                                  const WeightT *weights=static_cast<WeightT *>(nullptr),
+                                  double eps=DEFAULT_EPS)
+{
+    MINOCORE_VALIDATE(dist::is_valid_measure(measure));
+    resp.resize(mat.rows(), centers.size(), m);
+    auto centers_cpy(centers);
+    blz::DV<double> centersums(centers.size());
+    blz::DV<double> rowsums((mat).rows());
+    rowsums = sum<rowwise>(mat);
+    centersums = blaze::generate(centers.size(), [&](auto x){return blz::sum(centers[x]);});
+    double cost = std::numeric_limits<double>::max();
+    double initcost = -1;
+    size_t iternum = 0;
+    const uint64_t nbytes = detail::data_bytes(mat);
+    util::Telemetry *const tel = util::active_telemetry();
+    if(tel) tel->mark();
+    for(;;) {
+        PYBIND11_EXCEPTION_CHECK();
+        double oldcost = cost;
+        {
+            util::PhaseTimer pt("soft_topm.assign", uint64_t(mat.rows()) * centers.size(), nbytes);
+            cost = assign_points_topm<FT>(mat, measure, prior, centers_cpy, resp, weights, temperature, centersums, rowsums);
+        }
+        if(tel) tel->add_iteration(cost);
+        if(initcost < 0) {
+            initcost = cost;
+            std::fprintf(stderr, "[%s] initial cost: %0.12g\n", __PRETTY_FUNCTION__, cost);
+        }
+        DBG_ONLY(std::fprintf(stderr, "oldcost: %.20g. newcost: %.20g. Difference: %0.20g. Max dropped mass: %g\n", oldcost, cost, oldcost - cost, resp.max_dropped());)
+        if(oldcost >= cost) // Update centers only if an improvement
+            std::copy(centers_cpy.begin(), centers_cpy.end(), centers.begin());
+        if(oldcost - cost <= eps * std::max(oldcost, cost) || ++iternum == maxiter) {
+            break;
+        }
+        util::PhaseTimer pt("soft_topm.set_centroids", 0, nbytes);
+        set_centroids_topm<FT>(mat, measure, resp, centers_cpy, weights, centersums, rowsums);
+    }
+    VERBOSE_ONLY(std::fprintf(stderr, "[%s] Max dropped responsibility mass: %g\n", __func__, resp.max_dropped());)
+    return std::make_tuple(initcost, cost, iternum);
+}
 /*
  *
  * set_centroids_soft assumes that costs of points have been assigned
@@ -357,9 +573,9 @@ double set_centroids_soft(const Mat &mat,
     MINOCORE_VALIDATE(dist::is_valid_measure(measure));
     const CentroidPol pol = msr2pol(measure);
     assert(FULL_WEIGHTED_MEAN == pol || !dist::is_bregman(measure) || JSM_MEDIAN == pol); // sanity check
-    std::fprintf(stderr, "Policy %d/%s for measure %d/%s\n", (int)pol, cp2str(pol), (int)measure, msr2str(measure));
+    VERBOSE_ONLY(std::fprintf(stderr, "Policy %d/%s for measure %d/%s\n", (int)pol, cp2str(pol), (int)measure, msr2str(measure));)
     double ret = set_centroids_full_mean(mat, measure, prior, costs, asns, centers, weights, temp, centersums, rowsums);
-    std::fprintf(stderr, "cost: %g for %d/%s\n", ret, (int)measure, msr2str(measure));
+    VERBOSE_ONLY(std::fprintf(stderr, "cost: %g for %d/%s\n", ret, (int)measure, msr2str(measure));)
     const double prior_sum =
         prior.size() == 0 ? 0.
                           : prior.size() == 1
@@ -407,10 +623,39 @@ auto perform_hard_minibatch_clustering(const Matrix &mat,
     double initcost = std::numeric_limits<double>::max(), cost = initcost, bestcost = cost;
     std::vector<CtrT>  savectrs = centers;
     using IT = uint64_t;
+    const size_t np = costs.size(), k = centers.size();
+    // For squared Euclidean distance on sparse data, centers are kept as lazily-scaled vectors
+    // and updated with per-center learning rates, so that both the update and the
+    // distance computations cost O(nnz) per row rather than O(d).
+    const bool use_lazy_centers = !blaze::IsDenseMatrix_v<Matrix> && measure == distance::SQRL2;
+    std::vector<LazyScaledCenter<FT>> lazyctrs;
+    blz::DV<double> rowsqnorms;
+    if(use_lazy_centers) {
+        lazyctrs.resize(k);
+        OMP_PFOR
+        for(size_t i = 0; i < k; ++i)
+            lazyctrs[i].set(centers[i]);
+        rowsqnorms.resize(np);
+        OMP_PFOR
+        for(size_t i = 0; i < np; ++i) {
+            double sq = 0.;
+            detail::for_each_nonzero(row(mat, i, unchecked), [&sq](size_t, auto v) {sq += double(v) * v;});
+            rowsqnorms[i] = sq;
+        }
+    }
+    auto materialize_centers = [&]() {
+        OMP_PFOR
+        for(size_t i = 0; i < k; ++i) {
+            lazyctrs[i].flush();
+            lazyctrs[i].materialize(centers[i]);
+            centersums[i] = lazyctrs[i].sum();
+        }
+    };
     auto compute_point_cost = [&](auto id, auto cid) ALWAYS_INLINE {
+        if(use_lazy_centers)
+            return lazyctrs[cid].sqrl2(row(mat, id, unchecked), rowsqnorms[id]);
         return msr_with_prior<FT>(measure, row(mat, id, unchecked), centers[cid], prior, prior_sum, rowsums[id], centersums[cid]);
     };
-    const size_t np = costs.size(), k = centers.size();
     auto perform_assign = [&]() {
 #define __perform_assign_one(i) do {\
             double mincost = std::numeric_limits<double>::max();\
@@ -443,12 +688,16 @@ auto perform_hard_minibatch_clustering(const Matrix &mat,
     shared::flat_hash_set<IT> idxs;
     if(!with_importance_sampling && !with_replacement)
         idxs.reserve(mbsize);
+    const uint64_t nbytes = detail::data_bytes(mat);
+    util::Telemetry *const tel = util::active_telemetry();
+    if(tel) tel->mark();
     for(;;) {
         PYBIND11_EXCEPTION_CHECK();
         DBG_ONLY(std::fprintf(stderr, "Beginning iter %zu\n", iternum);)
         if(iternum % calc_cost_freq == 0 || (iternum == maxiter - 1)) {
             // Every once in a while, perform exhaustive center-point-comparisons
             // and restart any centers with no assigned points
+            util::PhaseTimer pt("minibatch.full_assign", np * k, nbytes);
             perform_assign();
             center_counts = 0;
 
@@ -482,6 +731,11 @@ auto perform_hard_minibatch_clustering(const Matrix &mat,
                     }
                     //if(isnorm) clustering::set_center(ctr, row(mat, id, blz::unchecked) / rowsums[id]);
                     //else
+                    if(use_lazy_centers) {
+                        lazyctrs[fidx].set(row(mat, id, blz::unchecked));
+                        centersums[fidx] = lazyctrs[fidx].sum();
+                        continue;
+                    }
                     clustering::set_center(ctr, row(mat, id, blz::unchecked));
                     centersums[fidx] = sum(ctr);
                 }
@@ -505,6 +759,7 @@ auto perform_hard_minibatch_clustering(const Matrix &mat,
             PYBIND11_EXCEPTION_CHECK();
             std::fprintf(stderr, "Cost at iter %zu (mbsize %zd): %0.20g\n", iternum, mbsize, cost);
             if(iternum == 0) initcost = cost, bestcost = initcost;
+            if(use_lazy_centers && cost < bestcost) materialize_centers();
             if(cost < bestcost) {
                 std::fprintf(stderr, "Distance between old and new centers: %0.12g\n", blz::sum(blz::generate(centers.size(), [&](auto x) {return l2Dist(centers[x], savectrs[x]);})));
                 bestcost = cost;
@@ -512,10 +767,12 @@ auto perform_hard_minibatch_clustering(const Matrix &mat,
             }
         }
 
+        if(tel) tel->add_iteration(cost);
         if(++iternum == maxiter) {
             std::fprintf(stderr, "Maximum iterations [%zu] reached\n", iternum);
             break;
         }
+        util::PhaseTimer pt("minibatch.step", mbsize * k, nbytes / std::max(np, size_t(1)) * mbsize);
 
         // 1. Sample the points
         if(with_replacement) {
@@ -552,6 +809,15 @@ auto perform_hard_minibatch_clustering(const Matrix &mat,
             shared::sort(assigned[i].begin(), assigned[i].end());
         }
         // 3. Calculate new center
+        if(use_lazy_centers) {
+            OMP_PFOR_DYN
+            for(size_t i = 0; i < k; ++i) {
+                for(const auto id: assigned[i])
+                    lazyctrs[i].update(row(mat, id, unchecked), weights ? double((*weights)[id]): 1.);
+                centersums[i] = lazyctrs[i].sum();
+            }
+            continue;
+        }
 #define __perform_one(i) do {\
             auto asnptr = assigned[i].data();\
             const auto asnsz = assigned[i].size();\
@@ -638,11 +904,15 @@ auto hmb_coreset_clustering(const Matrix &mat,
     blz::DV<double> cscosts(mbsize), csw;
     blz::DV<uint32_t> csasn(mbsize), nnz;
     blz::DV<double> csrowsums;
+    const uint64_t nbytes = detail::data_bytes(mat);
+    util::Telemetry *const tel = util::active_telemetry();
+    if(tel) tel->mark();
     for(;;) {
         PYBIND11_EXCEPTION_CHECK();
         DBG_ONLY(std::fprintf(stderr, "Beginning iter %zu\n", iternum);)
         // Every once in a while, perform exhaustive center-point-comparisons
         // and restart any centers with no assigned points
+        util::PhaseTimer assignpt("csopt.full_assign", np * k, nbytes);
         OMP_PFOR_DYN
         for(size_t i = 0; i < np; ++i) {
             double mincost = std::numeric_limits<double>::max();
@@ -702,6 +972,8 @@ auto hmb_coreset_clustering(const Matrix &mat,
                 cost = blz::dot(costs, *weights);
             else cost = blz::dot(costs, blz::make_cv(weights->data(), np));
         } else cost = blz::sum(costs);
+        assignpt.stop();
+        if(tel) tel->add_iteration(cost);
         DBG_ONLY(std::fprintf(stderr, "[CSOPT] Cost at iter %zu (mbsize %zd): %g. [best prev: %g]\n", iternum, mbsize, cost, bestcost);)
         if(iternum == 0) initcost = cost, bestcost = initcost;
         else if(cost < bestcost) {
@@ -720,19 +992,18 @@ auto hmb_coreset_clustering(const Matrix &mat,
         using WT = const std::remove_const_t<std::decay_t<decltype((*weights)[0])>>;
         const WT *ptr = nullptr;
         if(weights) ptr = weights->data();
-        auto start = std::chrono::high_resolution_clock::now();
-        sampler.make_sampler(np, k, costs.data(), asn.data(), ptr, seed, sm, k, (uint64_t *)nullptr, false, msr2alpha(measure));
-        auto stop = std::chrono::high_resolution_clock::now();
-        std::fprintf(stderr, "[CSOPT] Took %gms to create sampler\n", std::chrono::duration<double, std::milli>(stop - start).count());
+        {
+            util::PhaseTimer pt("csopt.make_sampler", 0, np * (sizeof(costs[0]) + sizeof(asn[0])));
+            sampler.make_sampler(np, k, costs.data(), asn.data(), ptr, seed, sm, k, (uint64_t *)nullptr, false, msr2alpha(measure));
+        }
         typename decltype(sampler)::CoresetType coreset(std::min(mbsize, np));
         for(size_t j = 0; j < calc_cost_freq; ++j) {
             //std::fprintf(stderr, "CSOPT inner loop %zu:%zu\n", iternum, j);
-            start = std::chrono::high_resolution_clock::now();
-            sampler.sample(coreset, rng(), subeps, true);
-            stop = std::chrono::high_resolution_clock::now();
-            std::fprintf(stderr, "[CSOPT] Took %gms to perform sample\n", std::chrono::duration<double, std::milli>(stop - start).count());
-
-            start = std::chrono::high_resolution_clock::now();
+            {
+                util::PhaseTimer pt("csopt.sample");
+                sampler.sample(coreset, rng(), subeps, true);
+            }
+            util::PhaseTimer matpt("csopt.set_coreset_matrix", 0, nbytes / std::max(np, size_t(1)) * coreset.size());
             smat.resize(coreset.size(), mat.columns());
 #if 0
             if constexpr(blaze::IsSparseMatrix_v<LMat>) {
@@ -746,9 +1017,6 @@ auto hmb_coreset_clustering(const Matrix &mat,
             }
 #endif
             csrowsums = elements(rowsums, coreset.indices_.data(), coreset.indices_.size());
-            stop = std::chrono::high_resolution_clock::now();
-            std::fprintf(stderr, "[CSOPT] Took %gms to resize coreset matrix\n", std::chrono::duration<double, std::milli>(stop - start).count());
-            start = std::chrono::high_resolution_clock::now();
             if constexpr(blaze::IsMatrix_v<Matrix>) {
                 smat = rows(mat, coreset.indices_.data(), coreset.indices_.size());
             } else {
@@ -758,21 +1026,23 @@ auto hmb_coreset_clustering(const Matrix &mat,
                     set_center(lh, row(mat, coreset.indices_[i]));
                 }
             }
-            stop = std::chrono::high_resolution_clock::now();
-            std::fprintf(stderr, "[CSOPT] Took %gms to set coreset matrix\n", std::chrono::duration<double, std::milli>(stop - start).count());
+            matpt.stop();
             cscosts.resize(coreset.size());
             csasn.resize(coreset.size());
             //std::fprintf(stderr, "About to perform coreset clustering\n");
-            start = std::chrono::high_resolution_clock::now();
             const size_t mysubiter = subiter + static_cast<int>(iternum < 2) * 2;
-            if(weights) {
-                csw = elements(*weights, coreset.indices_.data(), coreset.indices_.size()) * coreset.weights_;
-                perform_hard_clustering(smat, measure, prior, centers, csasn, cscosts, &csw, subeps, mysubiter, &csrowsums);
-            } else {
-                perform_hard_clustering(smat, measure, prior, centers, csasn, cscosts, &coreset.weights_, subeps, mysubiter, &csrowsums);
+            {
+                // Sub-clustering records into its own scope, so that its iterations are not counted as ours
+                util::PhaseTimer pt("csopt.subcluster");
+                util::TelemetryScope sub(tel != nullptr);
+                if(weights) {
+                    csw = elements(*weights, coreset.indices_.data(), coreset.indices_.size()) * coreset.weights_;
+                    perform_hard_clustering(smat, measure, prior, centers, csasn, cscosts, &csw, subeps, mysubiter, &csrowsums);
+                } else {
+                    perform_hard_clustering(smat, measure, prior, centers, csasn, cscosts, &coreset.weights_, subeps, mysubiter, &csrowsums);
+                }
+                if(tel) tel->merge_phases(*sub.get(), "csopt.subcluster.");
             }
-            stop = std::chrono::high_resolution_clock::now();
-            std::fprintf(stderr, "[CSOPT] Took %gms to perform coreset sub-clustering\n", std::chrono::duration<double, std::milli>(stop - start).count());
             if constexpr(is_dense) {
                 for(size_t i = 0; i < centers.size(); ++i) centersums[i] = sum(centers[i]);
             } else
@@ -0,0 +1,174 @@
+#ifndef MINOCORE_CLUSTERING_SPARSEMEDIAN_H__
+#define MINOCORE_CLUSTERING_SPARSEMEDIAN_H__
+#include "minicore/util/csc.h"
+#include "minicore/clustering/asnindex.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace minicore { namespace clustering {
+
+namespace detail {
+
+/*
+ * Weighted median of the (value, weight) pairs in [beg, end) together with an implicit zero of weight zw,
+ * found by weighted quickselect in expected linear time. Reorders [beg, end).
+ * If the weight at or below some value is exactly half, returns the midpoint between it and the next value,
+ * which matches the even-count unweighted median.
+ */
+template<typename FT>
+double weighted_median_select(std::pair<FT, FT> *beg, std::pair<FT, FT> *end, double zw) {
+    double target = .5 * (zw + std::accumulate(beg, end, 0., [](double s, const auto &x) {return s + x.second;}));
+    bool haszero = zw > 0.;
+    // Smallest value in a range, counting the implicit zero if present
+    auto rmin = [](auto b, auto e, bool z) {
+        double ret = z ? 0.: std::numeric_limits<double>::max();
+        for(; b != e; ++b) ret = std::min(ret, double(b->first));
+        return ret;
+    };
+    auto rmax = [](auto b, auto e, bool z) {
+        double ret = z ? 0.: std::numeric_limits<double>::lowest();
+        for(; b != e; ++b) ret = std::max(ret, double(b->first));
+        return ret;
+    };
+    for(;;) {
+        const ptrdiff_t n = end - beg;
+        if(n == 0) return 0.; // Only the implicit zero remains
+        if(n == 1 && !haszero) return beg->first;
+        // Median-of-three pivot
+        FT a = beg->first, b = beg[n / 2].first, c = end[-1].first;
+        const FT pivot = std::max(std::min(a, b), std::min(std::max(a, b), c));
+        // Three-way partition: [beg, lt) < pivot, [lt, gt) == pivot, [gt, end) > pivot
+        auto lt = beg, gt = end;
+        for(auto p = beg; p < gt;) {
+            if(p->first < pivot) std::swap(*p++, *lt++);
+            else if(p->first > pivot) std::swap(*p, *--gt);
+            else ++p;
+        }
+        double wl = 0., we = 0.;
+        for(auto p = beg; p != lt; ++p) wl += p->second;
+        for(auto p = lt; p != gt; ++p) we += p->second;
+        const bool zl = haszero && 0 < pivot, ze = haszero && pivot == 0, zg = haszero && 0 > pivot;
+        if(zl) wl += zw;
+        if(ze) we += zw;
+        if(wl > target) {
+            end = lt; haszero = zl;
+        } else if(wl == target) {
+            return .5 * (rmax(beg, lt, zl) + pivot);
+        } else if(wl + we > target) {
+            return pivot;
+        } else if(wl + we == target) {
+            return .5 * (pivot + rmin(gt, end, zg));
+        } else {
+            target -= wl + we;
+            beg = gt; haszero = zg;
+        }
+    }
+}
+
+} // namespace detail
+
+/*
+ * sparse_l1_medians
+ * Sets each center to the weighted coordinate-wise median of the rows assigned to it,
+ * computing every cluster's median in one pass over a CSparseMatrix.
+ *
+ * Rows are taken grouped by cluster from an AssignmentIndex, and each cluster's nonzeros are bucketed by column with a counting sort.
+ * Implicit zeros are never materialized: each column's zeros become a single entry
+ * weighted by the cluster weight not covered by that column's nonzeros,
+ * and columns where that weight exceeds half the total are set to zero without any selection.
+ * The remaining columns use weighted quickselect, parallelized over all (cluster, column) pairs.
+ *
+ * If rsums is non-null, row i is scaled by 1 / (*rsums)[i] first, which yields the TVD median.
+ * Centers with no assigned rows are left unchanged.
+ */
+template<typename FT=double, typename VT, typename IT, typename IPtrT, typename AIT, typename CtrT, typename WeightT, typename RSumT=blz::DV<double>>
+void sparse_l1_medians(const util::CSparseMatrix<VT, IT, IPtrT> &mat, const AssignmentIndex<AIT> &asnidx, std::vector<CtrT> &ctrs,
+                       const WeightT *weights, const RSumT *rsums=static_cast<const RSumT *>(nullptr))
+{
+    const size_t nc = mat.columns(), k = ctrs.size();
+    if(asnidx.ncenters() != k) throw std::invalid_argument("AssignmentIndex has the wrong number of centers");
+    // Offsets of each cluster's nonzeros
+    std::vector<size_t> entoff(k + 1);
+    OMP_PFOR
+    for(size_t c = 0; c < k; ++c)
+        for(const auto r: asnidx[c])
+            entoff[c + 1] += mat.indptr_[r + 1] - mat.indptr_[r];
+    std::partial_sum(entoff.begin(), entoff.end(), entoff.begin());
+    struct Segment {
+        IT col;
+        size_t beg, end;
+        double zw;
+        FT median;
+    };
+    std::vector<std::pair<FT, FT>> vals(entoff[k]);
+    std::vector<std::vector<Segment>> segs(k);
+    std::vector<double> totw(k);
+    // Bucket each cluster's nonzeros by column
+    OMP_PRAGMA("omp parallel")
+    {
+        std::vector<size_t> colcounts(nc + 1);
+        OMP_PRAGMA("omp for schedule(dynamic)")
+        for(size_t c = 0; c < k; ++c) {
+            const AIT *rb = asnidx.begin(c), *re = asnidx.end(c);
+            if(rb == re) continue;
+            std::fill(colcounts.begin(), colcounts.end(), size_t(0));
+            double wsum = 0.;
+            for(auto rp = rb; rp != re; ++rp) {
+                auto r = row(mat, *rp, unchecked);
+                for(size_t j = 0; j < r.n_; ++j) ++colcounts[r.indices_[j] + 1];
+                wsum += weights ? double((*weights)[*rp]): 1.;
+            }
+            totw[c] = wsum;
+            std::partial_sum(colcounts.begin(), colcounts.end(), colcounts.begin());
+            auto cvals = vals.data() + entoff[c];
+            auto &cs = segs[c];
+            for(size_t j = 0; j < nc; ++j)
+                if(colcounts[j + 1] != colcounts[j])
+                    cs.push_back(Segment{IT(j), entoff[c] + colcounts[j], entoff[c] + colcounts[j + 1], wsum, FT(0)});
+            for(auto rp = rb; rp != re; ++rp) {
+                auto r = row(mat, *rp, unchecked);
+                const double w = weights ? double((*weights)[*rp]): 1.;
+                const double mul = rsums ? 1. / double((*rsums)[*rp]): 1.;
+                for(size_t j = 0; j < r.n_; ++j)
+                    cvals[colcounts[r.indices_[j]]++] = {FT(r.data_[j] * mul), FT(w)};
+            }
+            for(auto &s: cs) {
+                for(size_t j = s.beg; j < s.end; ++j) s.zw -= vals[j].second;
+                if(s.zw <= 1e-12 * wsum) s.zw = 0.; // Fully-populated column, up to rounding
+            }
+        }
+    }
+    std::vector<std::pair<uint32_t, uint32_t>> tasks;
+    for(size_t c = 0; c < k; ++c)
+        for(size_t j = 0; j < segs[c].size(); ++j)
+            if(segs[c][j].zw <= .5 * totw[c]) // Otherwise, the median is 0
+                tasks.emplace_back(c, j);
+    OMP_PFOR_DYN
+    for(size_t t = 0; t < tasks.size(); ++t) {
+        auto &s = segs[tasks[t].first][tasks[t].second];
+        s.median = detail::weighted_median_select(vals.data() + s.beg, vals.data() + s.end, s.zw);
+    }
+    OMP_PFOR
+    for(size_t c = 0; c < k; ++c) {
+        if(asnidx.empty(c)) continue;
+        auto &ctr = ctrs[c];
+        if constexpr(blaze::IsSparseVector_v<CtrT>) {
+            ctr.reset();
+            ctr.resize(nc);
+            ctr.reserve(segs[c].size());
+            for(const auto &s: segs[c]) if(s.median) ctr.append(s.col, s.median);
+        } else {
+            if(ctr.size() != nc) ctr.resize(nc);
+            ctr = 0;
+            for(const auto &s: segs[c]) ctr[s.col] = s.median;
+        }
+    }
+}
+
+} // namespace clustering
+using clustering::sparse_l1_medians;
+
+} // namespace minicore
+
+#endif /* MINOCORE_CLUSTERING_SPARSEMEDIAN_H__ */
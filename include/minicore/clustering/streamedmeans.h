@@ -0,0 +1,84 @@
+#ifndef MINOCORE_CLUSTERING_STREAMEDMEANS_H__
+#define MINOCORE_CLUSTERING_STREAMEDMEANS_H__
+#pragma once
+
+#include "minicore/clustering/centroid.h"
+#include "minicore/clustering/lazycenter.h"
+
+namespace minicore {
+
+namespace clustering {
+
+#ifndef MC_STREAMED_MEANS_MAX_BYTES
+#define MC_STREAMED_MEANS_MAX_BYTES (size_t(1) << 30)
+#endif
+
+namespace detail {
+
+// Throws unless measure's centers are means, which can be accumulated one row at a time
+inline void check_mean_measure(dist::DissimilarityMeasure measure, const char *fn) {
+    if(!dist::is_valid_measure(measure)) throw std::invalid_argument("Invalid measure");
+    const CentroidPol pol = msr2pol(measure);
+    if(pol != FULL_WEIGHTED_MEAN && pol != JSM_MEDIAN)
+        throw std::invalid_argument(std::string(fn) + " requires a mean-based centroid policy, which can be accumulated one row at a time; "
+                                    + dist::msr2str(measure) + " uses " + cp2str(pol));
+}
+
+/*
+ * StreamedMeans
+ * Per-cluster weighted sums of (normalized, for msr_is_normalized measures) rows, accumulated during a pass over the data.
+ * Each of nt_ threads sums a static partition of the rows into its own k x d buffer, and buffers are added in thread order,
+ * so results do not depend on scheduling. Buffers are capped at MAX_ACCUM_BYTES in total, as in geomedians.
+ */
+struct StreamedMeans {
+    static constexpr size_t MAX_ACCUM_BYTES = MC_STREAMED_MEANS_MAX_BYTES;
+    std::vector<blz::DM<double>> sums_;
+    blz::DM<double> weights_; // nt_ x k, for soft clustering
+    int nt_ = 1;
+    StreamedMeans(size_t k, size_t nc) {
+        OMP_ONLY(nt_ = std::max(1, std::min(omp_get_max_threads(), int(MAX_ACCUM_BYTES / std::max(size_t(1), k * nc * sizeof(double))))));
+        sums_.resize(nt_, blz::DM<double>(k, nc, 0.));
+        weights_.resize(nt_, k);
+        weights_ = 0.;
+    }
+    void reset() {
+        for(auto &s: sums_) s = 0.;
+        weights_ = 0.;
+    }
+    // Resets clusters [first, last) only
+    void reset(size_t first, size_t last) {
+        for(auto &s: sums_) submatrix(s, first, 0, last - first, s.columns()) = 0.;
+        submatrix(weights_, 0, first, weights_.rows(), last - first) = 0.;
+    }
+    // Calls func(tid, i) for each row i in [0, n), with a static partition over nt_ threads
+    template<typename Func>
+    void partition(size_t n, const Func &func) {
+        OMP_PRAGMA("omp parallel num_threads(nt_)")
+        {
+            int tid = 0;
+            OMP_ONLY(tid = omp_get_thread_num();)
+            OMP_PRAGMA("omp for schedule(static)")
+            for(size_t i = 0; i < n; ++i)
+                func(tid, i);
+        }
+    }
+    template<typename RowT>
+    void add(int tid, size_t cid, const RowT &r, double scale) {
+        auto ar = row(sums_[tid], cid, unchecked);
+        for_each_nonzero(r, [&](size_t idx, auto v) {ar[idx] += scale * v;});
+    }
+    blz::DV<double, blz::rowVector> total(size_t cid) const {
+        blz::DV<double, blz::rowVector> ret = row(sums_[0], cid);
+        for(int t = 1; t < nt_; ++t) ret += row(sums_[t], cid);
+        return ret;
+    }
+    double total_weight(size_t cid) const {return sum(column(weights_, cid));}
+};
+
+} // namespace detail
+#undef MC_STREAMED_MEANS_MAX_BYTES
+
+} // namespace clustering
+
+} // namespace minicore
+#endif /* #ifndef MINOCORE_CLUSTERING_STREAMEDMEANS_H__ */
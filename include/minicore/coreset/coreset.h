@@ -7,9 +7,11 @@ extern "C" {
 #include <vector>
 #include <map>
 #include <queue>
-#include "alias_sampler/alias_sampler.h"
+#include <atomic>
 #include "minicore/util/shared.h"
 #include "minicore/util/blaze_adaptor.h"
+#include "minicore/util/wsample.h"
+#include "minicore/util/palias.h"
 #include <zlib.h>
 //#include "libsimdsampling/simdsampling.h"
 #ifdef _OPENMP
@@ -227,7 +229,7 @@ auto map2index(const MapCoreset<IT, FT, MapType, Extra...> &map) {
 
 template<typename FT=float, typename IT=std::uint32_t>
 struct CoresetSampler {
-    using Sampler = alias::AliasSampler<FT, wy::WyRand<IT, 2>, IT>;
+    using Sampler = util::ParallelAliasSampler<FT, IT>;
     using CoresetType = IndexCoreset<IT, FT>;
     std::unique_ptr<Sampler>     sampler_;
     std::unique_ptr<FT []>         probs_;
@@ -347,37 +349,101 @@ struct CoresetSampler {
         // From Training Gaussian Mixture Models at Scale via Coresets
         // http://www.jmlr.org/papers/volume18/15-506/15-506.pdf
         // Note: this can be expanded to general probability measures.
-        std::vector<FT> weight_sums(ncenters), weighted_cost_sums(ncenters);
-        std::vector<FT> sqcosts(ncenters);
-        std::vector<IT> center_counts(ncenters);
-        double total_cost = 0.;
-
-        OMP_PRAGMA("omp parallel for reduction(+:total_cost)")
-        for(size_t i = 0; i < np_; ++i) {
-            // So maybe like a ~30% speedup?
-            auto asn = assignments[i];
-            assert(asn < ncenters);
-            const auto w = getweight(i);
-            auto cost = costs[i] * costs[i]; // d^2(x, A)
-            auto wcost = w * cost;
-            OMP_ATOMIC
-            weighted_cost_sums[asn] += wcost;
-            OMP_ATOMIC
-            weight_sums[asn] += w; // If unweighted, weights are 1.
-            OMP_ATOMIC
-            ++center_counts[asn];
-            total_cost += wcost;
-            sqcosts[i] = cost;
+        make_probs_fused(LFKF, ncenters, costs, assignments, alpha_est);
+    }
+    /*
+     * make_probs_fused
+     * Sensitivities for VX, BFL, LBK, and LFKF in two passes over the points.
+     *
+     * Every one of these has the form s_i = A * x_i + B_a * w_i + K_a for point i in cluster a,
+     * where x_i is the weighted cost (the unweighted cost for LBK, squared for LFKF)
+     * and B_a, K_a depend only on the cluster's count, weight sum, and weighted cost sum.
+     * The first pass builds those per-cluster sums in per-chunk histograms, which also gives the total sensitivity in closed form,
+     * so the second pass writes normalized probabilities directly.
+     * If every sensitivity is 0 (LFKF with all points on their centers), probabilities are uniform.
+     */
+    template<typename CFT, typename AT>
+    void make_probs_fused(SensitivityMethod sens, size_t ncenters,
+                          const CFT *costs, const AT *assignments,
+                          double alpha_est=0.)
+    {
+        if(sens == FL) throw std::invalid_argument("FL sensitivities require bicriteria centers; use make_probs_fl");
+        if(sens != VX && sens != BFL && sens != LBK && sens != LFKF) throw std::runtime_error("Invalid SensitivityMethod");
+        const bool sqcost = sens == LFKF, unweighted_cost = sens == LBK;
+        int nt = 1;
+        OMP_ONLY(nt = std::max(1, std::min(omp_get_max_threads(), int(np_ / 16384)));)
+        const size_t blocksz = (np_ + nt - 1) / nt;
+        // Per chunk, per cluster: count, weight sum, weighted cost sum
+        // Chunks are distributed with omp for, so every chunk is counted even if the team is smaller than nt (e.g., when nested)
+        std::vector<double> hist(size_t(nt) * ncenters * 3);
+        std::vector<double> usums(nt);
+        std::atomic<int> badasn{0};
+        OMP_PRAGMA("omp parallel for num_threads(nt) schedule(static, 1)")
+        for(int t = 0; t < nt; ++t) {
+            double *const h = &hist[size_t(t) * ncenters * 3];
+            const size_t start = std::min(np_, t * blocksz), stop = std::min(np_, start + blocksz);
+            double u = 0.;
+            for(size_t i = start; i < stop; ++i) {
+                const size_t asn = assignments[i];
+                if(unlikely(asn >= ncenters)) {
+                    badasn.store(1, std::memory_order_relaxed);
+                    continue;
+                }
+                const double w = getweight(i), c = sqcost ? double(costs[i]) * costs[i]: double(costs[i]);
+                h[asn * 3] += 1.;
+                h[asn * 3 + 1] += w;
+                h[asn * 3 + 2] += w * c;
+                u += c;
+            }
+            usums[t] = u;
         }
+        if(badasn.load()) throw std::invalid_argument("Assignment out of range for the number of centers");
+        for(int t = 1; t < nt; ++t) {
+            const double *h = &hist[size_t(t) * ncenters * 3];
+            OMP_PFOR
+            for(size_t j = 0; j < ncenters * 3; ++j) hist[j] += h[j];
+        }
+        double total_cost = 0., weight_sum = 0.;
+        for(size_t a = 0; a < ncenters; ++a)
+            weight_sum += hist[a * 3 + 1], total_cost += hist[a * 3 + 2];
+        const double unweighted_total = std::accumulate(usums.begin(), usums.end(), 0.);
+        const bool hascost = total_cost > 0.;
+        std::vector<double> bcoef(ncenters), kcoef(ncenters);
+        double acoef = 0.;
+        const double lbk_alpha = 16 * std::log(k_) + 32., lbk_tc = total_cost / weight_sum;
+        switch(sens) {
+            case VX:   acoef = hascost ? 1. / total_cost: 0.; break;
+            case BFL:  acoef = hascost ? .5 / total_cost: 0.; break;
+            case LBK:  acoef = hascost ? lbk_alpha / lbk_tc: 0.; break;
+            case LFKF: acoef = alpha_est; break;
+            default: __builtin_unreachable();
+        }
+        VERBOSE_ONLY(std::fprintf(stderr, "%s: total cost %g, weight sum %g\n", sm2str(sens), total_cost, weight_sum);)
+        double total_sens = acoef * (unweighted_cost ? unweighted_total: total_cost);
+        for(size_t a = 0; a < ncenters; ++a) {
+            const double n = hist[a * 3], ws = hist[a * 3 + 1], wcs = hist[a * 3 + 2];
+            if(!n) continue;
+            switch(sens) {
+                case VX:   kcoef[a] = 1. / n; break;
+                case BFL:  bcoef[a] = .5 / (ws * n); break;
+                case LBK:  kcoef[a] = (hascost ? 2. * lbk_alpha * wcs / (ws * lbk_tc): 0.) + 4. * weight_sum / ws; break;
+                case LFKF: bcoef[a] = alpha_est * wcs / ws; kcoef[a] = 2. * total_cost / ws; break;
+                default: __builtin_unreachable();
+            }
+            total_sens += bcoef[a] * ws + kcoef[a] * n;
+        }
+        probs_.reset(new FT[np_]);
+        if(!(total_sens > 0.)) {
+            std::fill(probs_.get(), probs_.get() + np_, FT(1. / np_));
+            return;
+        }
+        const double sinv = 1. / total_sens;
         OMP_PFOR
         for(size_t i = 0; i < np_; ++i) {
-            this->probs_[i] = alpha_est * getweight(i) * (sqcosts[i] + weighted_cost_sums[assignments[i]] / weight_sums[assignments[i]])
-                        + 2. * total_cost / weight_sums[assignments[i]];
+            const auto asn = assignments[i];
+            const double w = getweight(i), c = sqcost ? double(costs[i]) * costs[i]: double(costs[i]);
+            probs_[i] = (acoef * (unweighted_cost ? c: w * c) + bcoef[asn] * w + kcoef[asn]) * sinv;
         }
-        auto si = 1. / std::accumulate(&this->probs_[0], this->probs_.get() + np_, 0.);
-        OMP_PFOR
-        for(size_t i = 0; i < np_; ++i)
-            this->probs_[i] *= si;
     }
     void make_alias_sampler(uint64_t seed) {
         auto p = probs_.get(), e = p + np_;
@@ -424,34 +490,8 @@ struct CoresetSampler {
     void make_probs_vx(size_t ncenters,
                          const CFT *costs, const IT *assignments)
     {
-        const auto cv = blz::make_cv(const_cast<CFT *>(costs), np_);
-        double total_cost =
-            weights_ ? blaze::dot(*weights_, cv)
-                     : blaze::sum(cv);
-        probs_.reset(new FT[np_]);
-        auto sensitivities = blz::make_cv(probs_.get(), np_);
-        std::vector<IT> center_counts(ncenters);
-        OMP_PFOR
-        for(size_t i = 0; i < np_; ++i) {
-            OMP_ATOMIC
-            ++center_counts[assignments[i]];
-        }
-        if(weights_) {
-            sensitivities = (*weights_) * cv / total_cost;
-        } else {
-            sensitivities = cv / total_cost;
-        }
-        //std::cerr << "Sensitivities: " << trans(sensitivities) << '\n';
-        // sensitivities = weights * costs / total_cost
-        blaze::DynamicVector<FT> ccinv(ncenters);
-        std::transform(center_counts.begin(), center_counts.end(), ccinv.begin(), [](auto x) -> FT {return FT(1) / x;});
-        OMP_PFOR
-        for(size_t i = 0; i < np_; ++i) {
-            sensitivities[i] += ccinv[assignments[i]];
-        }
-        const double total_sensitivity = blaze::sum(sensitivities);
-        // probabilities = sensitivity / sum(sensitivities) [use the same location in memory because we no longer need sensitivities]
-        sensitivities *= 1. / total_sensitivity;
+        // sensitivities = weights * costs / total_cost + 1 / |cluster|
+        make_probs_fused(VX, ncenters, costs, assignments);
     }
     template<typename CFT, typename IT2=IT, typename OIT=IT>
     void make_probs_fl(size_t,
@@ -488,48 +528,7 @@ struct CoresetSampler {
     void make_probs_lbk(size_t ncenters,
                           const CFT *costs, const IT *assignments)
     {
-        const double alpha = 16 * std::log(k_) + 32., alpha2 = 2. * alpha;
-
-        VERBOSE_ONLY(std::fprintf(stderr, "alpha: %g\n", alpha);)
-        //auto center_counts = std::make_unique<IT[]>(ncenters);
-        blaze::DynamicVector<FT> weight_sums(ncenters, FT(0));
-        blaze::DynamicVector<FT> cost_sums(ncenters, FT(0));
-
-        double total_costs(0.);
-        OMP_PRAGMA("omp parallel for reduction(+:total_costs)")
-        for(size_t i = 0; i < np_; ++i) {
-            const auto asn = assignments[i];
-            assert(asn < ncenters);
-            const auto w = getweight(i);
-
-            VERBOSE_ONLY(std::fprintf(stderr, "weight %zu: %g with asn %u\n", i, w, asn);)
-            OMP_ATOMIC
-            weight_sums[asn] += w; // If unweighted, weights are 1.
-            //OMP_ATOMIC
-            //++center_counts[asn];
-
-            const double pointcost = w * costs[i];
-            OMP_ATOMIC
-            cost_sums[asn] += pointcost;
-            total_costs += w * costs[i];
-        }
-        double weight_sum = blaze::sum(weight_sums);
-        VERBOSE_ONLY(std::fprintf(stderr, "wsum: %g\n", weight_sum);)
-        total_costs /= weight_sum;
-        const double tcinv = alpha / total_costs;
-        VERBOSE_ONLY(std::fprintf(stderr, "tcinv: %g\n", tcinv);)
-        blaze::DynamicVector<FT> sens(np_);
-        for(size_t i = 0; i < ncenters; ++i) {
-            cost_sums[i] = alpha2 * cost_sums[i] / (weight_sums[i] * total_costs) + 4 * weight_sum / weight_sums[i];
-            VERBOSE_ONLY(std::fprintf(stderr, "Adjusted cost: %g\n", cost_sums[i]);)
-        }
-        OMP_PFOR
-        for(size_t i = 0; i < np_; ++i) {
-            sens[i] = tcinv * costs[i] + cost_sums[assignments[i]];
-        }
-        VERBOSE_ONLY(std::fprintf(stderr, "sensitivity sum: %g\n", sum(sens));)
-        probs_.reset(new FT[np_]);
-        std::transform(sens.data(),  sens.data() + np_, probs_.get(), [tsi=1./sum(sens)](auto x) {return x * tsi;});
+        make_probs_fused(LBK, ncenters, costs, assignments);
     }
     template<typename CFT>
     void make_probs_bfl(size_t ncenters,
@@ -538,43 +537,7 @@ struct CoresetSampler {
         // This is for a bicriteria approximation
         // Use make_probs_vx for a constant approximation for arbitrary metric spaces,
         // and make_probs_lbk for bicriteria approximations for \mu-similar divergences.
-        const auto cv = blz::make_cv(const_cast<CFT *>(costs), np_);
-        double total_cost =
-            weights_ ? blaze::dot(*weights_, cv)
-                    : blaze::sum(cv);
-        //std::fprintf(stderr, "total cost: %g (sum of costs w/o weights: %g)\n", total_cost, std::accumulate(costs, costs + np_, 0.));
-        probs_.reset(new FT[np_]);
-        double total_probs = 0.;
-        std::vector<IT> center_counts(ncenters);
-        std::vector<FT> weight_sums(ncenters);
-        OMP_PFOR
-        for(size_t i = 0; i < np_; ++i) {
-            const auto asn = assignments[i];
-            assert(asn < ncenters);
-            const auto w = getweight(i);
-            OMP_ATOMIC
-            weight_sums[asn] += w; // If unweighted, weights are 1.
-            //std::fprintf(stderr, "weight: %g. wsum: %g\n", w, weight_sums[asn]);
-            OMP_ATOMIC
-            ++center_counts[asn];
-        }
-#if 0
-        for(size_t i = 0; i < ncenters; ++i) {
-            std::fprintf(stderr, "center %zu has total %zu and weight sum %g\n", i, size_t(center_counts[i]), weight_sums[i]);
-        }
-#endif
-        OMP_PRAGMA("omp parallel for reduction(+:total_probs)")
-        for(size_t i = 0; i < np_; ++i) {
-            const auto w = getweight(i);
-            double fraccost = w * costs[i] / total_cost;
-            const auto asn = assignments[i];
-            double fracw = w / (weight_sums[asn] * center_counts[asn]);
-            probs_[i] = .5 * (fraccost + fracw);
-            total_probs += probs_[i];
-            //std::fprintf(stderr, "fraccost: %g. fracw: %g. Total weight: %g\n", fraccost, fracw, probs_[i]);
-        }
-        // Because this doesn't necessarily sum to 1.
-        blaze::CustomVector<FT, blaze::unaligned, blaze::unpadded>(probs_.get(), np_) /= total_probs;
+        make_probs_fused(BFL, ncenters, costs, assignments);
     }
     auto getweight(size_t ind) const {
         return weights_ ? weights_->operator[](ind): static_cast<FT>(1.);
@@ -649,36 +612,47 @@ struct CoresetSampler {
                     ret.weights_[i] = getweight(ind) / (static_cast<double>(n) * probs_[ind]);
                 }
             }
-            if(unique) {
-                if(ctr.size() < sampled_directly) {
-                    auto flpts = (fl_bicriteria_points_ ? fl_bicriteria_points_->size(): size_t(0));
-                    ret.resize(ctr.size() + flpts);
-                    std::fprintf(stderr, "After compressing %zu samples into unique items, we have only %zu entries, of which %zu are FL sample\n", n, ret.size(), flpts);
-                }
-                const size_t csz = ctr.size();
-                // Copy from map, sort, and set
-                using PairT = typename shared::flat_hash_map<IT, uint32_t>::value_type;
-                auto space = std::make_unique<PairT[]>(csz);
-                std::copy(ctr.begin(), ctr.end(), space.get());
-                shared::sort(space.get(), space.get() + csz,
-                    [](const PairT &x, const PairT &y)
-                    {return std::tie(x.first, x.second) < std::tie(y.first, y.second);}
-                );
-                for(size_t i = 0; i < csz; ++i) {
-                    const auto idx = space[i].first;
-                    ret.indices_[i] = idx;
-                    ret.weights_[i] = space[i].second * (getweight(idx) / (n * probs_[idx]));
-                }
-            }
         } else {
             if(!probs_.get()) throw std::runtime_error("probs not generated, cannot sample");
             if(ret.indices_.size() != n) throw std::runtime_error(std::string("Wrong size ret indices ") + std::to_string(n) + " ," + std::to_string(ret.indices_.size()));
             if(!seed) seed = std::rand();
-            auto indices = reservoir_simd::sample_k(probs_.get(), np_, n, seed, unique ? SampleFmt::WITH_REPLACEMENT: SampleFmt::NEITHER);
-            DBG_ONLY(for(const auto v: indices) if(v > np_) throw std::runtime_error(std::string("index out of bounds") + std::to_string(v));)
-            std::copy(indices.begin(), indices.end(), ret.indices_.data());
-            std::sort(ret.indices_.begin(), ret.indices_.end());
-            std::transform(ret.indices_.begin(), ret.indices_.end(), ret.weights_.begin(), [&](auto idx) {return getweight(idx) / (static_cast<double>(n) * probs_[idx]);});
+            if(unique) {
+                // Batches of independent draws until sampled_directly distinct indices are found, counting repeats as the alias path does
+                if(size_t(std::count_if(probs_.get(), probs_.get() + np_, [](auto x) {return x > 0.;})) < sampled_directly)
+                    throw std::invalid_argument("Fewer points with positive probability than unique samples requested");
+                std::vector<IT> batch;
+                for(uint64_t round = 0; ctr.size() < sampled_directly; ++round) {
+                    batch.resize(sampled_directly - ctr.size());
+                    util::parallel_weighted_sample_k(probs_.get(), np_, batch.size(), batch.data(), seed + round);
+                    for(const auto ind: batch) ++ctr[ind];
+                }
+            } else {
+                // Independent draws, as the 1 / (n p_i) weights assume; indices come back sorted
+                util::parallel_weighted_sample_k(probs_.get(), np_, n, ret.indices_.data(), seed);
+                DBG_ONLY(for(const auto v: ret.indices_) if(v >= np_) throw std::runtime_error(std::string("index out of bounds") + std::to_string(v));)
+                std::transform(ret.indices_.begin(), ret.indices_.end(), ret.weights_.begin(), [&](auto idx) {return getweight(idx) / (static_cast<double>(n) * probs_[idx]);});
+            }
+        }
+        if(unique) {
+            if(ctr.size() < sampled_directly) {
+                auto flpts = (fl_bicriteria_points_ ? fl_bicriteria_points_->size(): size_t(0));
+                ret.resize(ctr.size() + flpts);
+                std::fprintf(stderr, "After compressing %zu samples into unique items, we have only %zu entries, of which %zu are FL sample\n", n, ret.size(), flpts);
+            }
+            const size_t csz = ctr.size();
+            // Copy from map, sort, and set
+            using PairT = typename shared::flat_hash_map<IT, uint32_t>::value_type;
+            auto space = std::make_unique<PairT[]>(csz);
+            std::copy(ctr.begin(), ctr.end(), space.get());
+            shared::sort(space.get(), space.get() + csz,
+                [](const PairT &x, const PairT &y)
+                {return std::tie(x.first, x.second) < std::tie(y.first, y.second);}
+            );
+            for(size_t i = 0; i < csz; ++i) {
+                const auto idx = space[i].first;
+                ret.indices_[i] = idx;
+                ret.weights_[i] = space[i].second * (getweight(idx) / (n * probs_[idx]));
+            }
         }
         if(sens_ == FL && fl_bicriteria_points_) {
             assert(fl_bicriteria_points_->size() == b_);
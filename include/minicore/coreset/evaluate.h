@@ -0,0 +1,133 @@
+#ifndef MINOCORE_CORESET_EVALUATE_H__
+#define MINOCORE_CORESET_EVALUATE_H__
+#include "minicore/coreset/matrix_coreset.h"
+#include "minicore/dist/applicator.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace minicore { namespace coresets {
+
+/*
+ * CoresetQuality
+ * Costs of Q center sets on the full data and on a coreset,
+ * with the maximum and mean of |coreset cost / full cost - 1| over those center sets.
+ */
+struct CoresetQuality {
+    std::vector<double> full_costs_, coreset_costs_;
+    double max_distortion_ = 0., mean_distortion_ = 0.;
+    size_t size() const {return full_costs_.size();}
+    void show(std::FILE *fp=stderr) const {
+        std::fprintf(fp, "%zu center sets: max distortion %0.6g, mean distortion %0.6g\n", size(), max_distortion_, mean_distortion_);
+    }
+};
+
+/*
+ * center_set_costs
+ * Weighted clustering cost of every center set in centersets (sum over points of w_i * min_c d(c, x_i), under app's measure),
+ * for all Q center sets in one pass over the data.
+ * If rows is non-null, only rows[0..nrows) of app's data are used, and weights[j] is the weight of rows[j]; this is how IndexCoresets are evaluated.
+ *
+ * Rows are processed in blocks, and each block is compared with every center set before moving on,
+ * so the data is streamed once, instead of once per center set.
+ */
+template<typename MatrixType, typename CtrT, typename WT=double, typename IT=uint32_t>
+std::vector<double> center_set_costs(const jsd::DissimilarityApplicator<MatrixType> &app,
+                                     const std::vector<std::vector<CtrT>> &centersets,
+                                     const WT *weights=static_cast<const WT *>(nullptr),
+                                     const IT *rows=static_cast<const IT *>(nullptr), size_t nrows=0)
+{
+    static constexpr size_t ROW_BLOCK = 256;
+    const size_t nq = centersets.size(), nr = rows ? nrows: app.size();
+    for(const auto &cs: centersets)
+        if(cs.empty()) throw std::invalid_argument("Center sets must be non-empty");
+    std::vector<double> ret(nq);
+    const size_t nblocks = (nr + ROW_BLOCK - 1) / ROW_BLOCK;
+    OMP_PRAGMA("omp parallel")
+    {
+        std::vector<double> local(nq);
+        OMP_PRAGMA("omp for schedule(dynamic)")
+        for(size_t b = 0; b < nblocks; ++b) {
+            const size_t start = b * ROW_BLOCK, stop = std::min(nr, start + ROW_BLOCK);
+            for(size_t q = 0; q < nq; ++q) {
+                const auto &ctrs = centersets[q];
+                double s = 0.;
+                for(size_t j = start; j < stop; ++j) {
+                    const size_t r = rows ? size_t(rows[j]): j;
+                    double mincost = app(ctrs[0], r);
+                    for(size_t c = 1; c < ctrs.size(); ++c)
+                        mincost = std::min(mincost, double(app(ctrs[c], r)));
+                    s += weights ? double(weights[j]) * mincost: mincost;
+                }
+                local[q] += s;
+            }
+        }
+        OMP_CRITICAL
+        {
+            for(size_t q = 0; q < nq; ++q) ret[q] += local[q];
+        }
+    }
+    return ret;
+}
+
+namespace detail {
+
+inline CoresetQuality summarize_quality(std::vector<double> &&full, std::vector<double> &&cs) {
+    CoresetQuality ret;
+    ret.full_costs_ = std::move(full);
+    ret.coreset_costs_ = std::move(cs);
+    const size_t nq = ret.full_costs_.size();
+    for(size_t q = 0; q < nq; ++q) {
+        const double fc = ret.full_costs_[q], cc = ret.coreset_costs_[q];
+        // A zero-cost center set is only matched exactly by a zero-cost coreset
+        const double d = fc > 0. ? std::abs(cc / fc - 1.): cc == 0. ? 0.: std::numeric_limits<double>::infinity();
+        ret.max_distortion_ = std::max(ret.max_distortion_, d);
+        ret.mean_distortion_ += d;
+    }
+    if(nq) ret.mean_distortion_ /= nq;
+    return ret;
+}
+
+} // namespace detail
+
+/*
+ * evaluate_coreset
+ * Compares the cost of each center set on the full data (weighted by weights, if non-null) with its cost on the coreset.
+ * The full-data costs for all center sets are computed in a single blocked pass (center_set_costs).
+ */
+template<typename MatrixType, typename IT, typename FT, typename CtrT, typename WT=FT>
+CoresetQuality evaluate_coreset(const jsd::DissimilarityApplicator<MatrixType> &app, const IndexCoreset<IT, FT> &cs,
+                                const std::vector<std::vector<CtrT>> &centersets, const WT *weights=static_cast<const WT *>(nullptr))
+{
+    for(const auto idx: cs.indices_)
+        if(idx >= app.size()) throw std::invalid_argument("Coreset index out of range for the applicator's data");
+    auto full = center_set_costs(app, centersets, weights);
+    auto csc = center_set_costs(app, centersets, cs.weights_.data(), cs.indices_.data(), cs.size());
+    return detail::summarize_quality(std::move(full), std::move(csc));
+}
+
+/*
+ * MatrixCoresets hold their own rows, so they are evaluated through an applicator over cs.mat_,
+ * which must have been built with the same measure and prior as app.
+ */
+template<typename MatrixType, typename CMatrixType, typename CSMatrixType, typename FT, typename CtrT, typename WT=FT>
+CoresetQuality evaluate_coreset(const jsd::DissimilarityApplicator<MatrixType> &app, const jsd::DissimilarityApplicator<CMatrixType> &csapp,
+                                const MatrixCoreset<CSMatrixType, FT> &cs,
+                                const std::vector<std::vector<CtrT>> &centersets, const WT *weights=static_cast<const WT *>(nullptr))
+{
+    if(!cs.rowwise_) throw std::invalid_argument("Only rowwise MatrixCoresets can be evaluated");
+    if(csapp.measure_ != app.measure_) throw std::invalid_argument("Coreset applicator must use the same measure as the full-data applicator");
+    if(csapp.size() != cs.weights_.size()) throw std::invalid_argument("Coreset applicator must have one row per coreset weight");
+    auto full = center_set_costs(app, centersets, weights);
+    auto csc = center_set_costs(csapp, centersets, cs.weights_.data());
+    return detail::summarize_quality(std::move(full), std::move(csc));
+}
+
+} // namespace coresets
+using coresets::CoresetQuality;
+using coresets::center_set_costs;
+using coresets::evaluate_coreset;
+
+} // namespace minicore
+
+#endif /* MINOCORE_CORESET_EVALUATE_H__ */
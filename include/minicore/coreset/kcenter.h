@@ -46,7 +46,76 @@ struct bicriteria_result_t: public std::tuple<IVec<IT>, IVec<IT>, std::vector<st
 */
 
 
-template<typename Oracle, typename FT=std::decay_t<decltype(Oracle()(0,0))>,
+namespace detail {
+
+/*
+ * Assigns each point to its nearest center among newctrs[0..nnew) if that is closer than distances[i],
+ * updating distances and labels in place. Points at distance 0 are skipped.
+ * Rows are processed in blocks, and each block is compared with every new center in turn,
+ * so that a block's rows stay in cache while the batch of centers is applied.
+ */
+template<typename Oracle, typename FT, typename IT>
+void update_nearest_centers(const Oracle &oracle, size_t np, const IT *newctrs, size_t nnew, FT *distances, IT *labels) {
+    static constexpr size_t ROW_BLOCK = 256;
+    const size_t nblocks = (np + ROW_BLOCK - 1) / ROW_BLOCK;
+    OMP_PFOR_DYN
+    for(size_t b = 0; b < nblocks; ++b) {
+        const size_t start = b * ROW_BLOCK, stop = std::min(np, start + ROW_BLOCK);
+        for(size_t j = 0; j < nnew; ++j) {
+            const IT c = newctrs[j];
+            for(size_t i = start; i < stop; ++i) {
+                if(distances[i] == 0.) continue;
+                const FT newdist = oracle(i, c);
+                if(newdist < distances[i])
+                    distances[i] = newdist, labels[i] = c;
+            }
+        }
+    }
+}
+
+/*
+ * Returns the (distance, index) pairs of the z points farthest from their centers, in no particular order.
+ * Points at distance 0 (centers and their duplicates) are never included.
+ * Each thread keeps a buffer of candidates from its own range, which is cut back to its z largest with nth_element
+ * whenever it reaches 2z entries; the thread buffers are then concatenated and cut to z the same way.
+ */
+template<typename FT, typename IT>
+std::vector<std::pair<FT, IT>> farthest_points(const FT *distances, size_t np, size_t z) {
+    using PT = std::pair<FT, IT>;
+    std::vector<PT> ret;
+    if(!z) return ret;
+    auto cut = [z](std::vector<PT> &v) {
+        std::nth_element(v.begin(), v.begin() + (z - 1), v.end(), std::greater<>());
+        v.resize(z);
+    };
+    int nt = 1;
+    OMP_ONLY(nt = std::max(1, std::min(omp_get_max_threads(), int(np / 16384)));)
+    std::vector<std::vector<PT>> buffers(nt);
+    const size_t chunksz = (np + nt - 1) / nt;
+    OMP_PRAGMA("omp parallel for num_threads(nt)")
+    for(int tid = 0; tid < nt; ++tid) {
+        auto &buf = buffers[tid];
+        buf.reserve(std::min(2 * z, chunksz));
+        for(size_t i = tid * chunksz, e = std::min(np, i + chunksz); i < e; ++i) {
+            if(distances[i] == 0.) continue;
+            buf.emplace_back(distances[i], i);
+            if(buf.size() == 2 * z) cut(buf);
+        }
+        if(buf.size() > z) cut(buf);
+    }
+    for(auto &buf: buffers) ret.insert(ret.end(), buf.begin(), buf.end());
+    if(ret.size() > z) cut(ret);
+    return ret;
+}
+
+} // namespace detail
+
+/*
+ * The distances from every point to the sampled centers are updated in blocked, parallel passes (detail::update_nearest_centers),
+ * and the farthest points are found from per-thread buffers merged by nth_element (detail::farthest_points).
+ * Each round samples from the farthest points left by the previous round, so rounds are applied in sequence.
+ */
+template<typename Oracle, typename FT=std::decay_t<decltype(std::declval<const Oracle &>()(0,0))>,
          typename IT=std::uint32_t, typename RNG, typename Norm=sqrL2Norm>
 bicriteria_result_t<IT, FT>
 kcenter_bicriteria(const Oracle &oracle, size_t np, RNG &rng, size_t, double eps,
@@ -60,8 +129,9 @@ kcenter_bicriteria(const Oracle &oracle, size_t np, RNG &rng, size_t, double eps
     IVec<IT> ret;
     IVec<IT> labels(np);
     ret.reserve(samplechunksize);
-    std::vector<FT> distances(np);
+    std::vector<FT> distances(np, std::numeric_limits<FT>::max());
     // randomly select 'log(1/eta) / (1 - eps)' vertices from X and add them to E.
+    samplechunksize = std::min(samplechunksize, np);
     while(ret.size() < samplechunksize) {
         // Assuming that this is relatively small and we can take bad asymptotic complexity
         auto newv = rng() % np;
@@ -76,85 +146,44 @@ kcenter_bicriteria(const Oracle &oracle, size_t np, RNG &rng, size_t, double eps
         std::fprintf(stderr, "samplecc is %zu (> fcs %zu). changing gcs to scc + z (%zu)\n", samplechunksize, farthestchunksize, samplechunksize + z);
         farthestchunksize = samplechunksize + z;
     }
-    fpq<IT, FT> pq(farthestchunksize);
-    const auto fv = ret[0];
-    labels[fv] = fv;
-    distances[fv] = 0.;
-    // Fill the priority queue from the first set
-#ifdef _OPENMP
-    #pragma omp declare reduction (merge : fpq<IT, FT> : omp_out.update(omp_in)) initializer(omp_priv(omp_orig))
-    #pragma omp parallel for reduction(merge: pq)
-#endif
-    for(IT i = 0; i < np; ++i) {
-        double dist = oracle(fv, i);
-        double newdist;
-        IT label = 0; // This label is an index into the ret vector, rather than the actual index
-        for(size_t j = 1, e = ret.size(); j < e; ++j) {
-            if((newdist = oracle(i, ret[j])) < dist) {
-                label = j;
-                dist = newdist;
-            }
-        }
-        distances[i] = dist;
-        labels[i] = ret[label];
-        pq.add(dist, i);
-    }
+    detail::update_nearest_centers(oracle, np, &ret[0], ret.size(), distances.data(), &labels[0]);
+    for(const auto c: ret) distances[c] = 0., labels[c] = c;
+    auto farthest = detail::farthest_points<FT, IT>(distances.data(), np, farthestchunksize);
     IVec<IT> random_samples(samplechunksize);
-    // modulo without a div/mod instruction, much faster
-    schism::Schismatic<IT> div(farthestchunksize); // pq size
-    assert(samplechunksize >= 1.);
-    for(size_t j = 0;j < t;++j) {
-        //std::fprintf(stderr, "j: %zu/%zu\n", j, t);
-        // Sample 'samplechunksize' points from pq into random_samples.
-        // Sample them
+    IT *const rsp = &random_samples[0];
+    for(size_t j = 0; j < t && !farthest.empty(); ++j) {
+        // Sample 'samplechunksize' points from the farthest points, without replacement.
+        // Points in farthest have nonzero distances, so none of them is already a center.
+        const size_t nsamp = std::min(samplechunksize, farthest.size());
+        // modulo without a div/mod instruction, much faster
+        schism::Schismatic<IT> div(farthest.size());
         size_t rsi = 0;
-        IT *rsp = random_samples.data();
         do {
             IT index = div.mod(rng());
-            // (Without replacement)
-            if(std::find(rsp, rsp + rsi, index))
+            if(std::find(rsp, rsp + rsi, index) == rsp + rsi)
                 rsp[rsi++] = index;
-        } while(rsi < samplechunksize);
-        // random_samples now contains indexes *into pq*
-        std::transform(rsp, rsp + rsi, rsp,
-                       [&](auto x) ALWAYS_INLINE {return pq[x].second;});
+        } while(rsi < nsamp);
+        // random_samples now contains indexes *into farthest*
+        std::transform(rsp, rsp + rsi, rsp, [&](auto x) ALWAYS_INLINE {return farthest[x].second;});
         // random_samples now contains indexes *into original dataset*
-
-        // Insert into solution
-        for(auto it = rsp, e = rsp + rsi; it < e;++it) {
-            if(std::find(ret.begin(), ret.end(), *it) != ret.end()) continue;
+        for(auto it = rsp, e = rsp + rsi; it < e; ++it) {
+            assert(std::find(ret.begin(), ret.end(), *it) == ret.end());
             distances[*it] = 0.;
             labels[*it] = *it;
-            ret.pushBack(*it);
+            push_back(ret, *it);
         }
-
         // compare each point against all of the new points
-        pq.getc().clear(); // empty priority queue
-        // Fill priority queue
-#ifdef _OPENMP
-    #pragma omp declare reduction (merge : fpq<IT, FT> : omp_out.update(omp_in)) initializer(omp_priv(omp_orig))
-    #pragma omp parallel for reduction(merge: pq)
-#endif
-        for(size_t i = 0; i < np; ++i) {
-            double dist = distances[i];
-            if(dist == 0.) continue;
-            double newdist;
-            IT label = labels[i];
-            for(size_t j = 0; j < rsi; ++j) {
-                if((newdist = oracle(i, rsp[j])) < dist)
-                    dist = newdist, label = rsp[j];
-            }
-            distances[i] = dist;
-            labels[i] = label;
-            pq.add(dist, i);
-        }
+        detail::update_nearest_centers(oracle, np, rsp, rsi, distances.data(), &labels[0]);
+        farthest = detail::farthest_points<FT, IT>(distances.data(), np, farthestchunksize);
     }
-    const double minmaxdist = pq.top().first;
+    FT minmaxdist = 0.;
+    if(!farthest.empty())
+        minmaxdist = std::min_element(farthest.begin(), farthest.end())->first;
     bicriteria_result_t<IT, FT> bicret;
     assert(flat_hash_set<IT>(ret.begin(), ret.end()).size() == ret.size());
     bicret.centers() = std::move(ret);
     bicret.labels() = std::move(labels);
-    bicret.outliers() = std::move(pq.getc());
+    bicret.outliers() = std::move(farthest);
 #ifndef NDEBUG
     std::fprintf(stderr, "outliers size: %zu\n", bicret.outliers().size());
 #endif
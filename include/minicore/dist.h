@@ -1,6 +1,7 @@
 #ifndef FGC_DISTANCE_HEADERS_
 #define FGC_DISTANCE_HEADERS_
 #include <minicore/dist/applicator.h>
+#include <minicore/dist/csrcache.h>
 #include <minicore/dist/distance.h>
 #include <minicore/dist/knngraph.h>
 #endif
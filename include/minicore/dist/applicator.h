@@ -1607,6 +1607,12 @@ auto make_kmeanspp(const DissimilarityApplicator<MatrixType> &app, unsigned k, u
     return coresets::kmeanspp(app, gen, app.size(), k, weights, use_exponential_skips, parallelize);
 }
 
+template<typename MatrixType, typename WFT=blaze::ElementType_t<MatrixType>>
+auto make_kmeans_parallel(const DissimilarityApplicator<MatrixType> &app, unsigned k, uint64_t seed=13, const WFT *weights=nullptr, size_t nrounds=0, double oversample=2.) {
+    wy::WyRand<uint64_t> gen(seed);
+    return coresets::kmeans_parallel(app, gen, app.size(), k, weights, nrounds, oversample);
+}
+
 template<typename MatrixType, typename WFT=blaze::ElementType_t<MatrixType>>
 auto make_kcenter(const DissimilarityApplicator<MatrixType> &app, unsigned k, uint64_t seed=13, const WFT *weights=nullptr) {
     throw NotImplementedError("Not implemented");
@@ -1629,10 +1635,18 @@ static constexpr inline double getv(const T &x) {
     }
 }
 
-template<typename FT=float, typename CtrT, typename MatrixRowT, typename PriorT, typename PriorSumT, typename SumT, typename OSumT>
-double msr_with_prior(dist::DissimilarityMeasure msr, const CtrT &ctr, const MatrixRowT &mr, const PriorT &prior, PriorSumT prior_sum, SumT ctrsum, OSumT mrsum)
+/*
+ * msr_with_prior
+ * msrv is either a runtime DissimilarityMeasure or a dist::MeasureConstant<M>.
+ * With a MeasureConstant, each measure gets its own instantiation in which msr is a constant,
+ * so the measure switches below fold away and only that measure's kernel remains.
+ */
+template<typename FT=float, typename MsrT, typename CtrT, typename MatrixRowT, typename PriorT, typename PriorSumT, typename SumT, typename OSumT,
+         typename=std::enable_if_t<std::is_convertible_v<MsrT, dist::DissimilarityMeasure>>>
+double msr_with_prior(MsrT msrv, const CtrT &ctr, const MatrixRowT &mr, const PriorT &prior, PriorSumT prior_sum, SumT ctrsum, OSumT mrsum)
 {
     static_assert(std::is_floating_point_v<FT>, "FT must be floating-point");
+    const dist::DissimilarityMeasure msr = msrv;
     const size_t nd = mr.size();
     thread_local blz::DV<FT> tmpmulx, tmpmuly;
     OMP_CRITICAL {
@@ -1902,7 +1916,7 @@ double msr_with_prior(dist::DissimilarityMeasure msr, const CtrT &ctr, const Mat
             std::fprintf(stderr, "Using mixed dense/sparse comparisons; this will be correct but may be slower");
         }
         blaze::CompressedVector<ElementType_t<MatrixRowT>, blaze::TransposeFlag_v<MatrixRowT>> cv = mr;
-        return msr_with_prior(msr, ctr, cv, prior, prior_sum, ctrsum, mrsum);
+        return msr_with_prior(msrv, ctr, cv, prior, prior_sum, ctrsum, mrsum);
     } else {
         static int mixed_warning_emitted = 0;
         if(!mixed_warning_emitted) {
@@ -1910,7 +1924,7 @@ double msr_with_prior(dist::DissimilarityMeasure msr, const CtrT &ctr, const Mat
             std::fprintf(stderr, "Using mixed dense/sparse comparisons; this will be correct but may be slower");
         }
         blaze::CompressedVector<ElementType_t<CtrT>, blaze::TransposeFlag_v<CtrT>> cv = ctr;
-        return msr_with_prior(msr, cv, mr, prior, prior_sum, ctrsum, mrsum);
+        return msr_with_prior(msrv, cv, mr, prior, prior_sum, ctrsum, mrsum);
     }
 }
 template<typename CtrT, typename MatrixRowT, typename PriorT, typename PriorSumT, typename SumT, typename OSumT>
@@ -1931,6 +1945,7 @@ using jsd::DissimilarityApplicator;
 using jsd::make_d2_coreset_sampler;
 using jsd::make_kmc2;
 using jsd::make_kmeanspp;
+using jsd::make_kmeans_parallel;
 using jsd::make_jsm_applicator;
 using jsd::make_probdiv_applicator;
 
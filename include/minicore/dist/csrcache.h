@@ -0,0 +1,265 @@
+#ifndef MINOCORE_DIST_CSRCACHE_H__
+#define MINOCORE_DIST_CSRCACHE_H__
+#include "minicore/dist/applicator.h"
+
+namespace minicore { namespace cmp {
+
+/*
+ * Transforms kept by CSRTransformCache, as a bitmask.
+ * Each per-value transform costs nnz * sizeof(FT) bytes, in the same order as the matrix's data_ array;
+ * row constants cost two doubles per row. Row sums are always kept.
+ */
+enum CSRTransform: unsigned {
+    CSR_NORMALIZED     = 1u, // (x + prior) / (rowsum + prior * ncolumns)
+    CSR_LOG            = 2u, // log of the normalized values
+    CSR_SQRT           = 4u, // sqrt of the normalized values
+    CSR_ROW_CONSTANTS  = 8u, // Squared norm and sum_j q_j log q_j (including implicit zeros) of each row
+    CSR_ALL_TRANSFORMS = 15u,
+    CSR_AUTO           = ~0u // Keep whatever the measure needs
+};
+
+/*
+ * Whether cached_msr_with_prior has an O(nnz(row)) kernel for msr.
+ * MKL and REVERSE_MKL take logs of implicit zeros, so they need a positive prior;
+ * without one, msr_with_prior's result depends on a per-pair vanishing prior which a fixed cache can't reproduce.
+ */
+static constexpr inline bool csr_cache_supports(dist::DissimilarityMeasure msr, bool has_prior) {
+    switch(msr) {
+        case dist::L1: case dist::L2: case dist::SQRL2:
+        case dist::HELLINGER: case dist::BHATTACHARYYA_METRIC: case dist::BHATTACHARYYA_DISTANCE:
+            return true;
+        case dist::MKL: case dist::REVERSE_MKL:
+            return has_prior;
+        default: return false;
+    }
+}
+
+// Transforms read by msr's cached kernel
+static constexpr inline unsigned csr_transforms_for(dist::DissimilarityMeasure msr) {
+    switch(msr) {
+        case dist::L2: case dist::SQRL2: return CSR_ROW_CONSTANTS;
+        case dist::HELLINGER: case dist::BHATTACHARYYA_METRIC: case dist::BHATTACHARYYA_DISTANCE: return CSR_SQRT;
+        case dist::MKL: return CSR_LOG;
+        case dist::REVERSE_MKL: return CSR_NORMALIZED | CSR_ROW_CONSTANTS;
+        default: return 0u;
+    }
+}
+
+/*
+ * CSRTransformCache
+ * Per-dataset transforms of a util::CSparseMatrix's values, computed once rather than per comparison.
+ * Arrays share the matrix's indices_ and indptr_, so value k of any transform belongs to column indices_[k].
+ * The prior value is folded into the normalized values, so a cache is only valid for the prior it was built with.
+ */
+template<typename FT=float>
+struct CSRTransformCache {
+    unsigned mask_ = 0;
+    size_t nr_ = 0, nc_ = 0;
+    double pv_ = 0.;
+    std::vector<FT> normalized_, log_, sqrt_;
+    blz::DV<double> rowsums_, sqrnorms_, qlogq_;
+
+    CSRTransformCache() {}
+    template<typename VT, typename IT, typename IPtrT, typename PriorT>
+    CSRTransformCache(const util::CSparseMatrix<VT, IT, IPtrT> &mat, const PriorT &prior, unsigned mask=CSR_ALL_TRANSFORMS) {
+        build(mat, prior, mask);
+    }
+    template<typename VT, typename IT, typename IPtrT, typename PriorT>
+    void build(const util::CSparseMatrix<VT, IT, IPtrT> &mat, const PriorT &prior, unsigned mask=CSR_ALL_TRANSFORMS) {
+        mask_ = mask & CSR_ALL_TRANSFORMS;
+        nr_ = mat.rows(); nc_ = mat.columns();
+        pv_ = prior.size() ? getv(prior): 0.;
+        const size_t nnz = mat.nnz();
+        normalized_.resize(has(CSR_NORMALIZED) ? nnz: size_t(0));
+        log_.resize(has(CSR_LOG) ? nnz: size_t(0));
+        sqrt_.resize(has(CSR_SQRT) ? nnz: size_t(0));
+        rowsums_.resize(nr_);
+        sqrnorms_.resize(has(CSR_ROW_CONSTANTS) ? nr_: size_t(0));
+        qlogq_.resize(has(CSR_ROW_CONSTANTS) ? nr_: size_t(0));
+        OMP_PFOR
+        for(size_t i = 0; i < nr_; ++i) {
+            const size_t beg = mat.indptr_[i], end = mat.indptr_[i + 1];
+            double rs = 0., sq = 0.;
+            for(size_t k = beg; k < end; ++k) {
+                const double v = mat.data_[k];
+                rs += v; sq += v * v;
+            }
+            rowsums_[i] = rs;
+            const double ssum = rs + pv_ * nc_;
+            const double rsi = ssum > 0. ? 1. / ssum: 0., q0 = pv_ * rsi;
+            double qlq = q0 > 0. ? (nc_ - (end - beg)) * q0 * std::log(q0): 0.;
+            for(size_t k = beg; k < end; ++k) {
+                const double q = mat.data_[k] * rsi + q0;
+                if(has(CSR_NORMALIZED)) normalized_[k] = q;
+                if(has(CSR_LOG)) log_[k] = std::log(q);
+                if(has(CSR_SQRT)) sqrt_[k] = std::sqrt(q);
+                if(q > 0.) qlq += q * std::log(q);
+            }
+            if(has(CSR_ROW_CONSTANTS)) {
+                sqrnorms_[i] = sq;
+                qlogq_[i] = qlq;
+            }
+        }
+    }
+    bool has(unsigned t) const {return (mask_ & t) == t;}
+    bool supports(dist::DissimilarityMeasure msr) const {
+        return csr_cache_supports(msr, pv_ > 0.) && has(csr_transforms_for(msr));
+    }
+    size_t rows() const {return nr_;}
+    size_t columns() const {return nc_;}
+    double prior_value() const {return pv_;}
+    size_t bytes() const {
+        return (normalized_.size() + log_.size() + sqrt_.size()) * sizeof(FT)
+             + (rowsums_.size() + sqrnorms_.size() + qlogq_.size()) * sizeof(double);
+    }
+    // CSR view of one transform, sharing mat's indices and indptr
+    template<typename VT, typename IT, typename IPtrT>
+    util::CSparseMatrix<const FT, IT, IPtrT> view(const util::CSparseMatrix<VT, IT, IPtrT> &mat, CSRTransform t) const {
+        const std::vector<FT> *p = t == CSR_NORMALIZED ? &normalized_: t == CSR_LOG ? &log_: t == CSR_SQRT ? &sqrt_: nullptr;
+        if(!p || !has(t)) throw std::invalid_argument("Transform is not a per-value transform kept in this cache");
+        return util::CSparseMatrix<const FT, IT, IPtrT>(p->data(), mat.indices_, mat.indptr_, mat.rows(), mat.columns(), mat.nnz());
+    }
+};
+
+/*
+ * CenterTransforms
+ * The center-side counterpart of CSRTransformCache for one dense center: the sums and dense transforms
+ * which let cached_msr_with_prior handle a row's implicit zeros in O(1).
+ * Built once per center per assignment pass.
+ */
+template<typename FT=float>
+struct CenterTransforms {
+    double ssum_ = 0., inc_ = 0.;               // Smoothed sum (sum + prior * d) and prior / smoothed sum
+    double sqrnorm_ = 0., abssum_ = 0.;         // L2, L1
+    double sqrtpsum_ = 0.;                      // Hellinger, Bhattacharyya
+    double plogp_ = 0., logpsum_ = 0.;          // MKL, REVERSE_MKL
+    blz::DV<FT> sqrtp_, logp_;
+
+    template<typename CtrT>
+    void build(dist::DissimilarityMeasure msr, const CtrT &ctr, double ctrsum, double pv) {
+        const size_t nd = ctr.size();
+        ssum_ = ctrsum + pv * nd;
+        const double rsi = ssum_ > 0. ? 1. / ssum_: 0.;
+        inc_ = pv * rsi;
+        switch(msr) {
+            case dist::L2: case dist::SQRL2:
+                sqrnorm_ = 0.;
+                for(size_t j = 0; j < nd; ++j) sqrnorm_ += double(ctr[j]) * ctr[j];
+                break;
+            case dist::L1:
+                abssum_ = 0.;
+                for(size_t j = 0; j < nd; ++j) abssum_ += std::abs(double(ctr[j]));
+                break;
+            case dist::HELLINGER: case dist::BHATTACHARYYA_METRIC: case dist::BHATTACHARYYA_DISTANCE:
+                sqrtp_.resize(nd);
+                sqrtpsum_ = 0.;
+                for(size_t j = 0; j < nd; ++j)
+                    sqrtpsum_ += (sqrtp_[j] = std::sqrt(ctr[j] * rsi + inc_));
+                break;
+            case dist::MKL: case dist::REVERSE_MKL:
+                logp_.resize(nd);
+                plogp_ = logpsum_ = 0.;
+                for(size_t j = 0; j < nd; ++j) {
+                    const double p = ctr[j] * rsi + inc_;
+                    const double lp = std::log(p);
+                    logp_[j] = lp;
+                    logpsum_ += lp;
+                    if(p > 0.) plogp_ += p * lp;
+                }
+                break;
+            default: throw std::invalid_argument(std::string("No cached kernel for measure ") + dist::msr2str(msr));
+        }
+    }
+};
+
+/*
+ * cached_msr_with_prior
+ * msr_with_prior(msr, row(mat, i), ctr, ...) for a dense center, in O(nnz(row i)) rather than O(d).
+ * Each measure is split into a sum over the row's nonzeros plus a term for its implicit zeros,
+ * which all share the row's smoothed zero value and are covered by the center's precomputed sums.
+ * Requires cache.supports(msr); ct must have been built for msr with cache.prior_value().
+ */
+template<typename FT, typename VT, typename IT, typename IPtrT, typename CtrT>
+double cached_msr_with_prior(dist::DissimilarityMeasure msr, const CSRTransformCache<FT> &cache,
+                             const util::CSparseMatrix<VT, IT, IPtrT> &mat, size_t i,
+                             const CtrT &ctr, const CenterTransforms<FT> &ct)
+{
+    const size_t beg = mat.indptr_[i], end = mat.indptr_[i + 1];
+    const IT *const idx = mat.indices_;
+    const double rhsum = cache.rowsums_[i] + cache.pv_ * cache.nc_;
+    const double q0 = cache.pv_ > 0. && rhsum > 0. ? cache.pv_ / rhsum: 0.;
+    double ret;
+    switch(msr) {
+        case dist::L2: case dist::SQRL2: {
+            double dot = 0.;
+            for(size_t k = beg; k < end; ++k) dot += double(mat.data_[k]) * ctr[idx[k]];
+            ret = std::max(cache.sqrnorms_[i] - 2. * dot + ct.sqrnorm_, 0.);
+            if(msr == dist::L2) ret = std::sqrt(ret);
+            break;
+        }
+        case dist::L1: {
+            ret = ct.abssum_;
+            for(size_t k = beg; k < end; ++k) {
+                const double c = ctr[idx[k]];
+                ret += std::abs(c - mat.data_[k]) - std::abs(c);
+            }
+            ret = std::max(ret, 0.);
+            break;
+        }
+        case dist::HELLINGER: case dist::BHATTACHARYYA_METRIC: case dist::BHATTACHARYYA_DISTANCE: {
+            // Both sides sum to 1, so sum_j (sqrt(p_j) - sqrt(q_j))^2 = 2 - 2 BC
+            double bc = 0., nzsqrtp = 0.;
+            for(size_t k = beg; k < end; ++k) {
+                const double sp = ct.sqrtp_[idx[k]];
+                bc += sp * cache.sqrt_[k];
+                nzsqrtp += sp;
+            }
+            bc += std::sqrt(q0) * (ct.sqrtpsum_ - nzsqrtp);
+            if(msr == dist::HELLINGER) {
+                ret = std::sqrt(std::max(1. - bc, 0.));
+            } else {
+                if(1. - bc < 1e-8) bc = 1.;
+                ret = msr == dist::BHATTACHARYYA_METRIC ? std::sqrt(std::max(1. - bc, 0.)): -std::log(bc);
+            }
+            break;
+        }
+        case dist::MKL: { // sum_j p_j log p_j - sum_j p_j log q_j
+            const double rsi = ct.ssum_ > 0. ? 1. / ct.ssum_: 0.;
+            double plogq = 0., nzp = 0.;
+            for(size_t k = beg; k < end; ++k) {
+                const double p = ctr[idx[k]] * rsi + ct.inc_;
+                plogq += p * cache.log_[k];
+                nzp += p;
+            }
+            plogq += std::log(q0) * std::max(1. - nzp, 0.);
+            ret = ct.plogp_ - plogq;
+            break;
+        }
+        case dist::REVERSE_MKL: { // sum_j q_j log q_j - sum_j q_j log p_j
+            double qlogp = 0., nzlogp = 0.;
+            for(size_t k = beg; k < end; ++k) {
+                const double lp = ct.logp_[idx[k]];
+                qlogp += cache.normalized_[k] * lp;
+                nzlogp += lp;
+            }
+            qlogp += q0 * (ct.logpsum_ - nzlogp);
+            ret = cache.qlogq_[i] - qlogp;
+            break;
+        }
+        default: throw std::invalid_argument(std::string("No cached kernel for measure ") + dist::msr2str(msr));
+    }
+    if(msr == dist::MKL || msr == dist::REVERSE_MKL) {
+        ret = std::max(ret, 0.);
+        if(ret == std::numeric_limits<double>::infinity()) ret = std::numeric_limits<FT>::max();
+    }
+    return ret;
+}
+
+} // namespace cmp
+using cmp::CSRTransformCache;
+using cmp::CenterTransforms;
+using cmp::cached_msr_with_prior;
+
+} // namespace minicore
+
+#endif /* MINOCORE_DIST_CSRCACHE_H__ */
@@ -63,6 +63,11 @@ enum DissimilarityMeasure {
     RSIS=REVERSE_SYMMETRIC_ITAKURA_SAITO,
 };
 
+// Compile-time measure tag; converts implicitly to DissimilarityMeasure,
+// so functions taking a measure by template type can be instantiated once per measure.
+template<DissimilarityMeasure M>
+using MeasureConstant = std::integral_constant<DissimilarityMeasure, M>;
+
 static constexpr inline bool msr_is_normalized(DissimilarityMeasure msr) {
     switch(msr) {
 #if 0
@@ -188,9 +188,9 @@ auto knns2graph(const std::vector<packed::pair<FT, IT>> &knns, size_t np, bool m
     MINOCORE_REQUIRE(knns.size(), "nonempty");
     unsigned k = knns.size() / np;
     MINOCORE_REQUIRE(knns.size() == np * k, "sanity");
-    std::cerr << "k: " << k << "knns: " << knns.size() << (mutual ? "mutual" : "absolute") << '\n';
+    VERBOSE_ONLY(std::cerr << "k: " << k << "knns: " << knns.size() << (mutual ? "mutual" : "absolute") << '\n';)
+    util::PhaseTimer pt("knns2graph", 0, knns.size() * sizeof(knns[0]));
     graph::Graph<boost::undirectedS, FT> ret(np);
-    std::fprintf(stderr, "produced graph\n");
     for(size_t i = 0; i < np; ++i) {
         auto p = &knns[i * k];
         SK_UNROLL_8
@@ -208,7 +208,6 @@ auto knns2graph(const std::vector<packed::pair<FT, IT>> &knns, size_t np, bool m
             }
             boost::add_edge(i, static_cast<size_t>(p[j].second), p[j].first, ret);
         }
-        std::fprintf(stderr, "%zu/%zu\n", i + 1, np);
     }
     return ret;
 }
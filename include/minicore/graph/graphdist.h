@@ -3,6 +3,7 @@
 #define FGC_GRAPH_DIST_H__
 #include "minicore/graph/graph.h"
 #include "diskmat/diskmat.h"
+#include "minicore/util/telemetry.h"
 #include <atomic>
 
 namespace minicore {
@@ -23,6 +24,7 @@ void fill_graph_distmat(const Graph &x, MatType &mat, const VType *sources=nullp
         throw std::invalid_argument(std::string(buf, std::sprintf(buf, "mat sizes (%zu rows, %zu col) don't match output requirements (%zu/%zu)\n",
                                                                   mat.rows(), mat.columns(), nrows, ncol)));
     }
+    util::PhaseTimer pt("graph_distmat", nrows, nrows * ncol * sizeof(mat(0, 0)));
     std::atomic<size_t> rows_complete;
     rows_complete.store(0);
     if(only_sources_as_dests) {
@@ -45,10 +47,10 @@ void fill_graph_distmat(const Graph &x, MatType &mat, const VType *sources=nullp
             auto wrow(row(working_space, rowid BLAZE_CHECK_DEBUG));
             boost::dijkstra_shortest_paths(x, vtx, boost::distance_map(&wrow[0]));
             row(mat, i BLAZE_CHECK_DEBUG) = blaze::serial(blaze::elements(wrow, sources->data(), sources->size()));
-            ++rows_complete;
-            const auto val = rows_complete.load();
-            if((val & (val - 1)) == 0)
-                std::fprintf(stderr, "Completed dijkstra for row %zu/%zu\n", val, nrows);
+            VERBOSE_ONLY(
+                if(const size_t val = ++rows_complete; (val & (val - 1)) == 0)
+                    std::fprintf(stderr, "Completed dijkstra for row %zu/%zu\n", val, nrows);
+            )
         }
     } else {
         assert(ncol == boost::num_vertices(x));
@@ -58,10 +60,10 @@ void fill_graph_distmat(const Graph &x, MatType &mat, const VType *sources=nullp
             auto vtx = all_sources || sources == nullptr ? vertices[i]: (*sources)[i];
             assert(vtx < boost::num_vertices(x));
             boost::dijkstra_shortest_paths(x, vtx, distance_map(&mr[0]));
-            ++rows_complete;
-            const auto val = rows_complete.load();
-            if((val & (val - 1)) == 0)
-                std::fprintf(stderr, "Completed dijkstra for row %zu/%zu\n", val, nrows);
+            VERBOSE_ONLY(
+                if(const size_t val = ++rows_complete; (val & (val - 1)) == 0)
+                    std::fprintf(stderr, "Completed dijkstra for row %zu/%zu\n", val, nrows);
+            )
         }
     }
 }
@@ -73,7 +75,7 @@ graph2diskmat(const Graph &x, std::string path, const VType *sources=nullptr, bo
     using FT = typename Graph::edge_property_type::value_type;
     size_t nv = sources && only_sources_as_dests ? sources->size(): boost::num_vertices(x);
     size_t nrows = all_sources || !sources ? boost::num_vertices(x): sources->size();
-    std::fprintf(stderr, "all sources: %d. nrows: %zu\n", all_sources, nrows);
+    VERBOSE_ONLY(std::fprintf(stderr, "all sources: %d. nrows: %zu\n", all_sources, nrows);)
     DiskMat<FT> ret(nrows, nv, path);
     fill_graph_distmat(x, ret, sources, only_sources_as_dests, all_sources);
     return ret;
@@ -87,7 +89,7 @@ graph2rammat(const Graph &x, std::string, const VType *sources=nullptr, bool onl
     using FT = typename Graph::edge_property_type::value_type;
     size_t nv = sources && only_sources_as_dests ? sources->size(): boost::num_vertices(x);
     size_t nrows = all_sources || !sources ? boost::num_vertices(x): sources->size();
-    std::fprintf(stderr, "all sources: %d. nrows: %zu\n", all_sources, nrows);
+    VERBOSE_ONLY(std::fprintf(stderr, "all sources: %d. nrows: %zu\n", all_sources, nrows);)
     blaze::DynamicMatrix<FT>  ret(nrows, nv);
     fill_graph_distmat(x, ret, sources, only_sources_as_dests, all_sources);
     return ret;
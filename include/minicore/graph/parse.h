@@ -7,7 +7,14 @@
 #include <unordered_map>
 #include <iostream>
 #include <cstring>
+#include <charconv>
+#include <numeric>
+#include <sys/mman.h>
 #include "minicore/util/io.h"
+#include "thirdparty/mio.hpp"
+#ifdef _OPENMP
+#  include <omp.h>
+#endif
 
 namespace minicore {
 using namespace ::minicore::shared;
@@ -22,34 +29,168 @@ enum ParsedFiletype {
 };
 namespace graph {
 
+namespace detail {
+
+/*
+ * Holds the full contents of a graph file.
+ * Uncompressed files are memory-mapped; compressed files are streamed through util::io::xopen
+ * into a single buffer so that both cases can be split into chunks and parsed in parallel.
+ */
+struct GraphFileBuffer {
+    std::unique_ptr<mio::mmap_source> map_;
+    std::string buf_;
+    const char *data_ = nullptr;
+    size_t size_ = 0;
+
+    static bool is_compressed(const std::string &fn) {
+        using boost::algorithm::ends_with;
+        return ends_with(fn, ".gz") || ends_with(fn, ".xz") || ends_with(fn, ".bz2") || ends_with(fn, ".zst");
+    }
+    GraphFileBuffer(const std::string &fn) {
+        if(is_compressed(fn)) {
+            static constexpr size_t BLOCKSIZE = size_t(1) << 20;
+            auto fdat = util::io::xopen(fn);
+            auto &ifs = *fdat.first;
+            for(;;) {
+                const size_t off = buf_.size();
+                buf_.resize(off + BLOCKSIZE);
+                ifs.read(&buf_[off], BLOCKSIZE);
+                buf_.resize(off + ifs.gcount());
+                if(!ifs) break;
+            }
+            data_ = buf_.data();
+            size_ = buf_.size();
+        } else {
+            std::error_code ec;
+            map_.reset(new mio::mmap_source);
+            map_->map(fn, ec);
+            if(ec) throw std::runtime_error(std::string("Failed to map file ") + fn + ": " + ec.message());
+            data_ = map_->data();
+            size_ = map_->size();
+            ::madvise((void *)data_, size_, MADV_SEQUENTIAL);
+        }
+        if(!size_) throw std::runtime_error(std::string("Failed to read from file ") + fn);
+    }
+    const char *begin() const {return data_;}
+    const char *end()   const {return data_ + size_;}
+    size_t size() const {return size_;}
+};
+
+static inline size_t default_nchunks() {
+    size_t nt = 1;
+    OMP_ONLY(nt = omp_get_max_threads();)
+    return nt * 4;
+}
+
+// Splits [s, s + n) into at most nchunks ranges, each of which begins at the start of a line.
+static std::vector<size_t> split_at_newlines(const char *s, size_t n, size_t nchunks=default_nchunks()) {
+    std::vector<size_t> ret{0};
+    for(size_t i = 1; i < nchunks; ++i) {
+        size_t pos = std::max(n / nchunks * i, ret.back());
+        if(pos >= n) break;
+        const void *nl = std::memchr(s + pos, '\n', n - pos);
+        if(!nl) break;
+        pos = static_cast<const char *>(nl) - s + 1;
+        if(pos > ret.back() && pos < n) ret.push_back(pos);
+    }
+    ret.push_back(n);
+    return ret;
+}
+
+// Calls func(linestart, lineend) for each line in [s, e), excluding the newline character.
+template<typename Func>
+static void for_each_line(const char *s, const char *e, const Func &func) {
+    while(s < e) {
+        const char *eol = static_cast<const char *>(std::memchr(s, '\n', e - s));
+        if(!eol) eol = e;
+        func(s, eol);
+        s = eol + 1;
+    }
+}
+
+static inline const char *skip_space(const char *s, const char *e) {
+    while(s < e && (*s == ' ' || *s == '\t' || *s == '"' || *s == '\r')) ++s;
+    return s;
+}
+
+// Bounded number parsing; the input buffer is not null-terminated.
+template<typename T>
+static inline const char *parse_number(const char *s, const char *e, T &val) {
+    s = skip_space(s, e);
+    auto res = std::from_chars(s, e, val);
+    return res.ec == std::errc() ? res.ptr: nullptr;
+}
+
+template<typename T>
+static std::vector<T> concatenate(std::vector<std::vector<T>> &chunks) {
+    std::vector<size_t> offsets(chunks.size() + 1);
+    for(size_t i = 0; i < chunks.size(); ++i) offsets[i + 1] = offsets[i] + chunks[i].size();
+    std::vector<T> ret(offsets.back());
+    OMP_PFOR
+    for(size_t i = 0; i < chunks.size(); ++i) {
+        std::copy(chunks[i].begin(), chunks[i].end(), ret.begin() + offsets[i]);
+        std::vector<T>().swap(chunks[i]);
+    }
+    return ret;
+}
+
+static inline void throw_first_error(const std::vector<std::string> &errors) {
+    for(const auto &err: errors)
+        if(!err.empty()) throw std::runtime_error(err);
+}
+
+} // namespace detail
+
+/*
+ * Parses METIS-style adjacency files: a header line holding the number of nodes and edges,
+ * followed by a line per vertex listing its 1-based neighbors.
+ *
+ * The file is split into chunks at newlines, and each chunk is parsed in parallel
+ * into its own edge list. Vertex ids come from an exclusive prefix sum over the number of
+ * adjacency lines in each chunk. The graph is then constructed in one pass from the edge range.
+ */
 template<typename DirectedS, typename VtxProps=boost::no_property, typename GraphProps=boost::no_property>
 Graph<DirectedS, float, VtxProps, GraphProps> parse_dimacs_unweighted(std::string fn) {
     using GraphType = Graph<DirectedS, float, VtxProps, GraphProps>;
-    std::string line;
-    auto fdat = util::io::xopen(fn);
-    auto &ifs = *fdat.first;
-    if(!std::getline(ifs, line)) throw std::runtime_error(std::string("Failed to read from file ") + fn);
-    unsigned nnodes = std::atoi(line.data());
-    if(!nnodes) throw 2;
-    auto p = std::strchr(line.data(), ' ') + 1;
-    unsigned nedges = std::atoi(p);
-    if(!nedges) throw 2;
-    GraphType ret(nnodes);
-    unsigned id = 0;
-    using edge_property_type = typename decltype(ret)::edge_property_type;
-    while(std::getline(ifs, line)) {
-        const char *s = line.data();
-        if(!std::isdigit(*s)) continue;
-        for(;;) {
-            auto newv = std::atoi(s) - 1;
-            boost::add_edge(id, newv, static_cast<edge_property_type>(1.), ret);
-            assert(unsigned(newv) < boost::num_vertices(ret));
-            assert(id < boost::num_vertices(ret));
-            if((s = std::strchr(s, ' ')) == nullptr || !std::isdigit(*++s)) break;
-        }
-        ++id;
+    using EdgeType = std::pair<size_t, size_t>;
+    detail::GraphFileBuffer fbuf(fn);
+    const char *const fbeg = fbuf.begin(), *const fend = fbuf.end();
+    const char *body = static_cast<const char *>(std::memchr(fbeg, '\n', fbuf.size()));
+    if(!body) throw std::runtime_error(std::string("Failed to read from file ") + fn);
+    size_t nnodes = 0, nedges = 0;
+    const char *p = detail::parse_number(fbeg, body, nnodes);
+    if(!p || !nnodes || !detail::parse_number(p, body, nedges) || !nedges)
+        throw std::runtime_error(std::string("Failed to parse header from file ") + fn);
+    ++body;
+    const size_t bodysize = fend - body;
+    const auto bounds = detail::split_at_newlines(body, bodysize);
+    const size_t nchunks = bounds.size() - 1;
+    std::vector<size_t> firstid(nchunks + 1);
+    OMP_PFOR
+    for(size_t i = 0; i < nchunks; ++i) {
+        size_t n = 0;
+        detail::for_each_line(body + bounds[i], body + bounds[i + 1], [&n](const char *s, const char *) {n += std::isdigit(*s) != 0;});
+        firstid[i + 1] = n;
+    }
+    std::partial_sum(firstid.begin(), firstid.end(), firstid.begin());
+    std::vector<std::vector<EdgeType>> chunkedges(nchunks);
+    OMP_PFOR_DYN
+    for(size_t i = 0; i < nchunks; ++i) {
+        size_t id = firstid[i];
+        auto &edges = chunkedges[i];
+        edges.reserve(nedges / nchunks * 2);
+        detail::for_each_line(body + bounds[i], body + bounds[i + 1], [&](const char *s, const char *e) {
+            if(!std::isdigit(*s)) return;
+            for(size_t v; (s = detail::parse_number(s, e, v)) != nullptr;) {
+                assert(v >= 1);
+                edges.emplace_back(id, v - 1);
+            }
+            ++id;
+        });
     }
-    std::cout << line << '\n';
+    auto edges = detail::concatenate(chunkedges);
+    std::vector<float> weights(edges.size(), 1.f);
+    GraphType ret(edges.begin(), edges.end(), weights.begin(), nnodes);
     std::fprintf(stderr, "num edges: %zu. num vertices: %zu\n", boost::num_edges(ret), boost::num_vertices(ret));
     return ret;
 }
@@ -58,95 +199,123 @@ Graph<DirectedS, float, VtxProps, GraphProps> parse_dimacs_unweighted(std::strin
 template<typename DirectedS, typename VtxProps=boost::no_property, typename GraphProps=boost::no_property, typename VtxIdType=uint64_t>
 Graph<DirectedS, float, VtxProps, GraphProps> parse_nber(std::string fn) {
     using GraphType = Graph<DirectedS, float, VtxProps, GraphProps>;
-    GraphType ret;
-    std::string line;
-    auto fdat = util::io::xopen(fn);
-    auto &ifs = *fdat.first;
-    std::vector<VtxIdType> ids;
-    std::unordered_map<VtxIdType, uint32_t> loc2id;
     static constexpr unsigned SHIFT = sizeof(VtxIdType) * CHAR_BIT / 2;
-    using edge_property_type = typename GraphType::edge_property_type;
-    while(std::getline(ifs, line)) {
-        if(line.empty() || line.front() == '#' || line.front() == '\n') continue;
-        line.erase(std::remove(line.begin(), line.end(), '"'), line.end());
-        const char *s = line.data();
-        VtxIdType val = VtxIdType(std::atoi(s)) << SHIFT;
-        if((s = std::strchr(s, ',')) == nullptr) throw std::runtime_error(std::string("Failed to parse from fn") + fn);
-        val |= std::atoi(++s);
-        auto it = loc2id.find(val);
-        if(it == loc2id.end()) {
-            it = loc2id.emplace(val, loc2id.size()).first;
-            //auto vid = boost::add_vertex(ret);
-            ids.push_back(val);
-            assert(loc2id[val] == ids.size() - 1);
-            assert(ids.back() == val);
-            //assert(vid == ids.back());
-        }
-        s = std::strchr(s, ',') + 1;
-        double dist = std::atof(s);
-        s = std::strchr(s, ',') + 1;
-        VtxIdType endval = (VtxIdType(std::atoi(s)) << SHIFT);
-        endval |= std::atoi(std::strchr(s, ',') + 1);
-        auto rit = loc2id.find(endval);
-        if(rit == loc2id.end()) {
-            rit = loc2id.emplace(endval, loc2id.size()).first;
-            ids.push_back(endval);
-            //auto vid = boost::add_vertex(ret);
-            assert(loc2id[endval] == ids.size() - 1);
-            assert(ids.back() == endval);
-            //assert(vid == ids.back());
-        }
-        boost::add_edge(it->second, rit->second, static_cast<edge_property_type>(dist), ret);
-        assert(it->second < boost::num_vertices(ret));
-        assert(it->first < boost::num_vertices(ret));
+    struct Record {
+        VtxIdType lhs, rhs;
+        float dist;
+    };
+    detail::GraphFileBuffer fbuf(fn);
+    const auto bounds = detail::split_at_newlines(fbuf.begin(), fbuf.size());
+    const size_t nchunks = bounds.size() - 1;
+    std::vector<std::vector<Record>> chunkrecords(nchunks);
+    std::vector<std::string> errors(nchunks);
+    OMP_PFOR_DYN
+    for(size_t i = 0; i < nchunks; ++i) {
+        auto &records = chunkrecords[i];
+        detail::for_each_line(fbuf.begin() + bounds[i], fbuf.begin() + bounds[i + 1], [&](const char *s, const char *e) {
+            if(s == e || *s == '#' || *s == '\r' || !errors[i].empty()) return;
+            // Skip header lines
+            if(!std::isdigit(*detail::skip_space(s, e))) return;
+            unsigned fields[4];
+            double dist;
+            const char *p = s;
+            for(unsigned f = 0; f < 5; ++f) {
+                if(f) {
+                    if((p = static_cast<const char *>(std::memchr(p, ',', e - p))) == nullptr) break;
+                    ++p;
+                }
+                const char *np = f == 2 ? detail::parse_number(p, e, dist)
+                                        : detail::parse_number(p, e, fields[f - (f > 2)]);
+                if(!np) {p = nullptr; break;}
+                p = np;
+            }
+            if(!p) {
+                errors[i] = std::string("Failed to parse from fn") + fn + ": " + std::string(s, e);
+                return;
+            }
+            records.push_back(Record{(VtxIdType(fields[0]) << SHIFT) | fields[1],
+                                     (VtxIdType(fields[2]) << SHIFT) | fields[3],
+                                     static_cast<float>(dist)});
+        });
+    }
+    detail::throw_first_error(errors);
+    auto records = detail::concatenate(chunkrecords);
+    // Ids are assigned in order of first appearance, which requires a serial pass.
+    shared::flat_hash_map<VtxIdType, uint32_t> loc2id;
+    std::vector<std::pair<uint32_t, uint32_t>> edges(records.size());
+    std::vector<float> weights(records.size());
+    auto getid = [&loc2id](VtxIdType key) {
+        return loc2id.emplace(key, uint32_t(loc2id.size())).first->second;
+    };
+    for(size_t i = 0; i < records.size(); ++i) {
+        const auto lhs = getid(records[i].lhs);
+        const auto rhs = getid(records[i].rhs);
+        edges[i] = {lhs, rhs};
+        weights[i] = records[i].dist;
     }
+    std::vector<Record>().swap(records);
+    GraphType ret(edges.begin(), edges.end(), weights.begin(), loc2id.size());
     std::fprintf(stderr, "num edges: %zu. num vertices: %zu\n", boost::num_edges(ret), boost::num_vertices(ret));
     return ret;
 }
 static minicore::Graph<undirectedS> dimacs_official_parse(std::string input) {
-    minicore::Graph<undirectedS> g;
-    auto fdat = util::io::xopen(input);
-    std::string graphtype;
-    size_t nnodes = 0, nedges = 0;
-    for(std::string line; std::getline(*fdat.first, line);) {
-        if(line.empty()) continue;
-        switch(line.front()) {
-            case 'c': break; // nothing
-            case 'p': {
-                const char *p = line.data() + 2, *p2 = ++p;
-                while(!std::isspace(*p2)) ++p2;
-                graphtype = std::string(p, p2 - p);
-                std::fprintf(stderr, "graphtype: %s\n", graphtype.data());
-                p = p2 + 1;
-                nnodes = std::strtoull(p, nullptr, 10);
-                for(size_t i = 0; i < nnodes; ++i)
-                    boost::add_vertex(g); // Add all the vertices
-                if((p2 = std::strchr(p, ' ')) == nullptr) throw std::runtime_error(std::string("Failed to parse file at ") + input);
-                p = p2 + 1;
-                nedges = std::strtoull(p, nullptr, 10);
-                std::fprintf(stderr, "n: %zu. m: %zu\n", nnodes, nedges);
-                break;
-            }
-            case 'a': {
-                assert(nnodes);
-                char *strend;
-                const char *p = line.data() + 2;
-                size_t lhs = std::strtoull(p, &strend, 10);
-                assert(lhs >= 1 || !std::fprintf(stderr, "p: %s\n", p));
-                p = strend + 1;
-                size_t rhs = std::strtoull(p, &strend, 10);
-                assert(rhs >= 1 || !std::fprintf(stderr, "p: %s\n", p));
-                p = strend + 1;
-                double dist = std::atof(p);
-                boost::add_edge(lhs - 1, rhs - 1, dist, g);
-                assert(lhs - 1 < boost::num_vertices(g));
-                assert(rhs - 1 < boost::num_vertices(g));
-                break;
+    using EdgeType = std::pair<size_t, size_t>;
+    struct ProblemLine {
+        std::string graphtype;
+        size_t nnodes = 0, nedges = 0;
+    };
+    detail::GraphFileBuffer fbuf(input);
+    const auto bounds = detail::split_at_newlines(fbuf.begin(), fbuf.size());
+    const size_t nchunks = bounds.size() - 1;
+    std::vector<std::vector<EdgeType>> chunkedges(nchunks);
+    std::vector<std::vector<float>> chunkweights(nchunks);
+    std::vector<ProblemLine> problems(nchunks);
+    std::vector<std::string> errors(nchunks);
+    OMP_PFOR_DYN
+    for(size_t i = 0; i < nchunks; ++i) {
+        auto &edges = chunkedges[i];
+        auto &weights = chunkweights[i];
+        detail::for_each_line(fbuf.begin() + bounds[i], fbuf.begin() + bounds[i + 1], [&](const char *s, const char *e) {
+            if(s == e || *s == '\r' || !errors[i].empty()) return;
+            switch(*s) {
+                case 'c': break; // nothing
+                case 'p': {
+                    const char *p = detail::skip_space(s + 1, e), *p2 = p;
+                    while(p2 < e && !std::isspace(*p2)) ++p2;
+                    auto &prob = problems[i];
+                    prob.graphtype = std::string(p, p2 - p);
+                    if((p = detail::parse_number(p2, e, prob.nnodes)) == nullptr || !detail::parse_number(p, e, prob.nedges))
+                        errors[i] = std::string("Failed to parse file at ") + input;
+                    break;
+                }
+                case 'a': {
+                    size_t lhs, rhs;
+                    double dist;
+                    const char *p = s + 1;
+                    if((p = detail::parse_number(p, e, lhs)) == nullptr
+                       || (p = detail::parse_number(p, e, rhs)) == nullptr
+                       || !detail::parse_number(p, e, dist)
+                       || !lhs || !rhs) {
+                        errors[i] = std::string("Failed to parse line: ") + std::string(s, e);
+                        break;
+                    }
+                    edges.emplace_back(lhs - 1, rhs - 1);
+                    weights.push_back(dist);
+                    break;
+                }
+                default: errors[i] = std::string("Unexpected: this line! (") + std::string(s, e) + ")";
             }
-            default: std::fprintf(stderr, "Unexpected: this line! (%s)\n", line.data()); throw std::runtime_error("");
-        }
+        });
     }
-    return g;
+    detail::throw_first_error(errors);
+    auto pit = std::find_if(problems.begin(), problems.end(), [](const auto &x) {return !x.graphtype.empty();});
+    if(pit == problems.end()) throw std::runtime_error(std::string("Missing problem line in ") + input);
+    std::fprintf(stderr, "graphtype: %s\n", pit->graphtype.data());
+    std::fprintf(stderr, "n: %zu. m: %zu\n", pit->nnodes, pit->nedges);
+    auto edges = detail::concatenate(chunkedges);
+    auto weights = detail::concatenate(chunkweights);
+    assert(std::all_of(edges.begin(), edges.end(), [n=pit->nnodes](auto x) {return x.first < n && x.second < n;}));
+    return minicore::Graph<undirectedS>(edges.begin(), edges.end(), weights.begin(), pit->nnodes);
 }
 
 static minicore::Graph<undirectedS> dimacs_parse(std::string fn) {
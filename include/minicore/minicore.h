@@ -4,6 +4,7 @@
 
 #include <minicore/dist.h>
 #include <minicore/coreset.h>
+#include <minicore/coreset/evaluate.h>
 
 #include <minicore/optim.h>
 
@@ -129,6 +129,136 @@ kcenter_greedy_2approx(Args &&...args)
     return kcenter_greedy_2approx_costs(std::forward<Args>(args)...).first;
 }
 
+/*
+ * Gonzalez traversal with triangle-inequality pruning, for oracles which are metrics.
+ * Returns exactly what kcenter_greedy_2approx_costs does, with far fewer oracle calls.
+ *
+ * Each point belongs to the cluster of the center which set its current distance D_i.
+ * When center c is added, a point in the cluster of center a can only move if d(c, a) < 2 D_i,
+ * since otherwise d(i, c) >= d(c, a) - D_i >= D_i. A cluster whose radius is at most d(c, a) / 2 is skipped entirely,
+ * and the members of other clusters are checked individually, in index order, to keep data accesses sequential.
+ * This costs one oracle call per existing center per step, in exchange for skipping most point-center calls.
+ * The savings are largest for expensive oracles and data of low intrinsic dimension;
+ * for cheap oracles in high dimensions, where few points can be pruned, kcenter_greedy_2approx_costs may be faster.
+ */
+template<typename Oracle, typename FT=std::decay_t<decltype(std::declval<Oracle>()(0, 0))>,
+         typename IT=std::uint32_t, typename RNG>
+auto
+kcenter_greedy_2approx_pruned_costs(Oracle &oracle, const size_t np, size_t k, RNG &rng)
+{
+    static_assert(sizeof(typename RNG::result_type) >= sizeof(IT), "IT must have the same size as the result type of the RNG");
+    static_assert(std::is_arithmetic<FT>::value, "FT must be arithmetic");
+    static constexpr size_t TASK_SIZE = 4096;
+    std::vector<IT> centers;
+    std::vector<FT> distances(np, 0.);
+    IT newc = rng() % np;
+    centers.push_back(newc);
+    OMP_PFOR
+    for(IT i = 0; i < np; ++i) {
+        if(likely(i != newc)) {
+            distances[i] = oracle(i, newc);
+        }
+    }
+    if(k == 1) return std::make_pair(centers, distances);
+    // members[a]: (D_i, i) for points whose distance was last set by centers[a], in index order
+    using MemberT = std::pair<FT, IT>;
+    std::vector<std::vector<MemberT>> members(1, std::vector<MemberT>(np));
+    OMP_PFOR
+    for(IT i = 0; i < np; ++i) members[0][i] = {distances[i], i};
+    std::vector<FT> radii{*std::max_element(distances.begin(), distances.end())};
+    std::vector<FT> ccdist;
+    std::vector<IT> owner(np); // Which cluster each point is in
+    std::vector<std::tuple<IT, size_t, size_t>> tasks;
+    std::vector<IT> touched;
+    // Once every distance is 0 (duplicate points, or k >= # distinct points), argmax can return a point
+    // which is already a center and no longer a member, which the unpruned traversal also selects again.
+    auto take_center = [&](IT c) {
+        auto &mem = members[owner[c]];
+        auto it = std::lower_bound(mem.begin(), mem.end(), c, [](const MemberT &x, IT y) {return x.second < y;});
+        if(it != mem.end() && it->second == c) mem.erase(it);
+        distances[c] = 0.;
+        centers.push_back(c);
+    };
+    take_center(reservoir_simd::argmax(distances, true));
+
+    while(centers.size() < k) {
+        const size_t nprev = centers.size() - 1;
+        newc = centers.back();
+        ccdist.resize(nprev);
+        OMP_PFOR
+        for(size_t a = 0; a < nprev; ++a)
+            ccdist[a] = oracle(centers[a], newc);
+        tasks.clear(); touched.clear();
+        for(size_t a = 0; a < nprev; ++a) {
+            if(ccdist[a] >= 2. * radii[a]) continue;
+            touched.push_back(a);
+            for(size_t s = 0; s < members[a].size(); s += TASK_SIZE)
+                tasks.emplace_back(a, s, std::min(s + TASK_SIZE, members[a].size()));
+        }
+        // Moved points are marked by setting their member distance to 0
+        OMP_PFOR_DYN
+        for(size_t t = 0; t < tasks.size(); ++t) {
+            const auto [a, s, e] = tasks[t];
+            const FT cd = ccdist[a];
+            MemberT *mp = members[a].data();
+            for(size_t j = s; j < e; ++j) {
+                const auto [ldist, i] = mp[j];
+                if(!ldist || cd >= 2. * ldist) continue;
+                const FT v = oracle(i, newc);
+                if(v < ldist) distances[i] = v, mp[j].first = 0.;
+            }
+        }
+        std::vector<MemberT> newmembers;
+        OMP_PRAGMA("omp parallel for schedule(dynamic)")
+        for(size_t ti = 0; ti < touched.size(); ++ti) {
+            auto &mem = members[touched[ti]];
+            std::vector<MemberT> out;
+            FT r = 0.;
+            auto newend = std::remove_if(mem.begin(), mem.end(), [&](const MemberT &x) {
+                if(x.first || distances[x.second] == 0.) {
+                    r = std::max(r, x.first);
+                    return false;
+                }
+                owner[x.second] = nprev;
+                out.emplace_back(distances[x.second], x.second);
+                return true;
+            });
+            mem.erase(newend, mem.end());
+            radii[touched[ti]] = r;
+            if(!out.empty()) {
+                OMP_CRITICAL
+                {
+                    newmembers.insert(newmembers.end(), out.begin(), out.end());
+                }
+            }
+        }
+        shared::sort(newmembers.begin(), newmembers.end(), [](const MemberT &x, const MemberT &y) {return x.second < y.second;});
+        FT r = 0.;
+        for(const auto &x: newmembers) r = std::max(r, x.first);
+        members.emplace_back(std::move(newmembers));
+        radii.push_back(r);
+        take_center(reservoir_simd::argmax(distances, true));
+    }
+    return std::make_pair(centers, distances);
+} // kcenter_greedy_2approx_pruned_costs
+
+template<typename Iter, typename FT=shared::ContainedTypeFromIterator<Iter>,
+         typename IT=std::uint32_t, typename RNG, typename Norm=L2Norm>
+auto
+kcenter_greedy_2approx_pruned_costs(Iter first, Iter end, RNG &rng, size_t k, const Norm &norm=Norm())
+{
+    auto dm = make_index_dm(first, norm);
+    auto oracle = [&dm](size_t i, size_t c) -> FT {return dm(c, i);};
+    return kcenter_greedy_2approx_pruned_costs<decltype(oracle), FT, IT>(oracle, end - first, k, rng);
+}
+
+template<typename...Args>
+auto
+kcenter_greedy_2approx_pruned(Args &&...args)
+{
+    return kcenter_greedy_2approx_pruned_costs(std::forward<Args>(args)...).first;
+}
+
 /*
 // Algorithm 2 from:
 // Greedy Strategy Works for k-Center Clustering with Outliers and Coreset Construction
@@ -268,6 +398,7 @@ solve_kcenter(blaze::Matrix<MT, SO> &matrix, const Norm &norm, RNG &rng, size_t
 using coresets::solve_kcenter;
 using coresets::kcenter_greedy_2approx_outliers;
 using coresets::kcenter_greedy_2approx;
+using coresets::kcenter_greedy_2approx_pruned;
 } // minicore
 
 #endif /* FGC_OPTIM_KCENTER_H__ */
@@ -12,6 +12,7 @@
 #include "minicore/optim/lsearchpp.h"
 #include "minicore/util/blaze_adaptor.h"
 #include "minicore/util/tsg.h"
+#include "minicore/util/wsample.h"
 //#include "libsimdsampling/simdsampling.h"
 #include "reservoir/include/DOGS/reservoir.h"
 #if USE_TBB
@@ -46,10 +47,80 @@ using blz::sqrL2Norm;
  */
 
 
+/*
+ * Fused evaluation of L candidate centers for greedy kmeans++.
+ * Each point is compared against all L candidates in a single pass over the data,
+ * accumulating into candcosts[l] the (weighted) cost of the solution after adding candidate l.
+ * If np x L distances fit in MAX_CANDIDATE_CACHE_BYTES, they are cached in canddists so that the winner
+ * can be applied afterwards by apply_candidate without further oracle calls; otherwise canddists is left empty
+ * and apply_candidate recomputes the winner's distances, one extra pass for that candidate alone.
+ */
+#ifndef MC_MAX_CANDIDATE_CACHE_BYTES
+#define MC_MAX_CANDIDATE_CACHE_BYTES (size_t(1) << 28)
+#endif
+static constexpr size_t MAX_CANDIDATE_CACHE_BYTES = MC_MAX_CANDIDATE_CACHE_BYTES;
+#undef MC_MAX_CANDIDATE_CACHE_BYTES
+
+template<typename Oracle, typename FT, typename IT, typename WFT>
+void evaluate_candidates(const Oracle &oracle, const IT *cands, size_t L, size_t np,
+                         const blz::DV<FT> &distances, const WFT *weights,
+                         blz::DM<FT> &canddists, double *candcosts, bool parallelize_oracle=true)
+{
+    const bool cache = np * L * sizeof(FT) <= MAX_CANDIDATE_CACHE_BYTES;
+    if(!cache) canddists.clear();
+    else if(canddists.rows() != np || canddists.columns() != L) canddists.resize(np, L);
+    std::fill_n(candcosts, L, 0.);
+    auto perform = [&](size_t j, double *lcosts) ALWAYS_INLINE {
+        const double w = weights ? double(weights[j]): 1.;
+        const FT cd = distances[j];
+        FT *const dp = cache ? canddists.data() + j * canddists.spacing(): static_cast<FT *>(nullptr);
+        for(size_t l = 0; l < L; ++l) {
+            const FT d = cands[l] == j ? FT(0): FT(oracle(cands[l], j));
+            if(dp) dp[l] = d;
+            lcosts[l] += w * std::min(d, cd);
+        }
+    };
+    if(parallelize_oracle) {
+        OMP_PRAGMA("omp parallel")
+        {
+            blz::SmallArray<double, 16> lcosts(L, 0.);
+            OMP_PRAGMA("omp for schedule(dynamic, 64)")
+            for(size_t j = 0; j < np; ++j)
+                perform(j, lcosts.data());
+            OMP_CRITICAL
+            {
+                for(size_t l = 0; l < L; ++l) candcosts[l] += lcosts[l];
+            }
+        }
+    } else {
+        for(size_t j = 0; j < np; ++j) perform(j, candcosts);
+    }
+}
+
+// Applies candidate l (index cand) from the last call to evaluate_candidates as center number center_idx.
+template<typename Oracle, typename FT, typename IT>
+void apply_candidate(const Oracle &oracle, IT cand, const blz::DM<FT> &canddists, size_t l,
+                     blz::DV<FT> &distances, std::vector<IT> &assignments, IT center_idx, bool parallelize_oracle=true)
+{
+    const size_t np = distances.size();
+    const bool cached = canddists.rows() == np;
+    auto perform = [&](size_t j) ALWAYS_INLINE {
+        const FT d = cached ? canddists(j, l): j == cand ? FT(0): FT(oracle(cand, j));
+        if(d < distances[j])
+            distances[j] = d, assignments[j] = center_idx;
+    };
+    if(parallelize_oracle || cached) {
+        OMP_PFOR
+        for(size_t j = 0; j < np; ++j) perform(j);
+    } else {
+        for(size_t j = 0; j < np; ++j) perform(j);
+    }
+}
+
 template<typename Oracle, typename FT=double,
          typename IT=std::uint32_t, typename RNG, typename WFT=FT>
 auto
-kmeanspp(const Oracle &oracle, RNG &rng, size_t np, size_t k, const WFT *weights=nullptr, size_t lspprounds=0, bool use_exponential_skips=false, bool parallelize_oracle=true, size_t n_local_samples=1)
+kmeanspp(const Oracle &oracle, RNG &rng, size_t np, size_t k, const WFT *weights=nullptr, size_t lspprounds=0, bool use_exponential_skips=false, bool parallelize_oracle=true, size_t n_local_samples=1, size_t lspp_batch=1)
 {
     const bool emit_log = false;
     if(emit_log)
@@ -59,41 +130,41 @@ kmeanspp(const Oracle &oracle, RNG &rng, size_t np, size_t k, const WFT *weights
         k = np;
     }
     std::vector<IT> centers(k, IT(0));
-    blz::DV<FT> distances(np, std::numeric_limits<FT>::max()), odists;
-    auto getcost = [&](auto &dists) {if(weights) {return dot(blz::make_cv(weights, np), dists);} return sum(dists);};
+    blz::DV<FT> distances(np, std::numeric_limits<FT>::max());
+    std::vector<IT> assignments(np, IT(0));
+    // Used for fused evaluation of candidates when n_local_samples > 1
+    blz::DM<FT> canddists;
+    std::vector<double> candcosts(n_local_samples);
+    blz::SmallArray<IT, 8> cands(n_local_samples <= 1u ? size_t(0): n_local_samples);
+    auto select_best_candidate = [&](IT center_idx) {
+        evaluate_candidates(oracle, cands.data(), n_local_samples, np, distances, weights, canddists, candcosts.data(), parallelize_oracle);
+        const size_t best = std::min_element(candcosts.begin(), candcosts.end()) - candcosts.begin();
+        VERBOSE_ONLY(std::fprintf(stderr, "Candidate %zu/%zu selected for idx %zu with cost %0.10g\n", best, n_local_samples, size_t(center_idx), candcosts[best]);)
+        apply_candidate(oracle, cands[best], canddists, best, distances, assignments, center_idx, parallelize_oracle);
+        return cands[best];
+    };
     {
         IT fc;
-        auto setdists = [&](auto &vec, auto index) {
+        if(n_local_samples > 1) {
+            for(auto &c: cands) c = rng() % np;
+            fc = select_best_candidate(IT(0));
+        } else {
+            fc = rng() % np;
             if(parallelize_oracle) {
-                vec = blaze::generate(np,[&](auto i) __attribute__((always_inline)) {
-                    if(unlikely(i == index)) return FT(0.);
-                    return FT(oracle(index, i));
+                distances = blaze::generate(np,[&](auto i) __attribute__((always_inline)) {
+                    if(unlikely(i == fc)) return FT(0.);
+                    return FT(oracle(fc, i));
                 });
             } else {
                 for(size_t i = 0; i < np; ++i) {
-                    if(i == index) vec[i] = 0.;
-                    else       vec[i] = oracle(index, i);
-                }
-            }
-        };
-        fc = rng() % np;
-        setdists(distances, fc);
-        if(n_local_samples > 1) {
-            double fcost = getcost(distances);
-            if(odists.size() != distances.size()) odists.resize(distances.size());
-            for(size_t i = 1; i < n_local_samples; ++i) {
-                const size_t ofc = rng() % np;
-                setdists(odists, ofc);
-                if(double ocost = getcost(odists);ocost < fcost) {
-                    std::swap(distances, odists);
-                    fcost = ocost; fc = ofc;
+                    if(i == fc) distances[i] = 0.;
+                    else       distances[i] = oracle(fc, i);
                 }
             }
         }
         centers[0] = fc;
         assert(distances[fc] == 0.);
     }
-    std::vector<IT> assignments(np, IT(0));
     std::uniform_real_distribution<double> urd;
     blz::DV<FT> rvals;
     // Short of re-writing the loop fully with SIMD-optimized argmin
@@ -102,10 +173,7 @@ kmeanspp(const Oracle &oracle, RNG &rng, size_t np, size_t k, const WFT *weights
     // this is as optimized as it can be.
     // At least it's all embarassingly parallelizable
     const SampleFmt fmt = use_exponential_skips ? USE_EXPONENTIAL_SKIPS: NEITHER;
-    blz::SmallArray<uint64_t, 6> samplesbuf(n_local_samples <= 1u ? size_t(0): n_local_samples);
-    blz::DV<double> samplescosts(odists.size());
-    std::vector<IT> samplesasn(odists.size()), oasn(odists.size());
-    if(odists.size()) odists = distances, oasn = assignments;
+    blz::SmallArray<uint64_t, 8> samplesbuf(n_local_samples <= 1u ? size_t(0): n_local_samples);
     for(size_t center_idx = 1;center_idx < k;) {
         //std::fprintf(stderr, "Centers size: %zu/%zu. Newest center: %u\r\n", center_idx, size_t(k), centers[center_idx - 1]);
         // At this point, the cdf has been prepared, and we are ready to sample.
@@ -113,7 +181,21 @@ kmeanspp(const Oracle &oracle, RNG &rng, size_t np, size_t k, const WFT *weights
         auto cd = centers.data(), ce = cd + center_idx;
         IT newc = std::numeric_limits<IT>::max();
         auto rngv = rng();
-        if(weights) {
+        if(!use_exponential_skips) {
+            // Weights are fused into the parallel sampling pass, so nothing n-sized is built per center
+            if(n_local_samples > 1u) {
+                util::parallel_weighted_sample_k(distances.data(), np, n_local_samples, samplesbuf.data(), rngv, weights);
+            } else if(weights) {
+                newc = util::parallel_weighted_sample(distances.data(), np, rngv, weights);
+            } else {
+                int k = 0;
+                do {
+                    newc = util::parallel_weighted_sample(distances.data(), np, rngv);
+                    if(distances[newc] > 0. && std::find(cd, ce, newc) == ce) break;
+                    rngv = rng();
+                } while(++k < 3);
+            }
+        } else if(weights) {
             auto w = blz::make_cv(weights, np);
             if constexpr(blaze::TransposeFlag_v<decltype(w)> == blaze::TransposeFlag_v<blz::DV<FT>>)
                 rvals = w * distances;
@@ -133,46 +215,12 @@ kmeanspp(const Oracle &oracle, RNG &rng, size_t np, size_t k, const WFT *weights
             } else
                 reservoir_simd::sample_k(distances.data(), np, n_local_samples, samplesbuf.data(), rngv, fmt);
         }
-        double dsum = -1.;
         if(n_local_samples > 1) {
             for(size_t i = 0; i < n_local_samples; ++i) {
-                VERBOSE_ONLY(std::fprintf(stderr, "Performing %zu sample/%zu for %zu\n", i, n_local_samples, center_idx);)
-                auto sptr = &distances;
-                auto iptr = &assignments;
-                if(i > 0) {
-                    samplescosts = odists, samplesasn = oasn;
-                    sptr = &samplescosts;
-                    iptr = &samplesasn;
-                }
-                auto nextc = samplesbuf[i];
-                if(unlikely(sptr->operator[](nextc) <= 0.)) std::fprintf(stderr, "Note: Selected item with weight 0 at index %zu [maybe there's something wrong?]\n", i);
-                double nsum = 0.;
-                if(parallelize_oracle) {
-                    OMP_PRAGMA("omp parallel for simd reduction(+:nsum)")
-                    for(size_t j = 0; j < np; ++j) {
-                        auto &v = sptr->operator[](j);
-                        if(auto newv = oracle(nextc, j);newv < v)
-                            v = newv, (*iptr)[j] = center_idx;
-                        if(weights) nsum += v * weights[j];
-                        else        nsum += v;
-                    }
-                } else {
-                    for(size_t j = 0; j < np; ++j) {
-                        auto &v = sptr->operator[](j);
-                        if(auto newv = oracle(nextc, j);newv < v)
-                            v = newv, (*iptr)[j] = center_idx;
-                    }
-                    nsum = getcost(*sptr);
-                }
-                if(dsum < 0.) {
-                    dsum = nsum, newc = nextc;
-                } else {
-                    if(nsum < dsum) {
-                        std::fprintf(stderr, "Sample %zu for idx %zu replaced cost %.10g with %0.10g\n", i, center_idx, dsum, nsum);
-                        distances = samplescosts, dsum = nsum, assignments = samplesasn, newc = nextc;
-                    } VERBOSE_ONLY(else std::fprintf(stderr, "new cost: %g. old: %g. old cost is %g better\n", nsum, dsum, dsum - nsum);)
-                }
+                cands[i] = samplesbuf[i];
+                if(unlikely(distances[cands[i]] <= 0.)) std::fprintf(stderr, "Note: Selected item with weight 0 at index %zu [maybe there's something wrong?]\n", i);
             }
+            newc = select_best_candidate(center_idx);
             centers[center_idx] = newc;
             assignments[newc] = center_idx;
         } else {
@@ -208,12 +256,81 @@ kmeanspp(const Oracle &oracle, RNG &rng, size_t np, size_t k, const WFT *weights
     if(emit_log) std::fprintf(stderr, "Completed kmeans++ with centers of size %zu\n", centers.size());
     if(lspprounds > 0) {
         if(emit_log) std::fprintf(stderr, "Performing %u rounds of ls++\n", int(lspprounds));
-        localsearchpp_rounds(oracle, rng, distances, centers, assignments, np, lspprounds, weights, parallelize_oracle);
+        localsearchpp_rounds(oracle, rng, distances, centers, assignments, np, lspprounds, weights, parallelize_oracle, lspp_batch);
     }
     //if(emit_log) std::fprintf(stderr, "returning %zu centers and %zu assignments\n", centers.size(), assignments.size());
     return std::make_tuple(std::move(centers), std::move(assignments), std::vector<FT>(distances.begin(), distances.end()));
 }
 
+/*
+ * kmeanspp_restarts
+ * Independent rounds of k-means++ seeding, one per RNG in rngs, advanced together:
+ * once every round has drawn its next center, one pass over the points updates the distances of all rounds,
+ * so each point is compared with the new centers of every round while it is in cache.
+ * Round r selects the same centers as kmeanspp(oracle, rngs[r], np, k, weights) and leaves rngs[r] in the same state.
+ * Returns one (centers, assignments, distances) tuple per round.
+ */
+template<typename Oracle, typename FT=double,
+         typename IT=std::uint32_t, typename RNG, typename WFT=FT>
+auto
+kmeanspp_restarts(const Oracle &oracle, std::vector<RNG> &rngs, size_t np, size_t k, const WFT *weights=nullptr)
+{
+    if(np < k) {
+        std::fprintf(stderr, "Warning: np (%zu) < k (%zu). Returning exactly %zu\n", np, k, np);
+        k = np;
+    }
+    const size_t nrounds = rngs.size();
+    std::vector<std::vector<IT>> centers(nrounds, std::vector<IT>(k, IT(0))), assignments(nrounds, std::vector<IT>(np, IT(0)));
+    std::vector<blz::DV<FT>> distances(nrounds, blz::DV<FT>(np));
+    std::vector<IT> newc(nrounds);
+    for(size_t r = 0; r < nrounds; ++r)
+        centers[r][0] = newc[r] = rngs[r]() % np;
+    OMP_PFOR
+    for(size_t i = 0; i < np; ++i)
+        for(size_t r = 0; r < nrounds; ++r)
+            distances[r][i] = i == newc[r] ? FT(0.): FT(oracle(newc[r], i));
+    for(size_t center_idx = 1; center_idx < k; ++center_idx) {
+        for(size_t r = 0; r < nrounds; ++r) {
+            auto &rng = rngs[r];
+            auto &dist = distances[r];
+            auto cd = centers[r].data(), ce = cd + center_idx;
+            IT c;
+            auto rngv = rng();
+            if(weights) {
+                c = util::parallel_weighted_sample(dist.data(), np, rngv, weights);
+            } else {
+                int t = 0;
+                do {
+                    c = util::parallel_weighted_sample(dist.data(), np, rngv);
+                    if(dist[c] > 0. && std::find(cd, ce, c) == ce) break;
+                    rngv = rng();
+                } while(++t < 3);
+            }
+            if(dist[c] == 0.) {
+                c = reservoir_simd::argmax(dist, /*multithead=*/true);
+                if(dist[c] == 0. && blaze::isnan(dist)) throw std::runtime_error("NAN distance found");
+            }
+            assignments[r][c] = center_idx;
+            centers[r][center_idx] = newc[r] = c;
+        }
+        OMP_PFOR_DYN
+        for(size_t i = 0; i < np; ++i) {
+            for(size_t r = 0; r < nrounds; ++r) {
+                if(i == newc[r]) continue;
+                auto &ldist = distances[r][i];
+                if(ldist <= 0.) continue;
+                if(auto dist = oracle(newc[r], i); dist < ldist) assignments[r][i] = center_idx, ldist = dist;
+            }
+        }
+        for(size_t r = 0; r < nrounds; ++r) distances[r][newc[r]] = 0.;
+    }
+    std::vector<std::tuple<std::vector<IT>, std::vector<IT>, std::vector<FT>>> ret;
+    ret.reserve(nrounds);
+    for(size_t r = 0; r < nrounds; ++r)
+        ret.emplace_back(std::move(centers[r]), std::move(assignments[r]), std::vector<FT>(distances[r].begin(), distances[r].end()));
+    return ret;
+}
+
 template<typename Iter, typename FT=double,
          typename IT=std::uint32_t, typename RNG, typename Norm=sqrL2Norm, typename WFT=FT>
 auto
@@ -224,6 +341,115 @@ kmeanspp(Iter first, Iter end, RNG &rng, size_t k, const Norm &norm=Norm(), WFT
 }
 
 
+/*
+ * k-means|| seeding
+ * Bahmani, et al. Scalable K-Means++ (2012)
+ * Available at https://arxiv.org/abs/1203.6402
+ *
+ * Each round oversamples ~ oversample * k candidates independently with probability
+ * proportional to their current (weighted) cost, then updates costs against the new candidates
+ * in a single parallel pass. After nrounds rounds (by default, ceil(log(np))),
+ * candidates are weighted by the total weight of the points nearest to them
+ * and reclustered into k centers with kmeanspp.
+ *
+ * Returns the same tuple as kmeanspp: (centers, assignments, costs), where centers index [0, np).
+ */
+template<typename Oracle, typename FT=double,
+         typename IT=std::uint32_t, typename RNG, typename WFT=FT>
+auto
+kmeans_parallel(const Oracle &oracle, RNG &rng, size_t np, size_t k, const WFT *weights=nullptr,
+                size_t nrounds=0, double oversample=2., size_t lspprounds=0, bool use_exponential_skips=false)
+{
+    if(np <= k || k <= 1)
+        return kmeanspp<Oracle, FT, IT>(oracle, rng, np, k, weights, lspprounds, use_exponential_skips);
+    if(nrounds == 0) nrounds = std::max(size_t(1), size_t(std::ceil(std::log(double(np)))));
+    const double ell = std::max(oversample, 1.) * k;
+    auto getw = [weights](size_t i) -> double {return weights ? double(weights[i]): 1.;};
+    std::vector<IT> cands{IT(rng() % np)};
+    blz::DV<FT> distances(np);
+    std::vector<IT> nearest(np, IT(0));
+    OMP_PFOR
+    for(size_t i = 0; i < np; ++i)
+        distances[i] = i == cands[0] ? FT(0): FT(oracle(cands[0], i));
+    int nt = 1;
+    OMP_ONLY(nt = omp_get_max_threads();)
+    std::vector<std::vector<IT>> tsel(nt);
+    for(size_t round = 0; round < nrounds; ++round) {
+        double phi = 0.;
+        OMP_PRAGMA("omp parallel for reduction(+:phi)")
+        for(size_t i = 0; i < np; ++i)
+            phi += getw(i) * distances[i];
+        if(phi <= 0.) break;
+        const double mul = ell / phi;
+        const uint64_t baseseed = rng();
+        static constexpr double max64inv = 1. / std::numeric_limits<uint64_t>::max();
+        for(auto &v: tsel) v.clear();
+        OMP_PFOR
+        for(size_t i = 0; i < np; ++i) {
+            const double p = mul * getw(i) * distances[i];
+            if(p <= 0.) continue;
+            uint64_t local_seed = baseseed + i;
+            wy::wyhash64_stateless(&local_seed);
+            if(local_seed * max64inv < p) {
+                int tid = 0;
+                OMP_ONLY(tid = omp_get_thread_num();)
+                tsel[tid].push_back(i);
+            }
+        }
+        const size_t firstnew = cands.size();
+        for(const auto &v: tsel) cands.insert(cands.end(), v.begin(), v.end());
+        if(cands.size() == firstnew) continue;
+        shared::sort(cands.begin() + firstnew, cands.end());
+        const IT *newp = cands.data() + firstnew;
+        const size_t nnew = cands.size() - firstnew;
+        OMP_PFOR_DYN
+        for(size_t i = 0; i < np; ++i) {
+            auto &ldist = distances[i];
+            if(ldist <= 0.) continue;
+            for(size_t j = 0; j < nnew; ++j) {
+                if(newp[j] == i) {
+                    ldist = 0., nearest[i] = firstnew + j;
+                    break;
+                }
+                if(const FT d = oracle(newp[j], i); d < ldist)
+                    ldist = d, nearest[i] = firstnew + j;
+            }
+        }
+    }
+    const size_t ncands = cands.size();
+    if(ncands <= k) {
+        std::fprintf(stderr, "[%s] Only %zu candidates selected for k = %zu; falling back to kmeans++\n", __func__, ncands, k);
+        return kmeanspp<Oracle, FT, IT>(oracle, rng, np, k, weights, lspprounds, use_exponential_skips);
+    }
+    // Weight each candidate by the points it covers
+    std::vector<double> candweights(ncands);
+    OMP_PFOR
+    for(size_t i = 0; i < np; ++i) {
+        OMP_ATOMIC
+        candweights[nearest[i]] += getw(i);
+    }
+    auto candoracle = [&](size_t i, size_t j) {return oracle(cands[i], cands[j]);};
+    auto subsol = kmeanspp<decltype(candoracle), FT, IT>(candoracle, rng, ncands, k, candweights.data(), 0, use_exponential_skips);
+    std::vector<IT> centers(k);
+    for(size_t i = 0; i < k; ++i) centers[i] = cands[std::get<0>(subsol)[i]];
+    // Final assignment against the selected centers
+    std::vector<IT> assignments(np);
+    OMP_PFOR_DYN
+    for(size_t i = 0; i < np; ++i) {
+        FT mind = std::numeric_limits<FT>::max();
+        IT mini = 0;
+        for(size_t j = 0; j < k; ++j) {
+            const FT d = centers[j] == i ? FT(0): FT(oracle(centers[j], i));
+            if(d < mind) mind = d, mini = j;
+        }
+        distances[i] = mind, assignments[i] = mini;
+    }
+    if(lspprounds > 0)
+        localsearchpp_rounds(oracle, rng, distances, centers, assignments, np, lspprounds, weights, true);
+    return std::make_tuple(std::move(centers), std::move(assignments), std::vector<FT>(distances.begin(), distances.end()));
+}
+
+
 template<typename Oracle, typename Sol, typename FT=double, typename IT=uint32_t>
 std::pair<blaze::DynamicVector<IT>, blaze::DynamicVector<FT>> get_oracle_costs(const Oracle &oracle, size_t np, const Sol &sol)
 {
@@ -649,5 +875,6 @@ auto kmeans_matrix_coreset(const blaze::Matrix<MT, SO> &mat, size_t k, RNG &rng,
 
 } // namespace coresets
 using coresets::kmeanspp;
+using coresets::kmeans_parallel;
 } // namespace minicore
 #endif // FGC_KMEANS_H__
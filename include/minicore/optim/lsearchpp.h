@@ -9,6 +9,7 @@
 #include "minicore/util/oracle.h"
 #include "minicore/util/blaze_adaptor.h"
 #include "minicore/util/exception.h"
+#include "minicore/util/wsample.h"
 //#include "libsimdsampling/simdsampling.h"
 #include "libsimdsampling/argminmax.h"
 #include "diskmat/diskmat.h"
@@ -17,9 +18,127 @@ namespace minicore {
 
 namespace coresets {
 
+namespace detail {
 
+/*
+ * Batched LocalSearch++: each batch D^2-samples B candidates at once
+ * and evaluates all B x k swaps (candidate b replaces center j) in one pass over the data.
+ *
+ * With d1/j1 a point's nearest center and d2 its second-nearest cost, and c_b its cost to candidate b,
+ * the change in cost from swapping j out for b is G_b + L_bj, where
+ *   G_b  = sum_i w_i min(c_b - d1, 0)                            (points which move to b)
+ *   L_bj = sum_{i: j1 = j} w_i (min(d2, c_b) - min(d1, c_b))      (points which lose their nearest center)
+ * so one pass accumulates B + B * k sums.
+ *
+ * Improving swaps are then taken greedily by delta, skipping any which reuse a center or a candidate.
+ * Deltas of different swaps are not additive, so if more than one swap is taken,
+ * the combined cost is computed exactly and only the best swap is applied if the combination is worse.
+ * Returns the total change in cost.
+ */
+template<typename Oracle, typename RNG, typename DistC, typename CostMat, typename CtrsC, typename WFT>
+double localsearchpp_batches(const Oracle &oracle, RNG &rng, DistC &dv, CostMat &ctrcostmat, CtrsC &ctrs, size_t np,
+                             size_t nrounds, const WFT *weights, bool parallelize, size_t batch_size)
+{
+    using value_type = blaze::ElementType_t<CostMat>;
+    using IT = std::decay_t<decltype(ctrs[0])>;
+    const size_t k = ctrs.size();
+    auto getw = [weights](size_t i) {return weights ? double(weights[i]): 1.;};
+    blz::DM<value_type> candcosts;
+    std::vector<uint64_t> cands;
+    double total_gain = 0.;
+    for(size_t round = 0; round < nrounds; round += batch_size) {
+        cands.resize(std::min(batch_size, nrounds - round));
+        util::parallel_weighted_sample_k(np, cands.size(), cands.data(), rng(), [&](size_t i) {return getw(i) * dv[i];});
+        cands.erase(std::unique(cands.begin(), cands.end()), cands.end());
+        const size_t nb = cands.size();
+        candcosts.resize(np, nb);
+        if(parallelize) {
+            candcosts = blaze::generate(np, nb, [&](auto x, auto y) {return oracle(x, IT(cands[y]));});
+        } else {
+            for(size_t i = 0; i < np; ++i)
+                for(size_t b = 0; b < nb; ++b)
+                    candcosts(i, b) = oracle(i, IT(cands[b]));
+        }
+        // Column 0 holds G_b, columns 1..k hold L_bj
+        blz::DM<double> deltas(nb, k + 1, 0.);
+        double curcost = 0.;
+        OMP_PRAGMA("omp parallel if(parallelize) reduction(+:curcost)")
+        {
+            blz::DM<double> tdeltas(nb, k + 1, 0.);
+            OMP_PRAGMA("omp for schedule(static)")
+            for(size_t i = 0; i < np; ++i) {
+                auto r = row(ctrcostmat, i, blaze::unchecked);
+                double d1 = r[0], d2 = std::numeric_limits<double>::max();
+                size_t j1 = 0;
+                for(size_t j = 1; j < k; ++j) {
+                    const double v = r[j];
+                    if(v < d1) d2 = d1, d1 = v, j1 = j;
+                    else if(v < d2) d2 = v;
+                }
+                const double w = getw(i);
+                curcost += w * d1;
+                for(size_t b = 0; b < nb; ++b) {
+                    const double nc = candcosts(i, b);
+                    tdeltas(b, 0) += w * std::min(nc - d1, 0.);
+                    tdeltas(b, j1 + 1) += w * (std::min(d2, nc) - std::min(d1, nc));
+                }
+            }
+            OMP_CRITICAL
+            {
+                deltas += tdeltas;
+            }
+        }
+        std::vector<std::tuple<double, uint32_t, uint32_t>> swaps;
+        for(size_t b = 0; b < nb; ++b)
+            for(size_t j = 0; j < k; ++j)
+                if(const double d = deltas(b, 0) + deltas(b, j + 1); d < 0.)
+                    swaps.emplace_back(d, b, j);
+        if(swaps.empty()) continue;
+        std::sort(swaps.begin(), swaps.end());
+        std::vector<std::pair<uint32_t, uint32_t>> taken{{std::get<1>(swaps[0]), std::get<2>(swaps[0])}};
+        std::vector<uint8_t> bused(nb), jused(k);
+        bused[std::get<1>(swaps[0])] = jused[std::get<2>(swaps[0])] = 1;
+        for(size_t s = 1; s < swaps.size(); ++s) {
+            const uint32_t b = std::get<1>(swaps[s]), j = std::get<2>(swaps[s]);
+            if(bused[b] || jused[j]) continue;
+            bused[b] = jused[j] = 1;
+            taken.emplace_back(b, j);
+        }
+        double delta = std::get<0>(swaps[0]);
+        if(taken.size() > 1) {
+            double newcost = 0.;
+            OMP_PRAGMA("omp parallel for if(parallelize) reduction(+:newcost)")
+            for(size_t i = 0; i < np; ++i) {
+                auto r = row(ctrcostmat, i, blaze::unchecked);
+                double m = std::numeric_limits<double>::max();
+                for(size_t j = 0; j < k; ++j) if(!jused[j]) m = std::min(m, double(r[j]));
+                for(const auto &bj: taken) m = std::min(m, double(candcosts(i, bj.first)));
+                newcost += getw(i) * m;
+            }
+            if(newcost - curcost <= delta) delta = newcost - curcost;
+            else taken.resize(1);
+        }
+        for(const auto &[b, j]: taken) {
+            DBG_ONLY(std::fprintf(stderr, "Swapping out %d for %d\n", int(ctrs[j]), int(cands[b]));)
+            ctrs[j] = cands[b];
+            column(ctrcostmat, j, blaze::unchecked) = column(candcosts, b);
+        }
+        dv = blaze::min<blaze::rowwise>(ctrcostmat);
+        total_gain += delta;
+    }
+    return total_gain;
+}
+
+} // namespace detail
+
+/*
+ * localsearchpp_rounds
+ * Performs nrounds rounds of LocalSearch++ on a seeding, updating ctrs, distances, and asn.
+ * With batch_size > 1, candidates are sampled and evaluated batch_size at a time (see detail::localsearchpp_batches),
+ * so nrounds rounds take about nrounds / batch_size passes over the data.
+ */
 template<typename Oracle, typename RNG, typename DistC, typename CtrsC, typename AsnT, typename WFT=double>
-auto localsearchpp_rounds(const Oracle &oracle, RNG &rng, DistC &distances, CtrsC &ctrs, AsnT &asn, size_t np, size_t nrounds, const WFT *weights=nullptr, bool parallelize=true) {
+auto localsearchpp_rounds(const Oracle &oracle, RNG &rng, DistC &distances, CtrsC &ctrs, AsnT &asn, size_t np, size_t nrounds, const WFT *weights=nullptr, bool parallelize=true, size_t batch_size=1) {
     using value_type = std::decay_t<decltype(*std::begin(distances))>;
     std::uniform_real_distribution<value_type> dist;
     const unsigned k = ctrs.size();
@@ -48,6 +167,10 @@ auto localsearchpp_rounds(const Oracle &oracle, RNG &rng, DistC &distances, Ctrs
     blz::DV<value_type> ctrcosts(k), newcosts(np);
     value_type gain;
     value_type total_gain = 0.;
+    if(batch_size > 1) {
+        total_gain = detail::localsearchpp_batches(oracle, rng, dv, ctrcostmat, ctrs, np, nrounds, weights, parallelize, batch_size);
+        nrounds = 0;
+    }
     for(size_t major_round = 0; major_round < nrounds; ++major_round) {
         auto seed = rng();
         long long unsigned int sel;
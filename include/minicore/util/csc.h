@@ -823,6 +823,14 @@ struct CSparseMatrix {
     using ElementType = VT;
 };
 
+template<typename T>
+struct IsCSparseMatrix: public std::false_type {};
+template<typename VT, typename IT, typename IPtrT>
+struct IsCSparseMatrix<CSparseMatrix<VT, IT, IPtrT>>: public std::true_type {};
+
+template<typename T>
+static constexpr const bool IsCSparseMatrix_v = IsCSparseMatrix<T>::value;
+
 using blaze::unchecked;
 
 template<typename VT, typename ORVT, typename IT, typename IPtr, bool TF, typename OIT=IT, typename WeightT=blz::DV<VT>, bool rowwise=true>
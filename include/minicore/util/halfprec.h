@@ -0,0 +1,187 @@
+#ifndef MINOCORE_UTIL_HALFPREC_H__
+#define MINOCORE_UTIL_HALFPREC_H__
+#include "minicore/util/blaze_adaptor.h"
+#include <cstring>
+#ifdef __F16C__
+#include <immintrin.h>
+#endif
+
+namespace minicore {
+
+namespace util {
+
+/*
+ * 16-bit storage types: IEEE 754 binary16 (float16_t) and bfloat16 (bfloat16_t, the upper half of a float).
+ * They only store values; arithmetic converts them to float, and conversion from float rounds to nearest, ties to even.
+ * binary16 conversions use F16C instructions when compiled with -mf16c (or -march supporting it).
+ */
+namespace detail {
+
+inline uint32_t f2bits(float x) {uint32_t ret; std::memcpy(&ret, &x, sizeof(ret)); return ret;}
+inline float bits2f(uint32_t x) {float ret; std::memcpy(&ret, &x, sizeof(ret)); return ret;}
+
+inline uint16_t float2fp16(float x) {
+#ifdef __F16C__
+    return _cvtss_sh(x, _MM_FROUND_TO_NEAREST_INT);
+#else
+    const uint32_t bits = f2bits(x), sign = (bits >> 16) & 0x8000u, absx = bits & 0x7FFFFFFFu;
+    if(absx >= 0x7F800000u) // Inf or NaN; NaNs stay quiet NaNs
+        return sign | 0x7C00u | (absx > 0x7F800000u ? 0x200u | ((absx >> 13) & 0x3FFu): 0u);
+    if(absx >= 0x477FF000u) return sign | 0x7C00u; // Rounds past 65504
+    if(absx < 0x38800000u) { // Below 2^-14: subnormal or zero
+        if(absx < 0x33000000u) return sign;
+        const uint32_t shift = 126 - (absx >> 23), m = (absx & 0x7FFFFFu) | 0x800000u;
+        const uint32_t rem = m & ((1u << shift) - 1), halfway = 1u << (shift - 1);
+        uint32_t ret = m >> shift;
+        ret += rem > halfway || (rem == halfway && (ret & 1u));
+        return sign | ret;
+    }
+    const uint32_t rebiased = absx - (112u << 23);
+    return sign | ((rebiased + 0xFFFu + ((rebiased >> 13) & 1u)) >> 13);
+#endif
+}
+
+inline float fp162float(uint16_t h) {
+#ifdef __F16C__
+    return _cvtsh_ss(h);
+#else
+    const uint32_t sign = uint32_t(h & 0x8000u) << 16;
+    uint32_t e = (h >> 10) & 0x1Fu, m = h & 0x3FFu;
+    if(e == 0x1Fu) return bits2f(sign | 0x7F800000u | (m << 13));
+    if(e) return bits2f(sign | ((e + 112) << 23) | (m << 13));
+    if(!m) return bits2f(sign);
+    for(e = 113; !(m & 0x400u); m <<= 1, --e); // Normalize a subnormal
+    return bits2f(sign | (e << 23) | ((m & 0x3FFu) << 13));
+#endif
+}
+
+inline uint16_t float2bf16(float x) {
+    const uint32_t bits = f2bits(x);
+    if((bits & 0x7FFFFFFFu) > 0x7F800000u) return (bits >> 16) | 0x40u; // Keep NaNs NaN
+    return (bits + 0x7FFFu + ((bits >> 16) & 1u)) >> 16;
+}
+
+inline float bf162float(uint16_t h) {return bits2f(uint32_t(h) << 16);}
+
+} // namespace detail
+
+struct float16_t {
+    uint16_t bits_;
+    float16_t() = default;
+    explicit float16_t(float x): bits_(detail::float2fp16(x)) {}
+    operator float() const {return detail::fp162float(bits_);}
+    static float16_t from_bits(uint16_t x) {float16_t ret; ret.bits_ = x; return ret;}
+};
+
+struct bfloat16_t {
+    uint16_t bits_;
+    bfloat16_t() = default;
+    explicit bfloat16_t(float x): bits_(detail::float2bf16(x)) {}
+    operator float() const {return detail::bf162float(bits_);}
+    static bfloat16_t from_bits(uint16_t x) {bfloat16_t ret; ret.bits_ = x; return ret;}
+};
+static_assert(sizeof(float16_t) == 2 && sizeof(bfloat16_t) == 2, "16-bit storage types must be 2 bytes");
+
+template<typename T> struct is_half: public std::false_type {};
+template<> struct is_half<float16_t>: public std::true_type {};
+template<> struct is_half<bfloat16_t>: public std::true_type {};
+template<typename T>
+static constexpr bool is_half_v = is_half<T>::value;
+
+// Converts n 16-bit values to float
+template<typename HT>
+inline void decode(const HT *src, float *dst, size_t n) {
+    static_assert(is_half_v<HT>, "decode requires float16_t or bfloat16_t");
+    size_t i = 0;
+#ifdef __F16C__
+    if constexpr(std::is_same_v<HT, float16_t>)
+        for(; i + 8 <= n; i += 8)
+            _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i))));
+#endif
+    for(; i < n; ++i) dst[i] = float(src[i]);
+}
+
+// Converts n float or double values to 16-bit storage
+template<typename HT, typename FT>
+inline void encode(const FT *src, HT *dst, size_t n) {
+    static_assert(is_half_v<HT>, "encode requires float16_t or bfloat16_t");
+    size_t i = 0;
+#ifdef __F16C__
+    if constexpr(std::is_same_v<HT, float16_t> && std::is_same_v<FT, float>)
+        for(; i + 8 <= n; i += 8)
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT));
+#endif
+    for(; i < n; ++i) dst[i] = HT(float(src[i]));
+}
+
+/*
+ * HalfDenseMatrix
+ * Row-major dense matrix stored as float16_t or bfloat16_t, which halves the bytes read per pass compared to float.
+ * Either views existing 16-bit data or owns a copy encoded from float or double data.
+ *
+ * row(mat, i) decodes a row into a float vector. Solvers which read each row once per pass
+ * (see clustering::perform_hard_clustering_restarts) instead call decoded_row, which decodes into a thread-local buffer,
+ * so all arithmetic is in fp32 while only 16-bit values are read from memory.
+ */
+template<typename HT>
+struct HalfDenseMatrix {
+    static_assert(is_half_v<HT>, "HalfDenseMatrix requires float16_t or bfloat16_t");
+    using ElementType = HT;
+    std::unique_ptr<HT[]> owned_;
+    const HT *data_;
+    size_t nr_, nc_;
+    HalfDenseMatrix(const HT *data, size_t nr, size_t nc): data_(data), nr_(nr), nc_(nc) {}
+    template<typename FT, typename=std::enable_if_t<std::is_floating_point_v<FT>>>
+    HalfDenseMatrix(const FT *data, size_t nr, size_t nc): owned_(new HT[nr * nc]), data_(owned_.get()), nr_(nr), nc_(nc) {
+        OMP_PFOR
+        for(size_t i = 0; i < nr; ++i)
+            encode(data + i * nc, owned_.get() + i * nc, nc);
+    }
+    size_t rows() const {return nr_;}
+    size_t columns() const {return nc_;}
+    const HT *data() const {return data_;}
+    const HT *rowptr(size_t i) const {return data_ + i * nc_;}
+    // Decodes row i into a buffer owned by the calling thread, which the next call on that thread overwrites
+    const blz::DV<float, blz::rowVector> &decoded_row(size_t i) const {
+        thread_local blz::DV<float, blz::rowVector> buf;
+        buf.resize(nc_, false);
+        decode(rowptr(i), buf.data(), nc_);
+        return buf;
+    }
+};
+
+template<typename T> struct IsHalfDenseMatrix: public std::false_type {};
+template<typename HT> struct IsHalfDenseMatrix<HalfDenseMatrix<HT>>: public std::true_type {};
+template<typename T>
+static constexpr bool IsHalfDenseMatrix_v = IsHalfDenseMatrix<T>::value;
+
+template<typename HT, bool checked>
+inline blz::DV<float, blz::rowVector> row(const HalfDenseMatrix<HT> &mat, size_t i, blaze::Check<checked>) {
+    if constexpr(checked) if(i >= mat.rows()) throw std::out_of_range("Row index out of range");
+    blz::DV<float, blz::rowVector> ret(mat.columns());
+    decode(mat.rowptr(i), ret.data(), mat.columns());
+    return ret;
+}
+template<typename HT>
+inline blz::DV<float, blz::rowVector> row(const HalfDenseMatrix<HT> &mat, size_t i) {
+    return row(mat, i, blaze::checked);
+}
+
+template<bool SO, typename HT>
+inline blz::DV<double> sum(const HalfDenseMatrix<HT> &mat) {
+    static_assert(SO == blz::rowwise, "Only row sums are supported for HalfDenseMatrix");
+    blz::DV<double> ret(mat.rows());
+    OMP_PFOR
+    for(size_t i = 0; i < mat.rows(); ++i) {
+        const HT *p = mat.rowptr(i);
+        double s = 0.;
+        for(size_t j = 0; j < mat.columns(); ++j) s += float(p[j]);
+        ret[i] = s;
+    }
+    return ret;
+}
+
+} // namespace util
+
+} // namespace minicore
+#endif /* #ifndef MINOCORE_UTIL_HALFPREC_H__ */
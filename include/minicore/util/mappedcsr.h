@@ -0,0 +1,136 @@
+#ifndef MINOCORE_UTIL_MAPPEDCSR_H__
+#define MINOCORE_UTIL_MAPPEDCSR_H__
+#include "minicore/util/csc.h"
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace minicore {
+
+namespace util {
+
+/*
+ * MappedCSparseMatrix
+ * Read-only, memory-mapped CSR matrix for data which does not fit in memory.
+ *
+ * Uses the same on-disk layout as csc2sparse: prefix + "indptr.file", "indices.file", "data.file" and "shape.file",
+ * where shape.file holds two uint32_t dimensions, (nfeatures, nsamples).
+ * A features x samples CSC matrix in this layout is a samples x features CSR matrix,
+ * so rows are samples; write_csparse_files writes a CSparseMatrix in this form.
+ *
+ * chunk(start, stop) returns a CSparseMatrix view of rows [start, stop) without copying.
+ * Its data and indices pointers refer to the full arrays, so only use it for row access.
+ * prefetch asks the kernel to read a row range ahead of use (MADV_WILLNEED), and release
+ * drops a processed range from this process's mappings (MADV_DONTNEED); the pages stay in the page cache until evicted.
+ */
+template<typename DataT=uint32_t, typename IndicesT=uint64_t, typename IndPtrT=uint64_t>
+struct MappedCSparseMatrix {
+    using ElementType = DataT;
+    using ChunkType = CSparseMatrix<DataT, IndicesT, IndPtrT>;
+    mio::mmap_source indptr_, indices_, data_;
+    size_t nr_, nc_, nnz_;
+
+    MappedCSparseMatrix(std::string prefix) {
+        const std::string indptrn = prefix + "indptr.file", indicesn = prefix + "indices.file",
+                          datan = prefix + "data.file", shapen = prefix + "shape.file";
+        for(const auto &fn: {indptrn, indicesn, datan, shapen})
+            if(!is_file(fn)) throw std::runtime_error(std::string("Missing file: ") + fn);
+        std::FILE *ifp = std::fopen(shapen.data(), "rb");
+        uint32_t dims[2];
+        const bool ok = ifp && std::fread(dims, sizeof(uint32_t), 2, ifp) == 2;
+        if(ifp) std::fclose(ifp);
+        if(!ok) throw std::runtime_error(std::string("Failed to read dims from ") + shapen);
+        nc_ = dims[0]; nr_ = dims[1];
+        std::error_code ec;
+        indptr_.map(indptrn, ec);
+        if(ec) throw std::runtime_error(std::string("Failed to map ") + indptrn + ": " + ec.message());
+        if(indptr_.size() != (nr_ + 1) * sizeof(IndPtrT))
+            throw std::runtime_error(std::string("indptr has ") + std::to_string(indptr_.size() / sizeof(IndPtrT)) + " entries, expected " + std::to_string(nr_ + 1));
+        nnz_ = indptr()[nr_];
+        if(nnz_) { // Empty files can't be mapped
+            indices_.map(indicesn, ec);
+            if(!ec) data_.map(datan, ec);
+            if(ec) throw std::runtime_error(std::string("Failed to map CSR files with prefix ") + prefix + ": " + ec.message());
+        }
+        if(indices_.size() != nnz_ * sizeof(IndicesT) || data_.size() != nnz_ * sizeof(DataT))
+            throw std::runtime_error("indices and data sizes do not match indptr");
+    }
+    size_t rows() const {return nr_;}
+    size_t columns() const {return nc_;}
+    size_t nnz() const {return nnz_;}
+    const IndPtrT *indptr() const {return reinterpret_cast<const IndPtrT *>(indptr_.data());}
+    const IndicesT *indices() const {return reinterpret_cast<const IndicesT *>(indices_.data());}
+    const DataT *data() const {return reinterpret_cast<const DataT *>(data_.data());}
+    ChunkType chunk(size_t start, size_t stop) const {
+        assert(start <= stop && stop <= nr_);
+        // CSparseMatrix takes mutable pointers, but rows of the view are only read
+        return ChunkType(const_cast<DataT *>(data()), const_cast<IndicesT *>(indices()), const_cast<IndPtrT *>(indptr()) + start,
+                         stop - start, nc_, indptr()[stop] - indptr()[start]);
+    }
+    // Entire matrix; this touches every page it reads, so prefer chunk for large files
+    ChunkType matrix() const {return chunk(0, nr_);}
+    // Bytes read from disk for rows [start, stop)
+    uint64_t bytes(size_t start, size_t stop) const {
+        return (indptr()[stop] - indptr()[start]) * (sizeof(DataT) + sizeof(IndicesT)) + (stop - start + 1) * sizeof(IndPtrT);
+    }
+    void prefetch(size_t start, size_t stop) const {advise(start, stop, MADV_WILLNEED);}
+    void release(size_t start, size_t stop) const {advise(start, stop, MADV_DONTNEED);}
+private:
+    void advise(size_t start, size_t stop, int advice) const {
+        if(start >= stop) return;
+        const size_t b = indptr()[start], e = indptr()[stop];
+        advise_range(indptr() + start, (stop - start + 1) * sizeof(IndPtrT), advice);
+        advise_range(indices() + b, (e - b) * sizeof(IndicesT), advice);
+        advise_range(data() + b, (e - b) * sizeof(DataT), advice);
+    }
+    static void advise_range(const void *p, size_t n, int advice) {
+        if(!n) return;
+        static const uintptr_t pgsz = ::sysconf(_SC_PAGESIZE);
+        const uintptr_t s = reinterpret_cast<uintptr_t>(p) & ~(pgsz - 1);
+        ::madvise(reinterpret_cast<void *>(s), reinterpret_cast<uintptr_t>(p) + n - s, advice);
+    }
+};
+
+template<typename T>
+struct IsMappedCSparseMatrix: public std::false_type {};
+template<typename DataT, typename IndicesT, typename IndPtrT>
+struct IsMappedCSparseMatrix<MappedCSparseMatrix<DataT, IndicesT, IndPtrT>>: public std::true_type {};
+template<typename T>
+static constexpr const bool IsMappedCSparseMatrix_v = IsMappedCSparseMatrix<T>::value;
+
+/*
+ * Writes mat in the layout MappedCSparseMatrix and csc2sparse read,
+ * converting data, indices and indptr to DataT, IndicesT and IndPtrT.
+ */
+template<typename DataT=uint32_t, typename IndicesT=uint64_t, typename IndPtrT=uint64_t, typename VT, typename IT, typename IPtrT>
+void write_csparse_files(const CSparseMatrix<VT, IT, IPtrT> &mat, std::string prefix) {
+    if(mat.rows() > 0xFFFFFFFFull || mat.columns() > 0xFFFFFFFFull)
+        throw std::invalid_argument("Dimensions must fit in 32 bits");
+    auto write = [&](const std::string &fn, const auto *src, size_t n, auto dest_tag) {
+        using DestT = decltype(dest_tag);
+        std::FILE *fp = std::fopen(fn.data(), "wb");
+        if(!fp) throw std::runtime_error(std::string("Failed to open ") + fn + " for writing");
+        static constexpr size_t BUFSZ = 1 << 16;
+        std::vector<DestT> buf(std::min(n, BUFSZ));
+        bool ok = true;
+        for(size_t i = 0; i < n && ok; i += BUFSZ) {
+            const size_t nw = std::min(BUFSZ, n - i);
+            std::transform(src + i, src + i + nw, buf.begin(), [](auto x) {return static_cast<DestT>(x);});
+            ok = std::fwrite(buf.data(), sizeof(DestT), nw, fp) == nw;
+        }
+        if((std::fclose(fp) != 0) || !ok) throw std::runtime_error(std::string("Failed to write ") + fn);
+    };
+    const size_t first = mat.indptr_[0], nnz = mat.indptr_[mat.rows()] - first;
+    std::vector<IPtrT> indptr(mat.indptr_, mat.indptr_ + mat.rows() + 1);
+    for(auto &x: indptr) x -= first;
+    write(prefix + "indptr.file", indptr.data(), indptr.size(), IndPtrT());
+    write(prefix + "indices.file", mat.indices_ + first, nnz, IndicesT());
+    write(prefix + "data.file", mat.data_ + first, nnz, DataT());
+    const uint32_t dims[2] {uint32_t(mat.columns()), uint32_t(mat.rows())};
+    write(prefix + "shape.file", dims, 2, uint32_t());
+}
+
+} // namespace util
+using util::MappedCSparseMatrix;
+
+} // namespace minicore
+#endif /* MINOCORE_UTIL_MAPPEDCSR_H__ */
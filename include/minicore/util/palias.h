@@ -0,0 +1,142 @@
+#ifndef MINOCORE_UTIL_PALIAS_H__
+#define MINOCORE_UTIL_PALIAS_H__
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+#include "minicore/util/macros.h"
+#include "aesctr/wy.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace minicore { namespace util {
+
+/*
+ * ParallelAliasSampler
+ * Alias table (O(1) sampling) whose construction is parallel.
+ *
+ * The table is the one the sequential sweeping construction produces, but in closed form:
+ * with weights scaled to mean 1, lights (q < 1) have deficits 1 - q and heavies excesses q - 1.
+ * Let D_i and E_j be the exclusive prefix sums of deficits over lights and of excesses over heavies, in index order.
+ *  - Light i keeps q_i and aliases to the heavy j with E_j < D_i <= E_(j+1).
+ *  - Heavy j is overdrawn by the first light whose deficit interval ends past E_(j+1), at X_j;
+ *    it keeps 1 - (X_j - E_(j+1)) and aliases to heavy j + 1. Heavies never overdrawn keep 1.
+ * Both are binary searches over the prefix sums, so after a parallel partition and scan every entry is independent.
+ */
+template<typename FT=float, typename IT=uint32_t>
+struct ParallelAliasSampler {
+    std::vector<FT> prob_;
+    std::vector<IT> alias_;
+    wy::WyRand<uint64_t, 2> rng_;
+
+    ParallelAliasSampler(): rng_(137) {}
+    template<typename It>
+    ParallelAliasSampler(It beg, It end, uint64_t seed=137): rng_(seed) {build(beg, end);}
+
+    void seed(uint64_t s) {rng_.seed(s);}
+    size_t size() const {return prob_.size();}
+    IT sample() {
+        const IT bucket = (__uint128_t(rng_()) * prob_.size()) >> 64;
+        const double u = (rng_() >> 11) * 0x1p-53;
+        return u < prob_[bucket] ? bucket: alias_[bucket];
+    }
+    template<typename OIT>
+    void sample(OIT *beg, OIT *end) {
+        while(beg != end) *beg++ = sample();
+    }
+
+    template<typename It>
+    void build(It beg, It end) {
+        const size_t n = end - beg;
+        if(!n) throw std::invalid_argument("Cannot build an alias table over 0 items");
+        prob_.resize(n);
+        alias_.resize(n);
+        double total = 0.;
+        OMP_PRAGMA("omp parallel for reduction(+:total)")
+        for(size_t i = 0; i < n; ++i) total += beg[i];
+        if(!(total > 0.)) throw std::invalid_argument("Alias table weights must have a positive sum");
+        const double scale = n / total;
+        int nt = 1;
+        OMP_ONLY(nt = std::max(1, std::min(omp_get_max_threads(), int(n / 16384)));)
+        const size_t blocksz = (n + nt - 1) / nt;
+        // Per-chunk light/heavy counts and deficit/excess sums, then their exclusive prefixes
+        std::vector<size_t> nlights(nt + 1), nheavies(nt + 1);
+        std::vector<double> dsums(nt + 1), esums(nt + 1);
+        std::vector<IT> lights, heavies;
+        std::vector<double> D, E; // D[i] (E[j]) is the deficit (excess) before light i (heavy j)
+        // Chunks are distributed with omp for, so every chunk is handled even if the team is smaller than nt (e.g., when nested)
+        OMP_PRAGMA("omp parallel num_threads(nt)")
+        {
+            OMP_PRAGMA("omp for schedule(static, 1)")
+            for(int t = 0; t < nt; ++t) {
+                const size_t start = std::min(n, t * blocksz), stop = std::min(n, start + blocksz);
+                size_t nl = 0;
+                double ds = 0., es = 0.;
+                for(size_t i = start; i < stop; ++i) {
+                    const double q = beg[i] * scale;
+                    if(q < 1.) ++nl, ds += 1. - q;
+                    else es += q - 1.;
+                }
+                nlights[t + 1] = nl; nheavies[t + 1] = (stop - start) - nl;
+                dsums[t + 1] = ds; esums[t + 1] = es;
+            }
+            OMP_PRAGMA("omp single")
+            {
+                std::partial_sum(nlights.begin(), nlights.end(), nlights.begin());
+                std::partial_sum(nheavies.begin(), nheavies.end(), nheavies.begin());
+                std::partial_sum(dsums.begin(), dsums.end(), dsums.begin());
+                std::partial_sum(esums.begin(), esums.end(), esums.begin());
+                lights.resize(nlights[nt]); heavies.resize(nheavies[nt]);
+                D.resize(nlights[nt] + 1); E.resize(nheavies[nt] + 1);
+                D.back() = dsums[nt]; E.back() = esums[nt];
+            }
+            OMP_PRAGMA("omp for schedule(static, 1)")
+            for(int t = 0; t < nt; ++t) {
+                const size_t start = std::min(n, t * blocksz), stop = std::min(n, start + blocksz);
+                size_t li = nlights[t], hi = nheavies[t];
+                double dcum = dsums[t], ecum = esums[t];
+                for(size_t i = start; i < stop; ++i) {
+                    const double q = beg[i] * scale;
+                    if(q < 1.) {
+                        lights[li] = i; D[li++] = dcum; dcum += 1. - q;
+                    } else {
+                        heavies[hi] = i; E[hi++] = ecum; ecum += q - 1.;
+                    }
+                }
+            }
+        }
+        const size_t nl = lights.size(), nh = heavies.size();
+        if(!nh) { // Only possible from rounding, with every weight ~the mean
+            OMP_PFOR
+            for(size_t i = 0; i < n; ++i) prob_[i] = 1., alias_[i] = i;
+            return;
+        }
+        OMP_PFOR
+        for(size_t i = 0; i < nl; ++i) {
+            const size_t j = std::min(size_t(std::lower_bound(E.begin() + 1, E.end(), D[i]) - (E.begin() + 1)), nh - 1);
+            prob_[lights[i]] = beg[lights[i]] * scale;
+            alias_[lights[i]] = heavies[j];
+        }
+        OMP_PFOR
+        for(size_t j = 0; j < nh; ++j) {
+            const double ej = E[j + 1];
+            const size_t li = std::upper_bound(D.begin() + 1, D.end(), ej) - (D.begin() + 1);
+            const IT h = heavies[j];
+            if(li < nl && j + 1 < nh) {
+                prob_[h] = std::max(1. - (D[li + 1] - ej), 0.);
+                alias_[h] = heavies[j + 1];
+            } else {
+                prob_[h] = 1.;
+                alias_[h] = h;
+            }
+        }
+    }
+};
+
+} // namespace util
+using util::ParallelAliasSampler;
+
+} // namespace minicore
+
+#endif /* MINOCORE_UTIL_PALIAS_H__ */
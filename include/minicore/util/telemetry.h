@@ -0,0 +1,187 @@
+#ifndef MINOCORE_UTIL_TELEMETRY_H__
+#define MINOCORE_UTIL_TELEMETRY_H__
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <numeric>
+#include <string>
+#include <vector>
+#include "minicore/util/timer.h"
+
+namespace minicore {
+namespace util {
+
+/*
+ * Telemetry
+ * Structured per-phase counters for solvers: wall time, number of times a phase was entered,
+ * distance evaluations and bytes of input touched, plus wall time and cost for each iteration.
+ *
+ * Recording is off by default. Solvers look up the active Telemetry with active_telemetry(),
+ * which is non-null only inside a TelemetryScope; when it is null, an instrumented site costs a pointer load and a branch,
+ * and no clocks are read.
+ * Recording happens on the calling thread, outside of parallel regions, so Telemetry is not synchronized.
+ */
+struct PhaseStats {
+    std::string name_;
+    double ms_ = 0.;
+    uint64_t calls_ = 0, distance_evals_ = 0, bytes_ = 0;
+    PhaseStats(std::string name): name_(std::move(name)) {}
+};
+
+struct Telemetry {
+    std::vector<PhaseStats> phases_; // In order of first use
+    std::vector<double> iteration_ms_, iteration_costs_;
+    std::chrono::time_point<hrc> last_;
+
+    PhaseStats &phase(const char *name) {
+        for(auto &p: phases_) if(p.name_ == name) return p;
+        return phases_.emplace_back(name);
+    }
+    void record(const char *name, double ms, uint64_t distance_evals=0, uint64_t bytes=0) {
+        auto &p = phase(name);
+        p.ms_ += ms;
+        ++p.calls_;
+        p.distance_evals_ += distance_evals;
+        p.bytes_ += bytes;
+    }
+    // Starts timing the first iteration
+    void mark() {last_ = hrc::now();}
+    // Ends an iteration with the given cost and starts timing the next
+    void add_iteration(double cost) {
+        auto t = hrc::now();
+        iteration_ms_.push_back(timediff2ms(last_, t));
+        iteration_costs_.push_back(cost);
+        last_ = t;
+    }
+    // Adds o's phases to this one's, with names prefixed by prefix; o's iterations are not added.
+    void merge_phases(const Telemetry &o, const std::string &prefix=std::string()) {
+        for(const auto &op: o.phases_) {
+            auto &p = phase((prefix + op.name_).data());
+            p.ms_ += op.ms_;
+            p.calls_ += op.calls_;
+            p.distance_evals_ += op.distance_evals_;
+            p.bytes_ += op.bytes_;
+        }
+    }
+    size_t iterations() const {return iteration_ms_.size();}
+    uint64_t distance_evals() const {
+        uint64_t ret = 0;
+        for(const auto &p: phases_) ret += p.distance_evals_;
+        return ret;
+    }
+    void clear() {
+        phases_.clear();
+        iteration_ms_.clear();
+        iteration_costs_.clear();
+    }
+    std::string to_json() const {
+        std::string ret = "{\"phases\": [";
+        for(size_t i = 0; i < phases_.size(); ++i) {
+            const auto &p = phases_[i];
+            if(i) ret += ", ";
+            ret += "{\"name\": \"" + escape(p.name_) + "\", \"ms\": " + num2json(p.ms_)
+                 + ", \"calls\": " + std::to_string(p.calls_)
+                 + ", \"distance_evals\": " + std::to_string(p.distance_evals_)
+                 + ", \"bytes\": " + std::to_string(p.bytes_) + "}";
+        }
+        ret += "], \"iterations\": " + std::to_string(iterations());
+        ret += ", \"distance_evals\": " + std::to_string(distance_evals());
+        ret += ", \"iteration_ms\": " + vec2json(iteration_ms_);
+        ret += ", \"iteration_costs\": " + vec2json(iteration_costs_);
+        ret += "}";
+        return ret;
+    }
+    bool write_json(const char *path) const {
+        std::FILE *fp = std::fopen(path, "w");
+        if(!fp) return false;
+        const auto s = to_json();
+        const bool ret = std::fwrite(s.data(), 1, s.size(), fp) == s.size();
+        return (std::fclose(fp) == 0) && ret;
+    }
+private:
+    static std::string num2json(double x) {
+        if(!std::isfinite(x)) return "null";
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%.17g", x);
+        return buf;
+    }
+    static std::string vec2json(const std::vector<double> &v) {
+        std::string ret = "[";
+        for(size_t i = 0; i < v.size(); ++i) {
+            if(i) ret += ", ";
+            ret += num2json(v[i]);
+        }
+        return ret + "]";
+    }
+    static std::string escape(const std::string &s) {
+        std::string ret;
+        for(const char c: s) {
+            if(c == '"' || c == '\\') ret += '\\';
+            ret += c;
+        }
+        return ret;
+    }
+};
+
+namespace detail {
+// Per thread, so that solvers running concurrently on different threads each record into their own scope
+inline Telemetry *&active_telemetry_ptr() {
+    static thread_local Telemetry *ptr = nullptr;
+    return ptr;
+}
+} // namespace detail
+
+inline Telemetry *active_telemetry() {return detail::active_telemetry_ptr();}
+
+/*
+ * TelemetryScope
+ * While alive, and if enabled, solvers called from the same thread record into this scope's Telemetry.
+ * Scopes nest; the previous one is restored on destruction.
+ */
+struct TelemetryScope {
+    Telemetry tel_;
+    Telemetry *prev_;
+    const bool enabled_;
+    TelemetryScope(bool enabled=true): prev_(active_telemetry()), enabled_(enabled) {
+        if(enabled_) detail::active_telemetry_ptr() = &tel_;
+    }
+    TelemetryScope(const TelemetryScope &) = delete;
+    TelemetryScope &operator=(const TelemetryScope &) = delete;
+    ~TelemetryScope() {
+        if(enabled_) detail::active_telemetry_ptr() = prev_;
+    }
+    Telemetry *get() {return enabled_ ? &tel_: nullptr;}
+};
+
+/*
+ * PhaseTimer
+ * Records the time between its construction and destruction (or stop()) as one call of phase name, along with the given counters,
+ * into the Telemetry active at construction. Does nothing if none is.
+ */
+struct PhaseTimer {
+    Telemetry *tel_;
+    const char *const name_;
+    const uint64_t distance_evals_, bytes_;
+    std::chrono::time_point<hrc> start_;
+    PhaseTimer(const char *name, uint64_t distance_evals=0, uint64_t bytes=0):
+        tel_(active_telemetry()), name_(name), distance_evals_(distance_evals), bytes_(bytes)
+    {
+        if(tel_) start_ = hrc::now();
+    }
+    PhaseTimer(const PhaseTimer &) = delete;
+    void stop() {
+        if(tel_) {
+            tel_->record(name_, timediff2ms(start_, hrc::now()), distance_evals_, bytes_);
+            tel_ = nullptr;
+        }
+    }
+    ~PhaseTimer() {stop();}
+};
+
+} // namespace util
+using util::Telemetry;
+using util::TelemetryScope;
+
+} // namespace minicore
+
+#endif /* MINOCORE_UTIL_TELEMETRY_H__ */
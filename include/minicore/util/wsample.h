@@ -0,0 +1,161 @@
+#ifndef MINOCORE_UTIL_WSAMPLE_H__
+#define MINOCORE_UTIL_WSAMPLE_H__
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <random>
+#include <cmath>
+#include <stdexcept>
+#include "minicore/util/macros.h"
+#include "aesctr/wy.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace minicore { namespace util {
+
+namespace detail {
+
+// Threads only pay off once each has a few thousand items to sum
+static inline int sample_nthreads(size_t n) {
+    int nt = 1;
+    OMP_ONLY(nt = std::max(1, std::min(omp_get_max_threads(), int(n / 16384)));)
+    return nt;
+}
+
+// Negative and NaN weights are never selected
+template<typename T>
+static INLINE double sample_weight(T x) {
+    const double v = x;
+    return v > 0. ? v: 0.;
+}
+
+// Per-chunk weight sums; chunk t covers [t * blocksz, min(n, (t + 1) * blocksz))
+// Chunks are distributed with omp for, so every chunk is summed even if the team is smaller than nt (e.g., when nested)
+template<typename Func>
+std::vector<double> chunk_weight_sums(size_t n, int nt, size_t blocksz, const Func &f) {
+    std::vector<double> sums(nt);
+    OMP_PRAGMA("omp parallel for num_threads(nt) schedule(static, 1)")
+    for(int t = 0; t < nt; ++t) {
+        const size_t start = std::min(n, t * blocksz), stop = std::min(n, start + blocksz);
+        double s = 0.;
+        for(size_t i = start; i < stop; ++i) s += sample_weight(f(i));
+        sums[t] = s;
+    }
+    return sums;
+}
+
+} // namespace detail
+
+/*
+ * parallel_weighted_sample
+ * Draws index i in [0, n) with probability f(i) / sum_j f(j).
+ * For weighted D^2 sampling, f(i) = w_i * d_i, so the product is fused into the pass rather than materialized.
+ *
+ * The weights of each contiguous chunk are summed in parallel, a single draw picks the chunk,
+ * and the selection is finished by a scan of that chunk alone,
+ * so the work is one parallel pass plus O(n / nthreads) serial work, with no n-sized allocation.
+ * Negative and NaN weights count as 0; if no weight is positive, returns a uniformly random index.
+ */
+template<typename Func>
+size_t parallel_weighted_sample(size_t n, uint64_t seed, const Func &f) {
+    if(!n) throw std::invalid_argument("Cannot sample from an empty range");
+    const int nt = detail::sample_nthreads(n);
+    const size_t blocksz = (n + nt - 1) / nt;
+    const std::vector<double> sums = detail::chunk_weight_sums(n, nt, blocksz, f);
+    const double total = std::accumulate(sums.begin(), sums.end(), 0.);
+    wy::WyRand<uint64_t, 2> rng(seed);
+    if(!(total > 0.)) return rng() % n;
+    double target = std::uniform_real_distribution<double>()(rng) * total;
+    // If rounding carries target past every chunk, the last chunk with positive weight is used
+    int c = -1;
+    for(int t = 0; t < nt; ++t) {
+        if(!(sums[t] > 0.)) continue;
+        c = t;
+        if(target < sums[t]) break;
+        target -= sums[t];
+    }
+    const size_t start = c * blocksz, stop = std::min(n, start + blocksz);
+    size_t last = start;
+    for(size_t i = start; i < stop; ++i) {
+        const double v = detail::sample_weight(f(i));
+        if(v > 0.) {
+            if(target < v) return i;
+            target -= v;
+            last = i;
+        }
+    }
+    return last;
+}
+
+/*
+ * parallel_weighted_sample_k
+ * Draws k indices independently (with replacement) with probability f(i) / sum_j f(j), writing them to out.
+ * The k draws are sorted, so each chunk's draws form a contiguous run, and all chunks are resolved in one parallel pass.
+ * Indices are written in increasing order.
+ */
+template<typename Func, typename OIT>
+void parallel_weighted_sample_k(size_t n, size_t k, OIT *out, uint64_t seed, const Func &f) {
+    if(!k) return;
+    if(!n) throw std::invalid_argument("Cannot sample from an empty range");
+    const int nt = detail::sample_nthreads(n);
+    const size_t blocksz = (n + nt - 1) / nt;
+    const std::vector<double> sums = detail::chunk_weight_sums(n, nt, blocksz, f);
+    std::vector<double> prefix(nt + 1);
+    std::partial_sum(sums.begin(), sums.end(), prefix.begin() + 1);
+    const double total = prefix[nt];
+    wy::WyRand<uint64_t, 2> rng(seed);
+    if(!(total > 0.)) {
+        for(size_t i = 0; i < k; ++i) out[i] = rng() % n;
+        std::sort(out, out + k);
+        return;
+    }
+    std::uniform_real_distribution<double> urd;
+    std::vector<double> targets(k);
+    for(auto &t: targets) t = urd(rng) * total;
+    std::sort(targets.begin(), targets.end());
+    // Runs of targets per chunk; the last chunk with positive weight takes any targets past the end from rounding
+    int lastpos = nt - 1;
+    while(!(sums[lastpos] > 0.)) --lastpos;
+    std::vector<size_t> tbeg(nt + 1, k);
+    for(int t = 0; t <= lastpos; ++t)
+        tbeg[t] = std::lower_bound(targets.begin(), targets.end(), prefix[t]) - targets.begin();
+    tbeg[0] = 0;
+    OMP_PRAGMA("omp parallel for num_threads(nt) schedule(dynamic)")
+    for(int t = 0; t <= lastpos; ++t) {
+        size_t tp = tbeg[t];
+        const size_t te = t == lastpos ? k: tbeg[t + 1];
+        if(tp == te) continue;
+        const size_t start = t * blocksz, stop = std::min(n, start + blocksz);
+        double cum = prefix[t];
+        size_t last = start;
+        for(size_t i = start; i < stop && tp < te; ++i) {
+            const double v = detail::sample_weight(f(i));
+            if(!(v > 0.)) continue;
+            cum += v;
+            while(tp < te && targets[tp] < cum) out[tp++] = i;
+            last = i;
+        }
+        while(tp < te) out[tp++] = last;
+    }
+}
+
+// Sampling proportional to vals[i], or to vals[i] * weights[i] if weights is non-null
+template<typename VT, typename WT=VT>
+size_t parallel_weighted_sample(const VT *vals, size_t n, uint64_t seed, const WT *weights=static_cast<const WT *>(nullptr)) {
+    if(weights) return parallel_weighted_sample(n, seed, [vals,weights](size_t i) {return double(vals[i]) * weights[i];});
+    return parallel_weighted_sample(n, seed, [vals](size_t i) {return vals[i];});
+}
+template<typename VT, typename OIT, typename WT=VT>
+void parallel_weighted_sample_k(const VT *vals, size_t n, size_t k, OIT *out, uint64_t seed, const WT *weights=static_cast<const WT *>(nullptr)) {
+    if(weights) parallel_weighted_sample_k(n, k, out, seed, [vals,weights](size_t i) {return double(vals[i]) * weights[i];});
+    else        parallel_weighted_sample_k(n, k, out, seed, [vals](size_t i) {return vals[i];});
+}
+
+} // namespace util
+using util::parallel_weighted_sample;
+using util::parallel_weighted_sample_k;
+
+} // namespace minicore
+
+#endif /* MINOCORE_UTIL_WSAMPLE_H__ */
@@ -8,6 +8,8 @@
 #include "minicore/util/Inf2Zero.h"
 
 #include "minicore/util/csc.h"
+#include "minicore/util/mappedcsr.h"
+#include "minicore/util/halfprec.h"
 
 #include "minicore/util/div.h"
 #include "minicore/util/packed.h"
@@ -17,6 +19,7 @@
 #include "minicore/util/geo.h"
 
 #include "minicore/util/timer.h"
+#include "minicore/util/telemetry.h"
 #include "minicore/util/fpq.h"
 
 #include "minicore/util/tsg.h"
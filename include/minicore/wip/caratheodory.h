@@ -1,310 +1,170 @@
 #ifndef CARATHEODORY_CORESET_H__
 #define CARATHEODORY_CORESET_H__
 #include "minicore/util/blaze_adaptor.h"
+#include "minicore/coreset/coreset.h"
 
-#if 0
-
+namespace minicore { namespace coresets {
 
 /*
-def linregcoreset(P, u, b=None, c_size=None, dtype='float64'):
-    """
-    This function computes a coreset for linear regression.
-    Input: a numpy array P containing n rows (points), each of size d, a positive vector of weights u of size n, a labels
-           vector b of size n, coreset size c_size (not required).
-    Output: a new numpy array new_P containing the coreset points in its rows and a new vector new_u of positive weights,
-            and a new vector of labels new_b for the coreset. The output satisfies for every vector x that:
-                 ||sqrt(u.transpose())*(Px-b)||^2 = ||sqrt(new_u.transpose())*(new_Px-new_b)||^2
-                 i.e., the output of a call to linearRegression with the original input or with the coreset is the same.
-    Computation time: O(nd^2+logn*d^8)
-    """
-    if b is not None:
-        P_tag = np.append(P, b, axis=1)
-    else:
-        P_tag = P
-
-    n_tag = P_tag.shape[0]; d_tag = P_tag.shape[1]
-    P_tag = P_tag.reshape(n_tag, d_tag, 1)
-
-    P_tag = np.einsum("ikj,ijk->ijk",P_tag ,P_tag)
-    P_tag = P_tag.reshape(n_tag, -1)
-    n_tag = P_tag.shape[0]; d_tag = P_tag.shape[1]
-
-    coreset_weigts = Fast_Caratheodory(P_tag.reshape(n_tag,-1), u, c_size,  dtype=dtype)
-    new_idx_array = np.nonzero(coreset_weigts)
-    coreset_weigts = coreset_weigts[new_idx_array]
-
-    if b is not None:
-        return P[new_idx_array], coreset_weigts.reshape(-1), b[new_idx_array]
-    else:
-        return P[new_idx_array], coreset_weigts.reshape(-1)
-
-
-def stream_coreset(P, u, b, folds=None, dtype='float64'):
-    """
-    This function computes a coreset for LMS solvers that use k-fold cross validation. It partitions the data into "folds"
-    parts, and computes a coreset for every part using the function linregcoreset.
-    Input: a numpy array P containing n rows (points), each of size d, a positive vector of weights u of size n, a labels
-           vector b of size n, and the number of folds used in the cross validation.
-    Output: a new numpy array new_P containing the coreset points in its rows and a new vector new_u of positive weights,
-            and a new vector of labels new_b for the coreset. The output satisfies for every vector x that:
-                 ||sqrt(u.transpose())*(Px-b)||^2 = ||sqrt(new_u.transpose())*(new_Px-new_b)||^2
-                 i.e., the output of a call to linearRegression with the original input or with the coreset is the same.
-    Computation time: O(nd^2+logn*d^8)
-    """
-    if folds is None:
-        return linregcoreset(P, u, b, dtype=dtype)
-    m = int(P.shape[0] / folds)
-
-    d = P.shape[1]
-    size_of_coreset = ((d+1)*(d+1)+1)
-
-    batches = folds
-    cc, uc, bc = linregcoreset(P[0:m], u[0:m], b[0:m], dtype=dtype)
-
-    if cc.shape[0] < size_of_coreset and folds:
-            add_z = size_of_coreset - cc.shape[0]
-            zeros = np.zeros((add_z, cc.shape[1]), dtype=dtype)
-            cc = np.concatenate((cc, zeros))
-            zeros = np.zeros((add_z), dtype=dtype)
-            uc = np.concatenate((uc, zeros))
-            zeros = np.zeros((add_z, bc.shape[1]), dtype=dtype)
-            bc = np.concatenate((bc, zeros))
-
-    for batch in range(1, batches):
-        coreset, new_u, new_b = linregcoreset(P[batch*m:(batch+1)*m], u[batch*m:(batch+1)*m], b[batch*m:(batch+1)*m], dtype=dtype)
-
-        if coreset.shape[0] < size_of_coreset and folds:
-            add_z = size_of_coreset - coreset.shape[0]
-            zeros = np.zeros((add_z, coreset.shape[1]), dtype=dtype)
-            coreset = np.concatenate((coreset, zeros))
-            zeros = np.zeros((add_z),dtype=dtype)
-            new_u = np.concatenate((new_u, zeros))
-            zeros = np.zeros((add_z, new_b.shape[1]), dtype=dtype)
-            new_b = np.concatenate((new_b, zeros))
-        bc = np.concatenate((bc, new_b))
-        cc = np.concatenate((cc, coreset))
-        uc = np.concatenate((uc, new_u))
-    return cc, uc, bc
-
-###################################################################################
-
-
-def test_model(test_data, test_labels, test_weights, clf):
-    weighted_test_data = test_data * np.sqrt(test_weights[:, np.newaxis])
-    weighted_test_labels = test_labels * np.sqrt(test_weights[:, np.newaxis])
-    score = clf.score(weighted_test_data, weighted_test_labels)
-    return score
-
-
-def train_model(data, labels, weights, clf):
-    time_start = time.time()
-    weighted_data = data * np.sqrt(weights[:, np.newaxis])
-    weighted_labels = (labels * np.sqrt(weights[:, np.newaxis])).ravel()
-    clf.fit(weighted_data, weighted_labels)
-    time_end = time.time()
-
-    return time_end - time_start, clf
-
-
-def coreset_train_model(data, labels, weights, clf, folds=None, solver='ridge'):
-    time_start = time.time()
-
-    coreset, coreset_weights, coreset_labels = stream_coreset(data, weights, labels, folds=folds)
-    weighted_coreset = coreset * np.sqrt(coreset_weights[:, np.newaxis])
-    weighted_coreset_labels = (coreset_labels * np.sqrt(coreset_weights[:, np.newaxis])).ravel()
-
-    if solver in ['lasso', 'elastic']:
-        const = np.sqrt(coreset.shape[0] / data.shape[0])
-        clf.fit(const * weighted_coreset, const * weighted_coreset_labels)
-    else:
-        clf.fit(weighted_coreset, weighted_coreset_labels)
-    time_end = time.time()
-
-    return time_end - time_start, clf
-
-
-def get_new_clf(solver, folds=3, alphas=100):
-    kf=KFold(n_splits=folds,shuffle=False)
-    if "linear" == solver:
-        clf = linear_model.LinearRegression(fit_intercept=False)
-    if "ridge" == solver:
-        alphas =  np.arange(1/alphas, 10+ 1/alphas, 10/alphas)
-        clf = linear_model.RidgeCV(alphas=alphas, fit_intercept=False, cv=kf)
-    elif "lasso" == solver:
-        clf=linear_model.LassoCV(n_alphas=alphas, fit_intercept=False, cv=kf)
-    elif "elastic" == solver:
-        clf = linear_model.ElasticNetCV(n_alphas=alphas, fit_intercept=False, cv=kf)
-    return clf
-
+ * Caratheodory coresets: at most d + 1 weighted input points with the same total weight and weighted mean as the input.
+ * fast_caratheodory is the booster from Maalouf, Jubran, and Feldman,
+ * Fast and Accurate Least-Mean-Squares Solvers (NeurIPS 2019), which takes O(nd + log(n) d^4) time.
+ */
 
-def main():
-    n = 240000
-    d = 3
-    data_range = 100
-    num_of_alphas = 300
-    folds = 3
-    data = np.floor(np.random.rand(n, d) * data_range)
-    labels = np.floor(np.random.rand(n, 1) * data_range)
-    weights = np.ones(n)
+namespace detail {
 
-    for solver in ["lasso", "ridge", "elastic"]:
-        #########RIDGE REGRESSION#############
-        clf = get_new_clf(solver, folds=folds, alphas=num_of_alphas)
-        time_coreset, clf_coreset = coreset_train_model(data, labels, weights, clf, folds=folds, solver=solver)
-        score_coreset = test_model(data, labels, weights, clf)
-
-        clf = get_new_clf(solver, folds=folds, alphas=num_of_alphas)
-        time_real, clf_real = train_model(data, labels, weights, clf)
-        score_real = test_model(data, labels, weights, clf)
-
-        print (" solver: {}\n number_of_alphas: {}, \nscore_diff = {}\n---->coef diff = {}\n---->coreset_time = {}\n---->data time = {}".format(
-            solver,
-            num_of_alphas,
-            np.abs(score_coreset - score_real),
-            np.sum(np.abs(clf_real.coef_ - clf_coreset.coef_)),
-            time_coreset,
-            time_real))
-
-def Caratheodory(P, u, dtype='float64'):
-    """
-    Implementation of the Caratheodory Theorem(1907)
-    input: a numpy array P containing n rows (points), each of size d, and a positive vector of weights u (that sums to 1)
-    output:a new vector of weights new_u that satisfies :
-                1. new_u is positive and sums to 1
-                2. new_u has at most d+1 non zero entries
-                3. the weighted sum of P and u (input) is the same as the weighted sum of P and new_u (output)
-    computation time: O(n^2d^2)
-    """
-    while 1:
-        n = np.count_nonzero(u)
-        d = P.shape[1]
-        u_non_zero = np.nonzero(u)
-
-        if n <= d + 1:
-            return u
-
-        A = P[u_non_zero]
-        reduced_vec = np.outer(A[0], np.ones(A.shape[0]-1, dtype = dtype))
-        A = A[1:].T - reduced_vec
-
-        _, _, V = np.linalg.svd(A, full_matrices=True)
-        v=V[-1]
-        v = np.insert(v, [0],   -1 * np.sum(v))
-
-        idx_good_alpha = np.nonzero(v > 0)
-        alpha = np.min(u[u_non_zero][idx_good_alpha]/v[idx_good_alpha])
-
-        w = np.zeros(u.shape[0] , dtype = dtype)
-        tmp_w = u[u_non_zero] - alpha * v
-        tmp_w[np.argmin(tmp_w)] = 0.0
-        w[u_non_zero] = tmp_w
-        w[u_non_zero][np.argmin(w[u_non_zero] )] = 0
-        u = w
+/*
+ * Finds v != 0 with sum_c v_c = 0 and sum_c v_c p_c = 0 for m > d + 1 points in d dimensions,
+ * by Gauss-Jordan elimination with partial pivoting on the (d + 1) x m row-major system M = [p_c; 1].
+ * M is overwritten.
+ */
+inline void affine_null_vector(std::vector<double> &M, size_t nrows, size_t m, std::vector<double> &v) {
+    double scale = 0.;
+    for(const auto x: M) scale = std::max(scale, std::abs(x));
+    const double tol = 1e-13 * std::max(scale, 1.);
+    std::vector<size_t> pivcols;
+    size_t freecol = m;
+    for(size_t c = 0, rank = 0; c < m; ++c) {
+        size_t piv = rank;
+        for(size_t r = rank + 1; r < nrows; ++r)
+            if(std::abs(M[r * m + c]) > std::abs(M[piv * m + c])) piv = r;
+        if(rank == nrows || std::abs(M[piv * m + c]) <= tol) {
+            if(freecol == m) freecol = c;
+            continue;
+        }
+        if(piv != rank) std::swap_ranges(&M[piv * m], &M[piv * m] + m, &M[rank * m]);
+        const double inv = 1. / M[rank * m + c];
+        for(size_t j = 0; j < m; ++j) M[rank * m + j] *= inv;
+        for(size_t r = 0; r < nrows; ++r) {
+            if(r == rank) continue;
+            const double f = M[r * m + c];
+            if(f == 0.) continue;
+            for(size_t j = 0; j < m; ++j) M[r * m + j] -= f * M[rank * m + j];
+        }
+        pivcols.push_back(c);
+        ++rank;
+    }
+    // m > nrows, so some column has no pivot
+    assert(freecol < m);
+    v.assign(m, 0.);
+    v[freecol] = 1.;
+    for(size_t i = 0; i < pivcols.size(); ++i)
+        if(pivcols[i] < freecol) v[pivcols[i]] = -M[i * m + freecol];
+}
 
-template<typename FT, bool SO=blaze::rowMajor, typename WFT>
-auto caratheodory(const blaze::DynamicMatrix<FT, SO> &mat, const WFT *weights=nullptr) {
-    // n^2d^2 time: slow. Only run on small subsets
-    blaze::DynamicVector<WFT> wv(mat.rows());
-    if(weights == nullptr)
-        wv = static_cast<WTF>(1.);
-    else std::memcpy(&wv[0], weights, sizeof(WFT) * mat.rows());
-    const size_t d = mat.coluns();
-    blaze::DynamicMatrix<FT, SO> u, v, A;
-    blaze::DynamicVector<FT> s, vv;
-    auto getnnz = [&]() {return std::accumulate(&wv[0], &wv[mat.rows()], size_t(0), [](auto x, auto y) {return x + y != 0;});};
+/*
+ * Caratheodory's theorem, by repeated elimination:
+ * while more than d + 1 weights are positive, takes d + 2 of those points, finds an affine dependence v among them,
+ * and moves the weights along v until one reaches zero. Each step preserves the total weight and the weighted sum,
+ * and costs O(d^3), so reducing m points takes O(m d^3).
+ * pt(i, j) is coordinate j of point i; w holds the m weights, which must be nonnegative, and is updated in place.
+ */
+template<typename PointFunc>
+void caratheodory_reduce(size_t m, size_t d, const PointFunc &pt, double *w) {
+    std::vector<size_t> nz;
+    std::vector<double> M, v;
+    size_t next = 0; // Points before next have already entered nz, so each point is scanned once
     for(;;) {
-        auto nnz = getnnz();
-        if(nnz <= d + 1) return wv;
-        // Get indices of nonzeros.
-        // A = A[1:].T - (np.outer(A[0], np.ones(A.shape[0] - 1)))
-        svd(A, u, s v);
-        vv.resize(row(v, 0).size() + 1);
-        subvector(vv, 1, vv.size() - 1) = row(v, v.rows() - 1);
-        vv[0] = -sum(subvector(vv, 1, row(v, 0).size()));
-        // idx_good_alpha = np.nonzero(v > 0)
-        // alpha = np.min(u[u_non_zero][idx_good_alpha]/v[idx_good_alpha])
-        // w = np.zeros(u.shape[0] , dtype = dtype)
-        // tmp_w = u[u_non_zero] - alpha * v
-        // tmp_w[np.argmin(tmp_w)] = 0.0
-        // w[u_non_zero] = tmp_w
-        // w[u_non_zero][np.argmin(w[u_non_zero] )] = 0
-        // wv = w
+        nz.erase(std::remove_if(nz.begin(), nz.end(), [w](size_t i) {return !(w[i] > 0.);}), nz.end());
+        for(; next < m && nz.size() < d + 2; ++next) if(w[next] > 0.) nz.push_back(next);
+        if(nz.size() <= d + 1) return;
+        const size_t mc = nz.size();
+        M.resize((d + 1) * mc);
+        for(size_t j = 0; j < d; ++j)
+            for(size_t c = 0; c < mc; ++c)
+                M[j * mc + c] = pt(nz[c], j);
+        std::fill(&M[d * mc], &M[d * mc] + mc, 1.);
+        affine_null_vector(M, d + 1, mc, v);
+        double alpha = std::numeric_limits<double>::max();
+        size_t amin = 0;
+        for(size_t c = 0; c < mc; ++c) {
+            if(v[c] > 0. && w[nz[c]] / v[c] < alpha) alpha = w[nz[c]] / v[c], amin = c;
+        }
+        for(size_t c = 0; c < mc; ++c)
+            w[nz[c]] = std::max(w[nz[c]] - alpha * v[c], 0.);
+        w[nz[amin]] = 0.;
     }
-    return wv; // Ultimately, do this as a sparse vector, returning indices and weights
 }
 
-def Fast_Caratheodory(P,u,coreset_size, dtype = 'float64'):
-    """
-    Our fast and accurate implementation of Caratheodory's Theorem
-    Input: a numpy array P containing n rows (points), each of size d, and a positive vector of weights u (if u does not
-    sum to 1, we first normalize u by its sum, then multiply u back by its original sum before returning it)
-    Output: a new vector of positive weights new_u that satisfies :
-                 1. new_u has at most d+1 non zero entries
-                 2. the weighted sum of P and u (input) is the same as the weighted sum of P and new_u (output)
-    Computation time: O(nd+logn*d^4)
-    """
-    d = P.shape[1]
-    n = P.shape[0]
-    m = 2*d + 2
-    if n <= d + 1:
-        return u.reshape(-1)
-
-    u_sum = np.sum(u)
-    u = u/u_sum
-    chunk_size = math.ceil(n/m)
-    current_m = math.ceil(n/chunk_size)
+} // namespace detail
 
-    add_z = chunk_size - int (n%chunk_size)
-    u = u.reshape(-1,1)
-    if add_z != chunk_size:
-        zeros = np.zeros((add_z, P.shape[1]), dtype = dtype)
-        P = np.concatenate((P, zeros))
-        zeros = np.zeros((add_z, u.shape[1]), dtype = dtype)
-        u = np.concatenate((u, zeros))
-
-    idxarray = np.array(range(P.shape[0]) )
-
-    p_groups = P.reshape(current_m, chunk_size, P.shape[1])
-    u_groups = u.reshape(current_m, chunk_size)
-    idx_group = idxarray.reshape(current_m, chunk_size)
-    u_nonzero = np.count_nonzero(u)
-
-    if not coreset_size:
-        coreset_size = d+1
-    while u_nonzero > coreset_size:
-
-        groups_means = np.einsum('ijk,ij->ik',p_groups, u_groups)
-        group_weigts = np.ones(groups_means.shape[0], dtype = dtype)*1/current_m
-
-        Cara_u_idx = Caratheodory(groups_means , group_weigts,dtype = dtype )
-
-        IDX = np.nonzero(Cara_u_idx)
-
-        new_P = p_groups[IDX].reshape(-1,d)
+/*
+ * fast_caratheodory
+ * Returns an IndexCoreset of at most d + 1 rows of mat whose weights have the same sum and weighted mean as the input.
+ * If weights is null, every row has weight 1. Weights must be nonnegative; rows with weight 0 are never selected.
+ *
+ * The active points are split into nchunks (default 2d + 2) contiguous, nonempty chunks,
+ * Caratheodory is applied to the chunk means weighted by the chunk weights,
+ * and only the chunks it keeps go to the next round, with their points' weights rescaled to match.
+ * Each round keeps at most d + 1 of 2d + 2 chunks, so the active set halves and the total work is O(nd + log(n) d^4).
+ */
+template<typename IT=uint32_t, typename FT=double, typename MatrixType, typename WT=FT>
+IndexCoreset<IT, FT> fast_caratheodory(const MatrixType &mat, const WT *weights=static_cast<const WT *>(nullptr), size_t nchunks=0) {
+    const size_t n = mat.rows(), d = mat.columns();
+    if(!nchunks) nchunks = 2 * d + 2;
+    if(nchunks < d + 2) throw std::invalid_argument("Caratheodory needs at least d + 2 chunks to make progress");
+    std::vector<IT> idx;
+    std::vector<double> w;
+    idx.reserve(n); w.reserve(n);
+    for(size_t i = 0; i < n; ++i) {
+        const double wi = weights ? double(weights[i]): 1.;
+        if(wi < 0.) throw std::invalid_argument("Caratheodory weights must be nonnegative");
+        if(wi > 0.) idx.push_back(i), w.push_back(wi);
+    }
+    std::vector<double> means, cw, newcw;
+    while(idx.size() > d + 1) {
+        const size_t np = idx.size();
+        if(np <= nchunks) {
+            detail::caratheodory_reduce(np, d, [&](size_t i, size_t j) {return double(mat(idx[i], j));}, w.data());
+        } else {
+            // Exactly nchunks >= d + 2 chunks, so that every round eliminates at least one
+            const size_t mc = nchunks;
+            auto cbeg = [np,mc](size_t c) {return c * np / mc;};
+            means.assign(mc * d, 0.);
+            cw.assign(mc, 0.);
+            OMP_PFOR
+            for(size_t c = 0; c < mc; ++c) {
+                double *const mp = &means[c * d];
+                double s = 0.;
+                for(size_t i = cbeg(c), e = cbeg(c + 1); i < e; ++i) {
+                    s += w[i];
+                    for(size_t j = 0; j < d; ++j) mp[j] += w[i] * mat(idx[i], j);
+                }
+                cw[c] = s;
+                for(size_t j = 0; j < d; ++j) mp[j] /= s;
+            }
+            newcw = cw;
+            detail::caratheodory_reduce(mc, d, [&](size_t c, size_t j) {return means[c * d + j];}, newcw.data());
+            for(size_t c = 0; c < mc; ++c) {
+                const double mul = newcw[c] / cw[c];
+                for(size_t i = cbeg(c), e = cbeg(c + 1); i < e; ++i) w[i] *= mul;
+            }
+        }
+        size_t nkeep = 0;
+        for(size_t i = 0; i < np; ++i)
+            if(w[i] > 0.) idx[nkeep] = idx[i], w[nkeep] = w[i], ++nkeep;
+        idx.resize(nkeep); w.resize(nkeep);
+    }
+    IndexCoreset<IT, FT> ret(idx.size());
+    std::copy(idx.begin(), idx.end(), ret.indices_.begin());
+    std::copy(w.begin(), w.end(), ret.weights_.begin());
+    return ret;
+}
 
-        subset_u = (current_m * u_groups[IDX] * Cara_u_idx[IDX][:, np.newaxis]).reshape(-1, 1)
-        new_idx_array = idx_group[IDX].reshape(-1,1)
-        ##############################################################################3
-        u_nonzero = np.count_nonzero(subset_u)
-        chunk_size = math.ceil(new_P.shape[0]/ m)
-        current_m = math.ceil(new_P.shape[0]/ chunk_size)
+/*
+ * caratheodory
+ * Direct reduction over all points, in O(n d^3) time; fast_caratheodory should be preferred beyond a few hundred points.
+ */
+template<typename IT=uint32_t, typename FT=double, typename MatrixType, typename WT=FT>
+IndexCoreset<IT, FT> caratheodory(const MatrixType &mat, const WT *weights=static_cast<const WT *>(nullptr)) {
+    const size_t n = mat.rows(), d = mat.columns();
+    return fast_caratheodory<IT, FT>(mat, weights, std::max(n, d + 2));
+}
 
-        add_z = chunk_size - int(new_P.shape[0] % chunk_size)
-        if add_z != chunk_size:
-            new_P = np.concatenate((new_P, np.zeros((add_z, new_P.shape[1]), dtype = dtype)))
-            subset_u = np.concatenate((subset_u, np.zeros((add_z, subset_u.shape[1]),dtype = dtype)))
-            new_idx_array = np.concatenate((new_idx_array, np.zeros((add_z, new_idx_array.shape[1]),dtype = dtype)))
-        p_groups = new_P.reshape(current_m, chunk_size, new_P.shape[1])
-        u_groups = subset_u.reshape(current_m, chunk_size)
-        idx_group = new_idx_array.reshape(current_m , chunk_size)
-        ###########################################################
+} // namespace coresets
+using coresets::fast_caratheodory;
+using coresets::caratheodory;
 
-    new_u = np.zeros(n)
-    subset_u = subset_u[(new_idx_array < n)]
-    new_idx_array = new_idx_array[(new_idx_array < n)].reshape(-1).astype(int)
-    new_u[new_idx_array] = subset_u
-    return u_sum * new_u
-*/
+} // namespace minicore
 
-#endif
 #endif /* CARATHEODORY_CORESET_H__ */
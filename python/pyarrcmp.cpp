@@ -87,12 +87,11 @@ py::object arrcmp1d2d(py::array lhs, py::array rhs, DissimilarityMeasure ms, dou
 }
 #endif
 
-py::object arrcmp2d(py::array lhs, py::array rhs, DissimilarityMeasure ms, double prior, bool reverse, int use_double, char dt) {
-    py::object ret = py::none();
+py::object arrcmp2d(py::array lhs, py::array rhs, DissimilarityMeasure ms, double prior, bool reverse, int use_double, char dt, py::object out) {
     auto lhi = lhs.request(), rhi = rhs.request();
-    if(use_double) ret = py::array_t<double>({py::ssize_t(lhi.shape[0]), py::ssize_t(rhi.shape[0])});
-    else           ret = py::array_t<float>({py::ssize_t(lhi.shape[0]), py::ssize_t(rhi.shape[0])});
-    py::buffer_info reti = py::cast<py::array>(ret).request();
+    if(lhi.shape[1] != rhi.shape[1]) throw std::invalid_argument("arrcmp requires arrays with the same number of columns");
+    py::array ret = prepare_out(out, use_double ? "d": "f", {py::ssize_t(lhi.shape[0]), py::ssize_t(rhi.shape[0])});
+    py::buffer_info reti = ret.request();
     if(dt == 'f') {
         py::array_t<float, py::array::c_style | py::array::forcecast> lhc(lhs), rhc(rhs);
         auto lbi = lhc.request(), rbi = rhc.request();
@@ -123,23 +122,25 @@ py::float_ arrcmp1d(py::array lhs, py::array rhs, DissimilarityMeasure ms, doubl
     return -1.;
 }
 
-py::object arrcmp(py::array lhs, py::array rhs, py::object msr, double prior, bool reverse, int use_double=-1) {
+py::object arrcmp(py::array lhs, py::array rhs, py::object msr, double prior, bool reverse, int use_double=-1, py::object out=py::none()) {
     auto lhi = lhs.request(), rhi = rhs.request();
     const auto ms = assure_dm(msr);
     auto lhdt = standardize_dtype(lhi.format)[0], rhdt = standardize_dtype(rhi.format)[0];
     if(lhdt != rhdt) throw std::invalid_argument("arrcmp requires objects be of the same dtype");
-    if(use_double < 0) use_double = std::max(lhi.itemsize, rhi.itemsize) > 4;
+    if(!out.is_none() && lhi.ndim != 2) throw std::invalid_argument("out is only supported for 2d inputs");
+    // A provided output buffer selects the precision unless use_double is set
+    if(use_double < 0) use_double = py::isinstance<py::array>(out) ? py::cast<py::array>(out).itemsize() == 8: std::max(lhi.itemsize, rhi.itemsize) > 4;
     if(lhi.ndim > 2 || rhi.ndim > 2) throw std::invalid_argument("arrcmp requires arrays of 1 or 2d");
     if(lhi.ndim != rhi.ndim) throw std::runtime_error("arrays should be 1d or 2d");
     auto v = ((lhi.ndim - 1) << 1) | (rhi.ndim - 1);
     switch(v) {
         case 0: return arrcmp1d(lhs, rhs, ms, prior, reverse, use_double, rhdt);
-        case 3: return arrcmp2d(lhs, rhs, ms, prior, reverse, use_double, rhdt);
+        case 3: return arrcmp2d(lhs, rhs, ms, prior, reverse, use_double, rhdt, out);
         default: throw std::runtime_error("Wrong number of dimensions");
     }
     return py::none(); // This never happens
 }
 
 void init_arrcmp(py::module &m) {
-    m.def("cmp", arrcmp, py::arg("lhs"), py::arg("rhs"), py::arg("msr") = 2, py::arg("prior") = 0., py::arg("reverse") = true, py::arg("use_double") = -1);
+    m.def("cmp", arrcmp, py::arg("lhs"), py::arg("rhs"), py::arg("msr") = 2, py::arg("prior") = 0., py::arg("reverse") = true, py::arg("use_double") = -1, py::arg("out") = py::none());
 }
@@ -6,10 +6,10 @@ void init_clustering(py::module &m) {
     m.def("hcluster", [](SparseMatrixWrapper &smw, py::object centers, double beta,
                          py::object msr, py::object weights, double eps,
                          uint64_t kmeansmaxiter, uint64_t seed, py::ssize_t mbsize, py::ssize_t ncheckins,
-                         py::ssize_t reseed_count, bool with_rep, bool use_cs) {
+                         py::ssize_t reseed_count, bool with_rep, bool use_cs, py::object out) {
                              return __py_cluster_from_centers(smw, centers, beta, msr, weights, eps, kmeansmaxiter,
                                  seed,
-                                 mbsize, ncheckins, reseed_count, with_rep, use_cs);
+                                 mbsize, ncheckins, reseed_count, with_rep, use_cs, out);
                          },
     py::arg("smw"),
     py::arg("centers"),
@@ -22,6 +22,6 @@ void init_clustering(py::module &m) {
     py::arg("mbsize") = py::ssize_t(-1),
     py::arg("ncheckins") = py::ssize_t(-1),
     py::arg("reseed_count") = py::ssize_t(5),
-    py::arg("with_rep") = false, py::arg("cs") = false,
+    py::arg("with_rep") = false, py::arg("cs") = false, py::arg("out") = py::none(),
     "Clusters a SparseMatrixWrapper object using settings and the centers provided above; set prior to < 0 for it to be 1 / ncolumns(). Performs seeding, followed by EM or minibatch k-means");
 } // init_clustering
@@ -4,9 +4,27 @@
 #include "smw.h"
 #include "pyhelpers.h"
 #include "pycsparse.h"
+#include <atomic>
 using blaze::unaligned;
 using blaze::unpadded;
 
+/*
+ * Output arrays for hcluster: out may map "costs" (float32, one per row), "asn" (uint32, one per row)
+ * and, for dense data, "centers" (k x ncolumns, of the data's dtype) to arrays to write results into; see prepare_out.
+ * Returns a dict holding every output array, allocating those not provided.
+ */
+inline py::dict prepare_hcluster_out(py::object out, size_t nr, size_t k, size_t nc, const char *ctrdtype) {
+    py::dict outd = out2dict(out, {"centers", "costs", "asn"});
+    py::dict ret;
+    ret["costs"] = prepare_out(out_entry(outd, "costs"), "f", {py::ssize_t(nr)}, "out['costs']");
+    ret["asn"] = prepare_out(out_entry(outd, "asn"), "I", {py::ssize_t(nr)}, "out['asn']");
+    if(ctrdtype)
+        ret["centers"] = prepare_out(out_entry(outd, "centers"), ctrdtype, {py::ssize_t(k), py::ssize_t(nc)}, "out['centers']");
+    else if(outd.contains("centers"))
+        throw std::invalid_argument("out['centers'] requires dense data; sparse centers are returned in CSR form");
+    return ret;
+}
+
 template<typename Matrix, typename WFT, typename CtrT, typename AsnT=blz::DV<uint32_t>, typename CostsT=blz::DV<double>>
 py::dict cpp_pycluster_from_centers(const Matrix &mat, unsigned int k, double beta,
                dist::DissimilarityMeasure measure,
@@ -20,14 +38,22 @@ py::dict cpp_pycluster_from_centers(const Matrix &mat, unsigned int k, double be
                py::ssize_t reseed_count,
                bool with_rep,
                py::ssize_t seed,
-               bool use_cs=false)
+               bool use_cs=false,
+               py::object out=py::none())
 {
     if(k != ctrs.size()) {
         throw std::invalid_argument(std::string("k ") + std::to_string(k) + "!=" + std::to_string(ctrs.size()) + ", ctrs.size()");
     }
+    const char *ctrdtype = nullptr;
+    if constexpr(blaze::IsCustom_v<Matrix>) {
+        using MET = blaze::ElementType_t<Matrix>;
+        ctrdtype = std::is_same_v<MET, double> ? "d": std::is_same_v<MET, float> ? "f": "";
+    }
+    const py::dict outs = prepare_hcluster_out(out, mat.rows(), k, mat.columns(), ctrdtype);
     using FT = double;
     blz::DV<FT> prior{FT(beta)};
     std::tuple<double, double, size_t> clusterret;
+    util::TelemetryScope telemetry(telemetry_enabled());
     if(mbsize < 0) {
         clusterret = perform_hard_clustering(mat, measure, prior, ctrs, asn, costs, weights, eps, kmeansmaxiter);
     } else {
@@ -44,9 +70,8 @@ py::dict cpp_pycluster_from_centers(const Matrix &mat, unsigned int k, double be
     py::object pyctrs;
     if constexpr(blaze::IsCustom_v<Matrix>) {
         using MET = blaze::ElementType_t<Matrix>;
-        constexpr const char *dtype_str = std::is_same_v<MET, double> ? "d": std::is_same_v<MET, float> ? "f": "";
         const size_t nd = ctrs.front().size();
-        py::array centers(py::dtype(dtype_str), std::vector<py::ssize_t>{py::ssize_t(ctrs.size()), py::ssize_t(ctrs.front().size())});
+        py::array centers = py::cast<py::array>(outs["centers"]);
         auto cbi = centers.request();
         OMP_PFOR
         for(size_t j = 0; j < ctrs.size(); ++j) {
@@ -56,12 +81,232 @@ py::dict cpp_pycluster_from_centers(const Matrix &mat, unsigned int k, double be
     } else {
         pyctrs = centers2pylist(ctrs);
     }
-    auto pycosts = vec2fnp<decltype(costs), float> (costs);
-    auto pyasn = vec2fnp<decltype(asn), uint32_t>(asn);
-    return py::dict("initcost"_a = initcost, "finalcost"_a = finalcost, "numiter"_a = numiter,
-                    "centers"_a = pyctrs, "costs"_a = pycosts, "asn"_a=pyasn);
+    py::array pycosts = py::cast<py::array>(outs["costs"]), pyasn = py::cast<py::array>(outs["asn"]);
+    std::copy(std::begin(costs), std::end(costs), (float *)pycosts.request().ptr);
+    std::copy(std::begin(asn), std::end(asn), (uint32_t *)pyasn.request().ptr);
+    py::dict ret("initcost"_a = initcost, "finalcost"_a = finalcost, "numiter"_a = numiter,
+                 "centers"_a = pyctrs, "costs"_a = pycosts, "asn"_a=pyasn);
+    if(telemetry.get()) ret["stats"] = telemetry2dict(*telemetry.get());
+    return ret;
+}
+
+/*
+ * Copies dense centers into a new (k, ncolumns) array: float64, or for 16-bit data its storage format
+ * (float16 for util::float16_t, bfloat16 bit patterns as uint16 for util::bfloat16_t).
+ */
+template<typename Matrix, typename CtrT>
+py::array centers2np(const std::vector<CtrT> &ctrs, size_t nc) {
+    using ET = blz::ElementType_t<Matrix>;
+    const std::vector<py::ssize_t> shape{py::ssize_t(ctrs.size()), py::ssize_t(nc)};
+    if constexpr(util::is_half_v<ET>) {
+        py::array ret(py::dtype(std::is_same_v<ET, util::float16_t> ? "e": "H"), shape);
+        auto ptr = (ET *)ret.request().ptr;
+        for(size_t i = 0; i < ctrs.size(); ++i) util::encode(ctrs[i].data(), ptr + i * nc, nc);
+        return ret;
+    } else {
+        py::array_t<double> ret(shape);
+        auto ptr = (double *)ret.request().ptr;
+        for(size_t i = 0; i < ctrs.size(); ++i) std::copy(ctrs[i].begin(), ctrs[i].end(), ptr + i * nc);
+        return ret;
+    }
+}
+
+/*
+ * Incrementally updates a hard clustering of the first nold rows of mat after rows are appended; see clustering::update_hard_clustering.
+ * centers is a (k, ncolumns) array of means, and asn, costs (and optionally rowsums) cover at least the first nold rows.
+ * Row sums for the old rows are recomputed if not provided; passing back the returned "rowsums" avoids this.
+ */
+template<typename Matrix>
+py::dict cpp_pycluster_update(const Matrix &mat, py::ssize_t nold, py::object centers,
+                              py::object asn, py::object costs, py::object rowsums,
+                              double beta, dist::DissimilarityMeasure measure, py::object weights,
+                              double tol, size_t maxiter)
+{
+    constexpr const int pyflags = py::array::c_style | py::array::forcecast;
+    const size_t nr = mat.rows(), nc = mat.columns();
+    if(nold < 0 || size_t(nold) > nr) throw std::invalid_argument("nold must be in [0, nrows]");
+    py::array_t<double, pyflags> ctrarr(centers);
+    auto cbi = ctrarr.request();
+    if(cbi.ndim != 2 || size_t(cbi.shape[1]) != nc) throw std::invalid_argument("centers must be a 2D array with as many columns as the data");
+    const size_t k = cbi.shape[0];
+    // Centers in the data's compute type, so that float32 data is not paired with double centers
+    using FT = std::conditional_t<(sizeof(blz::ElementType_t<Matrix>) <= 4), float, double>;
+    std::vector<blz::DV<FT, blz::rowVector>> ctrs(k);
+    for(size_t i = 0; i < k; ++i) ctrs[i] = blz::make_cv((double *)cbi.ptr + i * nc, nc);
+    py::array_t<uint32_t, pyflags> asnarr(asn);
+    py::array_t<double, pyflags> costarr(costs);
+    if(asnarr.size() < nold || costarr.size() < nold) throw std::invalid_argument("asn and costs must cover the first nold rows");
+    blz::DV<uint32_t> asnv = blz::make_cv((uint32_t *)asnarr.request().ptr, nold);
+    blz::DV<double> costv = blz::make_cv((double *)costarr.request().ptr, nold), rsums(nold);
+    if(rowsums.is_none()) {
+        OMP_PFOR
+        for(py::ssize_t i = 0; i < nold; ++i) rsums[i] = sum(row(mat, i, blz::unchecked));
+    } else {
+        py::array_t<double, pyflags> rsarr(rowsums);
+        if(rsarr.size() < nold) throw std::invalid_argument("rowsums must cover the first nold rows");
+        rsums = blz::make_cv((double *)rsarr.request().ptr, nold);
+    }
+    std::unique_ptr<blz::DV<double>> wv;
+    if(!weights.is_none()) {
+        py::array_t<double, pyflags> warr(weights);
+        if(size_t(warr.size()) != nr) throw std::invalid_argument("weights must have one entry per row");
+        wv.reset(new blz::DV<double>(blz::make_cv((double *)warr.request().ptr, nr)));
+    }
+    blz::DV<double> prior{beta};
+    util::TelemetryScope telemetry(telemetry_enabled());
+    auto [initcost, finalcost, numiter] = update_hard_clustering(mat, nold, measure, prior, ctrs, asnv, costv, rsums, wv.get(), tol, maxiter);
+    py::array pyctrs = centers2np<Matrix>(ctrs, nc);
+    py::dict ret("initcost"_a = initcost, "finalcost"_a = finalcost, "numiter"_a = numiter,
+                 "centers"_a = pyctrs, "costs"_a = vec2fnp<decltype(costv), double>(costv), "asn"_a = vec2fnp<decltype(asnv), uint32_t>(asnv),
+                 "rowsums"_a = vec2fnp<decltype(rsums), double>(rsums));
+    if(telemetry.get()) ret["stats"] = telemetry2dict(*telemetry.get());
+    return ret;
 }
 
+/*
+ * Seeding oracle over the rows of mat: oracle(x, y) is the cost of row y against row x as a center.
+ * For 16-bit data, row y is decoded into the calling thread's buffer (HalfDenseMatrix::decoded_row) and row x into a second
+ * per-thread buffer, which is only refilled when x changes; seeding compares every row against each new center in turn,
+ * so each thread decodes a center once rather than allocating and decoding two rows per call.
+ */
+template<typename FT, typename Matrix>
+auto make_seeding_oracle(const Matrix &mat, dist::DissimilarityMeasure measure, const blz::DV<double> &prior, double psum, const blz::DV<double> &rsums) {
+    if constexpr(util::IsHalfDenseMatrix_v<Matrix>) {
+        // Tags this oracle's cached centers, so that another oracle's (possibly for a different matrix) are never reused
+        static std::atomic<uint64_t> ngen{0};
+        const uint64_t gen = ++ngen;
+        return [&mat, measure, &prior, psum, &rsums, gen](size_t xi, size_t yi) {
+            thread_local blz::DV<float, blz::rowVector> ctr;
+            thread_local uint64_t ctrgen = 0;
+            thread_local size_t ctrid = 0;
+            if(ctrgen != gen || ctrid != xi) {
+                ctr.resize(mat.columns(), false);
+                util::decode(mat.rowptr(xi), ctr.data(), mat.columns());
+                ctrgen = gen, ctrid = xi;
+            }
+            return cmp::msr_with_prior<FT>(measure, mat.decoded_row(yi), ctr, prior, psum, rsums[yi], rsums[xi]);
+        };
+    } else {
+        return [&mat, measure, &prior, psum, &rsums](size_t xi, size_t yi) {
+            return cmp::msr_with_prior<FT>(measure, row(mat, yi, blz::unchecked), row(mat, xi, blz::unchecked), prior, psum, rsums[yi], rsums[xi]);
+        };
+    }
+}
+
+/*
+ * Seeds nrestarts solutions by k-means++ and runs Lloyd's algorithm on all of them, sharing passes over mat;
+ * see clustering::kmeanspp_restarts and clustering::perform_hard_clustering_restarts.
+ * Restart r is seeded with seed + r, and the best final solution is returned along with every restart's costs.
+ */
+template<typename Matrix>
+py::dict cpp_pycluster_restarts(const Matrix &mat, unsigned k, py::ssize_t nrestarts, double beta,
+                                dist::DissimilarityMeasure measure, py::object weights,
+                                uint64_t seed, double eps, size_t maxiter)
+{
+    constexpr const int pyflags = py::array::c_style | py::array::forcecast;
+    const size_t nr = mat.rows(), nc = mat.columns();
+    if(nrestarts < 1) throw std::invalid_argument("nrestarts must be at least 1");
+    if(k < 1 || k > nr) throw std::invalid_argument("k must be in [1, nrows]");
+    if(beta < 0.) beta = 1. / nc;
+    std::unique_ptr<blz::DV<double>> wv;
+    if(!weights.is_none()) {
+        py::array_t<double, pyflags> warr(weights);
+        if(size_t(warr.size()) != nr) throw std::invalid_argument("weights must have one entry per row");
+        wv.reset(new blz::DV<double>(blz::make_cv((double *)warr.request().ptr, nr)));
+    }
+    const blz::DV<double> prior{beta};
+    const double psum = beta * nc;
+    const blz::DV<double> rsums = sum<blz::rowwise>(mat);
+    using FT = std::conditional_t<(sizeof(blz::ElementType_t<Matrix>) <= 4), float, double>;
+    auto oracle = make_seeding_oracle<FT>(mat, measure, prior, psum, rsums);
+    util::TelemetryScope telemetry(telemetry_enabled());
+    std::vector<wy::WyRand<uint64_t>> rngs;
+    for(py::ssize_t r = 0; r < nrestarts; ++r) rngs.emplace_back(seed + r);
+    const double *wptr = wv ? wv->data(): static_cast<double *>(nullptr);
+    auto seeds = kmeanspp_restarts(oracle, rngs, nr, k, wptr);
+    std::vector<std::vector<blz::DV<FT, blz::rowVector>>> ctrs(nrestarts);
+    for(py::ssize_t r = 0; r < nrestarts; ++r)
+        for(const auto id: std::get<0>(seeds[r]))
+            ctrs[r].emplace_back(row(mat, id, blz::unchecked));
+    std::vector<blz::DV<uint32_t>> asns;
+    std::vector<blz::DV<double>> costs;
+    auto [best, res] = perform_hard_clustering_restarts(mat, measure, prior, ctrs, asns, costs, wv.get(), eps, maxiter);
+    py::array pyctrs = centers2np<Matrix>(ctrs[best], nc);
+    py::array_t<double> rcosts(nrestarts);
+    auto rcp = (double *)rcosts.request().ptr;
+    for(py::ssize_t r = 0; r < nrestarts; ++r) rcp[r] = std::get<1>(res[r]);
+    auto [initcost, finalcost, numiter] = res[best];
+    py::dict ret("initcost"_a = initcost, "finalcost"_a = finalcost, "numiter"_a = numiter,
+                 "centers"_a = pyctrs, "costs"_a = vec2fnp<blz::DV<double>, double>(costs[best]), "asn"_a = vec2fnp<blz::DV<uint32_t>, uint32_t>(asns[best]),
+                 "best"_a = best, "restart_costs"_a = rcosts);
+    if(telemetry.get()) ret["stats"] = telemetry2dict(*telemetry.get());
+    return ret;
+}
+
+/*
+ * Seeds max(ks) centers once, by k-means++ or (if use_kmeans_parallel) k-means||, and clusters with the first k of them
+ * for every k in ks, sharing passes over mat; see clustering::perform_hard_clustering_ksweep.
+ * Returns the cost curve ("finalcost", in the order of ks) along with each k's centers, assignments and costs.
+ */
+template<typename Matrix>
+py::dict cpp_pycluster_ksweep(const Matrix &mat, py::object pyks, double beta,
+                              dist::DissimilarityMeasure measure, py::object weights,
+                              uint64_t seed, double eps, size_t maxiter,
+                              bool use_kmeans_parallel, py::ssize_t kmpar_rounds, double oversample)
+{
+    constexpr const int pyflags = py::array::c_style | py::array::forcecast;
+    const size_t nr = mat.rows(), nc = mat.columns();
+    py::array_t<int64_t, pyflags> ksarr(pyks);
+    if(ksarr.ndim() != 1 || ksarr.size() == 0) throw std::invalid_argument("ks must be a nonempty 1D sequence of integers");
+    std::vector<size_t> ks;
+    for(py::ssize_t i = 0; i < ksarr.size(); ++i) {
+        const int64_t k = ksarr.at(i);
+        if(k < 1 || size_t(k) > nr) throw std::invalid_argument("Each k must be in [1, nrows]");
+        ks.push_back(k);
+    }
+    const size_t kmax = *std::max_element(ks.begin(), ks.end());
+    if(beta < 0.) beta = 1. / nc;
+    std::unique_ptr<blz::DV<double>> wv;
+    if(!weights.is_none()) {
+        py::array_t<double, pyflags> warr(weights);
+        if(size_t(warr.size()) != nr) throw std::invalid_argument("weights must have one entry per row");
+        wv.reset(new blz::DV<double>(blz::make_cv((double *)warr.request().ptr, nr)));
+    }
+    const blz::DV<double> prior{beta};
+    const double psum = beta * nc;
+    const blz::DV<double> rsums = sum<blz::rowwise>(mat);
+    using FT = std::conditional_t<(sizeof(blz::ElementType_t<Matrix>) <= 4), float, double>;
+    auto oracle = make_seeding_oracle<FT>(mat, measure, prior, psum, rsums);
+    util::TelemetryScope telemetry(telemetry_enabled());
+    wy::WyRand<uint64_t> rng(seed);
+    const double *wptr = wv ? wv->data(): static_cast<double *>(nullptr);
+    auto ids = use_kmeans_parallel ? std::get<0>(kmeans_parallel(oracle, rng, nr, kmax, wptr, std::max(kmpar_rounds, py::ssize_t(0)), oversample))
+                                   : std::get<0>(kmeanspp(oracle, rng, nr, kmax, wptr));
+    std::vector<blz::DV<FT, blz::rowVector>> seeds;
+    for(const auto id: ids) seeds.emplace_back(row(mat, id, blz::unchecked));
+    std::vector<std::vector<blz::DV<FT, blz::rowVector>>> ctrs;
+    std::vector<blz::DV<uint32_t>> asns;
+    std::vector<blz::DV<double>> costs;
+    auto res = perform_hard_clustering_ksweep(mat, measure, prior, seeds, ks, ctrs, asns, costs, wv.get(), eps, maxiter);
+    const py::ssize_t nk = ks.size();
+    std::vector<double> initcosts(nk), finalcosts(nk);
+    std::vector<size_t> numiters(nk);
+    py::list pyctrs, pyasns, pycosts;
+    for(py::ssize_t i = 0; i < nk; ++i) {
+        std::tie(initcosts[i], finalcosts[i], numiters[i]) = res[i];
+        pyctrs.append(centers2np<Matrix>(ctrs[i], nc));
+        pyasns.append(vec2fnp<blz::DV<uint32_t>, uint32_t>(asns[i]));
+        pycosts.append(vec2fnp<blz::DV<double>, double>(costs[i]));
+    }
+    py::dict ret("ks"_a = vec2fnp<std::vector<size_t>, uint64_t>(ks),
+                 "initcost"_a = vec2fnp<std::vector<double>, double>(initcosts), "finalcost"_a = vec2fnp<std::vector<double>, double>(finalcosts),
+                 "numiter"_a = vec2fnp<std::vector<size_t>, uint64_t>(numiters), "seeds"_a = vec2fnp<decltype(ids), uint32_t>(ids),
+                 "centers"_a = pyctrs, "asn"_a = pyasns, "costs"_a = pycosts);
+    if(telemetry.get()) ret["stats"] = telemetry2dict(*telemetry.get());
+    return ret;
+}
+
+
 template<typename Matrix, typename WFT, typename CtrT, typename AsnT=blz::DV<uint32_t>, typename CostsT=blz::DV<double>>
 py::dict cpp_pycluster_from_centers_base(const Matrix &mat, unsigned int k, double beta,
                dist::DissimilarityMeasure measure,
@@ -75,10 +320,11 @@ py::dict cpp_pycluster_from_centers_base(const Matrix &mat, unsigned int k, doub
                py::ssize_t reseed_count,
                bool with_rep,
                py::ssize_t seed,
-               bool use_cs=true)
+               bool use_cs=true,
+               py::object out=py::none())
 {
     py::dict ret;
-    mat.perform([&](auto &x) {ret = cpp_pycluster_from_centers(x, k, beta, measure, ctrs, asn, costs, weights, eps, kmeansmaxiter, mbsize, ncheckins, reseed_count, with_rep, seed, use_cs);});
+    mat.perform([&](auto &x) {ret = cpp_pycluster_from_centers(x, k, beta, measure, ctrs, asn, costs, weights, eps, kmeansmaxiter, mbsize, ncheckins, reseed_count, with_rep, seed, use_cs, out);});
     return ret;
 }
 
@@ -146,13 +392,14 @@ py::object __py_cluster_from_centers(const Matrix &smw,
                     //size_t kmcrounds, int ntimes, int lspprounds,
                     uint64_t seed,
                     py::ssize_t mbsize, py::ssize_t ncheckins,
-                    py::ssize_t reseed_count, bool with_rep, bool use_cs=false)
+                    py::ssize_t reseed_count, bool with_rep, bool use_cs=false, py::object out=py::none())
 {
     blz::DV<double> prior{double(beta)};
     const dist::DissimilarityMeasure measure = assure_dm(msr);
     std::vector<blz::CompressedVector<float, blz::rowVector>> dvecs;
     smw.perform([&dvecs,&centers](const auto &mat) {dvecs = obj2dvec(centers, mat);});
     const unsigned long long k = dvecs.size();
+    const py::dict outs = prepare_hcluster_out(out, smw.rows(), k, smw.columns(), nullptr);
     blz::DV<uint32_t> asn(smw.rows());
     if(k > 0xFFFFFFFFull) throw std::invalid_argument("k must be < 4.3 billion to fit into a uint32_t");
     const auto psum = beta * smw.columns();
@@ -201,7 +448,7 @@ py::object __py_cluster_from_centers(const Matrix &smw,
         dcv.reset(new blaze::CustomVector<double, blz::unaligned, blz::unpadded>(bwptr, costs.size()));
     }
     // Only compile 1 version: double weights, which can take a nullable weight container
-    return cpp_pycluster_from_centers_base(smw, k, beta, measure, dvecs, asn, costs, dcv.get(), eps, kmeansmaxiter, mbsize, ncheckins, reseed_count, with_rep, seed, use_cs);
+    return cpp_pycluster_from_centers_base(smw, k, beta, measure, dvecs, asn, costs, dcv.get(), eps, kmeansmaxiter, mbsize, ncheckins, reseed_count, with_rep, seed, use_cs, outs);
 }
 
 
@@ -7,11 +7,11 @@ void init_clustering_csr(py::module &m) {
                     uint64_t kmeansmaxiter,
                     uint64_t seed,
                     py::ssize_t mbsize, py::ssize_t ncheckins,
-                    py::ssize_t reseed_count, bool with_rep, bool use_cs) -> py::object
+                    py::ssize_t reseed_count, bool with_rep, bool use_cs, py::object out) -> py::object
     {
         return __py_cluster_from_centers(smw, centers, beta, msr, weights, eps, kmeansmaxiter,
                 seed,
-                mbsize, ncheckins, reseed_count, with_rep, use_cs);
+                mbsize, ncheckins, reseed_count, with_rep, use_cs, out);
     },
     py::arg("smw"),
     py::arg("centers"),
@@ -25,8 +25,67 @@ void init_clustering_csr(py::module &m) {
     py::arg("ncheckins") = py::ssize_t(-1),
     py::arg("reseed_count") = py::ssize_t(5),
     py::arg("with_rep") = false,
-    py::arg("cs") = false
+    py::arg("cs") = false,
+    py::arg("out") = py::none()
     );
 
+    m.def("hcluster_update", [](const PyCSparseMatrix &smw, py::ssize_t nold, py::object centers, py::object asn, py::object costs,
+                                py::object rowsums, double beta, py::object msr, py::object weights, double tol, uint64_t maxiter) {
+        const dist::DissimilarityMeasure measure = assure_dm(msr);
+        py::dict ret;
+        smw.perform([&](auto &mat) {ret = cpp_pycluster_update(mat, nold, centers, asn, costs, rowsums, beta, measure, weights, tol, maxiter);});
+        return ret;
+    },
+    py::arg("smw"),
+    py::arg("nold"),
+    py::arg("centers"),
+    py::arg("asn"),
+    py::arg("costs"),
+    py::arg("rowsums") = py::none(),
+    py::arg("prior") = 0.,
+    py::arg("msr") = 2,
+    py::arg("weights") = py::none(),
+    py::arg("tol") = clustering::DEFAULT_INCREMENTAL_TOL,
+    py::arg("maxiter") = 5,
+    "Updates a hard clustering of the first nold rows of a CSR matrix after rows were appended; see the dense hcluster_update.");
+
+    m.def("hcluster_restarts", [](const PyCSparseMatrix &smw, unsigned k, py::ssize_t nrestarts, double beta, py::object msr,
+                                  py::object weights, uint64_t seed, uint64_t maxiter, double eps) {
+        const dist::DissimilarityMeasure measure = assure_dm(msr);
+        py::dict ret;
+        smw.perform([&](auto &mat) {ret = cpp_pycluster_restarts(mat, k, nrestarts, beta, measure, weights, seed, eps, maxiter);});
+        return ret;
+    },
+    py::arg("smw"),
+    py::arg("k"),
+    py::arg("nrestarts") = 10,
+    py::arg("prior") = 0.,
+    py::arg("msr") = 2,
+    py::arg("weights") = py::none(),
+    py::arg("seed") = 0,
+    py::arg("maxiter") = 100,
+    py::arg("eps") = 1e-10,
+    "Multi-restart hard clustering of a CSR matrix, sharing passes over the data among restarts; see the dense hcluster_restarts.");
+
+    m.def("hcluster_ksweep", [](const PyCSparseMatrix &smw, py::object ks, double beta, py::object msr, py::object weights,
+                                uint64_t seed, uint64_t maxiter, double eps, bool use_kmeans_parallel, py::ssize_t kmpar_rounds, double oversample) {
+        const dist::DissimilarityMeasure measure = assure_dm(msr);
+        py::dict ret;
+        smw.perform([&](auto &mat) {ret = cpp_pycluster_ksweep(mat, ks, beta, measure, weights, seed, eps, maxiter, use_kmeans_parallel, kmpar_rounds, oversample);});
+        return ret;
+    },
+    py::arg("smw"),
+    py::arg("ks"),
+    py::arg("prior") = 0.,
+    py::arg("msr") = 2,
+    py::arg("weights") = py::none(),
+    py::arg("seed") = 0,
+    py::arg("maxiter") = 100,
+    py::arg("eps") = 1e-10,
+    py::arg("kmeans_parallel") = false,
+    py::arg("kmpar_rounds") = 0,
+    py::arg("oversample") = 2.,
+    "Clustering of a CSR matrix for every k in ks from one seeding, sharing passes over the data; see the dense hcluster_ksweep.");
+
 #endif
 } // init_clustering_csr
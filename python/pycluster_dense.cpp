@@ -9,7 +9,7 @@ py::object __py_cluster_from_centers_dense(py::array_t<FT, py::array::c_style |
                     //size_t kmcrounds, int ntimes, int lspprounds,
                     uint64_t seed,
                     py::ssize_t mbsize, py::ssize_t ncheckins,
-                    py::ssize_t reseed_count, bool with_rep, bool use_cs=false)
+                    py::ssize_t reseed_count, bool with_rep, bool use_cs=false, py::object out=py::none())
 {
     blz::DV<double> prior{double(beta)};
     const dist::DissimilarityMeasure measure = assure_dm(msr);
@@ -19,6 +19,7 @@ py::object __py_cluster_from_centers_dense(py::array_t<FT, py::array::c_style |
     std::vector<blz::DynamicVector<FT, blz::rowVector>> dvecs = obj2dvec(centers, py::cast<py::array_t<FT, py::array::c_style | py::array::forcecast>>(dataset));
 
     const auto k = dvecs.size();
+    const py::dict outs = prepare_hcluster_out(out, nr, k, nc, std::is_same_v<FT, double> ? "d": "f");
     blz::DV<uint32_t> asn(nr);
     if(k > 0xFFFFFFFFull) throw std::invalid_argument("k must be < 4.3 billion to fit into a uint32_t");
     const auto psum = beta * nc;
@@ -61,7 +62,90 @@ py::object __py_cluster_from_centers_dense(py::array_t<FT, py::array::c_style |
     }
     // Only compile 1 version: double weights, which can take a nullable weight container
     auto dmat = blaze::CustomMatrix<FT, blz::unaligned, blz::unpadded>((FT *)dbi.ptr, nr, nc);
-    return cpp_pycluster_from_centers(dmat, k, beta, measure, dvecs, asn, costs, dcv.get(), eps, kmeansmaxiter, mbsize, ncheckins, reseed_count, with_rep, seed, use_cs);
+    return cpp_pycluster_from_centers(dmat, k, beta, measure, dvecs, asn, costs, dcv.get(), eps, kmeansmaxiter, mbsize, ncheckins, reseed_count, with_rep, seed, use_cs, outs);
+}
+
+/*
+ * Dense data in 16-bit storage (util::HalfDenseMatrix). float16 arrays are used in place for float16_t,
+ * as are uint16 arrays (holding bfloat16 bit patterns) for bfloat16_t; other arrays are encoded once.
+ * A view refers to dataset's buffer, which must outlive it.
+ */
+template<typename HT>
+util::HalfDenseMatrix<HT> py2half(py::array dataset) {
+    constexpr const int pyflags = py::array::c_style | py::array::forcecast;
+    if(dataset.ndim() != 2) throw std::runtime_error("Expected 2 dimensions");
+    const size_t nr = dataset.shape(0), nc = dataset.shape(1);
+    const char kind = standardize_dtype(dataset.request().format)[0];
+    if(kind == (std::is_same_v<HT, util::float16_t> ? 'e': 'H')) {
+        if(!(dataset.flags() & py::array::c_style)) throw std::invalid_argument("16-bit data must be C-contiguous");
+        return util::HalfDenseMatrix<HT>((const HT *)dataset.request().ptr, nr, nc);
+    }
+    if(kind == 'd') {
+        py::array_t<double, pyflags> dcp(dataset);
+        return util::HalfDenseMatrix<HT>(dcp.data(), nr, nc);
+    }
+    py::array_t<float, pyflags> dcp(dataset);
+    return util::HalfDenseMatrix<HT>(dcp.data(), nr, nc);
+}
+
+// 16-bit storage is only used when requested, in one format
+inline void check_half_flags(bool use_fp16, bool use_bf16) {
+    if(use_fp16 && use_bf16) throw std::invalid_argument("use_fp16 and use_bf16 are mutually exclusive");
+}
+
+/*
+ * hcluster for 16-bit data: Lloyd's algorithm with fp32 arithmetic and centers, returned in the data's storage format.
+ * centers is either a (k, ncolumns) array (uint16 arrays holding bfloat16 bit patterns for bfloat16_t) or a sequence of row indices.
+ */
+template<typename HT>
+py::object __py_cluster_from_centers_half(const util::HalfDenseMatrix<HT> &mat, py::object centers, double beta,
+                                          py::object msr, py::object weights, double eps, uint64_t kmeansmaxiter, py::object out)
+{
+    const dist::DissimilarityMeasure measure = assure_dm(msr);
+    const size_t nr = mat.rows(), nc = mat.columns();
+    std::vector<std::vector<blz::DV<float, blz::rowVector>>> ctrs(1);
+    py::array carr = py::isinstance<py::array>(centers) ? py::cast<py::array>(centers): py::array(py::list(centers));
+    if(carr.ndim() == 2) {
+        const char kind = standardize_dtype(carr.request().format)[0];
+        if(size_t(carr.shape(1)) != nc) throw std::invalid_argument("centers must have as many columns as the data");
+        if(kind == 'H' && std::is_same_v<HT, util::bfloat16_t>) { // bfloat16 bit patterns
+            py::array_t<uint16_t, py::array::c_style | py::array::forcecast> hcp(carr);
+            for(py::ssize_t i = 0; i < carr.shape(0); ++i)
+                util::decode((const util::bfloat16_t *)hcp.data() + i * nc, ctrs[0].emplace_back(nc).data(), nc);
+        } else {
+            py::array_t<float, py::array::c_style | py::array::forcecast> fcp(carr);
+            for(py::ssize_t i = 0; i < carr.shape(0); ++i)
+                std::copy(fcp.data() + i * nc, fcp.data() + (i + 1) * nc, ctrs[0].emplace_back(nc).data());
+        }
+    } else {
+        py::array_t<int64_t, py::array::c_style | py::array::forcecast> ids(carr);
+        for(py::ssize_t i = 0; i < ids.size(); ++i) {
+            if(ids.at(i) < 0 || size_t(ids.at(i)) >= nr) throw std::invalid_argument("center index out of range");
+            ctrs[0].emplace_back(row(mat, ids.at(i), blz::unchecked));
+        }
+    }
+    const size_t k = ctrs[0].size();
+    if(k == 0) throw std::invalid_argument("centers must be nonempty");
+    std::unique_ptr<blz::DV<double>> wv;
+    if(!weights.is_none()) {
+        py::array_t<double, py::array::c_style | py::array::forcecast> warr(weights);
+        if(size_t(warr.size()) != nr) throw std::invalid_argument("weights must have one entry per row");
+        wv.reset(new blz::DV<double>(blz::make_cv((double *)warr.request().ptr, nr)));
+    }
+    const py::dict outs = prepare_hcluster_out(out, nr, k, nc, std::is_same_v<HT, util::float16_t> ? "e": "H");
+    const blz::DV<double> prior{beta < 0. ? 1. / nc: beta};
+    std::vector<blz::DV<uint32_t>> asns;
+    std::vector<blz::DV<double>> costs;
+    util::TelemetryScope telemetry(telemetry_enabled());
+    auto [initcost, finalcost, numiter] = perform_hard_clustering_restarts(mat, measure, prior, ctrs, asns, costs, wv.get(), eps, kmeansmaxiter).second.front();
+    py::array pyctrs = py::cast<py::array>(outs["centers"]), pycosts = py::cast<py::array>(outs["costs"]), pyasn = py::cast<py::array>(outs["asn"]);
+    for(size_t i = 0; i < k; ++i) util::encode(ctrs[0][i].data(), (HT *)pyctrs.request().ptr + i * nc, nc);
+    std::copy(costs[0].begin(), costs[0].end(), (float *)pycosts.request().ptr);
+    std::copy(asns[0].begin(), asns[0].end(), (uint32_t *)pyasn.request().ptr);
+    py::dict ret("initcost"_a = initcost, "finalcost"_a = finalcost, "numiter"_a = numiter,
+                 "centers"_a = pyctrs, "costs"_a = pycosts, "asn"_a = pyasn);
+    if(telemetry.get()) ret["stats"] = telemetry2dict(*telemetry.get());
+    return ret;
 }
 
 void init_clustering_dense(py::module &m) {
@@ -69,23 +153,30 @@ void init_clustering_dense(py::module &m) {
     m.def("hcluster", [](py::array dataset, py::object centers, double beta,
                          py::object msr, py::object weights, double eps,
                          uint64_t kmeansmaxiter, uint64_t seed, py::ssize_t mbsize, py::ssize_t ncheckins,
-                         py::ssize_t reseed_count, bool with_rep, bool use_cs) {
+                         py::ssize_t reseed_count, bool with_rep, bool use_cs, py::object out, bool use_fp16, bool use_bf16) {
                             constexpr const int pyflags = py::array::c_style | py::array::forcecast;
                             py::object ret = py::none();
+                            const char kind = standardize_dtype(dataset.request().format)[0];
+                            check_half_flags(use_fp16, use_bf16);
+                            if(use_fp16 || use_bf16) {
+                                if(mbsize >= 0) throw std::invalid_argument("16-bit storage does not support minibatch clustering");
+                                if(use_bf16) return __py_cluster_from_centers_half(py2half<util::bfloat16_t>(dataset), centers, beta, msr, weights, eps, kmeansmaxiter, out);
+                                return __py_cluster_from_centers_half(py2half<util::float16_t>(dataset), centers, beta, msr, weights, eps, kmeansmaxiter, out);
+                            }
                             try {
-                            switch(standardize_dtype(dataset.request().format)[0]) {
+                            switch(kind) {
                                 default:
                                 case 'f': {
                                     py::array_t<float, pyflags> dcp(dataset);
                                     PYBIND11_EXCEPTION_CHECK();
-                                    ret = __py_cluster_from_centers_dense(dcp, centers, beta, msr, weights, eps, kmeansmaxiter, seed, mbsize, ncheckins, reseed_count, with_rep, use_cs);
+                                    ret = __py_cluster_from_centers_dense(dcp, centers, beta, msr, weights, eps, kmeansmaxiter, seed, mbsize, ncheckins, reseed_count, with_rep, use_cs, out);
                                     PYBIND11_EXCEPTION_CHECK();
                                 }
                                 break;
                                 case 'd': {
                                     py::array_t<double, pyflags> dcp(dataset);
                                     PYBIND11_EXCEPTION_CHECK();
-                                    ret = __py_cluster_from_centers_dense(dcp, centers, beta, msr, weights, eps, kmeansmaxiter, seed, mbsize, ncheckins, reseed_count, with_rep, use_cs);
+                                    ret = __py_cluster_from_centers_dense(dcp, centers, beta, msr, weights, eps, kmeansmaxiter, seed, mbsize, ncheckins, reseed_count, with_rep, use_cs, out);
                                     PYBIND11_EXCEPTION_CHECK();
                                 }
                                 break;
@@ -107,6 +198,108 @@ void init_clustering_dense(py::module &m) {
     py::arg("mbsize") = py::ssize_t(-1),
     py::arg("ncheckins") = py::ssize_t(-1),
     py::arg("reseed_count") = py::ssize_t(5),
-    py::arg("with_rep") = false, py::arg("cs") = false,
-    "Clusters a SparseMatrixWrapper object using settings and the centers provided above; set prior to < 0 for it to be 1 / ncolumns(). Performs seeding, followed by EM or minibatch k-means");
+    py::arg("with_rep") = false, py::arg("cs") = false, py::arg("out") = py::none(),
+    py::arg("use_fp16") = false, py::arg("use_bf16") = false,
+    "Clusters a SparseMatrixWrapper object using settings and the centers provided above; set prior to < 0 for it to be 1 / ncolumns(). Performs seeding, followed by EM or minibatch k-means. "
+    "out optionally maps \"costs\" (float32), \"asn\" (uint32) and \"centers\" (k x d, the dataset's dtype) to C-contiguous arrays to write results into. "
+    "use_fp16 or use_bf16 (not both) stores the data in 16 bits and computes in fp32; centers are then returned as float16, or for bf16 as uint16 bit patterns. "
+    "A float16 dataset with use_fp16, or a uint16 dataset with use_bf16 (taken as bfloat16 bit patterns), is used without copying; "
+    "without either flag, float16 data is converted to float32. 16-bit storage requires a mean-based measure and mbsize < 0.");
+    m.def("hcluster_update", [](py::array dataset, py::ssize_t nold, py::object centers, py::object asn, py::object costs,
+                                py::object rowsums, double beta, py::object msr, py::object weights, double tol, uint64_t maxiter) {
+                            constexpr const int pyflags = py::array::c_style | py::array::forcecast;
+                            const dist::DissimilarityMeasure measure = assure_dm(msr);
+                            auto run = [&](auto dcp) {
+                                using FT = typename decltype(dcp)::value_type;
+                                auto dbi = dcp.request();
+                                if(dbi.ndim != 2) throw std::runtime_error("Expected 2 dimensions");
+                                auto dmat = blaze::CustomMatrix<FT, blz::unaligned, blz::unpadded>((FT *)dbi.ptr, dbi.shape[0], dbi.shape[1]);
+                                return cpp_pycluster_update(dmat, nold, centers, asn, costs, rowsums, beta, measure, weights, tol, maxiter);
+                            };
+                            if(standardize_dtype(dataset.request().format)[0] == 'd')
+                                return run(py::array_t<double, pyflags>(dataset));
+                            return run(py::array_t<float, pyflags>(dataset));
+                         },
+    py::arg("dataset"),
+    py::arg("nold"),
+    py::arg("centers"),
+    py::arg("asn"),
+    py::arg("costs"),
+    py::arg("rowsums") = py::none(),
+    py::arg("prior") = 0.,
+    py::arg("msr") = 2,
+    py::arg("weights") = py::none(),
+    py::arg("tol") = clustering::DEFAULT_INCREMENTAL_TOL,
+    py::arg("maxiter") = 5,
+    "Updates a hard clustering of the first nold rows of dataset after rows were appended, given its centers, assignments, costs and optionally row sums. "
+    "Only new rows are assigned, and local Lloyd iterations are restricted to centers which moved by more than tol. Requires a mean-based measure.");
+    m.def("hcluster_restarts", [](py::array dataset, unsigned k, py::ssize_t nrestarts, double beta, py::object msr,
+                                  py::object weights, uint64_t seed, uint64_t maxiter, double eps, bool use_fp16, bool use_bf16) {
+                            constexpr const int pyflags = py::array::c_style | py::array::forcecast;
+                            const dist::DissimilarityMeasure measure = assure_dm(msr);
+                            auto run = [&](auto dcp) {
+                                using FT = typename decltype(dcp)::value_type;
+                                auto dbi = dcp.request();
+                                if(dbi.ndim != 2) throw std::runtime_error("Expected 2 dimensions");
+                                auto dmat = blaze::CustomMatrix<FT, blz::unaligned, blz::unpadded>((FT *)dbi.ptr, dbi.shape[0], dbi.shape[1]);
+                                return cpp_pycluster_restarts(dmat, k, nrestarts, beta, measure, weights, seed, eps, maxiter);
+                            };
+                            const char kind = standardize_dtype(dataset.request().format)[0];
+                            check_half_flags(use_fp16, use_bf16);
+                            if(use_bf16) return cpp_pycluster_restarts(py2half<util::bfloat16_t>(dataset), k, nrestarts, beta, measure, weights, seed, eps, maxiter);
+                            if(use_fp16) return cpp_pycluster_restarts(py2half<util::float16_t>(dataset), k, nrestarts, beta, measure, weights, seed, eps, maxiter);
+                            if(kind == 'd')
+                                return run(py::array_t<double, pyflags>(dataset));
+                            return run(py::array_t<float, pyflags>(dataset));
+                         },
+    py::arg("dataset"),
+    py::arg("k"),
+    py::arg("nrestarts") = 10,
+    py::arg("prior") = 0.,
+    py::arg("msr") = 2,
+    py::arg("weights") = py::none(),
+    py::arg("seed") = 0,
+    py::arg("maxiter") = 100,
+    py::arg("eps") = 1e-10,
+    py::arg("use_fp16") = false, py::arg("use_bf16") = false,
+    "Seeds nrestarts solutions with kmeans++ (restart r uses seed + r) and runs Lloyd's algorithm on all of them, sharing each pass over dataset. "
+    "Returns the best solution, as hcluster does, plus \"best\" (its index) and \"restart_costs\" (each restart's final cost). "
+    "use_fp16 and use_bf16 select 16-bit storage, as for hcluster.");
+    m.def("hcluster_ksweep", [](py::array dataset, py::object ks, double beta, py::object msr, py::object weights,
+                                uint64_t seed, uint64_t maxiter, double eps, bool use_kmeans_parallel, py::ssize_t kmpar_rounds, double oversample,
+                                bool use_fp16, bool use_bf16) {
+                            constexpr const int pyflags = py::array::c_style | py::array::forcecast;
+                            const dist::DissimilarityMeasure measure = assure_dm(msr);
+                            auto run = [&](auto dcp) {
+                                using FT = typename decltype(dcp)::value_type;
+                                auto dbi = dcp.request();
+                                if(dbi.ndim != 2) throw std::runtime_error("Expected 2 dimensions");
+                                auto dmat = blaze::CustomMatrix<FT, blz::unaligned, blz::unpadded>((FT *)dbi.ptr, dbi.shape[0], dbi.shape[1]);
+                                return cpp_pycluster_ksweep(dmat, ks, beta, measure, weights, seed, eps, maxiter, use_kmeans_parallel, kmpar_rounds, oversample);
+                            };
+                            const char kind = standardize_dtype(dataset.request().format)[0];
+                            check_half_flags(use_fp16, use_bf16);
+                            if(use_bf16)
+                                return cpp_pycluster_ksweep(py2half<util::bfloat16_t>(dataset), ks, beta, measure, weights, seed, eps, maxiter, use_kmeans_parallel, kmpar_rounds, oversample);
+                            if(use_fp16)
+                                return cpp_pycluster_ksweep(py2half<util::float16_t>(dataset), ks, beta, measure, weights, seed, eps, maxiter, use_kmeans_parallel, kmpar_rounds, oversample);
+                            if(kind == 'd')
+                                return run(py::array_t<double, pyflags>(dataset));
+                            return run(py::array_t<float, pyflags>(dataset));
+                         },
+    py::arg("dataset"),
+    py::arg("ks"),
+    py::arg("prior") = 0.,
+    py::arg("msr") = 2,
+    py::arg("weights") = py::none(),
+    py::arg("seed") = 0,
+    py::arg("maxiter") = 100,
+    py::arg("eps") = 1e-10,
+    py::arg("kmeans_parallel") = false,
+    py::arg("kmpar_rounds") = 0,
+    py::arg("oversample") = 2.,
+    py::arg("use_fp16") = false, py::arg("use_bf16") = false,
+    "Clusters dataset for every k in ks from one kmeans++ (or, with kmeans_parallel, k-means||) seeding to max(ks), whose first k centers seed the k-clustering. "
+    "All values of k share each pass over dataset. Returns \"ks\", the cost curve \"finalcost\", \"initcost\", \"numiter\", the seed ordering \"seeds\", "
+    "and lists of \"centers\", \"asn\" and \"costs\" in the order of ks. use_fp16 and use_bf16 select 16-bit storage, as for hcluster.");
 } // init_clustering
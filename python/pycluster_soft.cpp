@@ -4,7 +4,7 @@ void init_clustering_soft(py::module &m) {
     m.def("scluster", [](const SparseMatrixWrapper &smw, py::object centers,
                     py::object measure, double beta, double temp,
                     uint64_t kmeansmaxiter, py::ssize_t mbsize, py::ssize_t mbn,
-                    py::object savepref, py::object weights) -> py::object
+                    py::object savepref, py::object weights, py::object out) -> py::object
     {
         void *wptr = nullptr;
         std::string wfmt = "f";
@@ -13,7 +13,7 @@ void init_clustering_soft(py::module &m) {
             wfmt = standardize_dtype(inf.format);
             wptr = inf.ptr;
         }
-        return py_scluster(smw, centers, assure_dm(measure), beta, temp, kmeansmaxiter, mbsize, mbn, static_cast<std::string>(savepref.cast<py::str>()), wptr);
+        return py_scluster(smw, centers, assure_dm(measure), beta, temp, kmeansmaxiter, mbsize, mbn, static_cast<std::string>(savepref.cast<py::str>()), wptr, wfmt, out);
     },
     py::arg("smw"),
     py::arg("centers"),
@@ -24,6 +24,7 @@ void init_clustering_soft(py::module &m) {
     py::arg("mbsize") = py::ssize_t(-1),
     py::arg("mbn") = py::ssize_t(-1),
     py::arg("savepref") = "",
-    py::arg("weights") = py::none()
+    py::arg("weights") = py::none(),
+    py::arg("out") = py::none()
     );
 } // init_clustering_csr
@@ -16,6 +16,26 @@ using blz::unaligned;
 using blz::padded;
 using blz::aligned;
 
+/*
+ * Cost and responsibility matrices (float32, nrows x k) for scluster.
+ * They are written into out["costs"] and out["asn"] where provided (see prepare_out),
+ * into new .npy memory maps if savepref is set, and into new arrays otherwise.
+ */
+inline std::pair<py::array, py::array> prepare_scluster_out(py::object out, const std::string &savepref, const std::vector<py::ssize_t> &shape) {
+    const py::dict outd = out2dict(out, {"costs", "asn"});
+    if(!savepref.empty()) {
+        if(outd.size()) throw std::invalid_argument("savepref and out can't both be provided");
+        std::fprintf(stderr, "Using savepref to mmap cost matrices diretly: %s\n", savepref.data());
+        auto mmfn = py::module::import("numpy").attr("memmap");
+        auto mmap = [&](std::string path) {
+            return py::cast<py::array>(mmfn(py::str(path), "dtype"_a = py::dtype("f"), "mode"_a = "w+", "shape"_a = py::tuple(py::cast(shape))));
+        };
+        return {mmap(savepref + ".costs.f32.npy"), mmap(savepref + ".asns.f32.npy")};
+    }
+    return {prepare_out(out_entry(outd, "costs"), "f", shape, "out['costs']"),
+            prepare_out(out_entry(outd, "asn"), "f", shape, "out['asn']")};
+}
+
 template<typename Matrix, typename CtrT, typename AsnT=blz::DV<uint32_t>, typename CostsT=blz::DV<double>>
 py::dict cpp_scluster(const Matrix &mat, int, double beta,
                dist::DissimilarityMeasure measure,
@@ -62,13 +82,16 @@ py::dict cpp_scluster(const Matrix &mat, int, double beta,
     }
     // Only one version of perform_soft_clustering compiled (for double weights)
     // This takes extra memory/time to copy the weights, but halves or thirds compile-time.
+    util::TelemetryScope telemetry(telemetry_enabled());
     clusterret = minicore::clustering::perform_soft_clustering(mat, measure, prior, ctrs, costs, asn, temp, kmeansmaxiter, mbsize, mbn, wview.get());
     auto &[initcost, finalcost, numiter]  = clusterret;
     auto pyctrs = centers2pylist(ctrs);
     //auto pycosts = vec2fnp<decltype(costs), float> (costs);
     //auto pyasn = vec2fnp<decltype(asn), uint32_t>(asn);
-    return py::dict("initcost"_a = initcost, "finalcost"_a = finalcost, "numiter"_a = numiter,
-                    "centers"_a = pyctrs);
+    py::dict ret("initcost"_a = initcost, "finalcost"_a = finalcost, "numiter"_a = numiter,
+                 "centers"_a = pyctrs);
+    if(telemetry.get()) ret["stats"] = telemetry2dict(*telemetry.get());
+    return ret;
 }
 
 template<typename Matrix>
@@ -82,28 +105,18 @@ py::dict py_scluster(const Matrix &smw,
                py::ssize_t mbn=10,
                std::string savepref="",
                void *weights = (void *)nullptr,
-               std::string wfmt="f")
+               std::string wfmt="f",
+               py::object out=py::none())
 {
     assert(beta > 0.);
-    py::object asns = py::none(), costs = py::none();
     std::vector<blz::CompressedVector<float, blz::rowVector>> dvecs;
     smw.perform([&](auto &mat) {dvecs = obj2dvec(centers, mat);});
     const int k = dvecs.size();
     std::vector<py::ssize_t> shape{py::ssize_t(smw.rows()), k};
     assert(k >= 1);
-    if(!savepref.empty()) {
-        std::fprintf(stderr, "Using savepref to mmap cost matrices diretly: %s\n", savepref.data());
-        std::string cpath = savepref + ".costs.f32.npy";
-        std::string apath = savepref + ".asns.f32.npy";
-        auto mmfn = py::module::import("numpy").attr("memmap");
-        auto dt = py::dtype("f");
-        costs = mmfn(py::str(cpath), shape, dt);
-        asns = mmfn(py::str(apath), shape, dt);
-    } else {
-        costs = py::array_t<float>({smw.rows(), smw.columns()}), asns = py::array_t<float>({smw.rows(), smw.columns()});
-    }
-    void *cp = py::cast<py::array>(costs).request().ptr,
-         *ap = py::cast<py::array>(asns).request().ptr;
+    auto [costs, asns] = prepare_scluster_out(out, savepref, shape);
+    void *cp = costs.request().ptr,
+         *ap = asns.request().ptr;
     blz::CustomMatrix<float, unaligned, unpadded, rowMajor> cm((float *)cp, smw.rows(), k);
     blz::CustomMatrix<float, unaligned, unpadded, rowMajor> am((float *)ap, smw.rows(), k);
     py::dict retdict;
@@ -4,7 +4,7 @@ void init_clustering_soft_csr(py::module &m) {
     m.def("scluster", [](const PyCSparseMatrix &smw, py::object centers,
                     py::object measure, double beta, double temp,
                     uint64_t kmeansmaxiter, py::ssize_t mbsize, py::ssize_t mbn,
-                    py::object savepref, py::object weights) -> py::object
+                    py::object savepref, py::object weights, py::object out) -> py::object
     {
         void *wptr = nullptr;
         std::string wfmt = "f";
@@ -14,7 +14,7 @@ void init_clustering_soft_csr(py::module &m) {
             wptr = inf.ptr;
         }
         std::string pref = static_cast<std::string>(py::cast<py::str>(savepref));
-        return py_scluster(smw, centers, assure_dm(measure), beta, temp, kmeansmaxiter, mbsize, mbn, pref, wptr);
+        return py_scluster(smw, centers, assure_dm(measure), beta, temp, kmeansmaxiter, mbsize, mbn, pref, wptr, wfmt, out);
     },
     py::arg("smw"),
     py::arg("centers"),
@@ -25,6 +25,7 @@ void init_clustering_soft_csr(py::module &m) {
     py::arg("mbsize") = py::ssize_t(-1),
     py::arg("mbn") = py::ssize_t(-1),
     py::arg("savepref") = "",
-    py::arg("weights") = py::none()
+    py::arg("weights") = py::none(),
+    py::arg("out") = py::none()
     );
 } // init_clustering_csr
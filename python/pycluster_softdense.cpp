@@ -10,12 +10,12 @@ py::dict py_scluster_arr(py::array matrix,
                py::ssize_t mbn=10,
                std::string savepref="",
                void *weights = (void *)nullptr,
-               std::string wfmt="f")
+               std::string wfmt="f",
+               py::object out=py::none())
 {
     std::unique_ptr<py::array_t<float, py::array::c_style | py::array::forcecast>> fmat;
     py::buffer_info inf = matrix.request(), fmatinf;
     std::string ifmt = standardize_dtype(inf.format);
-    py::object asns = py::none(), costs = py::none();
     std::vector<blz::CompressedVector<float, blz::rowVector>> dvecs;
     py::ssize_t nr;
     if(ifmt.front() == 'd') {
@@ -23,7 +23,7 @@ py::dict py_scluster_arr(py::array matrix,
         nr = inf.shape[0];
     } else {
         if(ifmt.front() != 'f') {
-            fmat.reset(new py::array_t<float, py::array::c_style | py::array::forcecast>({inf.shape[0], inf.shape[1]}));
+            fmat.reset(new py::array_t<float, py::array::c_style | py::array::forcecast>(matrix));
             fmatinf = fmat->request();
         } else fmatinf = matrix.request();
         dvecs = obj2dvec(centers, blaze::CustomMatrix<float, blaze::unaligned, blaze::unpadded>((float *)fmatinf.ptr, fmatinf.shape[0], fmatinf.shape[1], fmatinf.strides[0] / sizeof(float)));
@@ -32,20 +32,9 @@ py::dict py_scluster_arr(py::array matrix,
     const int k = dvecs.size();
     std::vector<py::ssize_t> shape{nr, k};
     assert(k >= 1);
-    if(!savepref.empty()) {
-        std::fprintf(stderr, "Using savepref to mmap cost matrices diretly: %s\n", savepref.data());
-        std::string cpath = savepref + ".costs.f32.npy";
-        std::string apath = savepref + ".asns.f32.npy";
-        auto mmfn = py::module::import("numpy").attr("memmap");
-        auto dt = py::dtype("f");
-        costs = mmfn(py::str(cpath), shape, dt);
-        asns = mmfn(py::str(apath), shape, dt);
-    } else {
-        costs = py::array_t<float>(shape);
-        asns = py::array_t<float>(shape);
-    }
-    void *cp = py::cast<py::array>(costs).request().ptr,
-         *ap = py::cast<py::array>(asns).request().ptr;
+    auto [costs, asns] = prepare_scluster_out(out, savepref, shape);
+    void *cp = costs.request().ptr,
+         *ap = asns.request().ptr;
     blz::CustomMatrix<float, unaligned, unpadded, rowMajor> cm((float *)cp, nr, k);
     blz::CustomMatrix<float, unaligned, unpadded, rowMajor> am((float *)ap, nr, k);
     py::dict retdict;
@@ -66,7 +55,7 @@ void init_clustering_softdense(py::module &m) {
     m.def("scluster", [](py::array mat, py::object centers,
                     py::object measure, double prior, double temp,
                     uint64_t kmeansmaxiter, py::ssize_t mbsize, py::ssize_t mbn,
-                    py::object savepref, py::object weights) -> py::object
+                    py::object savepref, py::object weights, py::object out) -> py::object
     {
         if(prior < 0.) prior = 0.;
         void *wptr = nullptr;
@@ -76,7 +65,7 @@ void init_clustering_softdense(py::module &m) {
             wfmt = standardize_dtype(inf.format);
             wptr = inf.ptr;
         }
-        return py_scluster_arr(mat, centers, assure_dm(measure), prior, temp, kmeansmaxiter, mbsize, mbn, static_cast<std::string>(savepref.cast<py::str>()), wptr, wfmt);
+        return py_scluster_arr(mat, centers, assure_dm(measure), prior, temp, kmeansmaxiter, mbsize, mbn, static_cast<std::string>(savepref.cast<py::str>()), wptr, wfmt, out);
     },
     py::arg("matrix"),
     py::arg("centers"),
@@ -87,6 +76,7 @@ void init_clustering_softdense(py::module &m) {
     py::arg("mbsize") = py::ssize_t(-1),
     py::arg("mbn") = py::ssize_t(-1),
     py::arg("savepref") = "",
-    py::arg("weights") = py::none()
+    py::arg("weights") = py::none(),
+    py::arg("out") = py::none()
     );
 } // init_clustering_csr
@@ -13,7 +13,7 @@ using minicore::util::row;
 using blaze::row;
 
 void init_cmp(py::module &m) {
-    m.def("cmp", [](const SparseMatrixWrapper &lhs, py::array arr, py::object msr, py::object betaprior, py::object reverse) {
+    m.def("cmp", [](const SparseMatrixWrapper &lhs, py::array arr, py::object msr, py::object betaprior, py::object reverse, py::object out) {
         auto inf = arr.request();
         const bool revb = reverse.cast<bool>();
         const double priorv = betaprior.cast<double>(), priorsum = priorv * lhs.columns();
@@ -26,7 +26,7 @@ void init_cmp(py::module &m) {
         lhs.perform([&](const auto &x){rsums = blz::sum<rowwise>(x);});
         if(inf.ndim == 1) {
             if(inf.size != py::ssize_t(lhs.columns())) throw std::invalid_argument("Array must be of the same dimensionality as the matrix");
-            py::array_t<float> ret(nr);
+            py::array ret = prepare_out(out, "f", {py::ssize_t(nr)});
             auto v = blz::make_cv((float *)ret.request().ptr, nr);
             lhs.perform([&](auto &matrix) {
                 using ET = typename std::decay_t<decltype(matrix)>::ElementType;
@@ -53,7 +53,7 @@ void init_cmp(py::module &m) {
             const py::ssize_t nc = inf.shape[1], ndr = inf.shape[0];
             if(nc != py::ssize_t(lhs.columns()))
                 throw std::invalid_argument("Array must be of the same dimensionality as the matrix");
-            py::array_t<float> ret(std::vector<py::ssize_t>{py::ssize_t(nr), ndr});
+            py::array ret = prepare_out(out, "f", {py::ssize_t(nr), ndr});
             blz::CustomMatrix<float, unaligned, unpadded, blz::rowMajor> cm((float *)ret.request().ptr, nr, ndr);
             lhs.perform([&](auto &matrix) {
                 using ET = typename std::decay_t<decltype(matrix)>::ElementType;
@@ -95,20 +95,21 @@ void init_cmp(py::module &m) {
             throw std::invalid_argument("NumPy array expected to have 1 or two dimensions.");
         }
         __builtin_unreachable();
-        return py::array_t<float>();
-    }, py::arg("matrix"), py::arg("data"), py::arg("msr") = 2, py::arg("prior") = 0., py::arg("reverse") = false);
-    m.def("cmp", [](const SparseMatrixWrapper &lhs, const SparseMatrixWrapper &rhs, py::object msr, py::object betaprior, bool reverse, int use_float=-1) {
-        if(use_float < 0) use_float = lhs.is_float() || rhs.is_float();
+        return py::array();
+    }, py::arg("matrix"), py::arg("data"), py::arg("msr") = 2, py::arg("prior") = 0., py::arg("reverse") = false, py::arg("out") = py::none());
+    m.def("cmp", [](const SparseMatrixWrapper &lhs, const SparseMatrixWrapper &rhs, py::object msr, py::object betaprior, bool reverse, int use_float, py::object out) {
+        // A provided output buffer selects the precision unless use_float is set
+        if(use_float < 0) use_float = py::isinstance<py::array>(out) ? py::cast<py::array>(out).itemsize() == 4: lhs.is_float() || rhs.is_float();
         const double priorv = betaprior.cast<double>(), priorsum = priorv * lhs.columns();
         const auto ms = assure_dm(msr);
         blz::DV<float> lrsums(lhs.rows());
         blz::DV<float> rrsums(lhs.rows());
         blz::DV<double> priorc({priorv});
         if(lhs.columns() != rhs.columns()) throw std::invalid_argument("mismatched # columns");
+        const py::ssize_t nr = lhs.rows(), nc = rhs.rows();
+        py::array ret = prepare_out(out, use_float ? "f": "d", {nr, nc});
         lhs.perform([&](const auto &x){lrsums = blz::sum<rowwise>(x);});
         rhs.perform([&](const auto &x){rrsums = blz::sum<rowwise>(x);});
-        const py::ssize_t nr = lhs.rows(), nc = rhs.rows();
-        py::array ret(py::dtype(use_float ? "f": "d"), std::vector<py::ssize_t>{nr, nc});
         auto retinf = ret.request();
         blz::CustomMatrix<float, unaligned, unpadded, blz::rowMajor> cm((float *)retinf.ptr, nr, nc, nc);
         blz::CustomMatrix<double, unaligned, unpadded, blz::rowMajor> cmd((double *)retinf.ptr, nr, nc, nc);
@@ -143,8 +144,8 @@ void init_cmp(py::module &m) {
         }
 #undef DO_GEN
         return ret;
-    }, py::arg("matrix"), py::arg("data"), py::arg("msr") = 2, py::arg("prior") = 0., py::arg("reverse") = false, py::arg("use_float") = -1);
-    m.def("cmp", [](const PyCSparseMatrix &lhs, py::array arr, py::object msr, py::object betaprior, py::object reverse) {
+    }, py::arg("matrix"), py::arg("data"), py::arg("msr") = 2, py::arg("prior") = 0., py::arg("reverse") = false, py::arg("use_float") = -1, py::arg("out") = py::none());
+    m.def("cmp", [](const PyCSparseMatrix &lhs, py::array arr, py::object msr, py::object betaprior, py::object reverse, py::object out) {
         const bool revb = reverse.cast<bool>();
         auto inf = arr.request();
         const double priorv = betaprior.cast<double>(), priorsum = priorv * lhs.columns();
@@ -157,7 +158,7 @@ void init_cmp(py::module &m) {
         lhs.perform([&](const auto &x){rsums = sum<rowwise>(x);});
         if(inf.ndim == 1) {
             if(inf.size != py::ssize_t(lhs.columns())) throw std::invalid_argument("Array must be of the same dimensionality as the matrix");
-            py::array_t<float> ret(nr);
+            py::array ret = prepare_out(out, "f", {py::ssize_t(nr)});
             auto v = blz::make_cv((float *)ret.request().ptr, nr);
             lhs.perform([&](auto &matrix) {
                 using ET = typename std::decay_t<decltype(matrix)>::ElementType;
@@ -184,7 +185,7 @@ void init_cmp(py::module &m) {
             const py::ssize_t nc = inf.shape[1], ndr = inf.shape[0];
             if(nc != py::ssize_t(lhs.columns()))
                 throw std::invalid_argument("Array must be of the same dimensionality as the matrix");
-            py::array_t<float> ret(std::vector<py::ssize_t>{py::ssize_t(nr), ndr});
+            py::array ret = prepare_out(out, "f", {py::ssize_t(nr), ndr});
             blz::CustomMatrix<float, unaligned, unpadded, blz::rowMajor> cm((float *)ret.request().ptr, nr, ndr);
             lhs.perform([&](auto &matrix) {
                 using ET = typename std::decay_t<decltype(matrix)>::ElementType;
@@ -219,9 +220,9 @@ void init_cmp(py::module &m) {
             throw std::invalid_argument("NumPy array expected to have 1 or two dimensions.");
         }
         __builtin_unreachable();
-        return py::array_t<float>();
-    }, py::arg("matrix"), py::arg("data"), py::arg("msr") = 2, py::arg("prior") = 0., py::arg("reverse") = false);
-    m.def("cmp", [](const PyCSparseMatrix &lhs, const PyCSparseMatrix &rhs, py::object msr, py::object betaprior) {
+        return py::array();
+    }, py::arg("matrix"), py::arg("data"), py::arg("msr") = 2, py::arg("prior") = 0., py::arg("reverse") = false, py::arg("out") = py::none());
+    m.def("cmp", [](const PyCSparseMatrix &lhs, const PyCSparseMatrix &rhs, py::object msr, py::object betaprior, py::object out) {
         if(lhs.data_t_ != rhs.data_t_ || lhs.indices_t_ != rhs.indices_t_ || lhs.indptr_t_ != rhs.indptr_t_) {
             std::string lmsg = std::string("lhs ") + lhs.data_t_ + "," + lhs.indices_t_ + "," + lhs.indptr_t_;
             std::string rmsg = std::string("rhs ") + rhs.data_t_ + "," + rhs.indices_t_ + "," + rhs.indptr_t_;
@@ -233,10 +234,10 @@ void init_cmp(py::module &m) {
         blz::DV<float> rrsums(lhs.rows());
         blz::DV<double> priorc({priorv});
         if(lhs.columns() != rhs.columns()) throw std::invalid_argument("mismatched # columns");
+        const py::ssize_t nr = lhs.rows(), nc = rhs.rows();
+        py::array ret = prepare_out(out, "f", {nr, nc});
         lhs.perform([&](const auto &x){lrsums = sum<rowwise>(x);});
         rhs.perform([&](const auto &x){rrsums = sum<rowwise>(x);});
-        const py::ssize_t nr = lhs.rows(), nc = rhs.rows();
-        py::array ret(py::dtype("f"), std::vector<py::ssize_t>{nr, nc});
         auto retinf = ret.request();
         blz::CustomMatrix<float, unaligned, unpadded, blz::rowMajor> cm((float *)retinf.ptr, nr, nc, nc);
         lhs.perform(rhs, [&](auto &mat, auto &rmat) {
@@ -245,15 +246,15 @@ void init_cmp(py::module &m) {
             });
         });
         return ret;
-    }, py::arg("matrix"), py::arg("data"), py::arg("msr") = 2, py::arg("prior") = 0.);
-    m.def("pcmp", [](const PyCSparseMatrix &lhs, py::object msr, py::object betaprior, py::ssize_t use_float) {
+    }, py::arg("matrix"), py::arg("data"), py::arg("msr") = 2, py::arg("prior") = 0., py::arg("out") = py::none());
+    m.def("pcmp", [](const PyCSparseMatrix &lhs, py::object msr, py::object betaprior, py::ssize_t use_float, py::object out) {
         const double priorv = betaprior.cast<double>(), priorsum = priorv * lhs.columns();
         const auto ms = assure_dm(msr);
+        const py::ssize_t nr = lhs.rows(), nc2 = (nr * (nr - 1)) / 2;
+        py::array ret = prepare_out(out, "f", {nc2});
         blz::DV<float> lrsums(lhs.rows());
         blz::DV<double> priorc({priorv});
         lhs.perform([&](const auto &x){lrsums = sum<rowwise>(x);});
-        const py::ssize_t nr = lhs.rows(), nc2 = (nr * (nr - 1)) / 2;
-        py::array ret(py::dtype("f"), std::vector<py::ssize_t>{nc2});
         auto retinf = ret.request();
         blz::CustomVector<float, unaligned, unpadded, blz::rowMajor> cm((float *)retinf.ptr, nc2);
         lhs.perform([&](auto &mat) {
@@ -269,14 +270,17 @@ void init_cmp(py::module &m) {
             }
         });
         return ret;
-    }, py::arg("matrix"), py::arg("msr") = 2, py::arg("prior") = 0., py::arg("use_float") = -1);
-    m.def("pcmp", [](py::array mat, py::object msr, py::object betaprior, py::ssize_t use_float) {
+    }, py::arg("matrix"), py::arg("msr") = 2, py::arg("prior") = 0., py::arg("use_float") = -1, py::arg("out") = py::none());
+    m.def("pcmp", [](py::array mat, py::object msr, py::object betaprior, py::ssize_t use_float, py::object out) {
         const double priorv = betaprior.cast<double>();
         const auto ms = assure_dm(msr);
         py::buffer_info bi = mat.request();
         py::object cobj = py::none();
-        blz::DV<float> lrsums(bi.shape[0]);
         if(bi.shape.size() != 2) throw std::invalid_argument("pcmp expects a 2-d numpy matrix");
+        // A provided output buffer selects the precision unless use_float is set
+        if(use_float < 0 && py::isinstance<py::array>(out)) use_float = py::cast<py::array>(out).itemsize() == 4;
+        const py::ssize_t nr = bi.shape[0], nc2 = (nr * (nr - 1)) / 2;
+        blz::DV<float> lrsums(bi.shape[0]);
         void *mptr = nullptr;
         std::vector<py::ssize_t> mshape;
         py::ssize_t m_itemsize;
@@ -297,11 +301,12 @@ void init_cmp(py::module &m) {
             lrsums = blz::evaluate(blz::sum<blz::rowwise>(cm));
             cobj = cmat;
         }
+        // By default, results have the precision of the compared data: float64 stays double, and other types were converted to float
+        const bool luf = use_float < 0 ? m_itemsize <= 4 : bool(use_float);
+        py::array ret = prepare_out(out, luf ? "f": "d", {nc2});
         blz::DV<double> priorc({priorv});
-        const py::ssize_t nr = mshape[0], nc = mshape[1], nc2 = (nr * (nr - 1)) / 2;
+        const py::ssize_t nc = mshape[1];
         const double priorsum = priorv * nc;
-        const bool luf = use_float < 0 ? m_itemsize <= 4 : bool(use_float);
-        py::array ret(py::dtype(luf ? "f": "d"), std::vector<py::ssize_t>{nc2});
         auto retinf = ret.request();
         blz::CustomVector<float, unaligned, unpadded, blz::rowMajor> cm((float *)retinf.ptr, nc2);
         blz::CustomVector<double, unaligned, unpadded, blz::rowMajor> cmd((double *)retinf.ptr, nc2);
@@ -335,5 +340,5 @@ void init_cmp(py::module &m) {
             }
         }
         return ret;
-    }, py::arg("matrix"), py::arg("msr") = 2, py::arg("prior") = 0., py::arg("use_float") = -1);
+    }, py::arg("matrix"), py::arg("msr") = 2, py::arg("prior") = 0., py::arg("use_float") = -1, py::arg("out") = py::none());
 }
@@ -5,8 +5,9 @@
 
 py::object run_kmpp_noso(const PyCSparseMatrix &smw, py::object msr, py::int_ k, double gamma_beta, uint64_t seed, unsigned ntimes,
                          py::ssize_t lspp, bool use_exponential_skips, py::ssize_t n_local_trials,
-                         py::object weights) {
-    return py_kmeanspp_noso(smw, msr, k, gamma_beta, seed, ntimes, lspp, use_exponential_skips, n_local_trials, weights);
+                         py::object weights, bool use_kmeans_parallel, py::ssize_t kmpar_rounds, double oversample, py::ssize_t lspp_batch) {
+    return py_kmeanspp_noso(smw, msr, k, gamma_beta, seed, ntimes, lspp, use_exponential_skips, n_local_trials, weights,
+                            use_kmeans_parallel, kmpar_rounds, oversample, lspp_batch);
 }
 #endif
 
@@ -90,7 +91,7 @@ void init_pycsparse(py::module &m) {
 
      m.def("kmeanspp", [](const PyCSparseMatrix &smw, const SumOpts &so, py::object weights) {
         return run_kmpp_noso(smw, py::int_(int(so.dis)), py::int_(int(so.k)),  so.gamma, so.seed, std::max(int(so.extra_sample_tries) - 1, 0),
-                       so.lspp, so.use_exponential_skips, so.n_local_trials, weights);
+                       so.lspp, so.use_exponential_skips, so.n_local_trials, weights, false, 0, 2., 1);
     },
     "Computes a selecion of points from the matrix pointed to by smw, returning indexes for selected centers, along with assignments and costs for each point.",
        py::arg("smw"),
@@ -101,7 +102,8 @@ void init_pycsparse(py::module &m) {
        "Computes a selecion of points from the matrix pointed to by smw, returning indexes for selected centers, along with assignments and costs for each point.\n",
        py::arg("smw"), py::arg("msr"), py::arg("k"), py::arg("prior") = 0., py::arg("seed") = 0, py::arg("ntimes") = 1,
        py::arg("lspp") = 0, py::arg("expskips") = false, py::arg("n_local_trials") = 1,
-       py::arg("weights") = py::none()
+       py::arg("weights") = py::none(), py::arg("kmeans_parallel") = false, py::arg("kmpar_rounds") = 0, py::arg("oversample") = 2.,
+       py::arg("lspp_batch") = 1
     );
     m.def("greedy_select",  [](PyCSparseMatrix &smw, const SumOpts &so) {
         std::vector<uint64_t> centers;
@@ -32,14 +32,16 @@ py::tuple mat2tup(py::array_t<FT, py::array::c_style | py::array::forcecast> arr
 void init_pydense(py::module &m) {
 
      m.def("kmeanspp", [](py::array_t<float, py::array::c_style | py::array::forcecast> arr, int k, py::object measure, py::object prior, py::object seed, py::object ntimes,
-                          py::object lspp, py::object weights, py::object expskips, py::object local_trials) {
+                          py::object lspp, py::object weights, py::object expskips, py::object local_trials,
+                          bool use_kmeans_parallel, py::ssize_t kmpar_rounds, double oversample, py::ssize_t lspp_batch) {
         auto dm = assure_dm(measure);
         auto arri = arr.request();
         if(arri.ndim != 2) throw std::invalid_argument("Wrong number of dimensions");
         blz::CustomMatrix<float, unaligned, unpadded, rowMajor> cm((float *)arri.ptr, arri.shape[0], arri.shape[1], arri.strides[0] / sizeof(float));
         DBG_ONLY(std::fprintf(stderr, "Doing kmeans++ over matriy at %p with floats\n", arri.ptr);)
         return py_kmeanspp_noso_dense(cm, py::int_(int(dm)), py::int_(k), prior.cast<double>(), seed.cast<py::ssize_t>(), std::max(ntimes.cast<int>() - 1, 0),
-                             lspp.cast<py::ssize_t>(), expskips.cast<bool>(), local_trials.cast<py::ssize_t>(), weights);
+                             lspp.cast<py::ssize_t>(), expskips.cast<bool>(), local_trials.cast<py::ssize_t>(), weights,
+                             use_kmeans_parallel, kmpar_rounds, oversample, lspp_batch);
     },
     "Computes a selecion of points from the matrix pointed to by smw, returning indexes for selected centers, along with assignments and costs for each point.",
        py::arg("matrix"),
@@ -51,17 +53,23 @@ void init_pydense(py::module &m) {
        py::arg("lspp") = 0,
        py::arg("weights") = py::none(),
        py::arg("expskips") = false,
-       py::arg("n_local_trials") = 1
+       py::arg("n_local_trials") = 1,
+       py::arg("kmeans_parallel") = false,
+       py::arg("kmpar_rounds") = 0,
+       py::arg("oversample") = 2.,
+       py::arg("lspp_batch") = 1
     );
      m.def("kmeanspp", [](py::array_t<double, py::array::c_style> arr, int k, py::object measure, py::object prior, py::object seed, py::object ntimes,
-                          py::object lspp, py::object weights, py::object expskips, py::object local_trials) -> py::object {
+                          py::object lspp, py::object weights, py::object expskips, py::object local_trials,
+                          bool use_kmeans_parallel, py::ssize_t kmpar_rounds, double oversample, py::ssize_t lspp_batch) -> py::object {
         auto dm = assure_dm(measure);
         auto arri = arr.request();
         if(arri.ndim != 2) throw std::invalid_argument("Wrong number of dimensions");
         blz::CustomMatrix<double, unaligned, unpadded, rowMajor> cm((double *)arri.ptr, arri.shape[0], arri.shape[1], arri.strides[0] / sizeof(double));
         std::fprintf(stderr, "Doing kmeans++ over matrix at %p with doubles\n", arri.ptr);
         return py_kmeanspp_noso_dense(cm, py::int_(int(dm)), py::int_(k), prior.cast<double>(), seed.cast<py::ssize_t>(), std::max(ntimes.cast<int>() - 1, 0),
-                             lspp.cast<py::ssize_t>(), expskips.cast<bool>(), local_trials.cast<py::ssize_t>(), weights);
+                             lspp.cast<py::ssize_t>(), expskips.cast<bool>(), local_trials.cast<py::ssize_t>(), weights,
+                             use_kmeans_parallel, kmpar_rounds, oversample, lspp_batch);
     },
     "Computes a selecion of points from the matrix pointed to by smw, returning indexes for selected centers, along with assignments and costs for each point.",
        py::arg("matrix"),
@@ -73,7 +81,11 @@ void init_pydense(py::module &m) {
        py::arg("lspp") = 0,
        py::arg("weights") = py::none(),
        py::arg("expskips") = false,
-       py::arg("n_local_trials") = 1
+       py::arg("n_local_trials") = 1,
+       py::arg("kmeans_parallel") = false,
+       py::arg("kmpar_rounds") = 0,
+       py::arg("oversample") = 2.,
+       py::arg("lspp_batch") = 1
     );
 
     m.def("greedy_select", mat2tup<double>,
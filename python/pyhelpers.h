@@ -10,6 +10,65 @@ namespace py = pybind11;
 
 static std::string standardize_dtype(std::string x);
 
+// Whether clustering functions record telemetry and return it under "stats"; see set_telemetry
+inline bool &telemetry_enabled() {
+    static bool ret = false;
+    return ret;
+}
+
+inline py::dict telemetry2dict(const util::Telemetry &tel) {
+    py::dict phases;
+    for(const auto &p: tel.phases_)
+        phases[py::str(p.name_)] = py::dict("ms"_a = p.ms_, "calls"_a = p.calls_,
+                                            "distance_evals"_a = p.distance_evals_, "bytes"_a = p.bytes_);
+    return py::dict("phases"_a = phases, "iterations"_a = tel.iterations(), "distance_evals"_a = tel.distance_evals(),
+                    "iteration_ms"_a = py::array_t<double>(tel.iteration_ms_.size(), tel.iteration_ms_.data()),
+                    "iteration_costs"_a = py::array_t<double>(tel.iteration_costs_.size(), tel.iteration_costs_.data()),
+                    "json"_a = tel.to_json());
+}
+
+/*
+ * Output buffers
+ * Functions taking out= write results directly into caller-provided arrays instead of allocating new ones.
+ * An output array must be writeable, C-contiguous and of exactly the result's dtype and shape; it is never converted,
+ * so a mismatch throws before any work is done. If out is None, a new array is allocated.
+ */
+inline py::array prepare_out(py::object out, const char *dtype, const std::vector<py::ssize_t> &shape, const std::string &name="out") {
+    const py::dtype dt(dtype);
+    if(out.is_none()) return py::array(dt, shape);
+    if(!py::isinstance<py::array>(out)) throw std::invalid_argument(name + " must be a numpy array");
+    py::array arr = py::reinterpret_borrow<py::array>(out);
+    if(!arr.dtype().equal(dt))
+        throw std::invalid_argument(name + " must have dtype " + std::string(py::str(dt)) + ", not " + std::string(py::str(arr.dtype())));
+    if(arr.ndim() != py::ssize_t(shape.size()) || !std::equal(shape.begin(), shape.end(), arr.shape())) {
+        auto shape2str = [](const py::ssize_t *p, size_t n) {
+            std::string ret = "(";
+            for(size_t i = 0; i < n; ++i) ret += (i ? ", ": "") + std::to_string(p[i]);
+            return ret + ")";
+        };
+        throw std::invalid_argument(name + " has shape " + shape2str(arr.shape(), arr.ndim()) + ", expected " + shape2str(shape.data(), shape.size()));
+    }
+    if(!(arr.flags() & py::array::c_style)) throw std::invalid_argument(name + " must be C-contiguous");
+    if(!arr.writeable()) throw std::invalid_argument(name + " must be writeable");
+    return arr;
+}
+
+// For functions with several outputs, out= is a dict mapping result names to arrays; returns it, or an empty dict for None
+inline py::dict out2dict(py::object out, std::initializer_list<const char *> keys) {
+    if(out.is_none()) return py::dict();
+    if(!py::isinstance<py::dict>(out)) throw std::invalid_argument("out must be a dict mapping result names to arrays");
+    py::dict ret = py::reinterpret_borrow<py::dict>(out);
+    for(const auto &item: ret) {
+        const std::string key = py::str(item.first);
+        if(std::find_if(keys.begin(), keys.end(), [&key](const char *k) {return key == k;}) == keys.end())
+            throw std::invalid_argument(std::string("Unexpected key in out: ") + key);
+    }
+    return ret;
+}
+inline py::object out_entry(const py::dict &out, const char *key) {
+    return out.contains(key) ? py::object(out[key]): py::object(py::none());
+}
+
 template<typename VT, bool SO>
 py::object sparse2pysr(const blaze::CompressedVector<VT, SO> &_x) {
     const auto &x = *_x;
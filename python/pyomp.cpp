@@ -23,6 +23,9 @@ struct OMPThreadNumManager {
 void init_omp_helpers(py::module &m) {
     m.def("set_num_threads", threadsetter);
     m.def("get_num_threads", threadgetter);
+    m.def("set_telemetry", [](bool x) {telemetry_enabled() = x;}, py::arg("enabled") = true,
+          "If enabled, clustering functions return per-phase timings and counters under the key 'stats'.");
+    m.def("get_telemetry", []() {return telemetry_enabled();});
     py::class_<OMPThreadNumManager>(m, "Threading").def(py::init<>()).def(py::init<py::ssize_t>())
     .def_property("nthreads", &OMPThreadNumManager::get, &OMPThreadNumManager::set)
     .def_property("p", &OMPThreadNumManager::get, &OMPThreadNumManager::set);
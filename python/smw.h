@@ -179,7 +179,7 @@ public:
 template<typename Mat>
 inline py::object py_kmeanspp_noso(Mat &smw, py::object msr, py::int_ k, double gamma_beta, uint64_t seed, unsigned ntimes,
                           py::ssize_t lspp, bool use_exponential_skips, py::ssize_t n_local_trials,
-                          py::object weights)
+                          py::object weights, bool use_kmeans_parallel=false, py::ssize_t kmpar_rounds=0, double oversample=2., py::ssize_t lspp_batch=1)
     {
         if(gamma_beta < 0.) {
             gamma_beta = 1. / smw.columns();
@@ -243,11 +243,16 @@ inline py::object py_kmeanspp_noso(Mat &smw, py::object msr, py::int_ k, double
                 case 'd': case -1: break;
                 default: throw std::runtime_error("Unsupported dtype for weights");
             }
-            auto sol = kmeanspp(cmp, rng, x.rows(), ki, (double *)wptr, lspp, use_exponential_skips, true, n_local_trials);
+            auto seed_centers = [&]() {
+                if(use_kmeans_parallel)
+                    return kmeans_parallel(cmp, rng, x.rows(), ki, (double *)wptr, std::max(kmpar_rounds, py::ssize_t(0)), oversample, lspp, use_exponential_skips);
+                return kmeanspp(cmp, rng, x.rows(), ki, (double *)wptr, lspp, use_exponential_skips, true, n_local_trials, std::max(lspp_batch, py::ssize_t(1)));
+            };
+            auto sol = seed_centers();
             auto solc = sum(std::get<2>(sol));
             for(auto nt = 0u;nt < ntimes; ++nt) {
-                auto sol2 = kmeanspp(cmp, rng, x.rows(), ki, (double *)wptr, lspp, use_exponential_skips, true, n_local_trials);
-                auto sol2c = sum(std::get<2>(sol));
+                auto sol2 = seed_centers();
+                auto sol2c = sum(std::get<2>(sol2));
                 if(sol2c < solc) {
                     std::swap(sol2, sol);
                     std::swap(sol2c, solc);
@@ -297,7 +302,7 @@ inline py::tuple py_kmeanspp_so(const Mat &smw, const SumOpts &sm, py::object we
 template<typename Mat>
 inline py::object py_kmeanspp_noso_dense(Mat &smw, py::object msr, py::int_ k, double gamma_beta, uint64_t seed, unsigned ntimes,
                           py::ssize_t lspp, bool use_exponential_skips, py::ssize_t n_local_trials,
-                          py::object weights)
+                          py::object weights, bool use_kmeans_parallel=false, py::ssize_t kmpar_rounds=0, double oversample=2., py::ssize_t lspp_batch=1)
     {
         if(gamma_beta < 0.) {
             gamma_beta = 1. / smw.columns();
@@ -380,12 +385,17 @@ inline py::object py_kmeanspp_noso_dense(Mat &smw, py::object msr, py::int_ k, d
             default: throw std::runtime_error("Unsupported dtype for weights");
         }
         //std::fprintf(stderr, "Weights: %p\n", tmpw.get());
-        auto sol = kmeanspp(cmp, rng, smw.rows(), ki, (double *)wptr, lspp, use_exponential_skips, true, n_local_trials);
+        auto seed_centers = [&]() {
+            if(use_kmeans_parallel)
+                return kmeans_parallel(cmp, rng, smw.rows(), ki, (double *)wptr, std::max(kmpar_rounds, py::ssize_t(0)), oversample, lspp, use_exponential_skips);
+            return kmeanspp(cmp, rng, smw.rows(), ki, (double *)wptr, lspp, use_exponential_skips, true, n_local_trials, std::max(lspp_batch, py::ssize_t(1)));
+        };
+        auto sol = seed_centers();
         //std::fprintf(stderr, "Performed first kmeans++\n");
         auto solc = sum(std::get<2>(sol));
         for(auto nt = 0u;nt < ntimes; ++nt) {
             //std::fprintf(stderr, "Performing %dth kmeans++\n", nt + 1);
-            auto sol2 = kmeanspp(cmp, rng, smw.rows(), ki, (double *)wptr, lspp, use_exponential_skips, true, n_local_trials);
+            auto sol2 = seed_centers();
             auto sol2c = sum(std::get<2>(sol2));
             if(sol2c < solc) {
                 std::swap(sol2, sol); std::swap(sol2c, solc);
@@ -0,0 +1,57 @@
+import sys
+import argparse
+
+"""
+Compares two result files written by minicore_bench (tab-separated: name, params, median ms, min ms, reps),
+and flags cases whose median time regressed by more than --tolerance relative to the baseline.
+Exits with status 1 if any case regressed, so it can gate upgrades.
+"""
+
+ap = argparse.ArgumentParser()
+ap.add_argument("baseline", type=str, help="Baseline results")
+ap.add_argument("current", type=str, help="Results to check")
+ap.add_argument("--tolerance", type=float, default=0.1, help="Allowed relative slowdown of the median time.")
+ap.add_argument("--min-ms", type=float, default=1., help="Ignore differences smaller than this many milliseconds, which are mostly noise.")
+ap.add_argument("--show-all", action="store_true", help="Print every case, not just regressions and improvements.")
+ap = ap.parse_args()
+
+
+def parse(path):
+    ret = {}
+    with open(path) as f:
+        for line in f:
+            if line.startswith("#") or not line.strip():
+                continue
+            name, params, median, mn, reps = line.rstrip("\n").split("\t")
+            ret[(name, params)] = (float(median), float(mn), int(reps))
+    return ret
+
+
+baseline = parse(ap.baseline)
+current = parse(ap.current)
+
+regressions = 0
+print("#Status\tName\tParams\tBaselineMs\tCurrentMs\tRatio")
+for key in sorted(set(baseline) | set(current)):
+    name, params = key
+    if key not in current:
+        print("MISSING\t%s\t%s\t%g\t-\t-" % (name, params, baseline[key][0]))
+        continue
+    if key not in baseline:
+        print("NEW\t%s\t%s\t-\t%g\t-" % (name, params, current[key][0]))
+        continue
+    old, new = baseline[key][0], current[key][0]
+    ratio = new / old if old > 0 else float("inf")
+    if new - old > ap.min_ms and ratio > 1. + ap.tolerance:
+        status = "REGRESSION"
+        regressions += 1
+    elif old - new > ap.min_ms and ratio < 1. - ap.tolerance:
+        status = "IMPROVEMENT"
+    elif ap.show_all:
+        status = "OK"
+    else:
+        continue
+    print("%s\t%s\t%s\t%g\t%g\t%0.3f" % (status, name, params, old, new, ratio))
+
+print("%d regression(s) in %d shared case(s)" % (regressions, len(set(baseline) & set(current))), file=sys.stderr)
+sys.exit(1 if regressions else 0)
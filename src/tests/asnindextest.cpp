@@ -0,0 +1,49 @@
+#undef NDEBUG
+#include "minicore/clustering/asnindex.h"
+#include <random>
+#include <algorithm>
+#include <cassert>
+
+using namespace minicore;
+
+// Every row is listed once, under its own cluster, in increasing order
+void check(const AssignmentIndex<uint32_t> &idx, const std::vector<uint32_t> &asn, size_t k) {
+    assert(idx.ncenters() == k && idx.perm_.size() == asn.size() && idx.offsets_[k] == asn.size());
+    std::vector<uint8_t> seen(asn.size());
+    for(size_t c = 0; c < k; ++c) {
+        for(const auto i: idx[c]) {
+            assert(asn[i] == c && !seen[i]);
+            seen[i] = 1;
+        }
+        assert(std::is_sorted(idx.begin(c), idx.end(c)));
+    }
+    assert(std::find(seen.begin(), seen.end(), 0) == seen.end());
+}
+
+int main() {
+    const size_t np = 50000, k = 37;
+    std::mt19937_64 mt(5);
+    std::vector<uint32_t> asn(np);
+    for(auto &a: asn) a = mt() % (k - 1); // Leaves the last cluster empty
+    OMP_ONLY(omp_set_num_threads(4);)
+    AssignmentIndex<uint32_t> idx(asn, np, k);
+    check(idx, asn, k);
+    assert(idx.orphans() == std::vector<uint32_t>{k - 1});
+    // Inside another parallel region, build's team may be smaller than the number of blocks it asks for
+    OMP_ONLY(omp_set_max_active_levels(1);)
+    std::vector<AssignmentIndex<uint32_t>> nested(4);
+    OMP_PRAGMA("omp parallel for num_threads(4)")
+    for(size_t i = 0; i < nested.size(); ++i)
+        nested[i].build(asn, np, k);
+    for(const auto &n: nested) {
+        check(n, asn, k);
+        assert(n.perm_ == idx.perm_ && n.offsets_ == idx.offsets_);
+    }
+    bool threw = false;
+    asn[7] = k;
+    try {
+        idx.build(asn, np, k);
+    } catch(const std::out_of_range &) {threw = true;}
+    assert(threw);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,94 @@
+#undef NDEBUG
+#include "minicore/coreset/kcenter.h"
+#include <random>
+#include <cassert>
+
+using namespace minicore;
+using coresets::outliers::detail::update_nearest_centers;
+using coresets::outliers::detail::farthest_points;
+
+using PT = std::pair<double, uint32_t>;
+
+// Sequential reference: the z largest nonzero (distance, index) pairs, in descending order
+std::vector<PT> ref_farthest(const std::vector<double> &distances, size_t z) {
+    std::vector<PT> all;
+    for(size_t i = 0; i < distances.size(); ++i)
+        if(distances[i] != 0.) all.emplace_back(distances[i], i);
+    std::sort(all.begin(), all.end(), std::greater<>());
+    all.resize(std::min(all.size(), z));
+    return all;
+}
+
+template<typename Oracle>
+void check_helpers(const Oracle &oracle, size_t np, std::mt19937_64 &mt) {
+    std::vector<uint32_t> ctrs;
+    for(size_t i = 0; i < 24; ++i) ctrs.push_back(mt() % np);
+    std::vector<double> distances(np, std::numeric_limits<double>::max()), refdistances(distances);
+    std::vector<uint32_t> labels(np, uint32_t(-1)), reflabels(labels);
+    for(const size_t c: {0u, 3u, 11u}) distances[c] = refdistances[c] = 0.;
+    // Two batches, as in successive rounds
+    for(const auto [s, e]: {std::pair<size_t, size_t>{0, 8}, std::pair<size_t, size_t>{8, ctrs.size()}}) {
+        update_nearest_centers(oracle, np, ctrs.data() + s, e - s, distances.data(), labels.data());
+        for(size_t i = 0; i < np; ++i) {
+            if(refdistances[i] == 0.) continue;
+            for(size_t j = s; j < e; ++j)
+                if(const double d = oracle(i, ctrs[j]); d < refdistances[i])
+                    refdistances[i] = d, reflabels[i] = ctrs[j];
+        }
+        assert(distances == refdistances);
+        assert(labels == reflabels);
+    }
+    for(const size_t z: {size_t(0), size_t(1), size_t(17), size_t(1000), np / 3, np + 5}) {
+        auto far = farthest_points<double, uint32_t>(distances.data(), np, z);
+        std::sort(far.begin(), far.end(), std::greater<>());
+        assert(far == ref_farthest(distances, z));
+    }
+}
+
+int main() {
+    const size_t nc = 3;
+    std::mt19937_64 mt(23);
+    std::normal_distribution<double> nd;
+    // Large enough that farthest_points splits the rows over several threads
+    for(const size_t np: {size_t(1000), size_t(70000)}) {
+        blz::DM<double> mat(np, nc);
+        for(size_t i = 0; i < np; ++i)
+            for(size_t j = 0; j < nc; ++j)
+                mat(i, j) = nd(mt);
+        // Duplicated rows produce ties and extra points at distance 0
+        for(size_t i = 0; i < np / 10; ++i) row(mat, np - 1 - i) = row(mat, i);
+        auto oracle = [&mat](size_t i, size_t j) -> double {return blz::sqrNorm(row(mat, i) - row(mat, j));};
+        check_helpers(oracle, np, mt);
+        // Under an enclosing parallel region, nested regions get teams of one thread
+        OMP_ONLY(omp_set_max_active_levels(1);)
+        OMP_PRAGMA("omp parallel for num_threads(4)")
+        for(int rep = 0; rep < 4; ++rep) {
+            std::mt19937_64 lmt(rep);
+            check_helpers(oracle, np, lmt);
+        }
+        // Against brute force: labels are nearest centers, and the outliers are exactly the farthest points
+        std::mt19937_64 rng(np);
+        const double eps = .5, gamma = .002;
+        auto bic = coresets::outliers::kcenter_bicriteria(oracle, np, rng, 0, eps, gamma, 20);
+        auto &ctrs = bic.centers();
+        assert(shared::flat_hash_set<uint32_t>(ctrs.begin(), ctrs.end()).size() == ctrs.size());
+        std::vector<double> mindist(np);
+        OMP_PFOR
+        for(size_t i = 0; i < np; ++i) {
+            double best = std::numeric_limits<double>::max();
+            for(const auto c: ctrs) best = std::min(best, oracle(i, c));
+            mindist[i] = best;
+            assert(oracle(i, bic.labels()[i]) == best);
+        }
+        auto outliers = bic.outliers();
+        std::sort(outliers.begin(), outliers.end(), std::greater<>());
+        // Same constants as kcenter_bicriteria, with eta = 0.01
+        const size_t z = std::ceil(gamma * np), nsamp = std::min(np, size_t(std::ceil(std::log(100.) / (1. - gamma))));
+        size_t nfar = std::ceil((1. + eps) * z);
+        if(nsamp > nfar) nfar = nsamp + z;
+        const auto refout = ref_farthest(mindist, nfar);
+        assert(outliers == refout);
+        assert(bic.outlier_threshold() == (refout.empty() ? 0.: refout.back().first));
+    }
+    return EXIT_SUCCESS;
+}
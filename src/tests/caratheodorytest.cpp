@@ -0,0 +1,55 @@
+#undef NDEBUG
+#include "minicore/wip/caratheodory.h"
+#include <random>
+#include <cassert>
+
+using namespace minicore;
+
+// The coreset has at most d + 1 points, drawn from those with positive weight, and the input's total weight and weighted mean
+template<typename CS>
+void check(const blaze::DynamicMatrix<double> &mat, const std::vector<double> &w, const CS &cs) {
+    const size_t n = mat.rows(), d = mat.columns();
+    assert(cs.size() <= d + 1);
+    const double wsum = std::accumulate(w.begin(), w.end(), 0.);
+    blaze::DynamicVector<double, blaze::rowVector> mean(d, 0.), csmean(d, 0.);
+    for(size_t i = 0; i < n; ++i) mean += w[i] * row(mat, i);
+    double cswsum = 0.;
+    for(size_t i = 0; i < cs.size(); ++i) {
+        assert(cs.weights_[i] > 0. && w[cs.indices_[i]] > 0.);
+        csmean += cs.weights_[i] * row(mat, cs.indices_[i]);
+        cswsum += cs.weights_[i];
+    }
+    assert(std::abs(cswsum - wsum) <= 1e-9 * wsum);
+    assert(blaze::max(blaze::abs(mean / wsum - csmean / cswsum)) <= 1e-8);
+}
+
+int main() {
+    std::mt19937_64 mt(7);
+    std::normal_distribution<double> nd;
+    std::uniform_real_distribution<double> urd;
+    for(const size_t n: {5, 100, 50000}) {
+        for(const size_t d: {1, 4, 16}) {
+            blaze::DynamicMatrix<double> mat(n, d);
+            for(auto &v: mat) v = 10. * nd(mt) + 3.;
+            std::vector<double> w(n);
+            for(auto &v: w) v = urd(mt) < .1 ? 0.: urd(mt);
+            check(mat, w, fast_caratheodory<uint32_t, double>(mat, w.data()));
+            if(n <= 100) check(mat, w, caratheodory<uint32_t, double>(mat, w.data()));
+        }
+    }
+    // The fewest chunks allowed, d + 2, with sizes that used to round down to d + 1 nonempty chunks (e.g., d = 1, n = 4)
+    for(const size_t d: {1, 2, 5}) {
+        for(const size_t n: {d + 3, 2 * d + 3, 4 * d + 5, size_t(1000)}) {
+            blaze::DynamicMatrix<double> mat(n, d);
+            for(auto &v: mat) v = nd(mt);
+            std::vector<double> w(n, 1.);
+            check(mat, w, fast_caratheodory<uint32_t, double>(mat, w.data(), d + 2));
+        }
+    }
+    {
+        blaze::DynamicMatrix<double> mat{{0.}, {1.}, {2.}, {3.}};
+        std::vector<double> w(4, 1.);
+        check(mat, w, fast_caratheodory<uint32_t, double>(mat, w.data(), 3));
+    }
+    return 0;
+}
@@ -0,0 +1,90 @@
+#include "minicore/coreset/evaluate.h"
+#include <chrono>
+#include <getopt.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace minicore;
+
+auto t() {return std::chrono::high_resolution_clock::now();}
+
+/*
+ * Coreset quality benchmark: samples coresets of each requested size for every sensitivity method,
+ * then reports the max and mean distortion of the coreset cost over Q random center sets.
+ * With -D, exits with failure if any max distortion exceeds the threshold, for use as a regression test.
+ */
+
+int main(int argc, char *argv[]) {
+    size_t npoints = 20000, ncols = 20, nq = 32;
+    unsigned k = 10;
+    dist::DissimilarityMeasure msr = dist::SQRL2;
+    double max_allowed = std::numeric_limits<double>::infinity();
+    std::vector<size_t> sizes;
+    uint64_t seed = 13;
+    for(int c;(c = getopt(argc, argv, "n:d:k:Q:c:m:D:s:p:h?")) >= 0;) {switch(c) {
+        case 'n': npoints = std::strtoull(optarg, nullptr, 10); break;
+        case 'd': ncols = std::strtoull(optarg, nullptr, 10); break;
+        case 'k': k = std::atoi(optarg); break;
+        case 'Q': nq = std::strtoull(optarg, nullptr, 10); break;
+        case 'c': sizes.push_back(std::strtoull(optarg, nullptr, 10)); break;
+        case 'm': msr = (dist::DissimilarityMeasure)std::atoi(optarg); break;
+        case 'D': max_allowed = std::atof(optarg); break;
+        case 's': seed = std::strtoull(optarg, nullptr, 10); break;
+        case 'p': OMP_ONLY(omp_set_num_threads(std::atoi(optarg));) break;
+        case '?':
+        case 'h': dist::print_measures();
+                std::fprintf(stderr, "Usage: %s <flags>\n-n: number of points [20000]\n-d: dimension [20]\n-k: number of centers [10]\n"
+                                     "-Q: number of random center sets [32]\n-c: coreset size (repeatable) [100, 500, 2500]\n"
+                                     "-m: measure [SQRL2]\n-D: fail if any max distortion exceeds this\n-s: seed [13]\n-p: number of threads\n", *argv);
+                return EXIT_FAILURE;
+    }}
+    if(sizes.empty()) sizes = {100, 500, 2500};
+    wy::WyRand<uint64_t> rng(seed);
+    std::uniform_real_distribution<double> urd;
+    // Clustered data: k Gaussian-ish blobs of positive values, so probability measures are also valid
+    blz::DM<double> centers(k, ncols), data(npoints, ncols);
+    for(auto &v: centers) v = 10. * urd(rng);
+    for(size_t i = 0; i < npoints; ++i) {
+        const auto c = rng() % k;
+        for(size_t j = 0; j < ncols; ++j) data(i, j) = std::abs(centers(c, j) + urd(rng) - .5) + 1e-3;
+    }
+    auto app = jsd::make_probdiv_applicator(data, msr);
+    auto [ctrs, asn, costs] = jsd::make_kmeanspp(app, k, seed);
+    std::vector<float> fcosts(costs.begin(), costs.end());
+    std::vector<uint32_t> fasn(asn.begin(), asn.end());
+    // Random center sets: each is k points of the data
+    std::vector<std::vector<blz::DV<double, blz::rowVector>>> centersets(nq);
+    for(auto &cs: centersets)
+        for(unsigned i = 0; i < k; ++i)
+            cs.emplace_back(row(app.data(), rng() % npoints));
+    auto start = t();
+    const auto full = center_set_costs(app, centersets);
+    auto stop = t();
+    std::fprintf(stderr, "Full-data costs for %zu center sets of %u in a blocked pass: %0.6gms\n", nq, k, util::timediff2ms(stop, start));
+    start = t();
+    for(const auto &cs: centersets) {
+        std::vector<double> one = center_set_costs(app, std::vector<std::vector<blz::DV<double, blz::rowVector>>>{cs});
+        (void)one;
+    }
+    stop = t();
+    std::fprintf(stderr, "Full-data costs, one pass per center set: %0.6gms\n", util::timediff2ms(stop, start));
+    int ret = EXIT_SUCCESS;
+    std::fprintf(stdout, "#Method\tSize\tMaxDistortion\tMeanDistortion\tms\n");
+    for(const auto sm: {coresets::BFL, coresets::VX, coresets::LBK}) {
+        coresets::CoresetSampler<float, uint32_t> sampler;
+        sampler.make_sampler(npoints, k, fcosts.data(), fasn.data(), static_cast<float *>(nullptr), seed + 1, sm);
+        for(const auto sz: sizes) {
+            start = t();
+            auto cs = sampler.sample(sz, seed + sz);
+            auto q = evaluate_coreset(app, cs, centersets);
+            stop = t();
+            std::fprintf(stdout, "%s\t%zu\t%0.6g\t%0.6g\t%0.6g\n", coresets::sm2str(sm), sz, q.max_distortion_, q.mean_distortion_, util::timediff2ms(stop, start));
+            if(q.max_distortion_ > max_allowed) {
+                std::fprintf(stderr, "%s coreset of size %zu exceeds the allowed distortion (%g > %g)\n", coresets::sm2str(sm), sz, q.max_distortion_, max_allowed);
+                ret = EXIT_FAILURE;
+            }
+        }
+    }
+    return ret;
+}
@@ -33,4 +33,24 @@ int main() {
         sampler2.sample(ind);
     }
     //if(0) sampler.make_sampler(10, 10, nullptr, nullptr);
+    // Sensitivities computed inside another parallel region, whose teams may be smaller than requested, match those computed outside
+    {
+        const size_t bign = 200000;
+        std::vector<uint32_t> basn(bign);
+        std::vector<float> bcosts(bign);
+        for(auto &v: basn) v = std::rand() % ncenters;
+        for(auto &v: bcosts) v = std::rand() % 7;
+        OMP_ONLY(omp_set_num_threads(4);)
+        for(const auto sens: {coresets::BFL, coresets::VX, coresets::LBK}) {
+            coresets::CoresetSampler<float, uint32_t> ref;
+            ref.make_sampler(bign, ncenters, bcosts.data(), basn.data(), (double *)nullptr, 13, sens);
+            OMP_ONLY(omp_set_max_active_levels(1);)
+            std::vector<coresets::CoresetSampler<float, uint32_t>> nested(4);
+            OMP_PRAGMA("omp parallel for num_threads(4)")
+            for(size_t i = 0; i < nested.size(); ++i)
+                nested[i].make_sampler(bign, ncenters, bcosts.data(), basn.data(), (double *)nullptr, 13, sens);
+            for(const auto &n: nested)
+                assert(std::equal(n.probs_.get(), n.probs_.get() + bign, ref.probs_.get()));
+        }
+    }
 }
@@ -0,0 +1,64 @@
+#undef NDEBUG
+#include "minicore/dist/csrcache.h"
+#include <random>
+#include <cassert>
+
+using namespace minicore;
+
+int main() {
+    const size_t nr = 100, nc = 200, k = 5;
+    std::mt19937_64 mt(13);
+    std::uniform_real_distribution<double> urd;
+    std::vector<double> data;
+    std::vector<uint32_t> indices;
+    std::vector<uint64_t> indptr{0};
+    for(size_t i = 0; i < nr; ++i) {
+        for(size_t j = 0; j < nc; ++j) {
+            if(urd(mt) < .1) {
+                data.push_back(urd(mt) * 10.);
+                indices.push_back(j);
+            }
+        }
+        indptr.push_back(data.size());
+    }
+    util::CSparseMatrix<double, uint32_t, uint64_t> mat(data.data(), indices.data(), indptr.data(), nr, nc, data.size());
+    std::vector<blz::DV<double, blz::rowVector>> centers(k, blz::DV<double, blz::rowVector>(nc));
+    for(auto &c: centers) for(auto &v: c) v = urd(mt) < .5 ? urd(mt): 0.;
+    blz::DV<double> rowsums(nr);
+    for(size_t i = 0; i < nr; ++i) rowsums[i] = sum(row(mat, i, unchecked));
+    const dist::DissimilarityMeasure msrs[] {dist::L1, dist::L2, dist::SQRL2, dist::HELLINGER, dist::BHATTACHARYYA_METRIC,
+                                             dist::BHATTACHARYYA_DISTANCE, dist::MKL, dist::REVERSE_MKL};
+    for(const double pval: {0., 1e-3, 1.}) {
+        blz::DV<double> prior{pval};
+        cmp::CSRTransformCache<double> cache(mat, prior);
+        assert(cache.bytes() > 0);
+        auto sqrtview = cache.view(mat, cmp::CSR_SQRT);
+        assert(sqrtview.nnz() == mat.nnz());
+        for(const auto msr: msrs) {
+            if(!cache.supports(msr)) {
+                assert(pval == 0. && (msr == dist::MKL || msr == dist::REVERSE_MKL));
+                continue;
+            }
+            for(size_t j = 0; j < k; ++j) {
+                cmp::CenterTransforms<double> ct;
+                const double csum = sum(centers[j]);
+                ct.build(msr, centers[j], csum, cache.prior_value());
+                for(size_t i = 0; i < nr; ++i) {
+                    const double v = cmp::cached_msr_with_prior(msr, cache, mat, i, centers[j], ct);
+                    const double ref = cmp::msr_with_prior<double>(msr, row(mat, i, unchecked), centers[j], prior, pval * nc, rowsums[i], csum);
+                    // Hellinger and Bhattacharyya are computed as 1 - BC, which loses relative precision for nearby points
+                    assert(std::abs(v - ref) <= 1e-6 * std::max(1., std::abs(ref))
+                           || !std::fprintf(stderr, "%s, prior %g, row %zu, center %zu: cached %0.12g vs %0.12g\n", dist::msr2str(msr), pval, i, j, v, ref));
+                }
+            }
+        }
+    }
+    // A narrower mask keeps less and supports fewer measures
+    cmp::CSRTransformCache<float> small(mat, blz::DV<double>{1.}, cmp::CSR_ROW_CONSTANTS);
+    assert(small.supports(dist::SQRL2));
+    assert(small.supports(dist::L1));
+    assert(!small.supports(dist::HELLINGER));
+    assert(!small.supports(dist::MKL));
+    assert(small.log_.empty() && small.sqrt_.empty() && small.normalized_.empty());
+    return 0;
+}
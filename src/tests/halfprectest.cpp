@@ -0,0 +1,121 @@
+#undef NDEBUG
+#include "minicore/clustering/restarts.h"
+#include "minicore/clustering/ksweep.h"
+#include <random>
+#include <cassert>
+
+using namespace minicore;
+using util::float16_t;
+using util::bfloat16_t;
+
+void test_conversions() {
+    assert(float16_t(1.f).bits_ == 0x3C00u && float16_t(-2.f).bits_ == 0xC000u);
+    assert(float16_t(65504.f).bits_ == 0x7BFFu && float16_t(65520.f).bits_ == 0x7C00u);
+    assert(float16_t(0x1p-24f).bits_ == 0x0001u && float16_t(0x1p-26f).bits_ == 0u);
+    assert(float16_t(1.f + 0x1p-11f).bits_ == 0x3C00u && float16_t(1.f + 3 * 0x1p-11f).bits_ == 0x3C02u); // Ties to even
+    assert(bfloat16_t(1.f).bits_ == 0x3F80u && bfloat16_t(-2.f).bits_ == 0xC000u);
+    assert(bfloat16_t(1.f + 0x1p-8f).bits_ == 0x3F80u && bfloat16_t(1.f + 3 * 0x1p-8f).bits_ == 0x3F82u);
+    // Every non-NaN 16-bit value survives a round trip through float
+    std::vector<float16_t> h(1 << 16), h2(1 << 16);
+    std::vector<bfloat16_t> b(1 << 16), b2(1 << 16);
+    for(uint32_t i = 0; i < (1u << 16); ++i) h[i] = float16_t::from_bits(i), b[i] = bfloat16_t::from_bits(i);
+    std::vector<float> f(1 << 16);
+    util::decode(h.data(), f.data(), f.size());
+    util::encode(f.data(), h2.data(), f.size());
+    for(uint32_t i = 0; i < (1u << 16); ++i) {
+        assert(float(h[i]) == f[i] || std::isnan(f[i]));
+        assert(h2[i].bits_ == i || std::isnan(f[i]));
+    }
+    util::decode(b.data(), f.data(), f.size());
+    util::encode(f.data(), b2.data(), f.size());
+    for(uint32_t i = 0; i < (1u << 16); ++i) assert(b2[i].bits_ == i || std::isnan(f[i]));
+}
+
+bool approx_equal(double x, double y, double rtol) {return std::abs(x - y) <= rtol * std::max({1., std::abs(x), std::abs(y)});}
+
+/*
+ * Checks one solution on 16-bit storage against the same solution on the decoded float matrix.
+ * They agree up to the order of summation: util::sum<rowwise> accumulates 16-bit rows in double, while blaze sums float rows in float.
+ * With the same assignments, costs and centers agree to 1e-5; otherwise only a few rows may differ, and the total cost to 1e-3.
+ */
+template<typename CtrT>
+void check_solution(const blz::DV<uint32_t> &hasn, const blz::DV<uint32_t> &dasn, const blz::DV<double> &hcosts, const blz::DV<double> &dcosts,
+                    const std::vector<CtrT> &hctrs, const std::vector<CtrT> &dctrs) {
+    const size_t nr = hasn.size();
+    assert(dasn.size() == nr && hctrs.size() == dctrs.size());
+    size_t nmismatch = 0;
+    for(size_t i = 0; i < nr; ++i) nmismatch += hasn[i] != dasn[i];
+    if(nmismatch == 0) {
+        for(size_t i = 0; i < nr; ++i) assert(approx_equal(hcosts[i], dcosts[i], 1e-5));
+        for(size_t j = 0; j < hctrs.size(); ++j)
+            for(size_t c = 0; c < hctrs[j].size(); ++c)
+                assert(approx_equal(hctrs[j][c], dctrs[j][c], 1e-5));
+    } else {
+        std::fprintf(stderr, "%zu/%zu assignments differ\n", nmismatch, nr);
+        assert(nmismatch <= std::max(size_t(2), nr / 100));
+        assert(approx_equal(sum(hcosts), sum(dcosts), 1e-3));
+    }
+}
+
+// 16-bit storage gives the results of the same data decoded to a float matrix, up to the order of summation
+template<typename HT>
+void run(const std::vector<double> &data, size_t nr, size_t nc, dist::DissimilarityMeasure msr, size_t k) {
+    const util::HalfDenseMatrix<HT> half(data.data(), nr, nc);
+    blz::DM<float> decoded(nr, nc);
+    for(size_t i = 0; i < nr; ++i) row(decoded, i) = row(half, i);
+    blz::DV<double> prior{msr == dist::SQRL2 ? 0.: 1.};
+    std::vector<std::vector<blz::DV<float, blz::rowVector>>> init(2);
+    for(size_t r = 0; r < init.size(); ++r)
+        for(size_t i = 0; i < k; ++i)
+            init[r].emplace_back(row(half, (i * (nr / k) + r * 7) % nr));
+    auto hctrs = init, dctrs = init;
+    std::vector<blz::DV<uint32_t>> hasns, dasns;
+    std::vector<blz::DV<double>> hcosts, dcosts;
+    auto [hbest, hres] = perform_hard_clustering_restarts(half, msr, prior, hctrs, hasns, hcosts, static_cast<blz::DV<double> *>(nullptr), 1e-6, 50);
+    auto [dbest, dres] = perform_hard_clustering_restarts(decoded, msr, prior, dctrs, dasns, dcosts, static_cast<blz::DV<double> *>(nullptr), 1e-6, 50);
+    assert(hres.size() == dres.size());
+    assert(approx_equal(std::get<1>(hres[hbest]), std::get<1>(dres[dbest]), 1e-3));
+    for(size_t r = 0; r < init.size(); ++r) {
+        assert(approx_equal(std::get<0>(hres[r]), std::get<0>(dres[r]), 1e-5));
+        check_solution(hasns[r], dasns[r], hcosts[r], dcosts[r], hctrs[r], dctrs[r]);
+    }
+    std::vector<blz::DV<float, blz::rowVector>> seeds(init[0].begin(), init[0].end());
+    const std::vector<size_t> ks{2, k};
+    std::vector<std::vector<blz::DV<float, blz::rowVector>>> hkctrs, dkctrs;
+    auto hkres = perform_hard_clustering_ksweep(half, msr, prior, seeds, ks, hkctrs, hasns, hcosts);
+    auto dkres = perform_hard_clustering_ksweep(decoded, msr, prior, seeds, ks, dkctrs, dasns, dcosts);
+    assert(hkres.size() == dkres.size() && hkctrs.size() == ks.size() && dkctrs.size() == ks.size());
+    for(size_t i = 0; i < ks.size(); ++i) {
+        assert(approx_equal(std::get<0>(hkres[i]), std::get<0>(dkres[i]), 1e-5));
+        check_solution(hasns[i], dasns[i], hcosts[i], dcosts[i], hkctrs[i], dkctrs[i]);
+    }
+    std::fprintf(stderr, "%s, %s: cost %0.12g -> %0.12g in %zu iterations\n", std::is_same_v<HT, float16_t> ? "fp16": "bf16", dist::msr2str(msr),
+                 std::get<0>(hres[hbest]), std::get<1>(hres[hbest]), std::get<2>(hres[hbest]));
+}
+
+int main() {
+    test_conversions();
+    const size_t nr = 500, nc = 40, k = 6;
+    std::mt19937_64 mt(13);
+    std::uniform_real_distribution<double> urd;
+    std::vector<double> data(nr * nc);
+    for(size_t i = 0; i < nr; ++i)
+        for(size_t j = 0; j < nc; ++j)
+            if(urd(mt) < .3 || j % k == i % k)
+                data[i * nc + j] = urd(mt) * 10. + (j % k == i % k) * 5.;
+    for(const auto msr: {dist::SQRL2, dist::MKL}) {
+        run<float16_t>(data, nr, nc, msr, k);
+        run<bfloat16_t>(data, nr, nc, msr, k);
+    }
+    // Only mean-based policies are supported for 16-bit storage
+    const util::HalfDenseMatrix<float16_t> half(data.data(), nr, nc);
+    std::vector<std::vector<blz::DV<float, blz::rowVector>>> centers{std::vector<blz::DV<float, blz::rowVector>>(k, row(half, 0))};
+    std::vector<blz::DV<uint32_t>> asns;
+    std::vector<blz::DV<double>> costs;
+    bool threw = false;
+    try {
+        perform_hard_clustering_restarts(half, dist::L1, blz::DV<double>{0.}, centers, asns, costs);
+    } catch(const std::invalid_argument &) {threw = true;}
+    assert(threw);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,121 @@
+#undef NDEBUG
+#include "minicore/clustering/incremental.h"
+#include <random>
+#include <cassert>
+
+using namespace minicore;
+
+// Checks that every point is assigned to its nearest center and that costs are current
+template<typename MT, typename CtrT, typename AsnT, typename CostsT>
+void check_assignments(const MT &mat, dist::DissimilarityMeasure msr, const blz::DV<double> &prior,
+                       const std::vector<CtrT> &centers, const AsnT &asn, const CostsT &costs) {
+    const double psum = prior[0] * mat.columns();
+    for(size_t i = 0; i < mat.rows(); ++i) {
+        auto r = row(mat, i, blz::unchecked);
+        const double rsum = sum(r);
+        double best = std::numeric_limits<double>::max();
+        for(size_t j = 0; j < centers.size(); ++j)
+            best = std::min(best, double(cmp::msr_with_prior<double>(msr, r, centers[j], prior, psum, rsum, sum(centers[j]))));
+        const double mine = cmp::msr_with_prior<double>(msr, r, centers[asn[i]], prior, psum, rsum, sum(centers[asn[i]]));
+        assert(std::abs(mine - best) <= 1e-8 * std::max(1., best) || !std::fprintf(stderr, "row %zu: %0.12g vs best %0.12g\n", i, mine, best));
+        assert(std::abs(costs[i] - mine) <= 1e-8 * std::max(1., mine));
+    }
+}
+
+// Relative L2 distance from each center to the mean of the rows assigned to it (or 0 if it has none)
+template<typename MT, typename CtrT, typename AsnT>
+std::vector<double> mean_offsets(const MT &mat, dist::DissimilarityMeasure msr, const std::vector<CtrT> &centers, const AsnT &asn) {
+    const size_t k = centers.size();
+    std::vector<blz::DV<double, blz::rowVector>> sums(k, blz::DV<double, blz::rowVector>(mat.columns(), 0.));
+    std::vector<size_t> counts(k);
+    for(size_t i = 0; i < asn.size(); ++i) {
+        auto r = row(mat, i, blz::unchecked);
+        const double scale = dist::msr_is_normalized(msr) ? 1. / sum(r): 1.;
+        clustering::detail::for_each_nonzero(r, [&](size_t idx, auto v) {sums[asn[i]][idx] += scale * v;});
+        ++counts[asn[i]];
+    }
+    std::vector<double> ret(k);
+    for(size_t j = 0; j < k; ++j)
+        if(counts[j]) ret[j] = blz::l2Norm(sums[j] / counts[j] - centers[j]) / blz::l2Norm(centers[j]);
+    return ret;
+}
+
+// lloyd_iter bounds the clustering of the old rows; with few iterations, centers are not yet the means of their rows
+template<typename OldMT, typename MT>
+void run(const OldMT &oldmat, const MT &mat, dist::DissimilarityMeasure msr, size_t k, size_t lloyd_iter=100) {
+    const size_t nold = oldmat.rows();
+    const double tol = 1e-6;
+    blz::DV<double> prior{msr == dist::SQRL2 ? 0.: 1.};
+    std::vector<blz::DV<double, blz::rowVector>> centers;
+    // Poor seeds, all from the same group of rows, when stopping early
+    for(size_t i = 0; i < k; ++i) centers.emplace_back(row(oldmat, lloyd_iter < 100 ? i * k: i * (nold / k), blz::unchecked));
+    blz::DV<uint32_t> asn(nold);
+    blz::DV<double> costs(nold), rowsums(nold);
+    for(size_t i = 0; i < nold; ++i) rowsums[i] = sum(row(oldmat, i, blz::unchecked));
+    perform_hard_clustering(oldmat, msr, prior, centers, asn, costs, static_cast<blz::DV<double> *>(nullptr), 1e-6, lloyd_iter, &rowsums);
+    const auto oldctrs = centers;
+    if(lloyd_iter < 100) {
+        const auto offs = mean_offsets(oldmat, msr, centers, asn);
+        assert(*std::max_element(offs.begin(), offs.end()) > tol);
+    }
+    TelemetryScope scope;
+    auto [initcost, finalcost, iters] = update_hard_clustering(mat, nold, msr, prior, centers, asn, costs, rowsums, static_cast<blz::DV<double> *>(nullptr), tol, 500);
+    assert(asn.size() == mat.rows() && costs.size() == mat.rows() && rowsums.size() == mat.rows());
+    assert(finalcost <= initcost * (1. + 1e-10));
+    assert(iters == scope.get()->iterations() && iters < 500);
+    check_assignments(mat, msr, prior, centers, asn, costs);
+    // Every center the update replaced is the mean of its rows, not of its rows and its previous center
+    const auto offs = mean_offsets(mat, msr, centers, asn);
+    for(size_t j = 0; j < k; ++j)
+        if(centers[j] != oldctrs[j])
+            assert(offs[j] <= tol * (1. + 1e-6) + 1e-10 || !std::fprintf(stderr, "center %zu is %g from its mean\n", j, offs[j]));
+    for(size_t i = nold; i < mat.rows(); ++i) assert(std::abs(rowsums[i] - sum(row(mat, i, blz::unchecked))) <= 1e-8 * rowsums[i]);
+    // Nothing new: nothing moves, and nothing changes
+    auto asncpy = asn;
+    auto [c2, f2, i2] = update_hard_clustering(mat, mat.rows(), msr, prior, centers, asn, costs, rowsums);
+    assert(i2 == 0 && c2 == f2 && asn == asncpy);
+    std::fprintf(stderr, "%s: %zu new rows, cost %0.12g -> %0.12g in %zu iterations\n", dist::msr2str(msr), mat.rows() - nold, initcost, finalcost, iters);
+}
+
+int main() {
+    const size_t nr = 600, nold = 500, nc = 40, k = 6;
+    std::mt19937_64 mt(7);
+    std::uniform_real_distribution<double> urd;
+    // New rows are drawn from a shifted distribution, so some centers have to move
+    blz::DM<double> dense(nr, nc);
+    for(size_t i = 0; i < nr; ++i)
+        for(size_t j = 0; j < nc; ++j)
+            dense(i, j) = urd(mt) * (1. + (j % k == i % k) * 4.) + (i >= nold && j < 4) * 3.;
+    std::vector<double> data;
+    std::vector<uint32_t> indices;
+    std::vector<uint64_t> indptr{0};
+    for(size_t i = 0; i < nr; ++i) {
+        for(size_t j = 0; j < nc; ++j) {
+            if(urd(mt) < .3 || (i >= nold && j < 4)) {
+                data.push_back(urd(mt) * 10. + (i >= nold) * 5.);
+                indices.push_back(j);
+            }
+        }
+        indptr.push_back(data.size());
+    }
+    util::CSparseMatrix<double, uint32_t, uint64_t> csr(data.data(), indices.data(), indptr.data(), nr, nc, data.size());
+    util::CSparseMatrix<double, uint32_t, uint64_t> oldcsr(data.data(), indices.data(), indptr.data(), nold, nc, indptr[nold]);
+    blaze::CustomMatrix<double, blaze::unaligned, blaze::unpadded> dmat(dense.data(), nr, nc, dense.spacing()), olddmat(dense.data(), nold, nc, dense.spacing());
+    for(const auto msr: {dist::SQRL2, dist::MKL, dist::HELLINGER}) {
+        run(olddmat, dmat, msr, k);
+        run(oldcsr, csr, msr, k);
+        // Starting from an unconverged clustering
+        run(olddmat, dmat, msr, k, 1);
+        run(oldcsr, csr, msr, k, 1);
+    }
+    // Median-based policies have no sums to update
+    std::vector<blz::DV<double, blz::rowVector>> centers(k, row(dmat, 0));
+    blz::DV<uint32_t> asn(nold);
+    blz::DV<double> costs(nold), rowsums(nold);
+    bool threw = false;
+    try {
+        update_hard_clustering(dmat, nold, dist::L1, blz::DV<double>{0.}, centers, asn, costs, rowsums);
+    } catch(const std::invalid_argument &) {threw = true;}
+    assert(threw);
+    return EXIT_SUCCESS;
+}
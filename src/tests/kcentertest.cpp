@@ -0,0 +1,41 @@
+#undef NDEBUG
+#include "minicore/optim/kcenter.h"
+#include <random>
+#include <cassert>
+
+using namespace minicore;
+
+// The pruned traversal must select exactly the centers, and produce exactly the distances, of the unpruned one
+void check(const blz::DM<double> &mat, size_t k, uint64_t seed) {
+    auto oracle = [&mat](size_t i, size_t j) -> double {return blz::l2Norm(row(mat, i) - row(mat, j));};
+    std::mt19937_64 rng1(seed), rng2(seed);
+    auto [refctrs, refdists] = coresets::kcenter_greedy_2approx_costs(oracle, mat.rows(), k, rng1);
+    auto [ctrs, dists] = coresets::kcenter_greedy_2approx_pruned_costs(oracle, mat.rows(), k, rng2);
+    assert(ctrs.size() == k);
+    assert(ctrs == refctrs);
+    assert(dists == refdists);
+}
+
+int main() {
+    std::mt19937_64 mt(17);
+    std::normal_distribution<double> nd;
+    for(const size_t nc: {1, 2, 8}) {
+        for(const size_t nr: {40, 3000}) {
+            blz::DM<double> mat(nr, nc);
+            for(size_t i = 0; i < nr; ++i)
+                for(size_t j = 0; j < nc; ++j)
+                    mat(i, j) = nd(mt);
+            // Duplicated rows: only 7 distinct points
+            const size_t ndistinct = 7;
+            blz::DM<double> dups(nr, nc);
+            for(size_t i = 0; i < nr; ++i) row(dups, i) = row(mat, i % ndistinct);
+            for(const size_t k: {size_t(1), size_t(2), size_t(5), std::min(nr, size_t(60))})
+                check(mat, k, k), check(dups, k, k);
+            // k >= # distinct points, which leaves every distance at 0
+            for(const size_t k: {ndistinct, ndistinct + 1, ndistinct + 5})
+                check(dups, k, k + 1);
+            check(mat, nr, 3);
+        }
+    }
+    return EXIT_SUCCESS;
+}
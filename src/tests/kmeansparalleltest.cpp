@@ -0,0 +1,58 @@
+#undef NDEBUG
+#include "minicore/optim/kmeans.h"
+#include <random>
+#include <cassert>
+
+using namespace minicore;
+
+// k distinct centers, each assignment the nearest returned center, and costs equal to the oracle's distances
+template<typename Oracle, typename Sol>
+void check_solution(const Oracle &oracle, size_t np, size_t k, const Sol &sol) {
+    const auto &[ctrs, asn, costs] = sol;
+    assert(ctrs.size() == k);
+    assert(asn.size() == np);
+    assert(costs.size() == np);
+    assert(shared::flat_hash_set<uint32_t>(ctrs.begin(), ctrs.end()).size() == k);
+    for(const auto c: ctrs) assert(c < np);
+    for(size_t i = 0; i < np; ++i) {
+        assert(asn[i] < k);
+        double mind = std::numeric_limits<double>::max();
+        for(const auto c: ctrs) mind = std::min(mind, oracle(c, i));
+        assert(costs[i] == oracle(ctrs[asn[i]], i));
+        assert(costs[i] == mind);
+    }
+}
+
+int main() {
+    const size_t np = 3000, nc = 5;
+    std::mt19937_64 mt(41);
+    std::normal_distribution<double> nd;
+    blz::DM<double> mat(np, nc);
+    for(size_t i = 0; i < np; ++i)
+        for(size_t j = 0; j < nc; ++j)
+            mat(i, j) = nd(mt) + 8. * (i % 10);
+    auto oracle = [&mat](size_t i, size_t j) -> double {return blz::sqrNorm(row(mat, i) - row(mat, j));};
+    std::vector<double> w(np);
+    for(auto &x: w) x = std::uniform_real_distribution<double>(.1, 3.)(mt);
+    for(const size_t k: {size_t(2), size_t(10), size_t(40)}) {
+        for(const size_t nrounds: {size_t(0), size_t(1), size_t(3)}) {
+            std::mt19937_64 rng(k * 7 + nrounds);
+            check_solution(oracle, np, k, kmeans_parallel(oracle, rng, np, k, static_cast<const double *>(nullptr), nrounds));
+            check_solution(oracle, np, k, kmeans_parallel(oracle, rng, np, k, w.data(), nrounds, 4.));
+        }
+        std::mt19937_64 rng(k);
+        check_solution(oracle, np, k, kmeans_parallel(oracle, rng, np, k, static_cast<const double *>(nullptr), 2, 2., 5));
+    }
+    // Only 3 points have weight, so at most 4 candidates are chosen and k = 6 falls back to kmeans++
+    std::vector<double> sparsew(np, 0.);
+    sparsew[5] = sparsew[500] = sparsew[2999] = 1.;
+    for(uint64_t seed = 0; seed < 4; ++seed) {
+        std::mt19937_64 rng(seed);
+        check_solution(oracle, np, 6, kmeans_parallel(oracle, rng, np, 6, sparsew.data(), 2));
+    }
+    // k <= 1 and np <= k are handled by kmeans++ directly
+    std::mt19937_64 rng(1);
+    check_solution(oracle, np, 1, kmeans_parallel(oracle, rng, np, 1, static_cast<const double *>(nullptr)));
+    check_solution(oracle, 20, 20, kmeans_parallel(oracle, rng, 20, 20, static_cast<const double *>(nullptr)));
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,72 @@
+#undef NDEBUG
+// Small enough that the larger case below exceeds the candidate distance cache
+#define MC_MAX_CANDIDATE_CACHE_BYTES 4096
+#include "minicore/optim/kmeans.h"
+#include <random>
+#include <cassert>
+
+using namespace minicore;
+using coresets::evaluate_candidates;
+using coresets::apply_candidate;
+
+// The fused pass, cached or not, must match evaluating and applying each candidate on its own
+template<typename FT, typename Oracle>
+void check(const Oracle &oracle, size_t np, const double *w, bool parallelize, std::mt19937_64 &mt) {
+    using IT = uint32_t;
+    const size_t L = 8;
+    // Current solution: two centers
+    const IT c0 = mt() % np, c1 = mt() % np;
+    blz::DV<FT> distances(np);
+    std::vector<IT> assignments(np);
+    for(size_t j = 0; j < np; ++j) {
+        const FT d0 = j == c0 ? FT(0): FT(oracle(c0, j)), d1 = j == c1 ? FT(0): FT(oracle(c1, j));
+        distances[j] = std::min(d0, d1), assignments[j] = d1 < d0;
+    }
+    // Includes a current center and a repeated candidate
+    std::vector<IT> cands(L);
+    for(auto &c: cands) c = mt() % np;
+    cands[1] = c0, cands[5] = cands[4];
+    blz::DM<FT> canddists;
+    std::vector<double> candcosts(L);
+    evaluate_candidates(oracle, cands.data(), L, np, distances, w, canddists, candcosts.data(), parallelize);
+    assert((canddists.rows() == np) == (np * L * sizeof(FT) <= coresets::MAX_CANDIDATE_CACHE_BYTES));
+    for(size_t l = 0; l < L; ++l) {
+        double refcost = 0.;
+        blz::DV<FT> refdist(distances);
+        std::vector<IT> refasn(assignments);
+        for(size_t j = 0; j < np; ++j) {
+            const FT d = j == cands[l] ? FT(0): FT(oracle(cands[l], j));
+            refcost += (w ? w[j]: 1.) * std::min(d, distances[j]);
+            if(d < refdist[j]) refdist[j] = d, refasn[j] = 2;
+        }
+        assert(std::abs(candcosts[l] - refcost) <= 1e-10 * refcost);
+        blz::DV<FT> newdist(distances);
+        std::vector<IT> newasn(assignments);
+        apply_candidate(oracle, cands[l], canddists, l, newdist, newasn, IT(2), parallelize);
+        assert(newdist == refdist);
+        assert(newasn == refasn);
+    }
+}
+
+int main() {
+    const size_t nc = 6;
+    std::mt19937_64 mt(53);
+    std::normal_distribution<double> nd;
+    // 60 x 8 doubles fit in the cache; 1000 x 8 do not
+    for(const size_t np: {size_t(60), size_t(1000)}) {
+        blz::DM<double> mat(np, nc);
+        for(size_t i = 0; i < np; ++i)
+            for(size_t j = 0; j < nc; ++j)
+                mat(i, j) = nd(mt) + 4. * (i % 3);
+        auto oracle = [&mat](size_t i, size_t j) -> double {return blz::sqrNorm(row(mat, i) - row(mat, j));};
+        std::vector<double> w(np);
+        for(auto &x: w) x = std::uniform_real_distribution<double>(.5, 2.)(mt);
+        for(const bool parallelize: {false, true}) {
+            for(const double *wp: {static_cast<const double *>(nullptr), static_cast<const double *>(w.data())}) {
+                check<double>(oracle, np, wp, parallelize, mt);
+                check<float>(oracle, np, wp, parallelize, mt);
+            }
+        }
+    }
+    return EXIT_SUCCESS;
+}
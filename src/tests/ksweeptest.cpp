@@ -0,0 +1,94 @@
+#undef NDEBUG
+#include "minicore/clustering/ksweep.h"
+#include "minicore/optim/kmeans.h"
+#include <random>
+#include <cassert>
+
+using namespace minicore;
+
+template<typename CtrT>
+double max_center_diff(const std::vector<CtrT> &lhs, const std::vector<CtrT> &rhs) {
+    double ret = 0.;
+    for(size_t i = 0; i < lhs.size(); ++i)
+        ret = std::max(ret, double(blz::max(blz::abs(lhs[i] - rhs[i]))) / std::max(1., double(blz::max(blz::abs(rhs[i])))));
+    return ret;
+}
+
+template<typename MT>
+void run(const MT &mat, dist::DissimilarityMeasure msr, const std::vector<size_t> &ks) {
+    const size_t nr = mat.rows(), kmax = *std::max_element(ks.begin(), ks.end());
+    blz::DV<double> prior{msr == dist::SQRL2 || msr == dist::L1 ? 0.: 1.};
+    const double psum = prior[0] * mat.columns();
+    const blz::DV<double> rsums = sum<blz::rowwise>(mat);
+    auto oracle = [&](size_t xi, size_t yi) {
+        return cmp::msr_with_prior<double>(msr, row(mat, yi, blz::unchecked), row(mat, xi, blz::unchecked), prior, psum, rsums[yi], rsums[xi]);
+    };
+    wy::WyRand<uint64_t> rng(7);
+    auto [ids, seedasn, seedcosts] = kmeanspp(oracle, rng, nr, kmax);
+    std::vector<blz::DV<double, blz::rowVector>> seeds;
+    for(const auto id: ids) seeds.emplace_back(row(mat, id, blz::unchecked));
+    std::vector<std::vector<blz::DV<double, blz::rowVector>>> ctrs;
+    std::vector<blz::DV<uint32_t>> asns;
+    std::vector<blz::DV<double>> costs;
+    auto res = perform_hard_clustering_ksweep(mat, msr, prior, seeds, ks, ctrs, asns, costs, static_cast<blz::DV<double> *>(nullptr), 1e-6, 50);
+    assert(res.size() == ks.size() && ctrs.size() == ks.size() && asns.size() == ks.size() && costs.size() == ks.size());
+    for(size_t i = 0; i < ks.size(); ++i) {
+        const size_t k = ks[i];
+        // The first k seeds of the ordering are the k-means++ seeds for k
+        wy::WyRand<uint64_t> krng(7);
+        auto kids = std::get<0>(kmeanspp(oracle, krng, nr, k));
+        assert(std::equal(kids.begin(), kids.end(), ids.begin()));
+        std::vector<blz::DV<double, blz::rowVector>> sctrs(seeds.begin(), seeds.begin() + k);
+        blz::DV<uint32_t> asn(nr);
+        blz::DV<double> kcosts(nr);
+        auto [ic, fc, iters] = perform_hard_clustering(mat, msr, prior, sctrs, asn, kcosts, static_cast<blz::DV<double> *>(nullptr), 1e-6, 50,
+                                                      static_cast<blz::DV<double> *>(nullptr), 0u);
+        auto [kic, kfc, kiters] = res[i];
+        assert(kiters == iters);
+        assert(std::abs(kic - ic) <= 1e-8 * ic && std::abs(kfc - fc) <= 1e-8 * fc);
+        assert(ctrs[i].size() == k);
+        assert(asns[i] == asn);
+        for(size_t j = 0; j < nr; ++j) assert(std::abs(costs[i][j] - kcosts[j]) <= 1e-8 * std::max(1., double(kcosts[j])));
+        assert(max_center_diff(ctrs[i], sctrs) <= 1e-10);
+        std::fprintf(stderr, "%s, k = %zu: cost %0.12g -> %0.12g in %zu iterations\n", dist::msr2str(msr), k, kic, kfc, kiters);
+    }
+}
+
+int main() {
+    const size_t nr = 500, nc = 40, nclusters = 6;
+    const std::vector<size_t> ks{2, 4, 6, 10, 16};
+    std::mt19937_64 mt(13);
+    std::uniform_real_distribution<double> urd;
+    std::vector<double> data;
+    std::vector<uint32_t> indices;
+    std::vector<uint64_t> indptr{0};
+    blz::DM<double> dense(nr, nc, 0.);
+    for(size_t i = 0; i < nr; ++i) {
+        for(size_t j = 0; j < nc; ++j) {
+            if(urd(mt) < .3 || j % nclusters == i % nclusters) {
+                dense(i, j) = urd(mt) * 10. + (j % nclusters == i % nclusters) * 5.;
+                data.push_back(dense(i, j));
+                indices.push_back(j);
+            }
+        }
+        indptr.push_back(data.size());
+    }
+    util::CSparseMatrix<double, uint32_t, uint64_t> csr(data.data(), indices.data(), indptr.data(), nr, nc, data.size());
+    for(const auto msr: {dist::SQRL2, dist::MKL}) {
+        run(dense, msr, ks);
+        run(csr, msr, ks);
+    }
+    for(const auto msr: {dist::L1, dist::TOTAL_VARIATION_DISTANCE})
+        run(dense, msr, ks);
+    // Every k must have enough seeds
+    std::vector<blz::DV<double, blz::rowVector>> seeds(4, row(dense, 0));
+    std::vector<std::vector<blz::DV<double, blz::rowVector>>> ctrs;
+    std::vector<blz::DV<uint32_t>> asns;
+    std::vector<blz::DV<double>> costs;
+    bool threw = false;
+    try {
+        perform_hard_clustering_ksweep(dense, dist::SQRL2, blz::DV<double>{0.}, seeds, std::vector<size_t>{2, 5}, ctrs, asns, costs);
+    } catch(const std::invalid_argument &) {threw = true;}
+    assert(threw);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,81 @@
+#undef NDEBUG
+#include "minicore/optim/lsearchpp.h"
+#include <cassert>
+
+using namespace minicore;
+using coresets::detail::localsearchpp_batches;
+
+template<typename Oracle>
+double exact_cost(const Oracle &oracle, const std::vector<uint32_t> &ctrs, size_t np, const double *w) {
+    double ret = 0.;
+    for(size_t i = 0; i < np; ++i) {
+        double m = std::numeric_limits<double>::max();
+        for(const auto c: ctrs) m = std::min(m, oracle(i, c));
+        ret += (w ? w[i]: 1.) * m;
+    }
+    return ret;
+}
+
+// Each batch's reported gain must be the exact change in cost, and the cost must never increase
+template<typename Oracle>
+void check_batches(const Oracle &oracle, size_t np, std::vector<uint32_t> ctrs, const double *w, bool parallelize, size_t batch_size, uint64_t seed) {
+    const size_t k = ctrs.size();
+    std::mt19937_64 rng(seed);
+    blz::DM<double> ctrcostmat = blaze::generate(np, k, [&](auto x, auto y) {return oracle(x, ctrs[y]);});
+    blz::DV<double> dv = blaze::min<blaze::rowwise>(ctrcostmat);
+    double cost = exact_cost(oracle, ctrs, np, w);
+    const double initcost = cost;
+    for(size_t batch = 0; batch < 25; ++batch) {
+        const double gain = localsearchpp_batches(oracle, rng, dv, ctrcostmat, ctrs, np, batch_size, w, parallelize, batch_size);
+        const double newcost = exact_cost(oracle, ctrs, np, w);
+        assert(gain <= 0.);
+        assert(std::abs(newcost - cost - gain) <= 1e-9 * initcost);
+        assert(newcost <= cost + 1e-9 * initcost);
+        for(size_t i = 0; i < np; ++i) {
+            for(size_t j = 0; j < k; ++j)
+                assert(ctrcostmat(i, j) == oracle(i, ctrs[j]));
+            assert(dv[i] == blaze::min(row(ctrcostmat, i)));
+        }
+        cost = newcost;
+    }
+    // Starting from all centers in one cluster, the swaps should find the others
+    assert(cost < .5 * initcost);
+}
+
+int main() {
+    const size_t nc = 4, nclusters = 8, np = 2000, k = nclusters;
+    std::mt19937_64 mt(37);
+    std::normal_distribution<double> nd;
+    blz::DM<double> mat(np, nc);
+    for(size_t i = 0; i < np; ++i)
+        for(size_t j = 0; j < nc; ++j)
+            mat(i, j) = nd(mt) + 20. * ((i % nclusters) >> j & 1) + 5. * (i % nclusters);
+    auto oracle = [&mat](size_t i, size_t j) -> double {return blz::sqrNorm(row(mat, i) - row(mat, j));};
+    std::vector<double> w(np);
+    for(auto &x: w) x = std::uniform_real_distribution<double>(.5, 2.)(mt);
+    // Every initial center is in cluster 0
+    std::vector<uint32_t> ctrs;
+    for(size_t i = 0; i < k; ++i) ctrs.push_back(i * nclusters);
+    for(const size_t batch_size: {size_t(2), size_t(4), size_t(16)}) {
+        for(const bool parallelize: {false, true}) {
+            check_batches(oracle, np, ctrs, static_cast<const double *>(nullptr), parallelize, batch_size, batch_size);
+            check_batches(oracle, np, ctrs, w.data(), parallelize, batch_size, batch_size + 1);
+        }
+    }
+    // Through localsearchpp_rounds with batch_size > 1: the total gain is the change in cost, and assignments are nearest centers
+    for(const size_t batch_size: {size_t(3), size_t(8)}) {
+        std::vector<uint32_t> lctrs = ctrs, asn(np);
+        std::vector<double> distances(np);
+        std::mt19937_64 rng(batch_size);
+        const double before = exact_cost(oracle, lctrs, np, w.data());
+        const double gain = coresets::localsearchpp_rounds(oracle, rng, distances, lctrs, asn, np, 64, w.data(), true, batch_size);
+        const double after = exact_cost(oracle, lctrs, np, w.data());
+        assert(std::abs(after - before - gain) <= 1e-9 * before);
+        assert(after <= before);
+        for(size_t i = 0; i < np; ++i) {
+            assert(distances[i] == oracle(i, lctrs[asn[i]]));
+            for(const auto c: lctrs) assert(distances[i] <= oracle(i, c));
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,287 @@
+#include "minicore/minicore.h"
+#include <chrono>
+#include <getopt.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace minicore;
+
+/*
+ * Benchmark suite: times
+ *   1. msr_with_prior for every usable measure, on dense, CSparseVector, and blaze sparse rows at several dimensions,
+ *   2. assign_points_hard and perform_hard_clustering, end to end,
+ *   3. kmeans++ and coreset sampler construction and sampling,
+ *   4. graph shortest-path distance matrices (graph2rammat),
+ * on synthetic data generated as in exp/generate_kmeans_data.py and exp/generate_bregman_data.py.
+ * Each case is run once to warm up and then -r times; one tab-separated line per case
+ * (name, parameters, median ms, min ms, reps) is written to -o, or stdout.
+ * Compare two result files with scripts/compare_bench.py, or use `make bench-compare`.
+ */
+
+struct BenchSuite {
+    std::FILE *ofp_;
+    unsigned reps_;
+    std::string filter_;
+    BenchSuite(std::FILE *ofp, unsigned reps, std::string filter): ofp_(ofp), reps_(std::max(reps, 1u)), filter_(filter) {
+        std::fprintf(ofp_, "#Name\tParams\tMedianMs\tMinMs\tReps\n");
+    }
+    bool enabled(const std::string &name) const {return filter_.empty() || name.find(filter_) != std::string::npos;}
+    // Whether any of a group's cases would run, so groups can skip generating data no case uses
+    bool any_enabled(std::initializer_list<const char *> names) const {
+        return std::any_of(names.begin(), names.end(), [this](const char *name) {return enabled(name);});
+    }
+    template<typename F>
+    void run(const std::string &name, const std::string &params, const F &f) {
+        if(!enabled(name)) return;
+        try {
+            f();
+        } catch(const std::exception &ex) {
+            std::fprintf(stderr, "Skipping %s %s: %s\n", name.data(), params.data(), ex.what());
+            return;
+        }
+        std::vector<double> times(reps_);
+        for(auto &t: times) {
+            auto start = std::chrono::high_resolution_clock::now();
+            f();
+            t = util::timediff2ms(start, std::chrono::high_resolution_clock::now());
+        }
+        std::sort(times.begin(), times.end());
+        const double median = reps_ & 1 ? times[reps_ / 2]: .5 * (times[reps_ / 2 - 1] + times[reps_ / 2]);
+        std::fprintf(ofp_, "%s\t%s\t%0.6g\t%0.6g\t%u\n", name.data(), params.data(), median, times.front(), reps_);
+        std::fflush(ofp_);
+        std::fprintf(stderr, "%s [%s]: %0.6gms\n", name.data(), params.data(), median);
+    }
+};
+
+// As in exp/generate_kmeans_data.py: unit-variance Gaussian blobs around |N(0, 25)| centers, in shuffled order
+blz::DM<double> generate_kmeans_data(size_t n, size_t d, size_t k, wy::WyRand<uint64_t> &rng) {
+    std::normal_distribution<double> nd;
+    blz::DM<double> centers(k, d), ret(n, d);
+    for(auto &v: centers) v = std::abs(nd(rng) * 5.);
+    std::vector<uint32_t> order(n);
+    std::iota(order.begin(), order.end(), 0u);
+    std::shuffle(order.begin(), order.end(), rng);
+    for(size_t i = 0; i < n; ++i) {
+        const size_t c = order[i] % k;
+        for(size_t j = 0; j < d; ++j) ret(i, j) = centers(c, j) + nd(rng);
+    }
+    return ret;
+}
+
+// As in exp/generate_bregman_data.py: multinomial counts, Poisson(coverage) draws per row,
+// from noisy copies of normalized |Cauchy * 5| centers, in shuffled order
+blz::DM<double> generate_bregman_data(size_t n, size_t d, size_t k, size_t coverage, wy::WyRand<uint64_t> &rng) {
+    std::normal_distribution<double> nd;
+    std::cauchy_distribution<double> cd;
+    std::poisson_distribution<size_t> pd(coverage);
+    blz::DM<double> centers(k, d), ret(n, d, 0.);
+    for(auto &v: centers) v = std::abs(cd(rng) * 5.);
+    for(size_t i = 0; i < k; ++i) row(centers, i) /= sum(row(centers, i));
+    std::vector<uint32_t> order(n);
+    std::iota(order.begin(), order.end(), 0u);
+    std::shuffle(order.begin(), order.end(), rng);
+    std::vector<double> p(d);
+    for(size_t i = 0; i < n; ++i) {
+        const size_t c = order[i] % k;
+        for(size_t j = 0; j < d; ++j) p[j] = std::abs(centers(c, j) + nd(rng));
+        std::discrete_distribution<uint32_t> dd(p.begin(), p.end());
+        for(size_t nsamp = pd(rng); nsamp--; ++ret(i, dd(rng)));
+    }
+    return ret;
+}
+
+// Owns the arrays behind a util::CSparseMatrix
+struct CSRHolder {
+    std::vector<double> data_;
+    std::vector<uint32_t> indices_;
+    std::vector<uint64_t> indptr_;
+    size_t nr_, nc_;
+    CSRHolder(const blz::SM<double> &mat): indptr_{0}, nr_(mat.rows()), nc_(mat.columns()) {
+        for(size_t i = 0; i < nr_; ++i) {
+            for(const auto &pair: row(mat, i)) data_.push_back(pair.value()), indices_.push_back(pair.index());
+            indptr_.push_back(data_.size());
+        }
+    }
+    util::CSparseMatrix<double, uint32_t, uint64_t> view() {
+        return util::CSparseMatrix<double, uint32_t, uint64_t>(data_.data(), indices_.data(), indptr_.data(), nr_, nc_, data_.size());
+    }
+};
+
+std::string params(std::initializer_list<std::pair<const char *, std::string>> kv) {
+    std::string ret;
+    for(const auto &p: kv) {
+        if(!ret.empty()) ret += ',';
+        ret += std::string(p.first) + '=' + p.second;
+    }
+    return ret;
+}
+
+void bench_kernels(BenchSuite &suite, const std::vector<size_t> &dims, size_t nrows, size_t nctrs, uint64_t seed) {
+    if(!suite.any_enabled({"msr.dense", "msr.csparse", "msr.blazesparse"})) return;
+    wy::WyRand<uint64_t> rng(seed);
+    const blz::DV<double> prior{1.};
+    for(const size_t d: dims) {
+        // Coverage d / 4 gives roughly 20% nonzeros
+        const blz::DM<double> dm = generate_bregman_data(nrows, d, 10, std::max(d / 4, size_t(1)), rng);
+        const blz::SM<double> sm = dm;
+        CSRHolder csr(sm);
+        const auto csm = csr.view();
+        const double psum = prior[0] * d;
+        const blz::DV<double> rsums = blz::sum<blz::rowwise>(dm);
+        std::vector<blz::DV<double, blz::rowVector>> ctrs;
+        std::vector<double> csums;
+        for(size_t i = 0; i < nctrs; ++i) {
+            ctrs.emplace_back(row(dm, rng() % nrows));
+            csums.push_back(sum(ctrs.back()));
+        }
+        const std::string dens = std::to_string(double(nonZeros(sm)) / (nrows * d));
+        for(const auto msr: dist::USABLE_MEASURES) {
+            const std::string mstr = dist::msr2str(msr);
+            auto run = [&](const char *kind, const auto &getrow) {
+                suite.run(std::string("msr.") + kind, params({{"msr", mstr}, {"d", std::to_string(d)}, {"n", std::to_string(nrows)}, {"k", std::to_string(nctrs)}, {"density", dens}}), [&]() {
+                    double s = 0.;
+                    OMP_PRAGMA("omp parallel for reduction(+:s)")
+                    for(size_t i = 0; i < nrows; ++i)
+                        for(size_t j = 0; j < nctrs; ++j)
+                            s += cmp::msr_with_prior<double>(msr, getrow(i), ctrs[j], prior, psum, rsums[i], csums[j]);
+                    if(std::isnan(s)) std::fprintf(stderr, "NaN sum for %s/%s\n", kind, mstr.data());
+                });
+            };
+            run("dense", [&](size_t i) {return row(dm, i, blz::unchecked);});
+            run("csparse", [&](size_t i) {return row(csm, i, blz::unchecked);});
+            run("blazesparse", [&](size_t i) {return row(sm, i, blz::unchecked);});
+        }
+    }
+}
+
+void bench_clustering(BenchSuite &suite, size_t n, size_t d, unsigned k, uint64_t seed) {
+    if(!suite.any_enabled({"assign_points_hard.dense", "assign_points_hard.csparse", "assign_points_hard.blazesparse",
+                           "perform_hard_clustering.dense", "perform_hard_clustering.csparse", "perform_hard_clustering.blazesparse",
+                           "kmeanspp.dense", "kmeanspp.blazesparse", "coreset.make_sampler", "coreset.sample"}))
+        return;
+    wy::WyRand<uint64_t> rng(seed);
+    const blz::DV<double> prior{1.};
+    const blz::DM<double> kmdata = generate_kmeans_data(n, d, k, rng);
+    const blz::DM<double> counts = generate_bregman_data(n, d, k, std::max(d / 4, size_t(1)), rng);
+    const blz::SM<double> scounts = counts;
+    CSRHolder csr(scounts);
+    const auto csm = csr.view();
+    const std::string ps = params({{"n", std::to_string(n)}, {"d", std::to_string(d)}, {"k", std::to_string(k)}});
+    auto initial_centers = [&](const auto &mat) {
+        std::vector<blz::DV<double, blz::rowVector>> ret;
+        for(unsigned i = 0; i < k; ++i) ret.emplace_back(row(mat, (i * n) / k));
+        return ret;
+    };
+    blz::DV<uint32_t> asn(n);
+    blz::DV<double> costs(n);
+    auto bench_assign = [&](const char *name, const auto &mat, dist::DissimilarityMeasure msr) {
+        const auto ctrs = initial_centers(counts);
+        blz::DV<double> rsums;
+        if constexpr(util::IsCSparseMatrix_v<std::decay_t<decltype(mat)>>) rsums = util::sum<blz::rowwise>(mat);
+        else rsums = blz::sum<blz::rowwise>(mat);
+        const blz::DV<double> csums = blaze::generate(k, [&](auto x) {return sum(ctrs[x]);});
+        suite.run(name, ps + ",msr=" + dist::msr2str(msr), [&]() {
+            clustering::assign_points_hard<double>(mat, msr, prior, ctrs, asn, costs, static_cast<blz::DV<double> *>(nullptr), csums, rsums);
+        });
+    };
+    bench_assign("assign_points_hard.dense", counts, dist::MKL);
+    bench_assign("assign_points_hard.csparse", csm, dist::MKL);
+    bench_assign("assign_points_hard.blazesparse", scounts, dist::MKL);
+    auto bench_lloyd = [&](const char *name, const auto &mat, dist::DissimilarityMeasure msr, const auto &seedmat) {
+        suite.run(name, ps + ",msr=" + dist::msr2str(msr) + ",maxiter=5", [&]() {
+            auto ctrs = initial_centers(seedmat);
+            perform_hard_clustering(mat, msr, prior, ctrs, asn, costs, static_cast<blz::DV<double> *>(nullptr), 0., 5);
+        });
+    };
+    bench_lloyd("perform_hard_clustering.dense", kmdata, dist::SQRL2, kmdata);
+    bench_lloyd("perform_hard_clustering.dense", counts, dist::MKL, counts);
+    bench_lloyd("perform_hard_clustering.csparse", csm, dist::MKL, counts);
+    bench_lloyd("perform_hard_clustering.blazesparse", scounts, dist::MKL, counts);
+
+    // Applicators may normalize their data in place, so they get copies
+    blz::DM<double> appdata = kmdata;
+    blz::SM<double> sappdata = scounts;
+    auto app = jsd::make_probdiv_applicator(appdata, dist::SQRL2);
+    suite.run("kmeanspp.dense", ps + ",msr=SQRL2", [&]() {
+        auto res = jsd::make_kmeanspp(app, k, seed);
+        (void)res;
+    });
+    auto sapp = jsd::make_probdiv_applicator(sappdata, dist::MKL, dist::DIRICHLET);
+    suite.run("kmeanspp.blazesparse", ps + ",msr=MKL", [&]() {
+        auto res = jsd::make_kmeanspp(sapp, k, seed);
+        (void)res;
+    });
+    auto [ctrs, kasn, kcosts] = jsd::make_kmeanspp(app, k, seed);
+    std::vector<float> fcosts(kcosts.begin(), kcosts.end());
+    std::vector<uint32_t> fasn(kasn.begin(), kasn.end());
+    for(const auto sm: {coresets::BFL, coresets::VX, coresets::LBK}) {
+        coresets::CoresetSampler<float, uint32_t> sampler;
+        suite.run("coreset.make_sampler", ps + ",sm=" + coresets::sm2str(sm), [&]() {
+            sampler.make_sampler(n, k, fcosts.data(), fasn.data(), static_cast<float *>(nullptr), seed, sm);
+        });
+        suite.run("coreset.sample", ps + ",sm=" + coresets::sm2str(sm) + ",size=1000", [&]() {
+            if(!sampler.ready()) sampler.make_sampler(n, k, fcosts.data(), fasn.data(), static_cast<float *>(nullptr), seed, sm);
+            auto cs = sampler.sample(1000, seed);
+            (void)cs;
+        });
+    }
+}
+
+void bench_graph(BenchSuite &suite, size_t nv, unsigned degree, size_t nsources, uint64_t seed) {
+    if(!suite.any_enabled({"graph.sources_to_sources", "graph.sources_to_all"})) return;
+    wy::WyRand<uint64_t> rng(seed);
+    std::uniform_real_distribution<float> urd(.5f, 2.f);
+    // A path through every vertex keeps the graph connected; the rest of the edges are random
+    graph::Graph<boost::undirectedS, float> g(nv);
+    for(size_t i = 1; i < nv; ++i) boost::add_edge(i - 1, i, urd(rng), g);
+    for(size_t i = 0; i < nv; ++i)
+        for(unsigned j = 1; j < degree; ++j)
+            boost::add_edge(i, rng() % nv, urd(rng), g);
+    std::vector<typename boost::graph_traits<decltype(g)>::vertex_descriptor> sources(nsources);
+    for(auto &s: sources) s = rng() % nv;
+    const std::string ps = params({{"nv", std::to_string(nv)}, {"degree", std::to_string(degree)}, {"sources", std::to_string(nsources)}});
+    suite.run("graph.sources_to_sources", ps, [&]() {
+        auto mat = graph::graph2rammat(g, std::string(), &sources, true, false);
+        (void)mat;
+    });
+    suite.run("graph.sources_to_all", ps, [&]() {
+        auto mat = graph::graph2rammat(g, std::string(), &sources, false, false);
+        (void)mat;
+    });
+}
+
+int main(int argc, char *argv[]) {
+    size_t npoints = 20000, ncols = 256, nkernelrows = 2000, nkernelctrs = 16, nv = 20000, nsources = 64;
+    unsigned k = 25, reps = 5;
+    uint64_t seed = 13;
+    std::string outpath, filter;
+    std::vector<size_t> dims;
+    for(int c;(c = getopt(argc, argv, "n:d:k:D:r:s:o:F:V:p:h?")) >= 0;) {switch(c) {
+        case 'n': npoints = std::strtoull(optarg, nullptr, 10); break;
+        case 'd': ncols = std::strtoull(optarg, nullptr, 10); break;
+        case 'k': k = std::atoi(optarg); break;
+        case 'D': dims.push_back(std::strtoull(optarg, nullptr, 10)); break;
+        case 'r': reps = std::atoi(optarg); break;
+        case 's': seed = std::strtoull(optarg, nullptr, 10); break;
+        case 'o': outpath = optarg; break;
+        case 'F': filter = optarg; break;
+        case 'V': nv = std::strtoull(optarg, nullptr, 10); break;
+        case 'p': OMP_ONLY(omp_set_num_threads(std::atoi(optarg));) break;
+        case '?':
+        case 'h': std::fprintf(stderr, "Usage: %s <flags>\n-n: number of points for clustering [20000]\n-d: dimension for clustering [256]\n"
+                                       "-k: number of centers [25]\n-D: dimension for kernel benchmarks (repeatable) [16, 256, 4096]\n"
+                                       "-r: repetitions per case [5]\n-s: seed [13]\n-o: output path [stdout]\n"
+                                       "-F: only run cases whose name contains this string\n-V: number of graph vertices [20000]\n-p: number of threads\n", *argv);
+                return EXIT_FAILURE;
+    }}
+    if(dims.empty()) dims = {16, 256, 4096};
+    std::FILE *ofp = outpath.empty() ? stdout: std::fopen(outpath.data(), "w");
+    if(!ofp) throw std::runtime_error(std::string("Failed to open ") + outpath);
+    BenchSuite suite(ofp, reps, filter);
+    bench_kernels(suite, dims, nkernelrows, nkernelctrs, seed);
+    bench_clustering(suite, npoints, ncols, k, seed);
+    bench_graph(suite, nv, 4, nsources, seed);
+    if(ofp != stdout) std::fclose(ofp);
+    return EXIT_SUCCESS;
+}
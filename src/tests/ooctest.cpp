@@ -0,0 +1,94 @@
+#undef NDEBUG
+#include "minicore/clustering/outofcore.h"
+#include <random>
+#include <cassert>
+
+using namespace minicore;
+
+template<typename CtrT>
+double max_center_diff(const std::vector<CtrT> &lhs, const std::vector<CtrT> &rhs) {
+    double ret = 0.;
+    for(size_t i = 0; i < lhs.size(); ++i)
+        ret = std::max(ret, double(blz::max(blz::abs(lhs[i] - rhs[i]))) / std::max(1., double(blz::max(blz::abs(rhs[i])))));
+    return ret;
+}
+
+template<typename MMT, typename MT>
+void run(const MMT &mapped, const MT &csr, dist::DissimilarityMeasure msr, size_t k) {
+    const size_t nr = csr.rows();
+    blz::DV<double> prior{msr == dist::SQRL2 ? 0.: 1.};
+    const double psum = prior[0] * csr.columns();
+    std::vector<blz::DV<double, blz::rowVector>> init;
+    for(size_t i = 0; i < k; ++i) init.emplace_back(row(csr, i * (nr / k), blz::unchecked));
+    // Hard clustering
+    {
+        auto ctrs = init, ooc_ctrs = init;
+        blz::DV<uint32_t> asn(nr), ooc_asn;
+        blz::DV<double> costs(nr), ooc_costs;
+        auto [ic, fc, iters] = perform_hard_clustering(csr, msr, prior, ctrs, asn, costs, static_cast<blz::DV<double> *>(nullptr), 1e-6, 50,
+                                                      static_cast<blz::DV<double> *>(nullptr), 0u);
+        TelemetryScope scope;
+        auto [oic, ofc, oiters] = perform_hard_clustering_ooc(mapped, msr, prior, ooc_ctrs, ooc_asn, ooc_costs, static_cast<blz::DV<double> *>(nullptr), 1e-6, 50, 37);
+        assert(oiters == iters);
+        assert(oiters == scope.get()->iterations() || oiters + 1 == scope.get()->iterations());
+        assert(std::abs(oic - ic) <= 1e-8 * ic && std::abs(ofc - fc) <= 1e-8 * fc);
+        assert(ooc_asn == asn);
+        for(size_t i = 0; i < nr; ++i) assert(std::abs(ooc_costs[i] - costs[i]) <= 1e-8 * std::max(1., double(costs[i])));
+        assert(max_center_diff(ooc_ctrs, ctrs) <= 1e-10);
+        std::fprintf(stderr, "%s hard: cost %0.12g -> %0.12g in %zu iterations\n", dist::msr2str(msr), oic, ofc, oiters);
+    }
+    // Soft clustering, with in-memory costs starting at those of the initial centers
+    {
+        auto ctrs = init, ooc_ctrs = init;
+        blz::DM<double> costs(nr, k), asns(nr, k);
+        for(size_t i = 0; i < nr; ++i) {
+            auto r = row(csr, i, blz::unchecked);
+            for(size_t j = 0; j < k; ++j)
+                costs(i, j) = cmp::msr_with_prior<double>(msr, r, ctrs[j], prior, psum, sum(r), sum(ctrs[j]));
+        }
+        auto [ic, fc, iters] = perform_soft_clustering(csr, msr, prior, ctrs, costs, asns, 1., 10);
+        auto [oic, ofc, oiters] = perform_soft_clustering_ooc(mapped, msr, prior, ooc_ctrs, 1., 10, static_cast<blz::DV<double> *>(nullptr), DEFAULT_EPS, 37);
+        assert(oiters == iters);
+        assert(std::abs(oic - ic) <= 1e-8 * ic && std::abs(ofc - fc) <= 1e-8 * fc);
+        assert(max_center_diff(ooc_ctrs, ctrs) <= 1e-8);
+        std::fprintf(stderr, "%s soft: cost %0.12g -> %0.12g in %zu iterations\n", dist::msr2str(msr), oic, ofc, oiters);
+    }
+}
+
+int main() {
+    const size_t nr = 500, nc = 40, k = 6;
+    std::mt19937_64 mt(13);
+    std::uniform_real_distribution<double> urd;
+    std::vector<double> data;
+    std::vector<uint32_t> indices;
+    std::vector<uint64_t> indptr{0};
+    for(size_t i = 0; i < nr; ++i) {
+        for(size_t j = 0; j < nc; ++j) {
+            if(urd(mt) < .3 || j % k == i % k) {
+                data.push_back(urd(mt) * 10. + (j % k == i % k) * 5.);
+                indices.push_back(j);
+            }
+        }
+        indptr.push_back(data.size());
+    }
+    util::CSparseMatrix<double, uint32_t, uint64_t> csr(data.data(), indices.data(), indptr.data(), nr, nc, data.size());
+    const std::string prefix = "/tmp/minicore_ooctest.";
+    util::write_csparse_files<double, uint32_t, uint64_t>(csr, prefix);
+    util::MappedCSparseMatrix<double, uint32_t, uint64_t> mapped(prefix);
+    assert(mapped.rows() == nr && mapped.columns() == nc && mapped.nnz() == data.size());
+    assert(std::equal(data.begin(), data.end(), mapped.data()));
+    for(const auto msr: {dist::SQRL2, dist::MKL, dist::HELLINGER})
+        run(mapped, csr, msr, k);
+    // Median-based policies can't be accumulated one chunk at a time
+    std::vector<blz::DV<double, blz::rowVector>> centers(k, row(csr, 0));
+    blz::DV<uint32_t> asn;
+    blz::DV<double> costs;
+    bool threw = false;
+    try {
+        perform_hard_clustering_ooc(mapped, dist::L1, blz::DV<double>{0.}, centers, asn, costs);
+    } catch(const std::invalid_argument &) {threw = true;}
+    assert(threw);
+    for(const char *suf: {"indptr.file", "indices.file", "data.file", "shape.file"})
+        std::remove((prefix + suf).data());
+    return EXIT_SUCCESS;
+}
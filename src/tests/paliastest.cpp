@@ -0,0 +1,57 @@
+#undef NDEBUG
+#include "minicore/util/palias.h"
+#include <random>
+#include <cmath>
+#include <cassert>
+#include <cstdio>
+
+using namespace minicore;
+
+// The probability each index is drawn, reconstructed from the table, must be exact
+void check_table(const util::ParallelAliasSampler<double, uint32_t> &sampler, const std::vector<double> &w) {
+    const size_t n = w.size();
+    const double total = std::accumulate(w.begin(), w.end(), 0.);
+    assert(sampler.size() == n);
+    std::vector<double> implied(n);
+    for(size_t b = 0; b < n; ++b) {
+        assert(sampler.prob_[b] >= 0. && sampler.prob_[b] <= 1.);
+        implied[b] += sampler.prob_[b];
+        if(sampler.alias_[b] != b) implied[sampler.alias_[b]] += 1. - sampler.prob_[b];
+    }
+    for(size_t i = 0; i < n; ++i)
+        assert(std::abs(implied[i] / n - w[i] / total) <= 1e-12
+               || !std::fprintf(stderr, "n = %zu, index %zu: %g vs %g\n", n, i, implied[i] / n, w[i] / total));
+}
+
+int main() {
+    for(const size_t n: {1ul, 7ul, 1000ul, 200000ul}) {
+        std::mt19937_64 mt(n);
+        std::uniform_real_distribution<double> urd;
+        std::vector<double> w(n);
+        // Heavy-tailed weights with many zeros stress the light/heavy pairing
+        for(auto &x: w) x = urd(mt) < .3 ? 0.: std::exp(10. * urd(mt));
+        w[0] = 1.;
+        util::ParallelAliasSampler<double, uint32_t> sampler(w.data(), w.data() + n, 13);
+        check_table(sampler, w);
+        for(size_t i = 0; i < 1000; ++i) {
+            const auto s = sampler.sample();
+            assert(s < n && w[s] > 0.);
+        }
+    }
+    // Tables built inside another parallel region, whose team may be smaller than requested, are still exact
+    {
+        std::mt19937_64 mt(13);
+        std::uniform_real_distribution<double> urd;
+        std::vector<double> w(200000);
+        for(auto &x: w) x = urd(mt) < .3 ? 0.: std::exp(10. * urd(mt));
+        w[0] = 1.;
+        OMP_ONLY(omp_set_num_threads(4);)
+        OMP_ONLY(omp_set_max_active_levels(1);)
+        std::vector<util::ParallelAliasSampler<double, uint32_t>> nested(4);
+        OMP_PRAGMA("omp parallel for num_threads(4)")
+        for(size_t i = 0; i < nested.size(); ++i)
+            nested[i].build(w.data(), w.data() + w.size());
+        for(const auto &s: nested) check_table(s, w);
+    }
+    return 0;
+}
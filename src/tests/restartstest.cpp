@@ -0,0 +1,108 @@
+#undef NDEBUG
+// Room for the sums of two restarts (k = 6, nc = 40), so that passes are split into batches of restarts
+#define MC_STREAMED_MEANS_MAX_BYTES 3840
+#include "minicore/clustering/restarts.h"
+#include "minicore/optim/kmeans.h"
+#include <random>
+#include <cassert>
+
+using namespace minicore;
+
+template<typename CtrT>
+double max_center_diff(const std::vector<CtrT> &lhs, const std::vector<CtrT> &rhs) {
+    double ret = 0.;
+    for(size_t i = 0; i < lhs.size(); ++i)
+        ret = std::max(ret, double(blz::max(blz::abs(lhs[i] - rhs[i]))) / std::max(1., double(blz::max(blz::abs(rhs[i])))));
+    return ret;
+}
+
+template<typename MT>
+void run(const MT &mat, dist::DissimilarityMeasure msr, size_t k, size_t nrestarts) {
+    const size_t nr = mat.rows();
+    blz::DV<double> prior{msr == dist::SQRL2 ? 0.: 1.};
+    std::vector<std::vector<blz::DV<double, blz::rowVector>>> init(nrestarts);
+    for(size_t r = 0; r < nrestarts; ++r)
+        for(size_t i = 0; i < k; ++i)
+            init[r].emplace_back(row(mat, (i * (nr / k) + r * 7) % nr, blz::unchecked));
+    // Duplicate centers leave a cluster empty, so this restart also exercises re-seeding of empty clusters
+    init.back().back() = init.back().front();
+    auto ctrs = init;
+    std::vector<blz::DV<uint32_t>> asns;
+    std::vector<blz::DV<double>> costs;
+    TelemetryScope scope;
+    auto [best, res] = perform_hard_clustering_restarts(mat, msr, prior, ctrs, asns, costs, static_cast<blz::DV<double> *>(nullptr), 1e-6, 50);
+    assert(res.size() == nrestarts && asns.size() == nrestarts && costs.size() == nrestarts);
+    size_t maxiters = 0;
+    for(size_t r = 0; r < nrestarts; ++r) {
+        auto sctrs = init[r];
+        blz::DV<uint32_t> asn(nr);
+        blz::DV<double> rcosts(nr);
+        auto [ic, fc, iters] = perform_hard_clustering(mat, msr, prior, sctrs, asn, rcosts, static_cast<blz::DV<double> *>(nullptr), 1e-6, 50,
+                                                      static_cast<blz::DV<double> *>(nullptr), 0u);
+        auto [ric, rfc, riters] = res[r];
+        assert(riters == iters);
+        assert(std::abs(ric - ic) <= 1e-8 * ic && std::abs(rfc - fc) <= 1e-8 * fc);
+        assert(asns[r] == asn);
+        for(size_t i = 0; i < nr; ++i) assert(std::abs(costs[r][i] - rcosts[i]) <= 1e-8 * std::max(1., double(rcosts[i])));
+        assert(max_center_diff(ctrs[r], sctrs) <= 1e-10);
+        assert(rfc >= std::get<1>(res[best]));
+        maxiters = std::max(maxiters, riters);
+    }
+    assert(maxiters == scope.get()->iterations() || maxiters + 1 == scope.get()->iterations());
+    std::fprintf(stderr, "%s: best restart %zu, cost %0.12g -> %0.12g in %zu iterations\n", dist::msr2str(msr), best,
+                 std::get<0>(res[best]), std::get<1>(res[best]), std::get<2>(res[best]));
+}
+
+int main() {
+    const size_t nr = 500, nc = 40, k = 6, nrestarts = 4;
+    std::mt19937_64 mt(13);
+    std::uniform_real_distribution<double> urd;
+    std::vector<double> data;
+    std::vector<uint32_t> indices;
+    std::vector<uint64_t> indptr{0};
+    blz::DM<double> dense(nr, nc, 0.);
+    for(size_t i = 0; i < nr; ++i) {
+        for(size_t j = 0; j < nc; ++j) {
+            if(urd(mt) < .3 || j % k == i % k) {
+                dense(i, j) = urd(mt) * 10. + (j % k == i % k) * 5.;
+                data.push_back(dense(i, j));
+                indices.push_back(j);
+            }
+        }
+        indptr.push_back(data.size());
+    }
+    util::CSparseMatrix<double, uint32_t, uint64_t> csr(data.data(), indices.data(), indptr.data(), nr, nc, data.size());
+    for(const auto msr: {dist::SQRL2, dist::MKL}) {
+        run(dense, msr, k, nrestarts);
+        run(csr, msr, k, nrestarts);
+    }
+    // Median-based policies share assignment passes only
+    run(dense, dist::L1, k, nrestarts);
+    // Batched seeding selects the same centers as separate calls with the same seeds
+    {
+        auto oracle = [&](size_t i, size_t j) {return blz::sqrNorm(row(dense, i, blz::unchecked) - row(dense, j, blz::unchecked));};
+        std::vector<wy::WyRand<uint64_t>> rngs;
+        for(size_t r = 0; r < nrestarts; ++r) rngs.emplace_back(r + 1);
+        auto batched = kmeanspp_restarts(oracle, rngs, nr, k);
+        assert(batched.size() == nrestarts);
+        for(size_t r = 0; r < nrestarts; ++r) {
+            wy::WyRand<uint64_t> rng(r + 1);
+            auto [ctrs, asn, dists] = kmeanspp(oracle, rng, nr, k);
+            assert(std::get<0>(batched[r]) == ctrs);
+            assert(std::get<1>(batched[r]) == asn);
+            for(size_t i = 0; i < nr; ++i) assert(std::abs(std::get<2>(batched[r])[i] - dists[i]) <= 1e-10 * std::max(1., double(dists[i])));
+            assert(rng() == rngs[r]());
+        }
+    }
+    // Restarts must have the same number of centers
+    std::vector<std::vector<blz::DV<double, blz::rowVector>>> centers{std::vector<blz::DV<double, blz::rowVector>>(k, row(dense, 0)),
+                                                                      std::vector<blz::DV<double, blz::rowVector>>(k + 1, row(dense, 0))};
+    std::vector<blz::DV<uint32_t>> asns;
+    std::vector<blz::DV<double>> costs;
+    bool threw = false;
+    try {
+        perform_hard_clustering_restarts(dense, dist::SQRL2, blz::DV<double>{0.}, centers, asns, costs);
+    } catch(const std::invalid_argument &) {threw = true;}
+    assert(threw);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,94 @@
+#undef NDEBUG
+#include "minicore/clustering/solve.h"
+#include <random>
+#include <cassert>
+
+using namespace minicore;
+using clustering::TopMResponsibilities;
+
+// Checks truncated responsibilities against the full softmax over all k costs
+void check_resp(const blz::DM<double> &mat, dist::DissimilarityMeasure msr, const blz::DV<double> &prior,
+                const std::vector<blz::DV<double, blz::rowVector>> &centers, size_t m, double temp) {
+    const size_t nr = mat.rows(), k = centers.size();
+    const double psum = prior[0] * mat.columns();
+    blz::DV<double> rsums = blz::sum<blz::rowwise>(mat), csums(k);
+    for(size_t j = 0; j < k; ++j) csums[j] = sum(centers[j]);
+    TopMResponsibilities<double, uint32_t> resp(nr, k, m);
+    const double cost = clustering::assign_points_topm<double>(mat, msr, prior, centers, resp, static_cast<blz::DV<double> *>(nullptr), temp, csums, rsums);
+    double refcost = 0.;
+    for(size_t i = 0; i < nr; ++i) {
+        std::vector<std::pair<double, uint32_t>> all(k);
+        for(size_t j = 0; j < k; ++j)
+            all[j] = {cmp::msr_with_prior<double>(msr, row(mat, i, blz::unchecked), centers[j], prior, psum, rsums[i], csums[j]), j};
+        std::sort(all.begin(), all.end());
+        double total = 0., kept = 0.;
+        for(size_t j = 0; j < k; ++j) {
+            const double e = std::exp(-temp * (all[j].first - all[0].first));
+            total += e;
+            if(j < m) kept += e;
+        }
+        double rsum = 0., rowcost = 0.;
+        for(size_t j = 0; j < m; ++j) {
+            // The kept centers are the m lowest-cost ones, with responsibilities renormalized over them
+            assert(std::abs(resp.costs(i)[j] - all[j].first) <= 1e-10 * std::max(1., all[j].first));
+            const double expected = std::exp(-temp * (all[j].first - all[0].first)) / kept;
+            assert(std::abs(resp.resp(i)[j] - expected) <= 1e-10);
+            rsum += resp.resp(i)[j];
+            rowcost += expected * all[j].first;
+        }
+        assert(std::abs(rsum - 1.) <= 1e-10);
+        assert(std::abs(resp.dropped_[i] - (1. - kept / total)) <= 1e-10);
+        if(m == k) assert(std::abs(resp.dropped_[i]) <= 1e-12);
+        refcost += rowcost;
+    }
+    assert(std::abs(cost - refcost) <= 1e-8 * refcost);
+    // With m = k, the M-step is the full soft weighted mean
+    if(m == k && msr == dist::SQRL2) {
+        auto ctrs = centers;
+        clustering::set_centroids_topm<double>(mat, msr, resp, ctrs, static_cast<blz::DV<double> *>(nullptr), csums, rsums);
+        for(size_t j = 0; j < k; ++j) {
+            blz::DV<double, blz::rowVector> num(mat.columns(), 0.);
+            double den = 0.;
+            for(size_t i = 0; i < nr; ++i)
+                for(size_t l = 0; l < m; ++l)
+                    if(resp.ids(i)[l] == j)
+                        num += resp.resp(i)[l] * row(mat, i, blz::unchecked), den += resp.resp(i)[l];
+            if(den > 0.) assert(blz::max(blz::abs(ctrs[j] - num / den)) <= 1e-8 * std::max(1., double(blz::max(blz::abs(ctrs[j])))));
+        }
+    }
+}
+
+int main() {
+    const size_t nr = 300, nc = 20, k = 8;
+    std::mt19937_64 mt(11);
+    std::uniform_real_distribution<double> urd;
+    blz::DM<double> dense(nr, nc);
+    for(size_t i = 0; i < nr; ++i)
+        for(size_t j = 0; j < nc; ++j)
+            dense(i, j) = urd(mt) * (1. + (j % k == i % k) * 4.);
+    std::vector<blz::DV<double, blz::rowVector>> centers;
+    for(size_t j = 0; j < k; ++j) centers.emplace_back(row(dense, j * (nr / k)));
+    for(const auto msr: {dist::SQRL2, dist::MKL}) {
+        const blz::DV<double> prior{msr == dist::SQRL2 ? 0.: 1.};
+        for(const size_t m: {size_t(1), size_t(3), k})
+            for(const double temp: {.1, 1.})
+                check_resp(dense, msr, prior, centers, m, temp);
+        auto ctrs = centers;
+        TopMResponsibilities<float, uint32_t> resp;
+        auto [initcost, finalcost, iters] = clustering::perform_soft_clustering_topm(dense, msr, prior, ctrs, resp, 3, 1., 20);
+        assert(resp.m() == 3 && resp.rows() == nr);
+        assert(std::isfinite(initcost) && std::isfinite(finalcost) && iters >= 1 && iters <= 20);
+        assert(resp.max_dropped() >= 0. && resp.max_dropped() <= 1.);
+        std::fprintf(stderr, "%s: top-3 of %zu, cost %0.12g -> %0.12g in %zu iterations, max dropped mass %g\n",
+                     dist::msr2str(msr), k, initcost, finalcost, iters, resp.max_dropped());
+    }
+    // m is clamped to k, and must be positive
+    TopMResponsibilities<float, uint32_t> resp(10, 4, 10);
+    assert(resp.m() == 4 && resp.nnz() == 40);
+    bool threw = false;
+    try {
+        resp.resize(10, 4, 0);
+    } catch(const std::invalid_argument &) {threw = true;}
+    assert(threw);
+    return EXIT_SUCCESS;
+}
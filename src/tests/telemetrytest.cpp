@@ -0,0 +1,67 @@
+#undef NDEBUG
+#include "minicore/util/telemetry.h"
+#include <cassert>
+#include <thread>
+
+using namespace minicore;
+
+int main() {
+    // Off by default: phases are not recorded anywhere
+    assert(util::active_telemetry() == nullptr);
+    {
+        util::PhaseTimer pt("ignored", 10, 10);
+    }
+    TelemetryScope scope;
+    Telemetry *tel = scope.get();
+    assert(tel && util::active_telemetry() == tel);
+    tel->mark();
+    for(int i = 0; i < 3; ++i) {
+        {
+            util::PhaseTimer pt("assign", 100, 800);
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        util::PhaseTimer pt("update", 0, 400);
+        pt.stop();
+        tel->add_iteration(10. - i);
+    }
+    {
+        TelemetryScope sub;
+        util::PhaseTimer pt("assign", 5, 0);
+        pt.stop();
+        assert(util::active_telemetry() == sub.get());
+        tel->merge_phases(*sub.get(), "sub.");
+    }
+    assert(util::active_telemetry() == tel);
+    assert(tel->phases_.size() == 3);
+    assert(tel->phases_[0].name_ == "assign");
+    assert(tel->phases_[0].calls_ == 3);
+    assert(tel->phases_[0].distance_evals_ == 300);
+    assert(tel->phases_[0].bytes_ == 2400);
+    assert(tel->phases_[0].ms_ >= 3.);
+    assert(tel->phases_[1].calls_ == 3 && tel->phases_[1].bytes_ == 1200);
+    assert(tel->phases_[2].name_ == "sub.assign" && tel->phases_[2].distance_evals_ == 5);
+    assert(tel->iterations() == 3);
+    assert(tel->iteration_costs_[2] == 8.);
+    assert(tel->distance_evals() == 305);
+    const std::string json = tel->to_json();
+    assert(json.find("\"name\": \"sub.assign\"") != std::string::npos);
+    assert(json.find("\"iterations\": 3") != std::string::npos);
+    assert(json.find("\"iteration_costs\": [10, 9, 8]") != std::string::npos);
+    std::fprintf(stderr, "%s\n", json.data());
+    // A disabled scope leaves the active telemetry unchanged
+    {
+        TelemetryScope off(false);
+        assert(off.get() == nullptr && util::active_telemetry() == tel);
+    }
+    // Scopes are per thread: another thread neither sees ours nor replaces it
+    std::thread other([] {
+        assert(util::active_telemetry() == nullptr);
+        TelemetryScope mine;
+        util::PhaseTimer pt("other", 1, 0);
+        pt.stop();
+        assert(util::active_telemetry() == mine.get() && mine.get()->phases_.size() == 1);
+    });
+    other.join();
+    assert(util::active_telemetry() == tel && tel->phases_.size() == 3);
+    return EXIT_SUCCESS;
+}
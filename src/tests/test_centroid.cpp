@@ -1,5 +1,10 @@
 #undef NDEBUG
+// Small enough that geomedians sweeps test5's clusters in blocks
+#define MC_GEOMEDIANS_MAX_BYTES 128
 #include "minicore/clustering/centroid.h"
+#include "minicore/clustering/lazycenter.h"
+#include "minicore/clustering/geomedian.h"
+#include "minicore/clustering/sparsemedian.h"
 
 using namespace minicore::clustering;
 
@@ -129,6 +134,96 @@ int test2() {
     return 0;
 }
 
+int test4() {
+    const size_t n = 10;
+    std::vector<double> cd(n);
+    std::vector<uint32_t> ci(n);
+    for(unsigned int i = 0; i < n; ++i) cd[i] = i + 1., ci[i] = i * 3;
+    mc::util::CSparseVector<double, uint32_t> csv(cd.data(), ci.data(), n, 40);
+    blaze::DynamicVector<double, blz::rowVector> dv(40), ref(40);
+    dv = 0.;
+    for(size_t i = 0; i < n; ++i) dv[ci[i]] = cd[i];
+    ref = blaze::generate(40, [](auto x) {return x % 4 == 1 ? 2.: 0.;});
+    mc::LazyScaledCenter<double> lc(ref);
+    for(size_t i = 0; i < 5; ++i) {
+        lc.update(csv);
+        lc.update(dv, 2.);
+        // Same updates on a dense center
+        const double c1 = 1. + 3 * i + 1., c2 = c1 + 2.;
+        ref = ref * ((c1 - 1.) / c1) + dv / c1;
+        ref = ref * ((c2 - 2.) / c2) + dv * (2. / c2);
+        assert(std::abs(lc.count() - c2) < 1e-12);
+        assert(std::abs(lc.sum() - sum(ref)) < 1e-8);
+        assert(std::abs(lc.sqrNorm() - sqrNorm(ref)) < 1e-8);
+        assert(std::abs(lc.sqrl2(csv, sqrNorm(dv)) - sqrNorm(dv - ref)) < 1e-8);
+    }
+    blaze::CompressedVector<double, blz::rowVector> out;
+    lc.materialize(out);
+    assert(blaze::max(blaze::abs(out - ref)) < 1e-10);
+    return 0;
+}
+
+int test5() {
+    const size_t n = 200, d = 8, k = 3;
+    blaze::DynamicMatrix<double> dm(n, d);
+    std::mt19937_64 mt(13);
+    std::normal_distribution<double> nd;
+    std::vector<uint32_t> asn(n);
+    for(size_t i = 0; i < n; ++i) {
+        asn[i] = i % k;
+        for(size_t j = 0; j < d; ++j) dm(i, j) = nd(mt) + 5. * asn[i] * (j % 2);
+    }
+    std::vector<blaze::DynamicVector<double, blz::rowVector>> ctrs(k, blaze::DynamicVector<double, blz::rowVector>(d, 0.));
+    mc::geomedians(dm, ctrs, [&](size_t i, const auto &f) {f(asn[i], 1.);}, 1e-12);
+    for(size_t c = 0; c < k; ++c) {
+        std::vector<uint32_t> ids;
+        for(size_t i = 0; i < n; ++i) if(asn[i] == c) ids.push_back(i);
+        auto sub = rows(dm, ids.data(), ids.size());
+        blaze::DynamicVector<double, blz::rowVector> ref(d, 0.);
+        blz::geomedian(sub, ref, 1e-14);
+        double mcost = 0., rcost = 0.;
+        for(size_t i = 0; i < ids.size(); ++i) {
+            mcost += l2Norm(row(sub, i) - ctrs[c]);
+            rcost += l2Norm(row(sub, i) - ref);
+        }
+        assert(std::abs(mcost - rcost) <= 1e-6 * rcost || !std::fprintf(stderr, "cluster %zu: %g vs %g\n", c, mcost, rcost));
+    }
+    return 0;
+}
+
+int test6() {
+    // Sparse 0/positive/negative data in 2 clusters of 21 rows each, checked against dense per-column medians;
+    // odd sizes make each median a single middle value rather than the midpoint of two
+    const size_t n = 42, d = 12, k = 2;
+    std::mt19937_64 mt(7);
+    std::vector<double> data;
+    std::vector<uint32_t> indices, indptr{0};
+    blaze::DynamicMatrix<double> dm(n, d, 0.);
+    for(size_t i = 0; i < n; ++i) {
+        for(size_t j = 0; j < d; ++j) {
+            if(mt() % 3 == 0) continue;
+            const double v = double(int(mt() % 9) - 2);
+            data.push_back(v); indices.push_back(j);
+            dm(i, j) = v;
+        }
+        indptr.push_back(data.size());
+    }
+    mc::util::CSparseMatrix<double, uint32_t, uint32_t> csm(data.data(), indices.data(), indptr.data(), n, d, data.size());
+    std::vector<uint32_t> asn(n);
+    for(size_t i = 0; i < n; ++i) asn[i] = i < 21 ? 0: 1;
+    std::vector<blaze::DynamicVector<double, blz::rowVector>> ctrs(k);
+    mc::sparse_l1_medians(csm, mc::AssignmentIndex<uint32_t>(asn, n, k), ctrs, static_cast<blz::DV<double> *>(nullptr));
+    for(size_t c = 0; c < k; ++c) {
+        for(size_t j = 0; j < d; ++j) {
+            std::vector<double> col;
+            for(size_t i = 0; i < n; ++i) if(asn[i] == c) col.push_back(dm(i, j));
+            std::nth_element(col.begin(), col.begin() + col.size() / 2, col.end());
+            assert(ctrs[c][j] == col[col.size() / 2]);
+        }
+    }
+    return 0;
+}
+
 int main() {
-    return test1() || test2() || test3();
+    return test1() || test2() || test3() || test4() || test5() || test6();
 }
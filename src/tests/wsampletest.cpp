@@ -0,0 +1,35 @@
+#undef NDEBUG
+#include "minicore/util/wsample.h"
+#include <cassert>
+#include <cstdio>
+
+using namespace minicore;
+
+int main() {
+    const size_t n = 200000, nlast = 100;
+    OMP_ONLY(omp_set_num_threads(4);)
+    // All of the weight is in the last chunk, and indices 2i and 2i + 1 there have weights 1 and 3
+    std::vector<double> w(n, 0.);
+    for(size_t i = n - nlast; i < n; ++i) w[i] = i % 2 ? 3.: 1.;
+    std::vector<uint32_t> out(40000);
+    parallel_weighted_sample_k(w.data(), n, out.size(), out.data(), 13);
+    assert(std::is_sorted(out.begin(), out.end()));
+    size_t nodd = 0;
+    for(const auto o: out) {
+        assert(o >= n - nlast);
+        nodd += o % 2;
+    }
+    assert(std::abs(double(nodd) / out.size() - .75) < .02);
+    // Inside another parallel region, the team may be smaller than the number of chunks; every chunk must still be summed
+    OMP_ONLY(omp_set_max_active_levels(1);)
+    int bad = 0;
+    OMP_PRAGMA("omp parallel for num_threads(4) reduction(+:bad)")
+    for(int r = 0; r < 16; ++r) {
+        bad += parallel_weighted_sample(w.data(), n, r + 1) < n - nlast;
+        std::vector<uint32_t> rout(50);
+        parallel_weighted_sample_k(w.data(), n, rout.size(), rout.data(), r + 1);
+        for(const auto o: rout) bad += o < n - nlast;
+    }
+    assert(bad == 0);
+    return EXIT_SUCCESS;
+}